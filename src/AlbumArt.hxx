@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+/**
+ * The file names which are recognized as album art by the "albumart"
+ * command, in order of preference.
+ */
+inline constexpr std::array<std::string_view, 3> album_art_names{
+	"cover.png",
+	"cover.jpg",
+	"cover.webp",
+};
+
+/**
+ * Is the given file name one of #album_art_names?
+ *
+ * @return the index into #album_art_names or album_art_names.size()
+ * if this is not an album art file
+ */
+[[gnu::pure]]
+inline std::size_t
+FindAlbumArtName(std::string_view name) noexcept
+{
+	return std::distance(album_art_names.begin(),
+			     std::find(album_art_names.begin(),
+				       album_art_names.end(), name));
+}
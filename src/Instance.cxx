@@ -6,9 +6,11 @@
 #include "Partition.hxx"
 #include "protocol/IdleFlags.hxx"
 #include "StateFile.hxx"
+#include "iostats/Logger.hxx"
 #include "Stats.hxx"
 #include "client/List.hxx"
 #include "input/cache/Manager.hxx"
+#include "Log.hxx"
 
 #ifdef ENABLE_CURL
 #include "RemoteTagCache.hxx"
@@ -214,6 +216,8 @@ Instance::FlushCaches() noexcept
 {
 	if (input_cache)
 		input_cache->Flush();
+
+	picture_cache.Flush();
 }
 
 void
@@ -241,8 +245,18 @@ Instance::OnStickerCleanupDone(bool changed) noexcept
 
 	sticker_cleanup.reset();
 
-	if (changed)
+	if (changed) {
+		/* the cleanup has deleted stickers using another
+		   connection */
+		try {
+			sticker_database->ReloadSongStickerColumns();
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to reload sticker columns");
+		}
+
 		EmitIdle(IDLE_STICKER);
+	}
 
 	if (need_sticker_cleanup)
 		StartStickerCleanup();
@@ -270,3 +284,13 @@ Instance::StartStickerCleanup()
 }
 
 #endif // ENABLE_SQLITE
+
+StickerColumnProvider *
+Instance::GetStickerColumnProvider() noexcept
+{
+#ifdef ENABLE_SQLITE
+	return sticker_database.get();
+#else
+	return nullptr;
+#endif
+}
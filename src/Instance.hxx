@@ -8,6 +8,7 @@
 #include "event/Loop.hxx"
 #include "event/Thread.hxx"
 #include "event/MaskMonitor.hxx"
+#include "PictureCache.hxx"
 
 #ifdef ENABLE_SYSTEMD_DAEMON
 #include "lib/systemd/Watchdog.hxx"
@@ -40,9 +41,11 @@ class ClientList;
 struct Partition;
 class AudioOutputControl;
 class StateFile;
+class IOStatsLogger;
 class RemoteTagCache;
 class StickerDatabase;
 class StickerCleanupService;
+class StickerColumnProvider;
 class InputCacheManager;
 
 /**
@@ -90,6 +93,11 @@ struct Instance final
 
 	std::unique_ptr<InputCacheManager> input_cache;
 
+	/**
+	 * Embedded pictures for the "readpicture" command.
+	 */
+	PictureCache picture_cache;
+
 	/**
 	 * Monitor for global idle events to be broadcasted to all
 	 * partitions.
@@ -126,6 +134,8 @@ struct Instance final
 
 	std::unique_ptr<StateFile> state_file;
 
+	std::unique_ptr<IOStatsLogger> io_stats_logger;
+
 #ifdef ENABLE_SQLITE
 	std::unique_ptr<StickerDatabase> sticker_database;
 
@@ -210,6 +220,14 @@ struct Instance final
 	void StartStickerCleanup();
 #endif
 
+	/**
+	 * Returns the object which provides sticker values to
+	 * SongFilter::Parse(), or nullptr if there is no sticker
+	 * database.
+	 */
+	[[gnu::pure]]
+	StickerColumnProvider *GetStickerColumnProvider() noexcept;
+
 	void BeginShutdownUpdate() noexcept;
 
 #ifdef ENABLE_CURL
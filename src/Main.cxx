@@ -8,6 +8,7 @@
 #include "PlaylistFile.hxx"
 #include "MusicChunk.hxx"
 #include "StateFile.hxx"
+#include "iostats/Logger.hxx"
 #include "Mapper.hxx"
 #include "Permission.hxx"
 #include "Listen.hxx"
@@ -239,7 +240,9 @@ LoadStickerDatabase(const ConfigData &config)
 	if (sticker_file.IsNull())
 		return nullptr;
 
-	return std::make_unique<StickerDatabase>(std::move(sticker_file));
+	auto db = std::make_unique<StickerDatabase>(std::move(sticker_file));
+	db->EnableWriteQueue();
+	return db;
 }
 
 #endif
@@ -257,6 +260,21 @@ glue_state_file_init(Instance &instance, const ConfigData &raw_config)
 	instance.state_file->Read();
 }
 
+static void
+glue_io_stats_init(Instance &instance, const ConfigData &raw_config)
+{
+	if (raw_config.GetParam(ConfigOption::IO_STATS_LOG_INTERVAL) == nullptr)
+		return;
+
+	const auto interval =
+		raw_config.GetDuration(ConfigOption::IO_STATS_LOG_INTERVAL,
+				       std::chrono::seconds{1},
+				       std::chrono::minutes{1});
+
+	instance.io_stats_logger =
+		std::make_unique<IOStatsLogger>(instance.event_loop, interval);
+}
+
 /**
  * Initialize the decoder and player core, including the music pipe.
  */
@@ -469,6 +487,7 @@ MainConfigured(const CommandLineOptions &options,
 #endif
 
 	glue_state_file_init(instance, raw_config);
+	glue_io_stats_init(instance, raw_config);
 
 #ifdef ENABLE_DATABASE
 	if (raw_config.GetBool(ConfigOption::AUTO_UPDATE, false)) {
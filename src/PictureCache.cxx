@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "PictureCache.hxx"
+#include "util/DeleteDisposer.hxx"
+
+#include <cassert>
+
+PictureCache::~PictureCache() noexcept
+{
+	Flush();
+}
+
+void
+PictureCache::Remove(Item &item) noexcept
+{
+	assert(size >= item.data.size());
+
+	size -= item.data.size();
+	lru.erase(lru.iterator_to(item));
+	map.erase(map.find(std::string_view{item.uri}));
+	delete &item;
+}
+
+const PictureCache::Item *
+PictureCache::Get(std::string_view uri,
+		  std::chrono::system_clock::time_point mtime) noexcept
+{
+	auto i = map.find(uri);
+	if (i == map.end()) {
+		++misses;
+		return nullptr;
+	}
+
+	Item &item = *i;
+	if (item.mtime != mtime) {
+		/* the file has been modified */
+		Remove(item);
+		++misses;
+		return nullptr;
+	}
+
+	/* move to the end of the LRU list */
+	lru.erase(lru.iterator_to(item));
+	lru.push_back(item);
+
+	++hits;
+	return &item;
+}
+
+void
+PictureCache::Put(std::string_view uri,
+		  std::chrono::system_clock::time_point mtime,
+		  std::string_view mime_type,
+		  std::span<const std::byte> data) noexcept
+{
+	if (data.size() > MAX_PICTURE_SIZE)
+		return;
+
+	if (auto i = map.find(uri); i != map.end())
+		Remove(*i);
+
+	while (!lru.empty() &&
+	       (size + data.size() > MAX_SIZE || map.size() >= MAX_ITEMS))
+		Remove(lru.front());
+
+	auto *item = new Item(uri, mtime, mime_type, data);
+	map.insert(*item);
+	lru.push_back(*item);
+	size += data.size();
+}
+
+void
+PictureCache::Flush() noexcept
+{
+	lru.clear();
+	map.clear_and_dispose(DeleteDisposer());
+	size = 0;
+}
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "util/AllocatedArray.hxx"
+#include "util/IntrusiveList.hxx"
+#include "util/IntrusiveHashSet.hxx"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+
+/**
+ * A cache for pictures embedded in song files.  Clients fetch
+ * pictures with the "readpicture" command in chunks at increasing
+ * offsets; this cache allows serving all chunks after the first one
+ * without parsing the song file again.
+ *
+ * Items are identified by the song URI and its modification time.
+ * The cache is shared by all clients; it is only accessed by the
+ * main thread and is therefore not thread-safe.
+ */
+class PictureCache final {
+	/**
+	 * The maximum total size of all cached pictures.
+	 */
+	static constexpr std::size_t MAX_SIZE = 16 * 1024 * 1024;
+
+	/**
+	 * Pictures larger than this are not cached.
+	 */
+	static constexpr std::size_t MAX_PICTURE_SIZE = 8 * 1024 * 1024;
+
+	/**
+	 * The maximum number of items (including songs without a
+	 * picture).
+	 */
+	static constexpr std::size_t MAX_ITEMS = 256;
+
+public:
+	struct Item final
+		: public IntrusiveHashSetHook<>,
+		  public IntrusiveListHook<>
+	{
+		const std::string uri;
+
+		const std::chrono::system_clock::time_point mtime;
+
+		/**
+		 * The MIME type of the picture; empty if unknown.
+		 */
+		const std::string mime_type;
+
+		/**
+		 * The picture data; empty if the song has no picture.
+		 */
+		const AllocatedArray<std::byte> data;
+
+		Item(std::string_view _uri,
+		     std::chrono::system_clock::time_point _mtime,
+		     std::string_view _mime_type,
+		     std::span<const std::byte> _data) noexcept
+			:uri(_uri), mtime(_mtime), mime_type(_mime_type),
+			 data(_data) {}
+
+		struct GetUri {
+			[[gnu::pure]]
+			std::string_view operator()(const Item &item) const noexcept {
+				return item.uri;
+			}
+		};
+	};
+
+private:
+	/**
+	 * All items; the least recently used one comes first.
+	 */
+	IntrusiveList<Item> lru;
+
+	IntrusiveHashSet<
+		Item, 127,
+		IntrusiveHashSetOperators<Item, Item::GetUri,
+					  std::hash<std::string_view>,
+					  std::equal_to<std::string_view>>,
+		IntrusiveHashSetBaseHookTraits<Item>,
+		IntrusiveHashSetOptions{.constant_time_size = true}> map;
+
+	/**
+	 * The total size of all pictures in this cache.
+	 */
+	std::size_t size = 0;
+
+	uint_least64_t hits = 0, misses = 0;
+
+public:
+	PictureCache() noexcept = default;
+	~PictureCache() noexcept;
+
+	PictureCache(const PictureCache &) = delete;
+	PictureCache &operator=(const PictureCache &) = delete;
+
+	/**
+	 * Look up the picture of the specified song.  Items with a
+	 * different modification time are discarded.
+	 *
+	 * @return the item or nullptr if the song is not in the cache
+	 */
+	const Item *Get(std::string_view uri,
+			std::chrono::system_clock::time_point mtime) noexcept;
+
+	/**
+	 * Add the picture of the specified song to the cache
+	 * (evicting old items if necessary).  Pictures which are too
+	 * large are ignored.
+	 *
+	 * @param data the picture data; empty if the song has no
+	 * picture
+	 */
+	void Put(std::string_view uri,
+		 std::chrono::system_clock::time_point mtime,
+		 std::string_view mime_type,
+		 std::span<const std::byte> data) noexcept;
+
+	/**
+	 * Remove all items.
+	 */
+	void Flush() noexcept;
+
+	uint_least64_t GetHits() const noexcept {
+		return hits;
+	}
+
+	uint_least64_t GetMisses() const noexcept {
+		return misses;
+	}
+
+private:
+	void Remove(Item &item) noexcept;
+};
@@ -4,6 +4,8 @@
 #include "SongPrint.hxx"
 #include "song/LightSong.hxx"
 #include "song/DetachedSong.hxx"
+#include "song/PrintCache.hxx"
+#include "protocol/BinaryRecords.hxx"
 #include "TimePrint.hxx"
 #include "TagPrint.hxx"
 #include "client/Response.hxx"
@@ -15,7 +17,7 @@
 
 #include <fmt/format.h>
 
-#define SONG_FILE "file: "
+#define SONG_FILE "file"
 
 static void
 song_print_uri(Response &r, const char *uri, bool base) noexcept
@@ -30,16 +32,19 @@ song_print_uri(Response &r, const char *uri, bool base) noexcept
 			uri = allocated.c_str();
 	}
 
-	r.Fmt(SONG_FILE "{}\n", uri);
+	r.WriteItem(SONG_FILE, uri);
 }
 
 void
 song_print_uri(Response &r, const LightSong &song, bool base) noexcept
 {
-	if (!base && song.directory != nullptr)
-		r.Fmt(SONG_FILE "{}/{}\n",
-		      song.directory, song.uri);
-	else
+	if (!base && song.directory != nullptr) {
+		if (r.GetRecordEncoder() != nullptr)
+			r.WriteItem(SONG_FILE, song.GetURI());
+		else
+			r.Fmt(SONG_FILE ": {}/{}\n",
+			      song.directory, song.uri);
+	} else
 		song_print_uri(r, song.uri, base);
 }
 
@@ -56,19 +61,45 @@ PrintRange(Response &r, SongTime start_time, SongTime end_time) noexcept
 	const unsigned end_ms = end_time.ToMS();
 
 	if (end_ms > 0)
-		r.Fmt("Range: {}.{:03}-{}.{:03}\n",
-		      start_ms / 1000,
-		      start_ms % 1000,
-		      end_ms / 1000,
-		      end_ms % 1000);
+		r.WriteItem("Range",
+			    fmt::format("{}.{:03}-{}.{:03}",
+					start_ms / 1000,
+					start_ms % 1000,
+					end_ms / 1000,
+					end_ms % 1000));
 	else if (start_ms > 0)
-		r.Fmt("Range: {}.{:03}-\n",
-		      start_ms / 1000,
-		      start_ms % 1000);
+		r.WriteItem("Range",
+			    fmt::format("{}.{:03}-",
+					start_ms / 1000,
+					start_ms % 1000));
 }
 
-void
-song_print_info(Response &r, const LightSong &song, bool base) noexcept
+static void
+PrintAudioFormat(Response &r, AudioFormat audio_format) noexcept
+{
+	if (r.GetRecordEncoder() != nullptr)
+		r.WriteItem("Format", fmt::format("{}", audio_format), true);
+	else
+		r.Fmt("Format: {}\n", audio_format);
+}
+
+static void
+PrintDuration(Response &r, SignedSongTime duration) noexcept
+{
+	if (auto *records = r.GetRecordEncoder()) {
+		/* in binary mode, the rounded "Time" is omitted
+		   because it is redundant */
+		records->Duration("duration", duration);
+		r.CommitRecords();
+	} else
+		r.Fmt("Time: {}\n"
+		      "duration: {:1.3f}\n",
+		      duration.RoundS(),
+		      duration.ToDoubleS());
+}
+
+static void
+PrintSongInfo(Response &r, const LightSong &song, bool base) noexcept
 {
 	song_print_uri(r, song, base);
 
@@ -81,16 +112,37 @@ song_print_info(Response &r, const LightSong &song, bool base) noexcept
 		time_print(r, "Added", song.added);
 
 	if (song.audio_format.IsDefined())
-		r.Fmt("Format: {}\n", song.audio_format);
+		PrintAudioFormat(r, song.audio_format);
 
 	tag_print_values(r, song.tag);
 
 	const auto duration = song.GetDuration();
 	if (!duration.IsNegative())
-		r.Fmt("Time: {}\n"
-		      "duration: {:1.3f}\n",
-		      duration.RoundS(),
-		      duration.ToDoubleS());
+		PrintDuration(r, duration);
+}
+
+void
+song_print_info(Response &r, const LightSong &song, bool base) noexcept
+{
+	if (song.print_cache == nullptr || r.GetRecordEncoder() != nullptr) {
+		PrintSongInfo(r, song, base);
+		return;
+	}
+
+	const auto tag_mask = r.GetTagMask();
+	if (const auto cached = song.print_cache->Get(tag_mask, base);
+	    !cached.empty()) {
+		r.Write(cached.data(), cached.size());
+		return;
+	}
+
+	std::string text;
+	r.SetCapture(&text);
+	PrintSongInfo(r, song, base);
+	r.SetCapture(nullptr);
+
+	r.Write(text.data(), text.size());
+	song.print_cache->Put(tag_mask, base, std::move(text));
 }
 
 void
@@ -107,14 +159,11 @@ song_print_info(Response &r, const DetachedSong &song, bool base) noexcept
 		time_print(r, "Added", song.GetAdded());
 
 	if (const auto &f = song.GetAudioFormat(); f.IsDefined())
-		r.Fmt("Format: {}\n", f);
+		PrintAudioFormat(r, f);
 
 	tag_print_values(r, song.GetTag());
 
 	const auto duration = song.GetDuration();
 	if (!duration.IsNegative())
-		r.Fmt("Time: {}\n"
-		      "duration: {:1.3f}\n",
-		      duration.RoundS(),
-		      duration.ToDoubleS());
+		PrintDuration(r, duration);
 }
@@ -92,6 +92,9 @@ db_stats_print(Response &r, const Database &db)
 	      stats.song_count,
 	      total_duration_s);
 
+	if (stats.memory_per_song > 0)
+		r.Fmt("db_memory_per_song: {}\n", stats.memory_per_song);
+
 	const auto update_stamp = db.GetUpdateStamp();
 	if (!IsNegative(update_stamp))
 		r.Fmt("db_update: {}\n",
@@ -119,4 +122,10 @@ stats_print(Response &r, const Partition &partition)
 	if (db != nullptr)
 		db_stats_print(r, *db);
 #endif
+
+	const auto &picture_cache = partition.instance.picture_cache;
+	r.Fmt("picture_cache_hits: {}\n"
+	      "picture_cache_misses: {}\n",
+	      picture_cache.GetHits(),
+	      picture_cache.GetMisses());
 }
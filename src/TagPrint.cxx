@@ -27,16 +27,15 @@ tag_print_types_available(Response &r) noexcept
 }
 
 void
-tag_print(Response &r, TagType type, std::string_view _value) noexcept
+tag_print(Response &r, TagType type, std::string_view value) noexcept
 {
-	const std::string_view value{_value};
-	r.Fmt("{}: {}\n", tag_item_names[type], value);
+	r.WriteItem(tag_item_names[type], value, true);
 }
 
 void
 tag_print(Response &r, TagType type, const char *value) noexcept
 {
-	r.Fmt("{}: {}\n", tag_item_names[type], value);
+	r.WriteItem(tag_item_names[type], value, true);
 }
 
 void
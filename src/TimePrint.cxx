@@ -3,6 +3,7 @@
 
 #include "TimePrint.hxx"
 #include "client/Response.hxx"
+#include "protocol/BinaryRecords.hxx"
 #include "time/ISO8601.hxx"
 #include "util/StringBuffer.hxx"
 
@@ -12,6 +13,12 @@ void
 time_print(Response &r, const char *name,
 	   std::chrono::system_clock::time_point t)
 {
+	if (auto *records = r.GetRecordEncoder()) {
+		records->Time(name, t);
+		r.CommitRecords();
+		return;
+	}
+
 	StringBuffer<64> s;
 
 	try {
@@ -10,6 +10,7 @@
 #include "util/StringUtil.hxx"
 #include "plugins/Bzip2ArchivePlugin.hxx"
 #include "plugins/Iso9660ArchivePlugin.hxx"
+#include "plugins/ZipArchivePlugin.hxx"
 #include "plugins/ZzipArchivePlugin.hxx"
 
 #include <cassert>
@@ -20,6 +21,9 @@ constinit const ArchivePlugin *const archive_plugins[] = {
 #ifdef ENABLE_BZ2
 	&bz2_archive_plugin,
 #endif
+#ifdef ENABLE_ZIP
+	&zip_archive_plugin,
+#endif
 #ifdef ENABLE_ZZIP
 	&zzip_archive_plugin,
 #endif
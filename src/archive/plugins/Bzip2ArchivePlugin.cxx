@@ -6,27 +6,560 @@
   */
 
 #include "Bzip2ArchivePlugin.hxx"
+#include "Bzip2Block.hxx"
 #include "../ArchivePlugin.hxx"
 #include "../ArchiveFile.hxx"
 #include "../ArchiveVisitor.hxx"
 #include "input/InputStream.hxx"
 #include "input/LocalOpen.hxx"
+#include "fs/FileInfo.hxx"
 #include "fs/NarrowPath.hxx"
 #include "fs/Path.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
 
 #include <bzlib.h>
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <list>
+#include <memory>
+#include <optional>
+#include <span>
 #include <stdexcept>
+#include <string>
 #include <utility>
+#include <vector>
+
+/**
+ * A bzip2 file with an index of its blocks.  Instances are shared by
+ * all streams reading the same file, and are kept in a small cache,
+ * so the file is scanned only once.
+ *
+ * The index is built lazily: the file is scanned for block headers
+ * only as far as a stream (or its #Bzip2Prefetcher) needs the next
+ * block.  The uncompressed size of a block is only known after it
+ * has been decompressed; this class remembers the uncompressed
+ * offsets of all blocks from the beginning of the file up to the
+ * first block which has not been decompressed yet.
+ *
+ * If a block cannot be decompressed on its own (e.g. because the
+ * scanner has mistaken a bit pattern inside a block for a block
+ * header), the index is marked as broken, and streams fall back to
+ * decompressing the file sequentially (see #Bzip2StreamDecoder).
+ */
+class Bzip2Source {
+	const std::string path;
+
+	/**
+	 * The size and modification time of the file when it was
+	 * opened; used to invalidate cache entries.
+	 */
+	const uint_least64_t file_size;
+	const std::chrono::system_clock::time_point mtime;
+
+	/**
+	 * Serializes all file access: #input, #scanner,
+	 * #scan_offset and #scan_complete.  This is held for the
+	 * whole Seek()/Read() sequence, because #input releases
+	 * #input_mutex while reading.
+	 */
+	Mutex io_mutex;
+
+	/**
+	 * The mutex passed to #input.
+	 */
+	Mutex input_mutex;
+
+	const InputStreamPtr input;
+
+	/**
+	 * Finds the blocks; it is fed on demand by HasBlock().
+	 */
+	Bzip2BlockScanner scanner;
+
+	/**
+	 * The number of bytes which have been fed into #scanner.
+	 */
+	uint_least64_t scan_offset = 0;
+
+	/**
+	 * Has the whole file been fed into #scanner?
+	 */
+	bool scan_complete = false;
+
+	/**
+	 * Protects #block_count, #offsets and #index_broken.
+	 */
+	mutable Mutex mutex;
+
+	/**
+	 * The total number of blocks, or SIZE_MAX if the file has not
+	 * been scanned completely yet.
+	 */
+	std::size_t block_count = SIZE_MAX;
+
+	/**
+	 * The uncompressed offsets of the first blocks.  It always
+	 * contains one element more than the number of blocks with
+	 * known sizes; the last one is the end of the last known
+	 * block.
+	 */
+	std::vector<uint_least64_t> offsets{0};
+
+	/**
+	 * Has a block failed to decompress, or is the file
+	 * truncated?  Then the index cannot be used.
+	 */
+	bool index_broken = false;
+
+public:
+	Bzip2Source(Path _path, const FileInfo &info)
+		:path(NarrowPath(_path)),
+		 file_size(info.GetSize()), mtime(info.GetModificationTime()),
+		 input(OpenLocalInputStream(_path, input_mutex)) {}
+
+	[[gnu::pure]]
+	bool IsSame(Path other_path, const FileInfo &info) const noexcept {
+		return IsPath(other_path) &&
+			file_size == info.GetSize() &&
+			mtime == info.GetModificationTime();
+	}
+
+	[[gnu::pure]]
+	bool IsPath(Path other_path) const noexcept {
+		return path == NarrowPath(other_path).c_str();
+	}
+
+	[[gnu::pure]]
+	bool IsIndexBroken() const noexcept {
+		const std::scoped_lock lock{mutex};
+		return index_broken;
+	}
+
+	/**
+	 * Does the specified block exist?  Scans the file as far as
+	 * necessary to find out.  This may be called from any
+	 * thread.
+	 *
+	 * Throws on error; if the file is truncated, the index is
+	 * marked as broken.
+	 */
+	bool HasBlock(std::size_t i);
+
+	/**
+	 * Read and decompress the specified block (which must have
+	 * been found by HasBlock()).  This may be called from any
+	 * thread.
+	 *
+	 * Throws on error; if the block cannot be decompressed, the
+	 * index is marked as broken.
+	 */
+	std::vector<std::byte> Decode(std::size_t i);
+
+	/**
+	 * Read compressed data from the file (for
+	 * #Bzip2StreamDecoder).  This may be called from any
+	 * thread.
+	 *
+	 * Throws on error.
+	 *
+	 * @return the number of bytes read; 0 at the end of the file
+	 */
+	std::size_t ReadAt(uint_least64_t offset, std::span<std::byte> dest);
+
+	/**
+	 * Remember the uncompressed size of a block.  This extends
+	 * the list of known offsets if all previous sizes are known.
+	 */
+	void SetBlockSize(std::size_t i, std::size_t size) noexcept {
+		const std::scoped_lock lock{mutex};
+		if (i == offsets.size() - 1)
+			offsets.push_back(offsets.back() + size);
+	}
+
+	struct BlockPosition {
+		std::size_t index;
+		uint_least64_t offset;
+	};
+
+	/**
+	 * Find the block which contains the given uncompressed
+	 * offset.
+	 *
+	 * @return the block or nullopt if its offset is not yet known
+	 */
+	[[gnu::pure]]
+	std::optional<BlockPosition> FindBlock(uint_least64_t offset) const noexcept;
+
+	/**
+	 * @return the first block whose size is not yet known (may be
+	 * equal to the number of blocks if all sizes are known)
+	 */
+	[[gnu::pure]]
+	BlockPosition GetFirstUnknown() const noexcept {
+		const std::scoped_lock lock{mutex};
+		return {offsets.size() - 1, offsets.back()};
+	}
+
+	/**
+	 * @return the uncompressed size or nullopt if not yet known
+	 */
+	[[gnu::pure]]
+	std::optional<uint_least64_t> GetSize() const noexcept {
+		const std::scoped_lock lock{mutex};
+		if (offsets.size() <= block_count)
+			return std::nullopt;
+		return offsets.back();
+	}
+
+private:
+	void MarkIndexBroken() noexcept {
+		const std::scoped_lock lock{mutex};
+		index_broken = true;
+	}
+
+	/**
+	 * Feed the next chunk of the file into #scanner.
+	 *
+	 * Caller must lock #io_mutex.
+	 */
+	void ScanChunk();
+};
+
+void
+Bzip2Source::ScanChunk()
+{
+	std::byte buffer[16384];
+	std::size_t nbytes;
+
+	{
+		std::unique_lock lock{input_mutex};
+		input->Seek(lock, scan_offset);
+		nbytes = input->Read(lock, buffer);
+	}
+
+	if (nbytes > 0) {
+		scanner.Feed(std::span{buffer}.first(nbytes));
+		scan_offset += nbytes;
+		return;
+	}
+
+	scan_complete = true;
+
+	if (scanner.IsInBlock()) {
+		MarkIndexBroken();
+	} else {
+		const std::scoped_lock lock{mutex};
+		block_count = scanner.GetCompleteBlocks().size();
+	}
+}
+
+bool
+Bzip2Source::HasBlock(std::size_t i)
+{
+	const std::scoped_lock lock{io_mutex};
+
+	while (i >= scanner.GetCompleteBlocks().size()) {
+		if (scan_complete) {
+			if (scanner.IsInBlock())
+				throw std::runtime_error("Unexpected end of bzip2 file");
+
+			return false;
+		}
+
+		ScanChunk();
+	}
+
+	return true;
+}
+
+std::vector<std::byte>
+Bzip2Source::Decode(std::size_t i)
+{
+	Bzip2Block block;
+	std::vector<std::byte> compressed;
+
+	{
+		const std::scoped_lock lock{io_mutex};
+		assert(i < scanner.GetCompleteBlocks().size());
+		block = scanner.GetCompleteBlocks()[i];
+
+		compressed.resize(block.GetByteSize());
+
+		std::unique_lock input_lock{input_mutex};
+		input->Seek(input_lock, block.GetByteOffset());
+		input->ReadFull(input_lock, compressed);
+	}
+
+	try {
+		return Bzip2DecodeBlock(block, compressed);
+	} catch (...) {
+		/* this is probably not a block boundary, but a
+		   random bit pattern inside a block which looks like
+		   a block header */
+		MarkIndexBroken();
+		throw;
+	}
+}
+
+std::size_t
+Bzip2Source::ReadAt(uint_least64_t offset, std::span<std::byte> dest)
+{
+	const std::scoped_lock lock{io_mutex};
+	std::unique_lock input_lock{input_mutex};
+	input->Seek(input_lock, offset);
+	return input->Read(input_lock, dest);
+}
+
+std::optional<Bzip2Source::BlockPosition>
+Bzip2Source::FindBlock(uint_least64_t offset) const noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	auto i = std::upper_bound(offsets.begin(), offsets.end(), offset);
+	if (i == offsets.end())
+		/* beyond the last known block */
+		return std::nullopt;
+
+	const std::size_t index = std::distance(offsets.begin(), i) - 1;
+	return BlockPosition{index, offsets[index]};
+}
+
+/**
+ * Decompresses the whole file sequentially with libbz2, without the
+ * block index.  This is the fallback if the index is broken (see
+ * Bzip2Source::IsIndexBroken()).
+ */
+class Bzip2StreamDecoder {
+	Bzip2Source &source;
+
+	bz_stream bz{};
+
+	/**
+	 * The compressed offset of the end of #buffer.
+	 */
+	uint_least64_t input_offset = 0;
+
+	/**
+	 * The number of uncompressed bytes returned so far.
+	 */
+	uint_least64_t output_offset = 0;
+
+	/**
+	 * Has #bz just been restarted for another stream
+	 * concatenated to the previous one?
+	 */
+	bool new_stream = false;
+
+	bool eof = false;
+
+	std::byte buffer[16384];
+
+public:
+	explicit Bzip2StreamDecoder(Bzip2Source &_source)
+		:source(_source) {
+		Init();
+	}
+
+	~Bzip2StreamDecoder() noexcept {
+		BZ2_bzDecompressEnd(&bz);
+	}
+
+	Bzip2StreamDecoder(const Bzip2StreamDecoder &) = delete;
+	Bzip2StreamDecoder &operator=(const Bzip2StreamDecoder &) = delete;
+
+	uint_least64_t GetOffset() const noexcept {
+		return output_offset;
+	}
+
+	/**
+	 * Throws on error.
+	 *
+	 * @return the number of bytes; 0 at the end of the file
+	 */
+	std::size_t Read(std::span<std::byte> dest);
+
+	/**
+	 * Continue decompressing at the given uncompressed offset;
+	 * this restarts from the beginning of the file if the offset
+	 * is before the current one.
+	 *
+	 * Throws on error.
+	 */
+	void SeekTo(uint_least64_t new_offset);
+
+private:
+	void Init() {
+		if (BZ2_bzDecompressInit(&bz, 0, 0) != BZ_OK)
+			throw std::runtime_error("BZ2_bzDecompressInit() has failed");
+	}
+
+	/**
+	 * Restart the decompressor for the next stream, keeping the
+	 * input and output buffers.
+	 */
+	void Restart() {
+		bz_stream old = bz;
+		BZ2_bzDecompressEnd(&bz);
+		bz = {};
+		Init();
+
+		bz.next_in = old.next_in;
+		bz.avail_in = old.avail_in;
+		bz.next_out = old.next_out;
+		bz.avail_out = old.avail_out;
+		new_stream = true;
+	}
+};
+
+std::size_t
+Bzip2StreamDecoder::Read(std::span<std::byte> dest)
+{
+	if (eof)
+		return 0;
+
+	bz.next_out = reinterpret_cast<char *>(dest.data());
+	bz.avail_out = dest.size();
+
+	do {
+		if (bz.avail_in == 0) {
+			const std::size_t nbytes = source.ReadAt(input_offset,
+								 buffer);
+			input_offset += nbytes;
+			bz.next_in = reinterpret_cast<char *>(buffer);
+			bz.avail_in = nbytes;
+		}
+
+		const bool had_input = bz.avail_in > 0;
+
+		const int ret = BZ2_bzDecompress(&bz);
+
+		if (ret == BZ_DATA_ERROR_MAGIC && new_stream) {
+			/* like bunzip2, ignore trailing garbage */
+			eof = true;
+			break;
+		}
+
+		if (ret == BZ_STREAM_END) {
+			if (bz.avail_in == 0) {
+				/* is there another stream concatenated
+				   to this one (e.g. from pbzip2)? */
+				const std::size_t nbytes =
+					source.ReadAt(input_offset, buffer);
+				input_offset += nbytes;
+				bz.next_in = reinterpret_cast<char *>(buffer);
+				bz.avail_in = nbytes;
+			}
+
+			if (bz.avail_in == 0) {
+				eof = true;
+				break;
+			}
+
+			Restart();
+			continue;
+		}
+
+		if (ret != BZ_OK)
+			throw std::runtime_error("BZ2_bzDecompress() has failed");
+
+		new_stream = false;
+
+		if (!had_input && bz.avail_out == dest.size())
+			throw std::runtime_error("Unexpected end of bzip2 file");
+	} while (bz.avail_out == dest.size());
+
+	const std::size_t nbytes = dest.size() - bz.avail_out;
+	output_offset += nbytes;
+	return nbytes;
+}
+
+void
+Bzip2StreamDecoder::SeekTo(uint_least64_t new_offset)
+{
+	if (new_offset < output_offset) {
+		/* rewind */
+		BZ2_bzDecompressEnd(&bz);
+		bz = {};
+		Init();
+		input_offset = output_offset = 0;
+		new_stream = eof = false;
+	}
+
+	std::byte discard[16384];
+	while (output_offset < new_offset) {
+		const std::size_t nbytes =
+			Read(std::span{discard}.first(std::min<uint_least64_t>(sizeof(discard),
+									       new_offset - output_offset)));
+		if (nbytes == 0)
+			throw std::runtime_error("Seek beyond end of bzip2 file");
+	}
+}
+
+/**
+ * The maximum number of #Bzip2Source instances kept in
+ * #bz2_source_cache.
+ */
+static constexpr std::size_t BZ2_SOURCE_CACHE_SIZE = 4;
+
+static Mutex bz2_source_cache_mutex;
+
+/**
+ * Recently used files, the most recently used one first.
+ */
+static std::list<std::shared_ptr<Bzip2Source>> bz2_source_cache;
+
+static std::shared_ptr<Bzip2Source>
+OpenBzip2Source(Path path)
+{
+	const FileInfo info{path};
+
+	const std::scoped_lock lock{bz2_source_cache_mutex};
+	for (auto i = bz2_source_cache.begin();
+	     i != bz2_source_cache.end(); ++i) {
+		if ((*i)->IsSame(path, info)) {
+			/* move to the front */
+			bz2_source_cache.splice(bz2_source_cache.begin(),
+						bz2_source_cache, i);
+			return *i;
+		}
+	}
+
+	auto source = std::make_shared<Bzip2Source>(path, info);
+
+	/* remove stale entries of this file */
+	bz2_source_cache.remove_if([path](const auto &i){
+		return i->IsPath(path);
+	});
+
+	bz2_source_cache.push_front(source);
+	if (bz2_source_cache.size() > BZ2_SOURCE_CACHE_SIZE)
+		bz2_source_cache.pop_back();
+
+	return source;
+}
+
+static void
+bz2_finish() noexcept
+{
+	const std::scoped_lock lock{bz2_source_cache_mutex};
+	bz2_source_cache.clear();
+}
 
 class Bzip2ArchiveFile final : public ArchiveFile {
 	std::string name;
-	std::shared_ptr<InputStream> istream;
+	std::shared_ptr<Bzip2Source> source;
 
 public:
-	Bzip2ArchiveFile(Path path, InputStreamPtr &&_is)
+	Bzip2ArchiveFile(Path path, std::shared_ptr<Bzip2Source> &&_source)
 		:name(NarrowPath(path.GetBase())),
-		 istream(std::move(_is)) {
+		 source(std::move(_source)) {
 		// remove .bz2 suffix
 		const size_t len = name.length();
 		if (len > 4)
@@ -41,32 +574,217 @@ public:
 				  Mutex &mutex) override;
 };
 
+/**
+ * Decompresses the next block in a separate thread while the
+ * current one is being consumed, so decompression runs in parallel
+ * with the decoder.
+ */
+class Bzip2Prefetcher {
+	Bzip2Source &source;
+
+	Thread thread{BIND_THIS_METHOD(Run)};
+
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * The block which shall be decompressed next, or
+	 * #NONE.
+	 */
+	std::size_t requested = NONE;
+
+	/**
+	 * The block which is being decompressed, or #NONE.
+	 */
+	std::size_t busy = NONE;
+
+	/**
+	 * The block in #ready_data / #error, or #NONE.
+	 */
+	std::size_t ready = NONE;
+
+	std::vector<std::byte> ready_data;
+	std::exception_ptr error;
+
+	bool quit = false;
+
+public:
+	static constexpr std::size_t NONE = SIZE_MAX;
+
+	explicit Bzip2Prefetcher(Bzip2Source &_source) noexcept
+		:source(_source) {}
+
+	~Bzip2Prefetcher() noexcept {
+		if (!thread.IsDefined())
+			return;
+
+		{
+			const std::scoped_lock lock{mutex};
+			quit = true;
+			cond.notify_one();
+		}
+
+		thread.Join();
+	}
+
+	Bzip2Prefetcher(const Bzip2Prefetcher &) = delete;
+	Bzip2Prefetcher &operator=(const Bzip2Prefetcher &) = delete;
+
+	/**
+	 * Start decompressing the given block in the background.
+	 */
+	void Request(std::size_t i) {
+		if (!thread.IsDefined())
+			thread.Start();
+
+		const std::scoped_lock lock{mutex};
+		if (ready == i || busy == i)
+			return;
+
+		requested = i;
+		cond.notify_one();
+	}
+
+	/**
+	 * Obtain the given block if it has been requested; waits for
+	 * the thread to finish it.  Throws if decompression has
+	 * failed.
+	 *
+	 * @return the block or nullopt if it has not been requested
+	 */
+	std::optional<std::vector<std::byte>> Take(std::size_t i) {
+		std::unique_lock lock{mutex};
+		if (requested == i)
+			/* not yet started: do it in this thread
+			   instead of waiting */
+			requested = NONE;
+
+		cond.wait(lock, [this, i]{ return busy != i; });
+
+		if (ready != i)
+			return std::nullopt;
+
+		ready = NONE;
+
+		if (error)
+			std::rethrow_exception(std::exchange(error, {}));
+
+		return std::move(ready_data);
+	}
+
+private:
+	void Run() noexcept;
+};
+
+void
+Bzip2Prefetcher::Run() noexcept
+{
+	SetThreadName("bzip2");
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		cond.wait(lock, [this]{ return quit || requested != NONE; });
+		if (quit)
+			break;
+
+		busy = std::exchange(requested, NONE);
+		std::vector<std::byte> data;
+		std::exception_ptr e;
+		bool found = true;
+
+		{
+			const ScopeUnlock unlock(mutex);
+
+			try {
+				found = source.HasBlock(busy);
+				if (found)
+					data = source.Decode(busy);
+			} catch (...) {
+				e = std::current_exception();
+			}
+		}
+
+		/* a block beyond the end of the file is never
+		   "ready" */
+		ready = found ? busy : NONE;
+		busy = NONE;
+		ready_data = std::move(data);
+		error = std::move(e);
+		cond.notify_all();
+	}
+}
+
 class Bzip2InputStream final : public InputStream {
-	std::shared_ptr<InputStream> input;
+	const std::shared_ptr<Bzip2Source> source;
 
-	bz_stream bzstream{};
+	Bzip2Prefetcher prefetcher{*source};
 
-	bool eof = false;
+	/**
+	 * The index of the block in #data, or Bzip2Prefetcher::NONE
+	 * if no block has been loaded yet.
+	 */
+	std::size_t block = Bzip2Prefetcher::NONE;
+
+	/**
+	 * The uncompressed offset of #data.
+	 */
+	uint_least64_t block_offset = 0;
 
-	std::byte buffer[5000];
+	/**
+	 * The uncompressed contents of the current block.
+	 */
+	std::vector<std::byte> data;
+
+	/**
+	 * If this is set, the block index is broken, and the file is
+	 * decompressed sequentially.
+	 */
+	std::unique_ptr<Bzip2StreamDecoder> sequential;
+
+	bool eof = false;
 
 public:
-	Bzip2InputStream(std::shared_ptr<InputStream> _input,
+	Bzip2InputStream(std::shared_ptr<Bzip2Source> &&_source,
 			 const char *uri,
 			 Mutex &mutex);
-	~Bzip2InputStream() noexcept override;
-
-	Bzip2InputStream(const Bzip2InputStream &) = delete;
-	Bzip2InputStream &operator=(const Bzip2InputStream &) = delete;
 
 	/* virtual methods from InputStream */
 	[[nodiscard]] bool IsEOF() const noexcept override;
 	size_t Read(std::unique_lock<Mutex> &lock,
 		    std::span<std::byte> dest) override;
+	void Seek(std::unique_lock<Mutex> &lock, offset_type offset) override;
 
 private:
-	void Open();
-	bool FillBuffer();
+	void LoadBlock(std::size_t i, uint_least64_t i_offset);
+
+	/**
+	 * Load the block containing the given offset.
+	 *
+	 * @return false if the offset is at the end of the file
+	 */
+	bool LoadBlockAt(uint_least64_t new_offset);
+
+	/**
+	 * Like LoadBlockAt(), but if the block index turns out to be
+	 * broken, switch to sequential decompression.
+	 *
+	 * @return false if the offset is at the end of the file
+	 * (always true in sequential mode)
+	 */
+	bool LoadOrFallBack(uint_least64_t new_offset);
+
+	/**
+	 * Switch to sequential decompression, continuing at the
+	 * given offset.
+	 */
+	void StartSequential(uint_least64_t new_offset);
+
+	void UpdateSize() noexcept {
+		if (!KnownSize())
+			if (const auto s = source->GetSize())
+				size = *s;
+	}
 };
 
 /* archive open && listing routine */
@@ -74,52 +792,118 @@ private:
 static std::unique_ptr<ArchiveFile>
 bz2_open(Path pathname)
 {
-	static Mutex mutex;
-	auto is = OpenLocalInputStream(pathname, mutex);
-	return std::make_unique<Bzip2ArchiveFile>(pathname, std::move(is));
+	return std::make_unique<Bzip2ArchiveFile>(pathname,
+						  OpenBzip2Source(pathname));
 }
 
 /* single archive handling */
 
-Bzip2InputStream::Bzip2InputStream(std::shared_ptr<InputStream> _input,
+Bzip2InputStream::Bzip2InputStream(std::shared_ptr<Bzip2Source> &&_source,
 				   const char *_uri,
 				   Mutex &_mutex)
 	:InputStream(_uri, _mutex),
-	 input(std::move(_input))
+	 source(std::move(_source))
 {
-	bzstream.next_in = (char *)buffer;
+	seekable = true;
 
-	int ret = BZ2_bzDecompressInit(&bzstream, 0, 0);
-	if (ret != BZ_OK)
-		throw std::runtime_error("BZ2_bzDecompressInit() has failed");
+	/* the size is known if another stream has already read the
+	   whole file */
+	if (const auto s = source->GetSize())
+		size = *s;
 
-	SetReady();
-}
+	if (source->IsIndexBroken())
+		/* another stream has already found out that the
+		   index is unusable */
+		sequential = std::make_unique<Bzip2StreamDecoder>(*source);
 
-Bzip2InputStream::~Bzip2InputStream() noexcept
-{
-	BZ2_bzDecompressEnd(&bzstream);
+	SetReady();
 }
 
 InputStreamPtr
 Bzip2ArchiveFile::OpenStream(const char *path,
 			     Mutex &mutex)
 {
-	return std::make_unique<Bzip2InputStream>(istream, path, mutex);
+	/* the block index is built lazily while reading, see
+	   Bzip2Source::HasBlock() */
+	return std::make_unique<Bzip2InputStream>(std::shared_ptr<Bzip2Source>{source},
+						  path, mutex);
+}
+
+void
+Bzip2InputStream::LoadBlock(std::size_t i, uint_least64_t i_offset)
+{
+	if (auto prefetched = prefetcher.Take(i))
+		data = std::move(*prefetched);
+	else
+		data = source->Decode(i);
+
+	block = i;
+	block_offset = i_offset;
+	source->SetBlockSize(i, data.size());
+
+	/* the prefetcher scans for the next block, and ignores the
+	   request if there is none */
+	prefetcher.Request(i + 1);
 }
 
-inline bool
-Bzip2InputStream::FillBuffer()
+bool
+Bzip2InputStream::LoadBlockAt(uint_least64_t new_offset)
 {
-	if (bzstream.avail_in > 0)
+	if (block != Bzip2Prefetcher::NONE && new_offset >= block_offset &&
+	    new_offset < block_offset + data.size())
+		/* already loaded */
 		return true;
 
-	size_t count = input->LockRead(buffer);
-	if (count == 0)
-		return false;
+	if (const auto p = source->FindBlock(new_offset)) {
+		LoadBlock(p->index, p->offset);
+		return true;
+	}
+
+	/* the offset is beyond the blocks whose sizes are known:
+	   decompress the following blocks until we get there */
+	auto p = source->GetFirstUnknown();
+	while (source->HasBlock(p.index)) {
+		LoadBlock(p.index, p.offset);
+		if (new_offset < block_offset + data.size())
+			return true;
+
+		++p.index;
+		p.offset += data.size();
+	}
+
+	if (new_offset > p.offset)
+		throw std::runtime_error("Seek beyond end of bzip2 file");
+
+	return false;
+}
 
-	bzstream.next_in = reinterpret_cast<char *>(buffer);
-	bzstream.avail_in = count;
+void
+Bzip2InputStream::StartSequential(uint_least64_t new_offset)
+{
+	block = Bzip2Prefetcher::NONE;
+	data = {};
+
+	auto s = std::make_unique<Bzip2StreamDecoder>(*source);
+	s->SeekTo(new_offset);
+	sequential = std::move(s);
+}
+
+bool
+Bzip2InputStream::LoadOrFallBack(uint_least64_t new_offset)
+{
+	if (sequential) {
+		sequential->SeekTo(new_offset);
+		return true;
+	}
+
+	try {
+		return LoadBlockAt(new_offset);
+	} catch (...) {
+		if (!source->IsIndexBroken())
+			throw;
+	}
+
+	StartSequential(new_offset);
 	return true;
 }
 
@@ -129,34 +913,52 @@ Bzip2InputStream::Read(std::unique_lock<Mutex> &, std::span<std::byte> dest)
 	if (eof)
 		return 0;
 
-	const ScopeUnlock unlock(mutex);
-
-	bzstream.next_out = reinterpret_cast<char *>(dest.data());
-	bzstream.avail_out = dest.size();
-
-	do {
-		const bool had_input = FillBuffer();
+	std::size_t nbytes;
 
-		const int bz_result = BZ2_bzDecompress(&bzstream);
+	{
+		const ScopeUnlock unlock(mutex);
 
-		if (bz_result == BZ_STREAM_END) {
-			eof = true;
-			break;
+		if (!LoadOrFallBack(offset)) {
+			nbytes = 0;
+		} else if (sequential) {
+			nbytes = sequential->Read(dest);
+		} else {
+			const std::size_t position = offset - block_offset;
+			nbytes = std::min(dest.size(), data.size() - position);
+			std::copy_n(data.begin() + position, nbytes,
+				    dest.begin());
 		}
+	}
 
-		if (bz_result != BZ_OK)
-			throw std::runtime_error("BZ2_bzDecompress() has failed");
+	offset += nbytes;
 
-		if (!had_input && bzstream.avail_out == dest.size())
-			throw std::runtime_error("Unexpected end of bzip2 file");
-	} while (bzstream.avail_out == dest.size());
+	if (nbytes == 0) {
+		eof = true;
+		if (!KnownSize())
+			size = offset;
+		return 0;
+	}
 
-	const size_t nbytes = dest.size() - bzstream.avail_out;
-	offset += nbytes;
+	UpdateSize();
+
+	if (KnownSize() && offset == size)
+		eof = true;
 
 	return nbytes;
 }
 
+void
+Bzip2InputStream::Seek(std::unique_lock<Mutex> &, offset_type new_offset)
+{
+	{
+		const ScopeUnlock unlock(mutex);
+		eof = !LoadOrFallBack(new_offset);
+	}
+
+	offset = new_offset;
+	UpdateSize();
+}
+
 bool
 Bzip2InputStream::IsEOF() const noexcept
 {
@@ -173,7 +975,7 @@ static constexpr const char *bz2_extensions[] = {
 const ArchivePlugin bz2_archive_plugin = {
 	"bz2",
 	nullptr,
-	nullptr,
+	bz2_finish,
 	bz2_open,
 	bz2_extensions,
 };
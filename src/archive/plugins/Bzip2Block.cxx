@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Bzip2Block.hxx"
+
+#include <bzlib.h>
+
+#include <cassert>
+#include <stdexcept>
+
+static constexpr uint_least64_t BZIP2_MAGIC_MASK = 0xffffffffffff;
+static constexpr uint_least64_t BZIP2_BLOCK_MAGIC = 0x314159265359;
+static constexpr uint_least64_t BZIP2_EOS_MAGIC = 0x177245385090;
+
+void
+Bzip2BlockScanner::Feed(std::span<const std::byte> src) noexcept
+{
+	for (const std::byte b : src) {
+		for (int bit = 7; bit >= 0; --bit) {
+			window = (window << 1) | ((std::to_integer<unsigned>(b) >> bit) & 1);
+			++position;
+
+			const auto magic = window & BZIP2_MAGIC_MASK;
+			if (magic == BZIP2_BLOCK_MAGIC && position >= 48) {
+				if (in_block)
+					blocks.back().end = position - 48;
+
+				blocks.push_back({position - 48, 0});
+				in_block = true;
+			} else if (magic == BZIP2_EOS_MAGIC && in_block) {
+				blocks.back().end = position - 48;
+				in_block = false;
+			}
+		}
+	}
+}
+
+std::vector<Bzip2Block>
+Bzip2BlockScanner::Finish()
+{
+	if (in_block)
+		throw std::runtime_error("Unexpected end of bzip2 file");
+
+	return std::move(blocks);
+}
+
+namespace {
+
+/**
+ * Helper class which writes a bit stream, most significant bit
+ * first.
+ */
+class BitWriter {
+	std::vector<std::byte> &dest;
+
+	/**
+	 * Pending bits which do not yet fill a whole byte.
+	 */
+	unsigned pending = 0, n_pending = 0;
+
+public:
+	explicit BitWriter(std::vector<std::byte> &_dest) noexcept
+		:dest(_dest) {}
+
+	void Write(uint_least64_t value, unsigned n_bits) {
+		while (n_bits > 0) {
+			--n_bits;
+			pending = (pending << 1) | ((value >> n_bits) & 1);
+			if (++n_pending == 8) {
+				dest.push_back(std::byte(pending));
+				pending = n_pending = 0;
+			}
+		}
+	}
+
+	/**
+	 * Copy bits from a buffer.
+	 *
+	 * @param first_bit the bit offset within src[0]
+	 */
+	void Copy(std::span<const std::byte> src, unsigned first_bit,
+		  uint_least64_t n_bits) {
+		assert(n_pending == 0);
+		assert(first_bit < 8);
+
+		const std::size_t n_bytes = n_bits / 8;
+		dest.reserve(dest.size() + n_bytes + 16);
+
+		/* whole bytes: combine two source bytes each */
+		if (first_bit == 0) {
+			dest.insert(dest.end(), src.begin(), src.begin() + n_bytes);
+		} else {
+			for (std::size_t i = 0; i < n_bytes; ++i) {
+				const unsigned a = std::to_integer<unsigned>(src[i]);
+				const unsigned b = std::to_integer<unsigned>(src[i + 1]);
+				dest.push_back(std::byte((a << first_bit) | (b >> (8 - first_bit))));
+			}
+		}
+
+		/* the remaining bits */
+		for (unsigned i = 0; i < n_bits % 8; ++i) {
+			const uint_least64_t bit = first_bit + n_bytes * 8 + i;
+			Write(std::to_integer<unsigned>(src[bit / 8]) >> (7 - bit % 8), 1);
+		}
+	}
+
+	void Flush() {
+		if (n_pending > 0)
+			Write(0, 8 - n_pending);
+	}
+};
+
+/**
+ * Read 32 bits at the given bit offset.
+ */
+static uint_least32_t
+ReadBits32(std::span<const std::byte> src, uint_least64_t bit) noexcept
+{
+	uint_least32_t result = 0;
+	for (unsigned i = 0; i < 32; ++i, ++bit)
+		result = (result << 1) |
+			((std::to_integer<unsigned>(src[bit / 8]) >> (7 - bit % 8)) & 1);
+	return result;
+}
+
+class Bzip2Decompressor {
+	bz_stream bz{};
+
+public:
+	Bzip2Decompressor() {
+		if (BZ2_bzDecompressInit(&bz, 0, 0) != BZ_OK)
+			throw std::runtime_error("BZ2_bzDecompressInit() has failed");
+	}
+
+	~Bzip2Decompressor() noexcept {
+		BZ2_bzDecompressEnd(&bz);
+	}
+
+	Bzip2Decompressor(const Bzip2Decompressor &) = delete;
+	Bzip2Decompressor &operator=(const Bzip2Decompressor &) = delete;
+
+	std::vector<std::byte> DecompressAll(std::span<const std::byte> src) {
+		bz.next_in = const_cast<char *>(reinterpret_cast<const char *>(src.data()));
+		bz.avail_in = src.size();
+
+		/* a block decompresses to at most 900 kB in most
+		   cases; the buffer grows if it doesn't */
+		std::vector<std::byte> result(1024 * 1024);
+		std::size_t fill = 0;
+
+		while (true) {
+			if (fill == result.size())
+				result.resize(result.size() * 2);
+
+			bz.next_out = reinterpret_cast<char *>(result.data() + fill);
+			bz.avail_out = result.size() - fill;
+
+			const int ret = BZ2_bzDecompress(&bz);
+			fill = result.size() - bz.avail_out;
+
+			if (ret == BZ_STREAM_END)
+				break;
+
+			if (ret != BZ_OK)
+				throw std::runtime_error("BZ2_bzDecompress() has failed");
+
+			if (bz.avail_in == 0 && bz.avail_out > 0)
+				throw std::runtime_error("Unexpected end of bzip2 block");
+		}
+
+		result.resize(fill);
+		return result;
+	}
+};
+
+} // anonymous namespace
+
+std::vector<std::byte>
+Bzip2DecodeBlock(const Bzip2Block &block, std::span<const std::byte> src)
+{
+	assert(src.size() >= block.GetByteSize());
+
+	const unsigned first_bit = block.begin % 8;
+	const uint_least64_t n_bits = block.end - block.begin;
+	if (n_bits < 48 + 32)
+		throw std::runtime_error("Malformed bzip2 block");
+
+	/* the block CRC follows the block header magic */
+	const uint_least32_t crc = ReadBits32(src, first_bit + 48);
+
+	std::vector<std::byte> stream;
+	stream.reserve(src.size() + 16);
+
+	BitWriter w{stream};
+
+	/* stream header; the largest block size is always
+	   sufficient */
+	w.Write('B', 8);
+	w.Write('Z', 8);
+	w.Write('h', 8);
+	w.Write('9', 8);
+
+	w.Copy(src, first_bit, n_bits);
+
+	/* the stream CRC of a stream with only one block equals the
+	   block CRC */
+	w.Write(BZIP2_EOS_MAGIC, 48);
+	w.Write(crc, 32);
+	w.Flush();
+
+	return Bzip2Decompressor{}.DecompressAll(stream);
+}
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * The location of one compressed block within a bzip2 file.  Blocks
+ * are not byte-aligned; the offsets are in bits.
+ */
+struct Bzip2Block {
+	/**
+	 * The bit offset of the block header magic.
+	 */
+	uint_least64_t begin;
+
+	/**
+	 * The bit offset of the next block header magic or the
+	 * end-of-stream magic.
+	 */
+	uint_least64_t end;
+
+	/**
+	 * The byte offset of the first byte containing bits of this
+	 * block.
+	 */
+	constexpr uint_least64_t GetByteOffset() const noexcept {
+		return begin / 8;
+	}
+
+	/**
+	 * The number of bytes containing bits of this block.
+	 */
+	constexpr std::size_t GetByteSize() const noexcept {
+		return (end + 7) / 8 - begin / 8;
+	}
+};
+
+/**
+ * Finds the block boundaries in a bzip2 file by searching for the
+ * 48 bit block header and end-of-stream magic numbers.  This works
+ * with files consisting of multiple concatenated streams (e.g. from
+ * pbzip2).
+ */
+class Bzip2BlockScanner {
+	std::vector<Bzip2Block> blocks;
+
+	/**
+	 * The most recently fed bits.
+	 */
+	uint_least64_t window = 0;
+
+	/**
+	 * The number of bits fed so far.
+	 */
+	uint_least64_t position = 0;
+
+	/**
+	 * Is the last element of #blocks still open, i.e. its end
+	 * has not been found yet?
+	 */
+	bool in_block = false;
+
+public:
+	/**
+	 * Feed the next chunk of the file.
+	 */
+	void Feed(std::span<const std::byte> src) noexcept;
+
+	/**
+	 * @return the blocks whose end has been found so far
+	 */
+	std::span<const Bzip2Block> GetCompleteBlocks() const noexcept {
+		return std::span{blocks}.first(blocks.size() - in_block);
+	}
+
+	/**
+	 * Is there a block whose end has not been found yet?  If this
+	 * is still the case at the end of the file, then the file is
+	 * truncated.
+	 */
+	bool IsInBlock() const noexcept {
+		return in_block;
+	}
+
+	/**
+	 * Throws if the file is truncated.
+	 *
+	 * @return all blocks found in the file
+	 */
+	std::vector<Bzip2Block> Finish();
+};
+
+/**
+ * Decompress a single block.  It is wrapped in a synthetic bzip2
+ * stream with the block's CRC as stream CRC, which libbz2 can decode
+ * without the preceding blocks.
+ *
+ * Throws on error.
+ *
+ * @param src the bytes containing the block, i.e. starting at
+ * Bzip2Block::GetByteOffset(), with Bzip2Block::GetByteSize() bytes
+ */
+std::vector<std::byte>
+Bzip2DecodeBlock(const Bzip2Block &block, std::span<const std::byte> src);
@@ -0,0 +1,312 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/**
+  * zip archive handling (native implementation using zlib)
+  */
+
+#include "ZipArchivePlugin.hxx"
+#include "../ArchivePlugin.hxx"
+#include "../ArchiveFile.hxx"
+#include "../ArchiveVisitor.hxx"
+#include "input/InputStream.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "lib/fmt/SystemError.hxx"
+#include "lib/zip/Directory.hxx"
+#include "lib/zip/Inflate.hxx"
+#include "fs/Path.hxx"
+#include "fs/FileInfo.hxx"
+#include "io/Open.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "system/Error.hxx"
+#include "util/UTF8.hxx"
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * An opened ZIP file with its parsed central directory.  Instances
+ * are shared by all #ZipArchiveFile and #ZipInputStream objects
+ * referring to the same file, and are kept in a small cache, so
+ * opening a song inside an archive does not parse the directory
+ * again.
+ */
+class ZipArchive {
+	const std::string path;
+
+	/**
+	 * The size and modification time of the file when it was
+	 * opened; used to invalidate cache entries.
+	 */
+	const uint_least64_t file_size;
+	const std::chrono::system_clock::time_point mtime;
+
+	const UniqueFileDescriptor fd;
+
+	const ZipDirectory directory;
+
+	Mutex mutex;
+
+	/**
+	 * Seek indexes for deflated entries, created on demand.
+	 * Indexed like ZipDirectory::GetEntries().
+	 */
+	std::vector<std::unique_ptr<ZipInflateIndex>> indexes;
+
+public:
+	ZipArchive(Path _path, UniqueFileDescriptor &&_fd,
+		   const FileInfo &info)
+		:path(_path.c_str()),
+		 file_size(info.GetSize()), mtime(info.GetModificationTime()),
+		 fd(std::move(_fd)), directory(fd),
+		 indexes(directory.GetEntries().size()) {}
+
+	[[gnu::pure]]
+	bool IsSame(Path other_path, const FileInfo &info) const noexcept {
+		return IsPath(other_path) &&
+			file_size == info.GetSize() &&
+			mtime == info.GetModificationTime();
+	}
+
+	[[gnu::pure]]
+	bool IsPath(Path other_path) const noexcept {
+		return path == other_path.c_str();
+	}
+
+	FileDescriptor GetFileDescriptor() const noexcept {
+		return fd;
+	}
+
+	const ZipDirectory &GetDirectory() const noexcept {
+		return directory;
+	}
+
+	ZipInflateIndex &GetIndex(const ZipEntry &entry) noexcept {
+		const std::scoped_lock lock{mutex};
+		auto &index = indexes[directory.GetIndex(entry)];
+		if (!index)
+			index = std::make_unique<ZipInflateIndex>();
+		return *index;
+	}
+};
+
+/**
+ * The maximum number of #ZipArchive instances kept in
+ * #zip_archive_cache.  Each one holds a file descriptor.
+ */
+static constexpr std::size_t ZIP_ARCHIVE_CACHE_SIZE = 4;
+
+static Mutex zip_archive_cache_mutex;
+
+/**
+ * Recently used archives, the most recently used one first.
+ */
+static std::list<std::shared_ptr<ZipArchive>> zip_archive_cache;
+
+static std::shared_ptr<ZipArchive>
+OpenZipArchive(Path path)
+{
+	{
+		const FileInfo info{path};
+
+		const std::scoped_lock lock{zip_archive_cache_mutex};
+		for (auto i = zip_archive_cache.begin();
+		     i != zip_archive_cache.end(); ++i) {
+			if ((*i)->IsSame(path, info)) {
+				/* move to the front */
+				zip_archive_cache.splice(zip_archive_cache.begin(),
+							 zip_archive_cache, i);
+				return *i;
+			}
+		}
+	}
+
+	/* parse the file without holding the lock */
+	auto fd = OpenReadOnly(path.c_str());
+	const FileInfo info{fd};
+	auto archive = std::make_shared<ZipArchive>(path, std::move(fd), info);
+
+	const std::scoped_lock lock{zip_archive_cache_mutex};
+
+	/* remove stale entries of this file */
+	zip_archive_cache.remove_if([path](const auto &i){
+		return i->IsPath(path);
+	});
+
+	zip_archive_cache.push_front(archive);
+	if (zip_archive_cache.size() > ZIP_ARCHIVE_CACHE_SIZE)
+		zip_archive_cache.pop_back();
+
+	return archive;
+}
+
+static void
+zip_archive_finish() noexcept
+{
+	const std::scoped_lock lock{zip_archive_cache_mutex};
+	zip_archive_cache.clear();
+}
+
+class ZipArchiveFile final : public ArchiveFile {
+	std::shared_ptr<ZipArchive> archive;
+
+public:
+	explicit ZipArchiveFile(std::shared_ptr<ZipArchive> &&_archive) noexcept
+		:archive(std::move(_archive)) {}
+
+	void Visit(ArchiveVisitor &visitor) override;
+
+	InputStreamPtr OpenStream(const char *path,
+				  Mutex &mutex) override;
+};
+
+/* archive open && listing routine */
+
+static std::unique_ptr<ArchiveFile>
+zip_archive_open(Path pathname)
+{
+	return std::make_unique<ZipArchiveFile>(OpenZipArchive(pathname));
+}
+
+void
+ZipArchiveFile::Visit(ArchiveVisitor &visitor)
+{
+	for (const auto &entry : archive->GetDirectory().GetEntries())
+		//add only files
+		if (!entry.IsDirectory() && entry.size > 0 &&
+		    ValidateUTF8(entry.name.c_str()))
+			visitor.VisitArchiveEntry(entry.name.c_str());
+}
+
+/* single archive handling */
+
+class ZipInputStream final : public InputStream {
+	const std::shared_ptr<ZipArchive> archive;
+
+	/**
+	 * The file offset of the entry's data.
+	 */
+	const uint_least64_t data_offset;
+
+	/**
+	 * The decompressor for "deflated" entries; unset for
+	 * "stored" entries, which are read directly from the file.
+	 */
+	std::optional<ZipInflateReader> inflate;
+
+public:
+	ZipInputStream(std::shared_ptr<ZipArchive> &&_archive,
+		       const ZipEntry &entry, uint_least64_t _data_offset,
+		       const char *_uri, Mutex &_mutex)
+		:InputStream(_uri, _mutex),
+		 archive(std::move(_archive)), data_offset(_data_offset) {
+		if (entry.method == ZipMethod::DEFLATED)
+			inflate.emplace(archive->GetFileDescriptor(),
+					data_offset, entry.compressed_size,
+					entry.size,
+					archive->GetIndex(entry));
+
+		seekable = true;
+		size = entry.size;
+		SetReady();
+	}
+
+	/* virtual methods from InputStream */
+	[[nodiscard]] bool IsEOF() const noexcept override {
+		return offset == size;
+	}
+
+	size_t Read(std::unique_lock<Mutex> &lock,
+		    std::span<std::byte> dest) override;
+	void Seek(std::unique_lock<Mutex> &lock, offset_type offset) override;
+};
+
+InputStreamPtr
+ZipArchiveFile::OpenStream(const char *pathname, Mutex &mutex)
+{
+	const auto *entry = archive->GetDirectory().Find(pathname);
+	if (entry == nullptr || entry->IsDirectory())
+		throw FmtFileNotFound("Failed to open {:?} in ZIP file",
+				      pathname);
+
+	if (entry->IsEncrypted())
+		throw FmtRuntimeError("Failed to open {:?} in ZIP file: encrypted",
+				      pathname);
+
+	if (entry->method != ZipMethod::STORED &&
+	    entry->method != ZipMethod::DEFLATED)
+		throw FmtRuntimeError("Failed to open {:?} in ZIP file: unsupported compression method {}",
+				      pathname, uint_least16_t(entry->method));
+
+	const auto data_offset =
+		ReadZipDataOffset(archive->GetFileDescriptor(), *entry);
+
+	return std::make_unique<ZipInputStream>(std::shared_ptr<ZipArchive>{archive},
+						*entry, data_offset,
+						pathname, mutex);
+}
+
+size_t
+ZipInputStream::Read(std::unique_lock<Mutex> &, std::span<std::byte> dest)
+{
+	const ScopeUnlock unlock(mutex);
+
+	std::size_t nbytes;
+
+	if (inflate) {
+		nbytes = inflate->Read(dest);
+	} else {
+		/* stored entry: read directly into the caller's
+		   buffer */
+		if (offset_type(dest.size()) > size - offset)
+			dest = dest.first(size - offset);
+
+		ssize_t result = dest.empty()
+			? 0
+			: archive->GetFileDescriptor().ReadAt(data_offset + offset, dest);
+		if (result < 0)
+			throw MakeErrno("Failed to read ZIP file");
+
+		nbytes = result;
+	}
+
+	if (nbytes == 0 && !IsEOF())
+		throw FmtRuntimeError("Unexpected end of file {:?} at {} of {}",
+				      GetURI(), GetOffset(), GetSize());
+
+	offset += nbytes;
+	return nbytes;
+}
+
+void
+ZipInputStream::Seek(std::unique_lock<Mutex> &, offset_type new_offset)
+{
+	if (new_offset > size)
+		throw std::runtime_error("Invalid seek offset");
+
+	const ScopeUnlock unlock(mutex);
+
+	if (inflate)
+		inflate->Seek(new_offset);
+
+	offset = new_offset;
+}
+
+/* exported structures */
+
+static constexpr const char *zip_archive_extensions[] = {
+	"zip",
+	nullptr
+};
+
+const ArchivePlugin zip_archive_plugin = {
+	"zip",
+	nullptr,
+	zip_archive_finish,
+	zip_archive_open,
+	zip_archive_extensions,
+};
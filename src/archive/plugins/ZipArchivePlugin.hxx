@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#ifndef MPD_ARCHIVE_ZIP_HXX
+#define MPD_ARCHIVE_ZIP_HXX
+
+struct ArchivePlugin;
+
+extern const ArchivePlugin zip_archive_plugin;
+
+#endif
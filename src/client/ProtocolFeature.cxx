@@ -18,6 +18,7 @@ struct feature_type_table {
 
 static constexpr struct feature_type_table protocol_feature_names_init[] = {
 	{"hide_playlists_in_root", PF_HIDE_PLAYLISTS_IN_ROOT},
+	{"binary_records", PF_BINARY_RECORDS},
 };
 
 /**
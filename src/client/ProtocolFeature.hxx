@@ -14,6 +14,7 @@ class Response;
  */
 enum ProtocolFeatureType : uint8_t {
 	PF_HIDE_PLAYLISTS_IN_ROOT,
+	PF_BINARY_RECORDS,
 
 	PF_NUM_OF_ITEM_TYPES
 };
@@ -3,6 +3,7 @@
 
 #include "Response.hxx"
 #include "Client.hxx"
+#include "protocol/BinaryRecords.hxx"
 
 #include <fmt/format.h>
 
@@ -15,15 +16,58 @@ Response::GetTagMask() const noexcept
 bool
 Response::Write(const void *data, size_t length) noexcept
 {
+	if (capture != nullptr) {
+		capture->append(static_cast<const char *>(data), length);
+		return true;
+	}
+
 	return client.Write(data, length);
 }
 
 bool
 Response::Write(const char *data) noexcept
 {
+	if (capture != nullptr) {
+		capture->append(data);
+		return true;
+	}
+
 	return client.Write(data);
 }
 
+void
+Response::CommitRecords() noexcept
+{
+	assert(records != nullptr);
+
+	const std::size_t limit = client.binary_limit;
+	while (records->GetSize() >= limit) {
+		WriteBinary(std::as_bytes(std::span{records->GetBuffer().substr(0, limit)}));
+		records->Consume(limit);
+	}
+}
+
+void
+Response::WriteItem(const char *name, std::string_view value,
+		    bool intern) noexcept
+{
+	if (records != nullptr) {
+		records->String(name, value, intern);
+		CommitRecords();
+	} else
+		Fmt("{}: {}\n", name, value);
+}
+
+void
+Response::WriteItem(const char *name, uint_least64_t value) noexcept
+{
+	if (records != nullptr) {
+		records->Unsigned(name, value);
+		CommitRecords();
+	} else
+		Fmt("{}: {}\n", name, value);
+}
+
 bool
 Response::VFmt(fmt::string_view format_str, fmt::format_args args) noexcept
 {
@@ -64,3 +108,25 @@ Response::VFmtError(enum ack code,
 
 	Write("\n");
 }
+
+ScopeBinaryRecords::ScopeBinaryRecords(Response &_r) noexcept
+	:r(_r)
+{
+	if (r.client.ProtocolFeatureEnabled(PF_BINARY_RECORDS)) {
+		encoder = std::make_unique<BinaryRecordEncoder>();
+		r.records = encoder.get();
+	}
+}
+
+ScopeBinaryRecords::~ScopeBinaryRecords() noexcept
+{
+	if (!encoder)
+		return;
+
+	r.CommitRecords();
+
+	if (encoder->GetSize() > 0)
+		r.WriteBinary(std::as_bytes(std::span{encoder->GetBuffer()}));
+
+	r.records = nullptr;
+}
@@ -8,10 +8,15 @@
 #include <fmt/core.h>
 
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <span>
+#include <string>
+#include <string_view>
 
 class Client;
 class TagMask;
+class BinaryRecordEncoder;
 
 class Response {
 	Client &client;
@@ -27,6 +32,22 @@ class Response {
 	 */
 	const char *command = "";
 
+	/**
+	 * If this is not nullptr, then all output is appended to this
+	 * string instead of being sent to the client.  This is used
+	 * to pre-render responses for caching.
+	 */
+	std::string *capture = nullptr;
+
+	/**
+	 * If this is not nullptr, then the command emits its result
+	 * items with this encoder instead of text lines.  See
+	 * #ScopeBinaryRecords.
+	 */
+	BinaryRecordEncoder *records = nullptr;
+
+	friend class ScopeBinaryRecords;
+
 public:
 	Response(Client &_client, unsigned _list_index) noexcept
 		:client(_client), list_index(_list_index) {}
@@ -55,9 +76,44 @@ public:
 		command = _command;
 	}
 
+	/**
+	 * Redirect all output to the given string (or back to the
+	 * client if nullptr is passed).
+	 */
+	void SetCapture(std::string *_capture) noexcept {
+		capture = _capture;
+	}
+
 	bool Write(const void *data, size_t length) noexcept;
 	bool Write(const char *data) noexcept;
 
+	/**
+	 * Returns the #BinaryRecordEncoder if the client has enabled
+	 * binary records for this command, nullptr otherwise.  After
+	 * using it, call CommitRecords().
+	 */
+	BinaryRecordEncoder *GetRecordEncoder() noexcept {
+		return records;
+	}
+
+	/**
+	 * Send all complete chunks of the #BinaryRecordEncoder buffer
+	 * to the client.
+	 */
+	void CommitRecords() noexcept;
+
+	/**
+	 * Write a "NAME: VALUE" line, or the equivalent binary record
+	 * item.
+	 *
+	 * @param intern allow interning the value in binary record
+	 * mode; set this for values which are likely to be repeated
+	 */
+	void WriteItem(const char *name, std::string_view value,
+		       bool intern=false) noexcept;
+
+	void WriteItem(const char *name, uint_least64_t value) noexcept;
+
 	bool VFmt(fmt::string_view format_str, fmt::format_args args) noexcept;
 
 	template<typename S, typename... Args>
@@ -86,3 +142,22 @@ public:
 				 fmt::make_format_args(args...));
 	}
 };
+
+/**
+ * Switch the #Response to binary records if the client has enabled
+ * the protocol feature "binary_records".  This is used by commands
+ * which may return large result sets.  The destructor sends the
+ * remaining buffer.
+ */
+class ScopeBinaryRecords {
+	Response &r;
+
+	std::unique_ptr<BinaryRecordEncoder> encoder;
+
+public:
+	explicit ScopeBinaryRecords(Response &_r) noexcept;
+	~ScopeBinaryRecords() noexcept;
+
+	ScopeBinaryRecords(const ScopeBinaryRecords &) = delete;
+	ScopeBinaryRecords &operator=(const ScopeBinaryRecords &) = delete;
+};
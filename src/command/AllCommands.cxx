@@ -103,6 +103,7 @@ static constexpr struct command commands[] = {
 #endif
 	{ "getvol", PERMISSION_READ, 0, 0, handle_getvol },
 	{ "idle", PERMISSION_READ, 0, -1, handle_idle },
+	{ "iostats", PERMISSION_READ, 0, 0, handle_iostats },
 	{ "kill", PERMISSION_ADMIN, -1, -1, handle_kill },
 #ifdef ENABLE_DATABASE
 	{ "list", PERMISSION_READ, 1, -1, handle_list },
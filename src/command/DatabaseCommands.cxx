@@ -5,6 +5,7 @@
 #include "PositionArg.hxx"
 #include "Request.hxx"
 #include "Partition.hxx"
+#include "Instance.hxx"
 #include "db/DatabaseQueue.hxx"
 #include "db/DatabasePlaylist.hxx"
 #include "db/DatabasePrint.hxx"
@@ -96,7 +97,8 @@ ParseInsertPosition(Request &args, const playlist &playlist)
  * @param filter a buffer to be used for DatabaseSelection::filter
  */
 static DatabaseSelection
-ParseDatabaseSelection(Request args, bool fold_case, SongFilter &filter)
+ParseDatabaseSelection(Client &client, Request args, bool fold_case,
+		       SongFilter &filter)
 {
 	RangeArg window = RangeArg::All();
 	if (args.size() >= 2 && StringIsEqual(args[args.size() - 2], "window")) {
@@ -122,7 +124,8 @@ ParseDatabaseSelection(Request args, bool fold_case, SongFilter &filter)
 	}
 
 	try {
-		filter.Parse(args, fold_case);
+		filter.Parse(args, fold_case,
+			     client.GetInstance().GetStickerColumnProvider());
 	} catch (...) {
 		throw ProtocolError(ACK_ERROR_ARG,
 				    GetFullMessage(std::current_exception()).c_str());
@@ -140,8 +143,9 @@ static CommandResult
 handle_match(Client &client, Request args, Response &r, bool fold_case)
 {
 	SongFilter filter;
-	const auto selection = ParseDatabaseSelection(args, fold_case, filter);
+	const auto selection = ParseDatabaseSelection(client, args, fold_case, filter);
 
+	const ScopeBinaryRecords binary_records{r};
 	db_selection_print(r, client.GetPartition(),
 			   selection, true, false);
 	return CommandResult::OK;
@@ -168,7 +172,7 @@ handle_match_add(Client &client, Request args, bool fold_case)
 		ParseInsertPosition(args, partition.playlist);
 
 	SongFilter filter;
-	const auto selection = ParseDatabaseSelection(args, fold_case, filter);
+	const auto selection = ParseDatabaseSelection(client, args, fold_case, filter);
 
 	AddFromDatabase(partition, selection);
 
@@ -207,7 +211,7 @@ handle_searchaddpl(Client &client, Request args, Response &)
 	const unsigned position = ParseQueuePosition(args, UINT_MAX);
 
 	SongFilter filter;
-	const auto selection = ParseDatabaseSelection(args, true, filter);
+	const auto selection = ParseDatabaseSelection(client, args, true, filter);
 
 	const Database &db = client.GetDatabaseOrThrow();
 
@@ -241,7 +245,8 @@ handle_count_internal(Client &client, Request args, Response &r, bool fold_case)
 	SongFilter filter;
 	if (!args.empty()) {
 		try {
-			filter.Parse(args, fold_case);
+			filter.Parse(args, fold_case,
+				     client.GetInstance().GetStickerColumnProvider());
 		} catch (...) {
 			r.Error(ACK_ERROR_ARG,
 				GetFullMessage(std::current_exception()).c_str());
@@ -287,7 +292,8 @@ handle_list_file(Client &client, Request args, Response &r)
 	if (!args.empty()) {
 		filter = std::make_unique<SongFilter>();
 		try {
-			filter->Parse(args, false);
+			filter->Parse(args, false,
+				      client.GetInstance().GetStickerColumnProvider());
 		} catch (...) {
 			r.Error(ACK_ERROR_ARG,
 				GetFullMessage(std::current_exception()).c_str());
@@ -370,7 +376,8 @@ handle_list(Client &client, Request args, Response &r)
 	if (!args.empty()) {
 		filter = std::make_unique<SongFilter>();
 		try {
-			filter->Parse(args, false);
+			filter->Parse(args, false,
+				      client.GetInstance().GetStickerColumnProvider());
 		} catch (...) {
 			r.Error(ACK_ERROR_ARG,
 				GetFullMessage(std::current_exception()).c_str());
@@ -379,6 +386,7 @@ handle_list(Client &client, Request args, Response &r)
 		filter->Optimize();
 	}
 
+	const ScopeBinaryRecords binary_records{r};
 	PrintUniqueTags(r, client.GetPartition(),
 			{&tag_types.front(), tag_types.size()},
 			filter.get(),
@@ -392,6 +400,7 @@ handle_listallinfo(Client &client, Request args, Response &r)
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
+	const ScopeBinaryRecords binary_records{r};
 	db_selection_print(r, client.GetPartition(),
 			   DatabaseSelection(uri, true),
 			   true, false);
@@ -7,6 +7,7 @@
 #include "protocol/Ack.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "util/AllocatedArray.hxx"
 #include "util/CharUtil.hxx"
 #include "util/OffsetPointer.hxx"
 #include "util/ScopeExit.hxx"
@@ -24,6 +25,8 @@
 #include "input/InputStream.hxx"
 #include "input/Error.hxx"
 #include "LocateUri.hxx"
+#include "AlbumArt.hxx"
+#include "Instance.hxx"
 #include "TimePrint.hxx"
 #include "thread/Mutex.hxx"
 #include "Log.hxx"
@@ -32,7 +35,7 @@
 
 #include <algorithm>
 #include <cassert>
-#include <array>
+#include <optional>
 
 [[gnu::pure]]
 static bool
@@ -127,38 +130,50 @@ handle_read_comments(Client &client, Request args, Response &r)
 	return CommandResult::OK;
 }
 
+static InputStreamPtr
+open_stream_art(std::string_view directory, std::string_view name,
+		Mutex &mutex)
+{
+	std::string art_file = PathTraitsUTF8::Build(directory, name);
+
+	try {
+		return InputStream::OpenReady(art_file, mutex);
+	} catch (...) {
+		auto e = std::current_exception();
+		if (!IsFileNotFound(e))
+			LogError(e);
+		return nullptr;
+	}
+}
+
 /**
- * Searches for the files listed in #artnames in the UTF8 folder
- * URI #directory. This can be a local path or protocol-based
+ * Searches for the files listed in #album_art_names in the UTF8
+ * folder URI #directory. This can be a local path or protocol-based
  * URI that #InputStream supports. Returns the first successfully
  * opened file or #nullptr on failure.
+ *
+ * @param album_art the name of the album art file according to the
+ * database's album art index, or nullptr to try all names
  */
 static InputStreamPtr
-find_stream_art(std::string_view directory, Mutex &mutex)
+find_stream_art(std::string_view directory, const char *album_art,
+		Mutex &mutex)
 {
-	static constexpr auto art_names = std::array {
-		"cover.png",
-		"cover.jpg",
-		"cover.webp",
-	};
+	if (album_art != nullptr)
+		/* the database knows which file exists; don't
+		   bother trying the others */
+		return open_stream_art(directory, album_art, mutex);
 
-	for(const auto name : art_names) {
-		std::string art_file = PathTraitsUTF8::Build(directory, name);
+	for (const auto name : album_art_names)
+		if (auto is = open_stream_art(directory, name, mutex))
+			return is;
 
-		try {
-			return InputStream::OpenReady(art_file, mutex);
-		} catch (...) {
-			auto e = std::current_exception();
-			if (!IsFileNotFound(e))
-				LogError(e);
-		}
-	}
 	return nullptr;
 }
 
 static CommandResult
 read_stream_art(Response &r, const std::string_view art_directory,
-		size_t offset)
+		size_t offset, const char *album_art=nullptr)
 {
 	// TODO: eliminate this const_cast
 	auto &client = const_cast<Client &>(r.GetClient());
@@ -166,9 +181,9 @@ read_stream_art(Response &r, const std::string_view art_directory,
 	/* to avoid repeating the search for each chunk request by the
 	   same client, use the #LastInputStream class to cache the
 	   #InputStream instance */
-	auto *is = client.last_album_art.Open(art_directory, [](std::string_view directory,
-								Mutex &mutex){
-		return find_stream_art(directory, mutex);
+	auto *is = client.last_album_art.Open(art_directory, [album_art](std::string_view directory,
+									 Mutex &mutex){
+		return find_stream_art(directory, album_art, mutex);
 	});
 
 	if (is == nullptr) {
@@ -225,11 +240,15 @@ read_stream_art(Response &r, const std::string_view art_directory,
  * Attempt to locate the "real" directory where the given song is
  * stored.  This attempts to resolve "virtual" directories/songs,
  * e.g. expanded CUE sheet contents.
+ *
+ * @param album_art_r receives the name of the album art file
+ * according to the database's album art index (empty if there is
+ * none); left unset if that is unknown
  */
-[[gnu::pure]]
 static std::string_view
 RealDirectoryOfSong(Client &client, const char *song_uri,
-		    std::string_view directory_uri) noexcept
+		    std::string_view directory_uri,
+		    std::optional<std::string> &album_art_r) noexcept
 try {
 	const auto *db = client.GetDatabase();
 	if (db == nullptr)
@@ -241,6 +260,9 @@ try {
 
 	AtScopeExit(db, song) { db->ReturnSong(song); };
 
+	if (song->album_art != nullptr)
+		album_art_r.emplace(song->album_art);
+
 	if (song->real_uri == nullptr)
 		return directory_uri;
 
@@ -268,12 +290,22 @@ read_db_art(Client &client, Response &r, const char *uri, const uint64_t offset)
 	}
 	std::string uri2 = storage->MapUTF8(uri);
 
+	std::optional<std::string> album_art;
 	std::string_view directory_uri =
 		RealDirectoryOfSong(client,
 				    uri,
-				    PathTraitsUTF8::GetParent(uri2.c_str()));
+				    PathTraitsUTF8::GetParent(uri2.c_str()),
+				    album_art);
+
+	if (album_art && album_art->empty()) {
+		/* the database update has found no album art in
+		   this directory */
+		r.Error(ACK_ERROR_NO_EXIST, "No file exists");
+		return CommandResult::ERROR;
+	}
 
-	return read_stream_art(r, directory_uri, offset);
+	return read_stream_art(r, directory_uri, offset,
+			       album_art ? album_art->c_str() : nullptr);
 }
 #endif
 
@@ -310,26 +342,21 @@ handle_album_art(Client &client, Request args, Response &r)
 	return CommandResult::ERROR;
 }
 
-class PrintPictureHandler final : public NullTagHandler {
-	Response &response;
+/**
+ * Copy the first picture into a buffer.
+ */
+class CollectPictureHandler final : public NullTagHandler {
+public:
+	std::string mime_type;
 
-	const size_t offset;
+	AllocatedArray<std::byte> data;
 
 	bool found = false;
 
-	bool bad_offset = false;
-
-public:
-	PrintPictureHandler(Response &_response, size_t _offset) noexcept
-		:NullTagHandler(WANT_PICTURE), response(_response),
-		 offset(_offset) {}
-
-	void RethrowError() const {
-		if (bad_offset)
-			throw ProtocolError(ACK_ERROR_ARG, "Bad file offset");
-	}
+	CollectPictureHandler() noexcept
+		:NullTagHandler(WANT_PICTURE) {}
 
-	void OnPicture(const char *mime_type,
+	void OnPicture(const char *_mime_type,
 		       std::span<const std::byte> buffer) noexcept override {
 		if (found)
 			/* only use the first picture */
@@ -337,25 +364,81 @@ public:
 
 		found = true;
 
-		if (offset > buffer.size()) {
-			bad_offset = true;
-			return;
-		}
+		if (_mime_type != nullptr)
+			mime_type = _mime_type;
+
+		data = buffer;
+	}
+};
+
+static void
+PrintPicture(Response &r, std::string_view mime_type,
+	     std::span<const std::byte> buffer, size_t offset)
+{
+	if (offset > buffer.size())
+		throw ProtocolError(ACK_ERROR_ARG, "Bad file offset");
+
+	r.Fmt("size: {}\n", buffer.size());
+
+	if (!mime_type.empty())
+		r.Fmt("type: {}\n", mime_type);
+
+	buffer = buffer.subspan(offset);
 
-		    response.Fmt("size: {}\n", buffer.size());
+	const std::size_t binary_limit = r.GetClient().binary_limit;
+	if (buffer.size() > binary_limit)
+		buffer = buffer.first(binary_limit);
 
-		if (mime_type != nullptr)
-			response.Fmt("type: {}\n", mime_type);
+	r.WriteBinary(buffer);
+}
 
-		buffer = buffer.subspan(offset);
+/**
+ * Determine the modification time of the specified song file, which
+ * is part of the #PictureCache key.  Returns std::nullopt if the
+ * picture shall not be cached (e.g. for remote URIs, which have no
+ * reliable modification time).
+ */
+static std::optional<std::chrono::system_clock::time_point>
+GetPictureCacheMTime(Client &client, const LocatedUri &located_uri) noexcept
+{
+	switch (located_uri.type) {
+	case LocatedUri::Type::ABSOLUTE:
+		break;
 
-		const std::size_t binary_limit = response.GetClient().binary_limit;
-		if (buffer.size() > binary_limit)
-			buffer = buffer.first(binary_limit);
+	case LocatedUri::Type::RELATIVE:
+#ifdef ENABLE_DATABASE
+		try {
+			const auto *db = client.GetDatabase();
+			if (db == nullptr)
+				break;
+
+			const auto *song = db->GetSong(located_uri.canonical_uri);
+			if (song == nullptr)
+				break;
+
+			AtScopeExit(db, song) { db->ReturnSong(song); };
+
+			if (song->mtime == std::chrono::system_clock::time_point::min())
+				break;
+
+			return song->mtime;
+		} catch (...) {
+			/* ignore all exceptions from
+			   Database::GetSong() */
+		}
+#else
+		(void)client;
+#endif
+		break;
 
-		response.WriteBinary(buffer);
+	case LocatedUri::Type::PATH:
+		if (FileInfo info; GetFileInfo(located_uri.path, info))
+			return info.GetModificationTime();
+		break;
 	}
-};
+
+	return std::nullopt;
+}
 
 CommandResult
 handle_read_picture(Client &client, Request args, Response &r)
@@ -365,8 +448,36 @@ handle_read_picture(Client &client, Request args, Response &r)
 	const char *const uri = args.front();
 	const size_t offset = args.ParseUnsigned(1);
 
-	PrintPictureHandler handler(r, offset);
+	const auto located_uri = LocateUri(UriPluginKind::INPUT, uri, &client
+#ifdef ENABLE_DATABASE
+					   , nullptr
+#endif
+					   );
+
+	/* clients fetch the picture in chunks; serve all but the
+	   first one from the cache instead of parsing the file
+	   again */
+	auto &cache = client.GetInstance().picture_cache;
+	const auto mtime = GetPictureCacheMTime(client, located_uri);
+	if (mtime) {
+		if (const auto *item = cache.Get(located_uri.canonical_uri,
+						 *mtime)) {
+			if (!item->data.empty())
+				PrintPicture(r, item->mime_type, item->data,
+					     offset);
+			return CommandResult::OK;
+		}
+	}
+
+	CollectPictureHandler handler;
 	TagScanAny(client, uri, handler);
-	handler.RethrowError();
+
+	if (mtime)
+		cache.Put(located_uri.canonical_uri, *mtime,
+			  handler.mime_type, handler.data);
+
+	if (handler.found)
+		PrintPicture(r, handler.mime_type, handler.data, offset);
+
 	return CommandResult::OK;
 }
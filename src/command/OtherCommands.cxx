@@ -22,6 +22,8 @@
 #include "util/StringAPI.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "Stats.hxx"
+#include "iostats/Registry.hxx"
+#include "Chrono.hxx"
 #include "PlaylistFile.hxx"
 #include "db/PlaylistVector.hxx"
 #include "client/Client.hxx"
@@ -361,6 +363,36 @@ handle_stats(Client &client, [[maybe_unused]] Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_iostats([[maybe_unused]] Client &client,
+	       [[maybe_unused]] Request args, Response &r)
+{
+	for (const auto &i : CollectIOStats()) {
+		const auto &s = i.snapshot;
+
+		r.Fmt("source: {}\n"
+		      "operation: {}\n"
+		      "count: {}\n"
+		      "bytes: {}\n"
+		      "errors: {}\n"
+		      "time: {:1.3f}\n"
+		      "latency_p50: {:1.6f}\n"
+		      "latency_p99: {:1.6f}\n",
+		      i.source, i.operation,
+		      s.count, s.bytes, s.errors,
+		      FloatDuration{s.duration}.count(),
+		      FloatDuration{s.GetPercentile(0.5)}.count(),
+		      FloatDuration{s.GetPercentile(0.99)}.count());
+
+		r.Write("histogram:");
+		for (const auto n : s.histogram)
+			r.Fmt(" {}", n);
+		r.Write("\n");
+	}
+
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_config(Client &client, [[maybe_unused]] Request args, Response &r)
 {
@@ -173,7 +173,8 @@ handle_searchplaylist(Client &client, Request args, Response &r)
 
 	SongFilter filter;
 	try {
-		filter.Parse(args, true);
+		filter.Parse(args, true,
+			     client.GetInstance().GetStickerColumnProvider());
 	} catch (...) {
 		r.Error(ACK_ERROR_ARG,
 			GetFullMessage(std::current_exception()).c_str());
@@ -234,6 +234,8 @@ handle_plchanges(Client &client, Request args, Response &r)
 {
 	uint32_t version = ParseCommandArgU32(args.front());
 	RangeArg range = args.ParseOptional(1, RangeArg::All());
+
+	const ScopeBinaryRecords binary_records{r};
 	playlist_print_changes_info(r, client.GetPlaylist(), version, range);
 	return CommandResult::OK;
 }
@@ -253,6 +255,7 @@ handle_playlistinfo(Client &client, Request args, Response &r)
 {
 	RangeArg range = args.ParseOptional(0, RangeArg::All());
 
+	const ScopeBinaryRecords binary_records{r};
 	playlist_print_info(r, client.GetPlaylist(), range);
 	return CommandResult::OK;
 }
@@ -318,7 +321,8 @@ handle_playlist_match(Client &client, Request args, Response &r,
 
 	SongFilter filter;
 	try {
-		filter.Parse(args, fold_case);
+		filter.Parse(args, fold_case,
+			     client.GetInstance().GetStickerColumnProvider());
 	} catch (...) {
 		r.Error(ACK_ERROR_ARG,
 			GetFullMessage(std::current_exception()).c_str());
@@ -59,6 +59,8 @@ enum class ConfigOption {
 	GAPLESS_MP3_PLAYBACK,
 	AUTO_UPDATE,
 	AUTO_UPDATE_DEPTH,
+	TRUST_DIRECTORY_MTIME,
+	IO_STATS_LOG_INTERVAL,
 
 	MIXRAMP_ANALYZER,
 
@@ -57,6 +57,8 @@ const ConfigTemplate config_param_templates[] = {
 	{ "gapless_mp3_playback", false, true },
 	{ "auto_update" },
 	{ "auto_update_depth" },
+	{ "trust_directory_mtime" },
+	{ "io_stats_log_interval" },
 	{ "mixramp_analyzer" },
 };
 
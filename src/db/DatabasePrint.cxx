@@ -34,8 +34,7 @@ static void
 PrintDirectoryURI(Response &r, bool base,
 		  const LightDirectory &directory) noexcept
 {
-	r.Fmt("directory: {}\n",
-	      ApplyBaseFlag(directory.GetPath(), base));
+	r.WriteItem("directory", ApplyBaseFlag(directory.GetPath(), base));
 }
 
 static void
@@ -64,8 +63,9 @@ print_playlist_in_directory(Response &r, bool base,
 			    const char *name_utf8) noexcept
 {
 	if (base || directory == nullptr)
-		r.Fmt("playlist: {}\n",
-		      ApplyBaseFlag(name_utf8, base));
+		r.WriteItem("playlist", ApplyBaseFlag(name_utf8, base));
+	else if (r.GetRecordEncoder() != nullptr)
+		r.WriteItem("playlist", PathTraitsUTF8::Build(directory, name_utf8));
 	else
 		r.Fmt("playlist: {}/{}\n",
 		      directory, name_utf8);
@@ -77,10 +77,10 @@ print_playlist_in_directory(Response &r, bool base,
 			    const char *name_utf8) noexcept
 {
 	if (base || directory == nullptr || directory->IsRoot())
-		r.Fmt("playlist: {}\n", name_utf8);
+		r.WriteItem("playlist", name_utf8);
 	else
-		r.Fmt("playlist: {}/{}\n",
-		      directory->GetPath(), name_utf8);
+		print_playlist_in_directory(r, false,
+					    directory->GetPath(), name_utf8);
 }
 
 static void
@@ -191,7 +191,7 @@ PrintUniqueTags(Response &r, std::span<const TagType> tag_types,
 		else if (position >= window.end)
 			break;
 
-		r.Fmt("{}: {}\n", name, key);
+		r.WriteItem(name, key, true);
 
 		if (!tag_types.empty())
 			PrintUniqueTags(r, tag_types, tag, RangeArg::All());
@@ -6,25 +6,42 @@
 #include "Interface.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
+#include "PlaylistError.hxx"
 #include "song/DetachedSong.hxx"
 
-#include <functional>
-
-static void
-AddToQueue(Partition &partition, const LightSong &song)
-{
-	const auto *storage = partition.instance.storage;
-	partition.playlist.AppendSong(partition.pc,
-				      DatabaseDetachSong(storage,
-							 song));
-}
+#include <vector>
 
 void
 AddFromDatabase(Partition &partition, const DatabaseSelection &selection)
 {
 	const Database &db = partition.instance.GetDatabaseOrThrow();
+	const auto *storage = partition.instance.storage;
+	auto &playlist = partition.playlist;
+
+	/* collect all songs first (while the database is locked) and
+	   append them to the queue in one batch afterwards */
+
+	const std::size_t available =
+		playlist.queue.max_length - playlist.queue.GetLength();
+
+	std::vector<DetachedSong> songs;
+
+	const auto f = [&](const LightSong &song){
+		if (songs.size() >= available)
+			throw PlaylistError(PlaylistResult::TOO_LARGE,
+					    "Playlist is too large");
+
+		songs.emplace_back(DatabaseDetachSong(storage, song));
+	};
+
+	try {
+		db.Visit(selection, f);
+	} catch (const PlaylistError &) {
+		/* append the songs which fit into the queue, just
+		   like AppendSong() would have done */
+		playlist.AppendSongs(partition.pc, songs);
+		throw;
+	}
 
-	const auto f = [&](const auto &song)
-		{ return AddToQueue(partition, song); };
-	db.Visit(selection, f);
+	playlist.AppendSongs(partition.pc, songs);
 }
@@ -7,6 +7,13 @@
 struct Partition;
 struct DatabaseSelection;
 
+/**
+ * Append all songs matching the selection to the queue.
+ *
+ * Throws on error.  If the queue becomes full, the songs which fit
+ * are appended and kept, and then PlaylistError is thrown, just like
+ * a sequence of playlist::AppendSong() calls would do.
+ */
 void
 AddFromDatabase(Partition &partition, const DatabaseSelection &selection);
 
@@ -6,6 +6,8 @@
 
 #include "Chrono.hxx"
 
+#include <cstddef>
+
 struct DatabaseStats {
 	/**
 	 * Number of songs.
@@ -27,10 +29,19 @@ struct DatabaseStats {
 	 */
 	unsigned album_count;
 
+	/**
+	 * Approximate number of bytes used by the in-memory
+	 * representation of the database divided by the number of
+	 * songs, or 0 if unknown.  Unlike the other attributes, this
+	 * does not include mounted databases.
+	 */
+	std::size_t memory_per_song = 0;
+
 	void Clear() {
 		song_count = 0;
 		total_duration = total_duration.zero();
 		artist_count = album_count = 0;
+		memory_per_song = 0;
 	}
 };
 
@@ -14,7 +14,9 @@
 #include "song/Filter.hxx"
 #include "lib/icu/Collate.hxx"
 #include "fs/Traits.hxx"
+#include "thread/Mutex.hxx"
 #include "util/DeleteDisposer.hxx"
+#include "util/SlabAllocator.hxx"
 #include "util/SortList.hxx"
 #include "util/StringCompare.hxx"
 #include "util/StringSplit.hxx"
@@ -26,6 +28,32 @@
 
 using std::string_view_literals::operator""sv;
 
+static Mutex directory_allocator_mutex;
+static SlabAllocator<Directory, 64> directory_allocator;
+
+void *
+Directory::operator new([[maybe_unused]] std::size_t size)
+{
+	assert(size == sizeof(Directory));
+
+	const std::scoped_lock lock{directory_allocator_mutex};
+	return directory_allocator.Allocate();
+}
+
+void
+Directory::operator delete(void *p) noexcept
+{
+	const std::scoped_lock lock{directory_allocator_mutex};
+	directory_allocator.Free(p);
+}
+
+std::size_t
+Directory::GetAllocatedMemoryPerObject() noexcept
+{
+	const std::scoped_lock lock{directory_allocator_mutex};
+	return directory_allocator.GetMemoryPerObject();
+}
+
 Directory::Directory(std::string &&_path_utf8, Directory *_parent) noexcept
 	:parent(_parent),
 	 path(std::move(_path_utf8))
@@ -49,6 +77,8 @@ Directory::Delete() noexcept
 	assert(holding_db_lock());
 	assert(parent != nullptr);
 
+	InvalidateSongTargets();
+
 	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
 					   DeleteDisposer());
 }
@@ -111,6 +141,32 @@ Directory::LookupTargetSong(std::string_view target) noexcept
 	return lr.directory->FindSong(lr.rest);
 }
 
+[[gnu::pure]]
+static std::size_t
+GetHeapUsage(const std::string &s) noexcept
+{
+	return s.capacity() > std::string{}.capacity()
+		? s.capacity() + 1
+		: 0;
+}
+
+void
+Directory::CollectMemoryUsage(MemoryUsage &usage) const noexcept
+{
+	assert(holding_db_lock());
+
+	++usage.n_directories;
+	usage.heap += GetHeapUsage(path) + GetHeapUsage(album_art);
+
+	for (const auto &song : songs) {
+		++usage.n_songs;
+		usage.heap += song.GetHeapUsage();
+	}
+
+	for (const auto &child : children)
+		child.CollectMemoryUsage(usage);
+}
+
 void
 Directory::ClearInPlaylist() noexcept
 {
@@ -177,6 +233,7 @@ Directory::AddSong(SongPtr song) noexcept
 	assert(&song->parent == this);
 
 	songs.push_back(*song.release());
+	InvalidateSongTargets();
 }
 
 SongPtr
@@ -187,6 +244,7 @@ Directory::RemoveSong(Song *song) noexcept
 	assert(&song->parent == this);
 
 	songs.erase(songs.iterator_to(*song));
+	InvalidateSongTargets();
 	return SongPtr(song);
 }
 
@@ -226,7 +284,7 @@ Directory::Sort() noexcept
 
 void
 Directory::Walk(bool recursive, const SongFilter *filter,
-		bool hide_playlist_targets,
+		bool hide_playlist_targets, bool cache_song_info,
 		const VisitDirectory& visit_directory, const VisitSong& visit_song,
 		const VisitPlaylist& visit_playlist) const
 {
@@ -249,7 +307,13 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 			if (hide_playlist_targets && song.in_playlist)
 				continue;
 
-			const auto song2 = song.Export();
+			auto song2 = song.Export();
+			if (cache_song_info && song.target.empty())
+				/* songs with a "target" are not cached
+				   because their tags depend on the
+				   target song */
+				song2.print_cache = &song.print_cache;
+
 			if (filter == nullptr || filter->Match(song2))
 				visit_song(song2);
 		}
@@ -266,7 +330,7 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 
 		if (recursive)
 			child.Walk(recursive, filter,
-				   hide_playlist_targets,
+				   hide_playlist_targets, cache_song_info,
 				   visit_directory, visit_song,
 				   visit_playlist);
 	}
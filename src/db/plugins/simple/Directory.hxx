@@ -69,6 +69,23 @@ struct Directory : IntrusiveListHook<> {
 
 	const std::string path;
 
+	/**
+	 * The name of the album art file (one of #album_art_names)
+	 * found in this directory by the last update; empty if there
+	 * is none.  Only valid if #album_art_indexed is set.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 * Read access in the update thread does not need protection.
+	 */
+	std::string album_art;
+
+	/**
+	 * Has the database update looked for album art files in this
+	 * directory?  This is false for directories loaded from old
+	 * database files.
+	 */
+	bool album_art_indexed = false;
+
 	/**
 	 * If this is not nullptr, then this directory does not really
 	 * exist, but is a mount point for another #Database.
@@ -85,6 +102,52 @@ public:
 	Directory(std::string &&_path_utf8, Directory *_parent) noexcept;
 	~Directory() noexcept;
 
+	/* Directory objects are allocated from a slab allocator,
+	   just like #Song objects */
+	static void *operator new(std::size_t size);
+	static void operator delete(void *p) noexcept;
+
+	/**
+	 * Returns the number of bytes obtained for all #Directory
+	 * objects (not including memory referenced by them), divided
+	 * by the number of #Directory objects.  This includes the
+	 * objects of all #SimpleDatabase instances (e.g. mounts).
+	 */
+	[[gnu::pure]]
+	static std::size_t GetAllocatedMemoryPerObject() noexcept;
+
+	struct MemoryUsage {
+		/**
+		 * The number of bytes allocated on the heap by the
+		 * attributes of the directories and songs (not
+		 * including the #Song and #Directory objects
+		 * themselves).
+		 */
+		std::size_t heap = 0;
+
+		std::size_t n_directories = 0, n_songs = 0;
+
+		/**
+		 * Estimate the total number of bytes, including each
+		 * object's share of the slab allocators.
+		 */
+		[[gnu::pure]]
+		std::size_t GetTotal() const noexcept {
+			return heap +
+				n_directories * GetAllocatedMemoryPerObject() +
+				n_songs * Song::GetAllocatedMemoryPerObject();
+		}
+	};
+
+	/**
+	 * Add the memory used by this directory and its songs,
+	 * recursively, to the given object.  Mounted databases are
+	 * not included.
+	 *
+	 * Caller must lock #db_mutex.
+	 */
+	void CollectMemoryUsage(MemoryUsage &usage) const noexcept;
+
 	/**
 	 * Create a new root #Directory object.
 	 */
@@ -285,9 +348,12 @@ public:
 
 	/**
 	 * Caller must lock #db_mutex.
+	 *
+	 * @param cache_song_info attach Song::print_cache to the
+	 * #LightSong instances passed to the visitor
 	 */
 	void Walk(bool recursive, const SongFilter *match,
-		  bool hide_playlist_targets,
+		  bool hide_playlist_targets, bool cache_song_info,
 		  const VisitDirectory& visit_directory, const VisitSong& visit_song,
 		  const VisitPlaylist& visit_playlist) const;
 
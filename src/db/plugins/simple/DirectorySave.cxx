@@ -3,6 +3,7 @@
 
 #include "DirectorySave.hxx"
 #include "Directory.hxx"
+#include "AlbumArt.hxx"
 #include "Song.hxx"
 #include "SongSave.hxx"
 #include "song/DetachedSong.hxx"
@@ -25,6 +26,7 @@
 #define DIRECTORY_DIR "directory: "
 #define DIRECTORY_TYPE "type: "
 #define DIRECTORY_MTIME "mtime: "
+#define DIRECTORY_ALBUM_ART "album_art: "
 #define DIRECTORY_BEGIN "begin: "
 #define DIRECTORY_END "end: "
 
@@ -73,6 +75,12 @@ directory_save(BufferedOutputStream &os, const Directory &directory)
 			os.Fmt(DIRECTORY_MTIME "{}\n",
 			       std::chrono::system_clock::to_time_t(directory.mtime));
 
+		if (directory.album_art_indexed)
+			os.Fmt(DIRECTORY_ALBUM_ART "{}\n",
+			       directory.album_art.empty()
+			       ? std::string_view{"none"}
+			       : std::string_view{directory.album_art});
+
 		os.Fmt(DIRECTORY_BEGIN "{}\n", directory.GetPath());
 	}
 
@@ -103,6 +111,14 @@ ParseLine(Directory &directory, const char *line)
 			directory.mtime = std::chrono::system_clock::from_time_t(mtime);
 	} else if ((p = StringAfterPrefix(line, DIRECTORY_TYPE))) {
 		directory.device = ParseTypeString(p);
+	} else if ((p = StringAfterPrefix(line, DIRECTORY_ALBUM_ART))) {
+		/* file names not known by this MPD version leave the
+		   index unset, to fall back to searching */
+		if (FindAlbumArtName(p) < album_art_names.size()) {
+			directory.album_art = p;
+			directory.album_art_indexed = true;
+		} else if (StringIsEqual(p, "none"))
+			directory.album_art_indexed = true;
 	} else
 		return false;
 
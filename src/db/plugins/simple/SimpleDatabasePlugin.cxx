@@ -46,7 +46,8 @@ inline SimpleDatabase::SimpleDatabase(const ConfigBlock &block)
 #ifdef ENABLE_ZLIB
 	 compress(block.GetBlockValue("compress", true)),
 #endif
-	 hide_playlist_targets(block.GetBlockValue("hide_playlist_targets", true))
+	 hide_playlist_targets(block.GetBlockValue("hide_playlist_targets", true)),
+	 cache_song_info(block.GetBlockValue("cache_song_info", false))
 {
 	if (path.IsNull())
 		throw std::runtime_error("No \"path\" parameter specified");
@@ -60,7 +61,8 @@ SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 			       [[maybe_unused]]
 #endif
 			       bool _compress,
-			       bool _hide_playlist_targets) noexcept
+			       bool _hide_playlist_targets,
+			       bool _cache_song_info) noexcept
 	:Database(simple_db_plugin),
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
@@ -68,7 +70,8 @@ SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 #ifdef ENABLE_ZLIB
 	 compress(_compress),
 #endif
-	 hide_playlist_targets(_hide_playlist_targets)
+	 hide_playlist_targets(_hide_playlist_targets),
+	 cache_song_info(_cache_song_info)
 {
 }
 
@@ -291,7 +294,7 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 			visit_directory(r.directory->Export());
 
 		r.directory->Walk(selection.recursive, selection.filter,
-				  hide_playlist_targets,
+				  hide_playlist_targets, cache_song_info,
 				  visit_directory, visit_song,
 				  visit_playlist);
 		helper.Commit();
@@ -302,7 +305,10 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		if (visit_song) {
 			const Song *song = r.directory->FindSong(r.rest);
 			if (song != nullptr) {
-				const auto song2 = song->Export();
+				auto song2 = song->Export();
+				if (cache_song_info && song->target.empty())
+					song2.print_cache = &song->print_cache;
+
 				if (selection.Match(song2))
 					visit_song(song2);
 
@@ -326,7 +332,24 @@ SimpleDatabase::CollectUniqueTags(const DatabaseSelection &selection,
 DatabaseStats
 SimpleDatabase::GetStats(const DatabaseSelection &selection) const
 {
-	return ::GetStats(*this, selection);
+	auto stats = ::GetStats(*this, selection);
+
+	if (selection.recursive && !selection.IsFiltered()) {
+		/* this counts only the songs of this database, not
+		   the ones of mounted databases (which
+		   DatabaseStats::song_count includes) */
+		Directory::MemoryUsage usage;
+
+		{
+			const ScopeDatabaseLock protect;
+			root->CollectMemoryUsage(usage);
+		}
+
+		if (usage.n_songs > 0)
+			stats.memory_per_song = usage.GetTotal() / usage.n_songs;
+	}
+
+	return stats;
 }
 
 void
@@ -429,7 +452,8 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri)
 	constexpr bool compress = false;
 #endif
 	auto db = std::make_unique<SimpleDatabase>(cache_path / name_fs,
-						   compress, hide_playlist_targets);
+						   compress, hide_playlist_targets,
+						   cache_song_info);
 	db->Open();
 
 	bool exists = db->FileExists();
@@ -54,10 +54,17 @@ class SimpleDatabase : public Database {
 
 	const bool hide_playlist_targets;
 
+	/**
+	 * Keep the pre-rendered protocol output of songs (see
+	 * Song::print_cache)?
+	 */
+	const bool cache_song_info;
+
 public:
 	SimpleDatabase(const ConfigBlock &block);
 	SimpleDatabase(AllocatedPath &&_path, bool _compress,
-		       bool _hide_playlist_targets) noexcept;
+		       bool _hide_playlist_targets,
+		       bool _cache_song_info) noexcept;
 
 	static DatabasePtr Create(EventLoop &main_event_loop,
 				  EventLoop &io_event_loop,
@@ -4,13 +4,18 @@
 #include "Song.hxx"
 #include "ExportedSong.hxx"
 #include "Directory.hxx"
+#include "db/DatabaseLock.hxx"
 #include "tag/Tag.hxx"
 #include "tag/Builder.hxx"
 #include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
 #include "fs/Traits.hxx"
+#include "thread/Mutex.hxx"
 #include "time/ChronoUtil.hxx"
 #include "util/IterableSplitString.hxx"
+#include "util/SlabAllocator.hxx"
+
+#include <cassert>
 
 using std::string_view_literals::operator""sv;
 
@@ -26,6 +31,63 @@ Song::Song(DetachedSong &&other, Directory &_parent) noexcept
 {
 }
 
+/**
+ * Songs are allocated and freed by the update thread and by the main
+ * thread (when loading the database), therefore the allocator needs
+ * its own lock.
+ */
+static Mutex song_allocator_mutex;
+static SlabAllocator<Song, 256> song_allocator;
+
+void *
+Song::operator new([[maybe_unused]] std::size_t size)
+{
+	assert(size == sizeof(Song));
+
+	const std::scoped_lock lock{song_allocator_mutex};
+	return song_allocator.Allocate();
+}
+
+void
+Song::operator delete(void *p) noexcept
+{
+	const std::scoped_lock lock{song_allocator_mutex};
+	song_allocator.Free(p);
+}
+
+std::size_t
+Song::GetAllocatedMemoryPerObject() noexcept
+{
+	const std::scoped_lock lock{song_allocator_mutex};
+	return song_allocator.GetMemoryPerObject();
+}
+
+/**
+ * Returns the number of bytes allocated on the heap by the
+ * std::string (i.e. zero if it fits in the small string buffer).
+ */
+[[gnu::pure]]
+static std::size_t
+GetHeapUsage(const std::string &s) noexcept
+{
+	return s.capacity() > std::string{}.capacity()
+		? s.capacity() + 1
+		: 0;
+}
+
+std::size_t
+Song::GetHeapUsage() const noexcept
+{
+	std::size_t result = ::GetHeapUsage(filename) + ::GetHeapUsage(target)
+		+ tag.num_items * sizeof(*tag.items);
+
+	if (resolved_target)
+		result += sizeof(*resolved_target)
+			+ resolved_target->tag.num_items * sizeof(*tag.items);
+
+	return result;
+}
+
 const char *
 Song::GetFilenameSuffix() const noexcept
 {
@@ -90,31 +152,78 @@ FindTargetSong(const Directory &_directory, std::string_view target) noexcept
 	return directory->FindSong(last);
 }
 
-ExportedSong
-Song::Export() const noexcept
+/**
+ * Incremented by InvalidateSongTargets().  Starts at 1 so a
+ * default-initialized Song::ResolvedTarget is stale.  Protected with
+ * the global #db_mutex.
+ */
+static unsigned song_target_generation = 1;
+
+void
+InvalidateSongTargets() noexcept
+{
+	assert(holding_db_lock());
+
+	if (++song_target_generation == 0)
+		/* skip zero after wraparound */
+		song_target_generation = 1;
+}
+
+const Song::ResolvedTarget &
+Song::ResolveTarget() const noexcept
 {
-	const auto *target_song = !target.empty()
-		? FindTargetSong(parent, target)
-		: nullptr;
+	assert(holding_db_lock());
+	assert(!target.empty());
+
+	if (!resolved_target)
+		resolved_target = std::make_unique<ResolvedTarget>();
+
+	auto &r = *resolved_target;
+	if (r.generation == song_target_generation)
+		return r;
 
-	Tag merged_tag;
-	if (target_song != nullptr) {
+	r.generation = song_target_generation;
+	r.song = FindTargetSong(parent, target);
+
+	if (r.song != nullptr) {
 		/* if we found the target song (which may be the
 		   underlying song file of a CUE file), merge the tags
 		   from that song with this song's tags (from the CUE
 		   file) */
 		TagBuilder builder(tag);
-		builder.Complement(target_song->tag);
-		merged_tag = builder.Commit();
+		builder.Complement(r.song->tag);
+		r.tag = builder.Commit();
+	} else
+		r.tag.Clear();
+
+	return r;
+}
+
+ExportedSong
+Song::Export() const noexcept
+{
+	const Song *target_song = nullptr;
+	const Tag *merged_tag = &tag;
+
+	if (!target.empty()) {
+		const auto &r = ResolveTarget();
+		target_song = r.song;
+		if (r.tag.IsDefined())
+			merged_tag = &r.tag;
 	}
 
-	ExportedSong dest = merged_tag.IsDefined()
-		? ExportedSong(filename.c_str(), std::move(merged_tag))
+	/* copy the merged tag: #resolved_target may be
+	   rebuilt or freed as soon as the caller releases the
+	   #db_mutex */
+	ExportedSong dest = merged_tag != &tag
+		? ExportedSong(filename.c_str(), Tag{*merged_tag})
 		: ExportedSong(filename.c_str(), tag);
 	if (!parent.IsRoot())
 		dest.directory = parent.GetPath();
 	if (!target.empty())
 		dest.real_uri = target.c_str();
+	else if (parent.album_art_indexed && !parent.IsReallyAFile())
+		dest.album_art = parent.album_art.c_str();
 	dest.mtime = IsNegative(mtime) && target_song != nullptr
 		? target_song->mtime
 		: mtime;
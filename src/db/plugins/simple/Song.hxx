@@ -8,9 +8,11 @@
 #include "Chrono.hxx"
 #include "tag/Tag.hxx"
 #include "pcm/AudioFormat.hxx"
+#include "song/PrintCache.hxx"
 #include "util/IntrusiveList.hxx"
 #include "config.h"
 
+#include <memory>
 #include <string>
 
 struct Directory;
@@ -50,6 +52,41 @@ struct Song : IntrusiveListHook<> {
 
 	Tag tag;
 
+	/**
+	 * The resolved #target, see ResolveTarget().
+	 */
+	struct ResolvedTarget {
+		/**
+		 * The value of the global generation counter (see
+		 * InvalidateSongTargets()) when this object was
+		 * filled.  If it differs, then the other fields are
+		 * stale.
+		 */
+		unsigned generation = 0;
+
+		/**
+		 * The #Song which #target points to, or nullptr if it
+		 * does not exist in the database.
+		 */
+		const Song *song;
+
+		/**
+		 * This song's #tag complemented with the target
+		 * song's tag; empty if there is no target song.
+		 */
+		Tag tag;
+	};
+
+	/**
+	 * Cached result of resolving #target within the database, so
+	 * Export() doesn't need to traverse the directory tree and
+	 * merge tags each time.  Only allocated for songs with a
+	 * #target.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	mutable std::unique_ptr<ResolvedTarget> resolved_target;
+
 	/**
 	 * The time stamp of the last file modification.  A negative
 	 * value means that this is unknown/unavailable.
@@ -81,6 +118,15 @@ struct Song : IntrusiveListHook<> {
 	 */
 	AudioFormat audio_format = AudioFormat::Undefined();
 
+	/**
+	 * Pre-rendered protocol output of this song (if the option
+	 * "cache_song_info" is enabled).  It must be cleared whenever
+	 * this object is modified.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	mutable SongPrintCache print_cache;
+
 	/**
 	 * Is this song referenced by at least one playlist file that
 	 * is part of the database?
@@ -99,6 +145,31 @@ struct Song : IntrusiveListHook<> {
 
 	Song(DetachedSong &&other, Directory &_parent) noexcept;
 
+	/* Song objects are allocated from a slab allocator (see
+	   GetAllocatedMemoryPerObject()), because there are many of
+	   them and they live long; this saves the general purpose
+	   allocator's per-object overhead (16 bytes with glibc).
+	   The #Tag item array is still allocated by class #Tag. */
+	static void *operator new(std::size_t size);
+	static void operator delete(void *p) noexcept;
+
+	/**
+	 * Returns the number of bytes obtained for all #Song objects
+	 * (not including memory referenced by them), divided by the
+	 * number of #Song objects.  This includes the objects of all
+	 * #SimpleDatabase instances (e.g. mounts).
+	 */
+	[[gnu::pure]]
+	static std::size_t GetAllocatedMemoryPerObject() noexcept;
+
+	/**
+	 * Returns the number of bytes allocated on the heap by this
+	 * object's attributes (strings and tags, not including the
+	 * shared tag items).
+	 */
+	[[gnu::pure]]
+	std::size_t GetHeapUsage() const noexcept;
+
 	[[gnu::pure]]
 	const char *GetFilenameSuffix() const noexcept;
 
@@ -144,8 +215,29 @@ struct Song : IntrusiveListHook<> {
 	[[gnu::pure]]
 	std::string GetURI() const noexcept;
 
-	[[gnu::pure]]
+	/**
+	 * Caller must lock the #db_mutex (because this may update
+	 * #resolved_target).
+	 */
 	ExportedSong Export() const noexcept;
+
+private:
+	/**
+	 * Update #resolved_target if it is stale.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	const ResolvedTarget &ResolveTarget() const noexcept;
 };
 
+/**
+ * Invalidate all #Song::resolved_target instances.  This must be
+ * called whenever a song is added, removed or modified, because the
+ * target of any other song may point to it.
+ *
+ * Caller must lock the #db_mutex.
+ */
+void
+InvalidateSongTargets() noexcept;
+
 #endif
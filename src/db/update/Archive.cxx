@@ -78,7 +78,15 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 					  directory.GetPath(), name);
 			}
 		} else {
-			if (!song->UpdateFileInArchive(archive)) {
+			const bool recognized = song->UpdateFileInArchive(archive);
+
+			{
+				const ScopeDatabaseLock protect;
+				song->print_cache.Clear();
+				InvalidateSongTargets();
+			}
+
+			if (!recognized) {
 				FmtDebug(update_domain,
 					 "deleting unrecognized file {}/{}",
 					 directory.GetPath(), name);
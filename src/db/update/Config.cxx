@@ -15,7 +15,8 @@ UpdateConfig::UpdateConfig(const ConfigData &config)
 	follow_outside_symlinks =
 		config.GetBool(ConfigOption::FOLLOW_OUTSIDE_SYMLINKS,
 			       DEFAULT_FOLLOW_OUTSIDE_SYMLINKS);
-#else
-	(void)config;
 #endif
+
+	trust_directory_mtime =
+		config.GetBool(ConfigOption::TRUST_DIRECTORY_MTIME, false);
 }
@@ -15,6 +15,13 @@ struct UpdateConfig {
 	bool follow_outside_symlinks = DEFAULT_FOLLOW_OUTSIDE_SYMLINKS;
 #endif
 
+	/**
+	 * If true, then the entries of a directory whose modification
+	 * time has not changed since the last update are assumed to
+	 * be unmodified; only its subdirectories are visited.
+	 */
+	bool trust_directory_mtime = false;
+
 	explicit UpdateConfig(const ConfigData &config);
 };
 
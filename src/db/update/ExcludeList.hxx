@@ -43,6 +43,16 @@ public:
 #endif
 	}
 
+	/**
+	 * Remove the patterns loaded by Load() (but not those of the
+	 * parent), e.g. before loading a modified .mpdignore file.
+	 */
+	void Clear() noexcept {
+#ifdef HAVE_CLASS_GLOB
+		patterns.clear();
+#endif
+	}
+
 	/**
 	 * Loads and parses a .mpdignore file.
 	 *
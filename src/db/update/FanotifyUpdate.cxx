@@ -0,0 +1,422 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "FanotifyUpdate.hxx"
+#include "InotifyQueue.hxx"
+#include "InotifyDomain.hxx"
+#include "LocalExcludeList.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "lib/fmt/SystemError.hxx"
+#include "fs/Path.hxx"
+#include "io/FileLineReader.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <array>
+#include <set>
+#include <cstdlib> // for realpath()
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h> // for snprintf()
+#include <string.h> // for strerror()
+#include <sys/fanotify.h>
+#include <unistd.h>
+
+/**
+ * Clear FanotifyUpdate::handle_cache when it has grown to this size.
+ */
+static constexpr std::size_t MAX_HANDLE_CACHE = 4096;
+
+static constexpr uint64_t FAN_MASK =
+	FAN_CLOSE_WRITE|FAN_CREATE|FAN_DELETE|FAN_MOVED_FROM|FAN_MOVED_TO|
+	FAN_ONDIR;
+
+static UniqueFileDescriptor
+CreateFanotify()
+{
+	int fd = fanotify_init(FAN_CLASS_NOTIF|FAN_REPORT_DFID_NAME|
+			       FAN_CLOEXEC|FAN_NONBLOCK,
+			       O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		throw MakeErrno("fanotify_init() failed");
+
+	return UniqueFileDescriptor(AdoptTag{}, fd);
+}
+
+static UniqueFileDescriptor
+OpenDirectoryPath(Path path)
+{
+	UniqueFileDescriptor fd;
+	if (!fd.Open(path.c_str(), O_RDONLY|O_DIRECTORY))
+		throw FmtErrno("Failed to open {:?}", path.c_str());
+
+	return fd;
+}
+
+static AllocatedPath
+RealPath(Path path)
+{
+	char *p = realpath(path.c_str(), nullptr);
+	if (p == nullptr)
+		throw FmtErrno("Failed to resolve {:?}", path.c_str());
+
+	auto result = AllocatedPath::FromFS(p);
+	free(p);
+	return result;
+}
+
+/**
+ * Check whether we are allowed to call open_by_handle_at(), which
+ * requires CAP_DAC_READ_SEARCH.  Without it, fanotify events could
+ * not be mapped to paths.
+ *
+ * Throws on error.
+ */
+static void
+CheckOpenByHandle(FileDescriptor mount_fd)
+{
+	alignas(struct file_handle) std::array<std::byte, sizeof(struct file_handle) + MAX_HANDLE_SZ> buffer;
+	auto *fh = reinterpret_cast<struct file_handle *>(buffer.data());
+	fh->handle_bytes = MAX_HANDLE_SZ;
+
+	int mount_id;
+	if (name_to_handle_at(mount_fd.Get(), "", fh, &mount_id,
+			      AT_EMPTY_PATH) < 0)
+		throw MakeErrno("name_to_handle_at() failed");
+
+	UniqueFileDescriptor fd{AdoptTag{}, open_by_handle_at(mount_fd.Get(), fh, O_PATH|O_CLOEXEC)};
+	if (!fd.IsDefined())
+		throw MakeErrno("open_by_handle_at() failed");
+}
+
+FanotifyUpdate::FanotifyUpdate(EventLoop &loop, InotifyQueue &_queue,
+			       Path path, unsigned _max_depth)
+	:queue(_queue),
+	 mount_fd(OpenDirectoryPath(path)),
+	 root_path(RealPath(path)),
+	 max_depth(_max_depth),
+	 event(loop, BIND_THIS_METHOD(OnFanotifyReady),
+	       CreateFanotify().Release())
+{
+	try {
+		CheckOpenByHandle(mount_fd);
+
+		if (fanotify_mark(event.GetFileDescriptor().Get(),
+				  FAN_MARK_ADD|FAN_MARK_FILESYSTEM, FAN_MASK,
+				  AT_FDCWD, path.c_str()) < 0)
+			throw FmtErrno("fanotify_mark({:?}) failed",
+				       path.c_str());
+	} catch (...) {
+		event.Close();
+		throw;
+	}
+
+	event.ScheduleRead();
+}
+
+AllocatedPath
+FanotifyUpdate::GetPathFS(std::string_view directory) const noexcept
+{
+	if (directory.empty())
+		return root_path;
+
+	return root_path / AllocatedPath::FromFS(directory);
+}
+
+const ExcludeList &
+FanotifyUpdate::GetExcludeList(std::string_view directory) noexcept
+{
+	if (auto i = exclude_lists.find(directory); i != exclude_lists.end())
+		return i->second;
+
+	ExcludeList *exclude_list;
+	if (directory.empty()) {
+		exclude_list = &exclude_lists.try_emplace(std::string{}).first->second;
+	} else {
+		const auto slash = directory.rfind('/');
+		const auto &parent = GetExcludeList(slash == directory.npos
+						    ? std::string_view{}
+						    : directory.substr(0, slash));
+		exclude_list = &exclude_lists.try_emplace(std::string{directory},
+							  parent).first->second;
+	}
+
+	LoadLocalExcludeList(*exclude_list, GetPathFS(directory));
+	return *exclude_list;
+}
+
+bool
+FanotifyUpdate::IsExcluded(std::string_view directory,
+			   std::string_view name) noexcept
+{
+	if (!name.empty()) {
+		const auto &exclude_list = GetExcludeList(directory);
+		if (!exclude_list.IsEmpty() &&
+		    exclude_list.Check(AllocatedPath::FromFS(name)))
+			return true;
+	}
+
+	if (directory.empty())
+		return false;
+
+	/* check the directory's own name in its parent */
+	const auto slash = directory.rfind('/');
+	if (slash == directory.npos)
+		return IsExcluded({}, directory);
+
+	return IsExcluded(directory.substr(0, slash),
+			  directory.substr(slash + 1));
+}
+
+void
+FanotifyUpdate::ReloadExcludeLists(std::string_view directory,
+				   bool descendants) noexcept
+{
+	for (auto i = exclude_lists.lower_bound(directory);
+	     i != exclude_lists.end() && i->first.starts_with(directory);
+	     ++i) {
+		if (i->first.size() != directory.size() &&
+		    (!descendants || i->first[directory.size()] != '/'))
+			continue;
+
+		i->second.Clear();
+		LoadLocalExcludeList(i->second, GetPathFS(i->first));
+	}
+}
+
+std::optional<std::string>
+FanotifyUpdate::ResolveDirectory(const struct file_handle &fh) noexcept
+{
+	std::string key{reinterpret_cast<const char *>(&fh),
+			sizeof(fh) + fh.handle_bytes};
+	if (auto i = handle_cache.find(key); i != handle_cache.end())
+		return i->second;
+
+	/* open_by_handle_at() wants a non-const pointer, but does
+	   not modify the handle */
+	UniqueFileDescriptor fd{AdoptTag{}, open_by_handle_at(mount_fd.Get(), const_cast<struct file_handle *>(&fh), O_PATH|O_CLOEXEC)};
+	if (!fd.IsDefined())
+		/* the directory has been deleted meanwhile; its
+		   parent gets an event, too */
+		return std::nullopt;
+
+	char proc_path[64];
+	snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", fd.Get());
+
+	char buffer[PATH_MAX];
+	const ssize_t length = readlink(proc_path, buffer, sizeof(buffer));
+	if (length <= 0 || std::size_t(length) >= sizeof(buffer))
+		return std::nullopt;
+
+	/* filesystem marks report events from the whole filesystem;
+	   remember directories outside of the music directory, too,
+	   so they can be ignored cheaply next time */
+	std::optional<std::string> result;
+
+	std::string_view path{buffer, std::size_t(length)};
+	const std::string_view root{root_path.c_str()};
+	if (path.starts_with(root)) {
+		path.remove_prefix(root.size());
+		if (path.empty())
+			result.emplace();
+		else if (path.front() == '/')
+			result.emplace(path.substr(1));
+	}
+
+	if (handle_cache.size() >= MAX_HANDLE_CACHE)
+		handle_cache.clear();
+
+	handle_cache.emplace(std::move(key), result);
+	return result;
+}
+
+void
+FanotifyUpdate::HandleEvent(uint64_t mask, const struct file_handle &fh,
+			    std::string_view name) noexcept
+{
+	const auto directory = ResolveDirectory(fh);
+	if (!directory)
+		return;
+
+	if (!directory->empty()) {
+		/* honor "auto_update_depth" like the inotify
+		   implementation, which doesn't watch deeper
+		   directories */
+		const std::size_t depth = std::count(directory->begin(),
+						     directory->end(), '/') + 1;
+		if (depth > max_depth)
+			return;
+	}
+
+	if (name == ".mpdignore") {
+		ReloadExcludeLists(*directory, false);
+	} else if (!name.empty() && (mask & FAN_ONDIR) != 0) {
+		/* a subdirectory was created, moved or deleted:
+		   cached paths of moved directories are stale, and
+		   the .mpdignore files which were loaded for its old
+		   incarnation may differ */
+		if ((mask & (FAN_MOVED_FROM|FAN_MOVED_TO|FAN_DELETE)) != 0)
+			handle_cache.clear();
+
+		std::string child{*directory};
+		if (!child.empty())
+			child.push_back('/');
+		child.append(name);
+		ReloadExcludeLists(child, true);
+	}
+
+	if (IsExcluded(*directory, name))
+		return;
+
+	const auto uri_utf8 = AllocatedPath::FromFS(*directory).ToUTF8();
+	if (uri_utf8.empty() && !directory->empty())
+		return;
+
+	queue.Enqueue(uri_utf8.c_str());
+}
+
+static constexpr bool
+IsOctalDigit(char ch) noexcept
+{
+	return ch >= '0' && ch <= '7';
+}
+
+/**
+ * Unescape a path from /proc/self/mountinfo, where space, tab,
+ * newline and backslash are written as octal escape sequences.
+ */
+static std::string
+UnescapeMountInfo(std::string_view src) noexcept
+{
+	std::string dest;
+	dest.reserve(src.size());
+
+	for (std::size_t i = 0; i < src.size(); ++i) {
+		if (src[i] == '\\' && i + 3 < src.size() &&
+		    IsOctalDigit(src[i + 1]) && IsOctalDigit(src[i + 2]) &&
+		    IsOctalDigit(src[i + 3])) {
+			dest.push_back(char(((src[i + 1] - '0') << 6) |
+					    ((src[i + 2] - '0') << 3) |
+					    (src[i + 3] - '0')));
+			i += 3;
+		} else
+			dest.push_back(src[i]);
+	}
+
+	return dest;
+}
+
+std::vector<std::string>
+FanotifyUpdate::FindMounts() noexcept
+try {
+	std::string prefix{root_path.c_str()};
+	if (!prefix.ends_with('/'))
+		prefix.push_back('/');
+
+	/* sorted, so each mount comes before the ones below it */
+	std::set<std::string, std::less<>> mounts;
+
+	FileLineReader reader{Path::FromFS("/proc/self/mountinfo")};
+	char *line;
+	while ((line = reader.ReadLine()) != nullptr) {
+		/* the fifth field is the mount point */
+		std::string_view field{line};
+		for (unsigned i = 0; i < 4; ++i) {
+			const auto space = field.find(' ');
+			if (space == field.npos) {
+				field = {};
+				break;
+			}
+
+			field.remove_prefix(space + 1);
+		}
+
+		auto mount_point = UnescapeMountInfo(field.substr(0, field.find(' ')));
+		if (mount_point.size() > prefix.size() &&
+		    mount_point.starts_with(prefix))
+			mounts.emplace(mount_point.substr(prefix.size()));
+	}
+
+	std::vector<std::string> result;
+	for (const auto &i : mounts) {
+		if (std::any_of(result.begin(), result.end(), [&i](const std::string &j){
+			return i == j || (i.starts_with(j) && i[j.size()] == '/');
+		}))
+			/* already covered by an inotify watch on
+			   an ancestor */
+			continue;
+
+		const std::size_t depth = std::count(i.begin(), i.end(), '/') + 1;
+		if (depth > max_depth || IsExcluded(i, {}))
+			continue;
+
+		result.emplace_back(i);
+	}
+
+	return result;
+} catch (...) {
+	FmtError(inotify_domain, "Failed to find mounts: {}",
+		 std::current_exception());
+	return {};
+}
+
+inline void
+FanotifyUpdate::OnFanotifyReady(unsigned) noexcept
+{
+	alignas(struct fanotify_event_metadata) std::array<std::byte, 8192> buffer;
+
+	ssize_t nbytes = event.GetFileDescriptor().Read(buffer);
+	if (nbytes <= 0) [[unlikely]] {
+		if (nbytes < 0 && errno == EAGAIN)
+			return;
+
+		FmtError(inotify_domain, "Reading fanotify failed: {}",
+			 nbytes < 0 ? strerror(errno) : "end of file");
+		event.Close();
+		return;
+	}
+
+	for (auto *meta = reinterpret_cast<const struct fanotify_event_metadata *>(buffer.data());
+	     FAN_EVENT_OK(meta, nbytes); meta = FAN_EVENT_NEXT(meta, nbytes)) {
+		if (meta->vers != FANOTIFY_METADATA_VERSION) [[unlikely]]
+			break;
+
+		if (meta->mask & FAN_Q_OVERFLOW) {
+			/* events were lost; update everything */
+			LogWarning(inotify_domain, "fanotify queue overflow");
+			queue.Enqueue("");
+			continue;
+		}
+
+		/* look for the file handle of the directory
+		   containing the modified entry */
+		const std::byte *p = reinterpret_cast<const std::byte *>(meta) + meta->metadata_len;
+		const std::byte *const end = reinterpret_cast<const std::byte *>(meta) + meta->event_len;
+
+		while (std::size_t(end - p) >= sizeof(struct fanotify_event_info_fid)) {
+			const auto &fid = *reinterpret_cast<const struct fanotify_event_info_fid *>(p);
+			if (fid.hdr.len == 0 || fid.hdr.len > std::size_t(end - p))
+				break;
+
+			if (fid.hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME ||
+			    fid.hdr.info_type == FAN_EVENT_INFO_TYPE_DFID) {
+				const auto &fh = *reinterpret_cast<const struct file_handle *>(fid.handle);
+
+				/* with DFID_NAME, the file handle is
+				   followed by the null-terminated name
+				   of the modified entry */
+				std::string_view name;
+				if (fid.hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME)
+					name = reinterpret_cast<const char *>(fh.f_handle + fh.handle_bytes);
+				if (name == ".")
+					name = {};
+
+				HandleEvent(meta->mask, fh, name);
+				break;
+			}
+
+			p += fid.hdr.len;
+		}
+	}
+}
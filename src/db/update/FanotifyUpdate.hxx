@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "ExcludeList.hxx"
+#include "event/PipeEvent.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct file_handle;
+class Path;
+class InotifyQueue;
+
+/**
+ * Watch the music directory with one fanotify filesystem mark
+ * instead of one inotify watch per directory.  This does not hit the
+ * "max_user_watches" limit on huge libraries, and new directories
+ * need not be registered.  It requires Linux 5.9 and the
+ * CAP_SYS_ADMIN and CAP_DAC_READ_SEARCH capabilities.
+ *
+ * The mark covers only the file system of the music directory;
+ * other file systems mounted below it need to be watched with
+ * inotify (see FindMounts()).
+ */
+class FanotifyUpdate final {
+	InotifyQueue &queue;
+
+	/**
+	 * The music directory; used to resolve the file handles
+	 * reported by fanotify with open_by_handle_at().
+	 */
+	const UniqueFileDescriptor mount_fd;
+
+	/**
+	 * The canonical path of the music directory.
+	 */
+	const AllocatedPath root_path;
+
+	const unsigned max_depth;
+
+	PipeEvent event;
+
+	/**
+	 * Maps the raw file handles of directories reported by
+	 * fanotify to their paths relative to the music directory,
+	 * or std::nullopt if they are outside of it.  The mark
+	 * reports events from the whole file system, and this saves
+	 * an open_by_handle_at() and a readlink() call for each of
+	 * them.  Cleared when a directory is moved or deleted.
+	 */
+	std::unordered_map<std::string, std::optional<std::string>> handle_cache;
+
+	/**
+	 * The .mpdignore files of directories which had events
+	 * (and their ancestors), keyed by the path relative to the
+	 * music directory.  Elements are never erased, because each
+	 * one refers to the one of its parent directory; a modified
+	 * .mpdignore file is reloaded in place.
+	 */
+	std::map<std::string, ExcludeList, std::less<>> exclude_lists;
+
+public:
+	/**
+	 * Throws on error (e.g. if fanotify is not supported by the
+	 * kernel or if we lack the required privileges).
+	 */
+	FanotifyUpdate(EventLoop &loop, InotifyQueue &_queue,
+		       Path path, unsigned _max_depth);
+
+	~FanotifyUpdate() noexcept {
+		event.Close();
+	}
+
+	FanotifyUpdate(const FanotifyUpdate &) = delete;
+	FanotifyUpdate &operator=(const FanotifyUpdate &) = delete;
+
+	/**
+	 * Returns the file systems mounted below the music directory
+	 * (relative paths in the file system encoding), which are not
+	 * covered by the fanotify mark.  Mounts below other mounts
+	 * in this list and mounts excluded by a .mpdignore file are
+	 * omitted.
+	 */
+	std::vector<std::string> FindMounts() noexcept;
+
+	/**
+	 * Returns the #ExcludeList of the given directory (a path
+	 * relative to the music directory), which includes the
+	 * patterns of all its ancestors.  The reference remains
+	 * valid as long as this object exists.
+	 */
+	const ExcludeList &GetExcludeList(std::string_view directory) noexcept;
+
+private:
+	[[gnu::pure]]
+	AllocatedPath GetPathFS(std::string_view directory) const noexcept;
+
+	/**
+	 * Is the given entry of the given directory (or the
+	 * directory itself or one of its ancestors, if the name is
+	 * empty) excluded by a .mpdignore file?
+	 */
+	bool IsExcluded(std::string_view directory,
+			std::string_view name) noexcept;
+
+	/**
+	 * Reload the .mpdignore file of the given directory (if it
+	 * has been loaded), and optionally those of all of its
+	 * descendants.
+	 */
+	void ReloadExcludeLists(std::string_view directory,
+				bool descendants) noexcept;
+
+	/**
+	 * Map a directory file handle reported by fanotify to its
+	 * path relative to the music directory.
+	 *
+	 * @return std::nullopt if the directory is outside of the
+	 * music directory or does not exist anymore
+	 */
+	std::optional<std::string> ResolveDirectory(const struct file_handle &fh) noexcept;
+
+	/**
+	 * Enqueue an update for the directory referred to by the
+	 * given file handle, unless the modified entry is excluded.
+	 *
+	 * @param name the name of the modified directory entry;
+	 * empty if unknown
+	 */
+	void HandleEvent(uint64_t mask, const struct file_handle &fh,
+			 std::string_view name) noexcept;
+
+	void OnFanotifyReady(unsigned) noexcept;
+};
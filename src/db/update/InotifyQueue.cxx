@@ -7,7 +7,6 @@
 #include "UpdateDomain.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
 #include "protocol/Ack.hxx" // for class ProtocolError
-#include "util/StringCompare.hxx"
 #include "Log.hxx"
 
 /**
@@ -18,13 +17,28 @@
 static constexpr Event::Duration INOTIFY_UPDATE_DELAY =
 	std::chrono::seconds(5);
 
+/**
+ * If this many subdirectories of one directory have changed, update
+ * the whole directory with one job instead.  This bundles bulk copies
+ * into few update jobs.
+ */
+static constexpr std::size_t INOTIFY_COALESCE_CHILDREN = 64;
+
+InotifyQueue::InotifyQueue(EventLoop &_loop, UpdateService &_update) noexcept
+	:update(_update),
+	 pending(INOTIFY_COALESCE_CHILDREN),
+	 delay_event(_loop, BIND_THIS_METHOD(OnDelay))
+{
+}
+
 void
 InotifyQueue::OnDelay() noexcept
 {
-	unsigned id;
+	const auto list = pending.TakeAll();
 
-	while (!queue.empty()) {
-		const char *uri_utf8 = queue.front().c_str();
+	for (auto i = list.begin(); i != list.end(); ++i) {
+		const char *uri_utf8 = i->c_str();
+		unsigned id;
 
 		try {
 			try {
@@ -32,6 +46,9 @@ InotifyQueue::OnDelay() noexcept
 			} catch (const ProtocolError &e) {
 				if (e.GetCode() == ACK_ERROR_UPDATE_ALREADY) {
 					/* retry later */
+					for (; i != list.end(); ++i)
+						pending.Insert(*i);
+
 					delay_event.Schedule(INOTIFY_UPDATE_DELAY);
 					return;
 				}
@@ -42,49 +59,18 @@ InotifyQueue::OnDelay() noexcept
 			FmtError(update_domain,
 				 "Failed to enqueue {:?}: {}",
 				 uri_utf8, std::current_exception());
-			queue.pop_front();
 			continue;
 		}
 
 		FmtDebug(inotify_domain, "updating {:?} job={}",
 			 uri_utf8, id);
-
-		queue.pop_front();
 	}
 }
 
-[[gnu::pure]]
-static bool
-path_in(const char *path, const char *possible_parent) noexcept
-{
-	if (StringIsEmpty(path))
-		return true;
-
-	auto rest = StringAfterPrefix(path, possible_parent);
-	return rest != nullptr &&
-		(StringIsEmpty(rest) || rest[0] == '/');
-}
-
 void
 InotifyQueue::Enqueue(const char *uri_utf8) noexcept
 {
 	delay_event.Schedule(INOTIFY_UPDATE_DELAY);
 
-	for (auto i = queue.begin(), end = queue.end(); i != end;) {
-		const char *current_uri = i->c_str();
-
-		if (path_in(uri_utf8, current_uri))
-			/* already enqueued */
-			return;
-
-		if (path_in(current_uri, uri_utf8))
-			/* existing path is a sub-path of the new
-			   path; we can dequeue the existing path and
-			   update the new path instead */
-			i = queue.erase(i);
-		else
-			++i;
-	}
-
-	queue.emplace_back(uri_utf8);
+	pending.Insert(uri_utf8);
 }
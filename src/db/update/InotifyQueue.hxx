@@ -4,24 +4,23 @@
 #ifndef MPD_INOTIFY_QUEUE_HXX
 #define MPD_INOTIFY_QUEUE_HXX
 
+#include "PathTree.hxx"
 #include "event/CoarseTimerEvent.hxx"
 
-#include <list>
-#include <string>
-
 class UpdateService;
 
 class InotifyQueue final {
 	UpdateService &update;
 
-	std::list<std::string> queue;
+	/**
+	 * The paths which are scheduled to be updated.
+	 */
+	UpdatePathTree pending;
 
 	CoarseTimerEvent delay_event;
 
 public:
-	InotifyQueue(EventLoop &_loop, UpdateService &_update) noexcept
-		:update(_update),
-		 delay_event(_loop, BIND_THIS_METHOD(OnDelay)) {}
+	InotifyQueue(EventLoop &_loop, UpdateService &_update) noexcept;
 
 	void Enqueue(const char *uri_utf8) noexcept;
 
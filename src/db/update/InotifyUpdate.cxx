@@ -4,22 +4,24 @@
 #include "InotifyUpdate.hxx"
 #include "InotifyDomain.hxx"
 #include "ExcludeList.hxx"
+#include "LocalExcludeList.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
 #include "lib/fmt/PathFormatter.hxx"
 #include "storage/StorageInterface.hxx"
-#include "input/InputStream.hxx"
-#include "input/Error.hxx"
-#include "input/LocalOpen.hxx"
-#include "input/WaitReady.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/DirectoryReader.hxx"
 #include "fs/FileInfo.hxx"
 #include "fs/Traits.hxx"
-#include "thread/Mutex.hxx"
 #include "util/DeleteDisposer.hxx"
 #include "util/IntrusiveList.hxx"
 #include "Log.hxx"
+#include "config.h"
 
+#ifdef ENABLE_FANOTIFY
+#include "FanotifyUpdate.hxx"
+#endif
+
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <string>
@@ -45,6 +47,12 @@ class InotifyUpdate::Directory final : public InotifyWatch, public IntrusiveList
 
 	const AllocatedPath name;
 
+	/**
+	 * For a root directory: its URI relative to the music
+	 * directory, or nullptr if this is the music directory.
+	 */
+	const AllocatedPath root_uri = nullptr;
+
 	ExcludeList exclude_list;
 
 	IntrusiveList<Directory> children;
@@ -60,6 +68,21 @@ public:
 		 parent(nullptr), name(std::forward<N>(_name)),
 		 remaining_depth(_remaining_depth) {}
 
+	/**
+	 * Construct the root of a file system mounted inside the
+	 * music directory.
+	 */
+	template<typename N>
+	Directory(InotifyManager &_manager, InotifyQueue &_queue,
+		  N &&_name, AllocatedPath &&_root_uri,
+		  const ExcludeList &parent_exclude_list,
+		  unsigned _remaining_depth)
+		:InotifyWatch(_manager), queue(_queue),
+		 parent(nullptr), name(std::forward<N>(_name)),
+		 root_uri(std::move(_root_uri)),
+		 exclude_list(parent_exclude_list),
+		 remaining_depth(_remaining_depth) {}
+
 	template<typename N>
 	Directory(Directory &_parent, N &&_name)
 		:InotifyWatch(_parent.GetManager()), queue(_parent.queue),
@@ -79,16 +102,12 @@ public:
 	[[nodiscard]] [[gnu::pure]]
 	AllocatedPath GetUriFS() const noexcept;
 
+	[[nodiscard]] [[gnu::pure]]
+	AllocatedPath GetPathFS() const noexcept;
+
 	void RecursiveWatchSubdirectories(Path path_fs) noexcept;
 
 private:
-	const Directory &GetRoot() const noexcept {
-		const Directory *directory = this;
-		while (directory->parent != nullptr)
-			directory = directory->parent;
-		return *directory;
-	}
-
 	void Delete() noexcept;
 
 protected:
@@ -97,15 +116,8 @@ protected:
 
 void
 InotifyUpdate::Directory::LoadExcludeList(Path directory_path) noexcept
-try {
-	Mutex mutex;
-	auto is = OpenLocalInputStream(directory_path / Path::FromFS(".mpdignore"),
-				       mutex);
-	LockWaitReady(*is);
-	exclude_list.Load(std::move(is));
-} catch (...) {
-	if (!IsFileNotFound(std::current_exception()))
-		LogError(std::current_exception());
+{
+	LoadLocalExcludeList(exclude_list, directory_path);
 }
 
 void
@@ -126,7 +138,7 @@ AllocatedPath
 InotifyUpdate::Directory::GetUriFS() const noexcept
 {
 	if (parent == nullptr)
-		return nullptr;
+		return root_uri;
 
 	const auto uri = parent->GetUriFS();
 	if (uri.IsNull())
@@ -135,6 +147,15 @@ InotifyUpdate::Directory::GetUriFS() const noexcept
 	return uri / name;
 }
 
+AllocatedPath
+InotifyUpdate::Directory::GetPathFS() const noexcept
+{
+	if (parent == nullptr)
+		return name;
+
+	return parent->GetPathFS() / name;
+}
+
 /* we don't look at "." / ".." nor files with newlines in their name */
 [[gnu::pure]]
 static bool
@@ -209,9 +230,60 @@ InotifyUpdate::InotifyUpdate(EventLoop &loop, UpdateService &update,
 
 InotifyUpdate::~InotifyUpdate() noexcept = default;
 
+#ifdef ENABLE_FANOTIFY
+
+inline void
+InotifyUpdate::WatchMount(Path music_directory, std::string_view uri_fs) noexcept
+{
+	const auto path_fs = music_directory / AllocatedPath::FromFS(uri_fs);
+	const std::size_t depth = std::count(uri_fs.begin(), uri_fs.end(), '/') + 1;
+	const auto slash = uri_fs.rfind('/');
+	const auto &parent_exclude_list =
+		fanotify->GetExcludeList(slash == uri_fs.npos
+					 ? std::string_view{}
+					 : uri_fs.substr(0, slash));
+
+	auto &directory = mounts.emplace_front(inotify_manager, queue, path_fs,
+					       AllocatedPath::FromFS(uri_fs),
+					       parent_exclude_list,
+					       max_depth - depth);
+	if (!directory.TryAddWatch(path_fs.c_str(), IN_MASK)) {
+		FmtError(inotify_domain, "Failed to register {}: {}",
+			 path_fs, strerror(errno));
+		mounts.pop_front();
+		return;
+	}
+
+	FmtDebug(inotify_domain, "watching mount {} with inotify", path_fs);
+
+	directory.LoadExcludeList(path_fs);
+	directory.RecursiveWatchSubdirectories(path_fs);
+}
+
+#endif
+
 inline void
 InotifyUpdate::Start(Path path)
 {
+#ifdef ENABLE_FANOTIFY
+	try {
+		fanotify = std::make_unique<FanotifyUpdate>(inotify_manager.GetEventLoop(),
+							    queue, path, max_depth);
+		LogDebug(inotify_domain, "using fanotify");
+	} catch (...) {
+		FmtDebug(inotify_domain, "fanotify not available: {}",
+			 std::current_exception());
+	}
+
+	if (fanotify) {
+		/* the fanotify mark covers only the file system of
+		   the music directory */
+		for (const auto &uri_fs : fanotify->FindMounts())
+			WatchMount(path, uri_fs);
+		return;
+	}
+#endif
+
 	root = std::make_unique<Directory>(inotify_manager, queue, path, max_depth);
 	root->AddWatch(path.c_str(), IN_MASK);
 	root->LoadExcludeList(path);
@@ -232,13 +304,7 @@ InotifyUpdate::Directory::OnInotify(unsigned mask, const char *) noexcept
 	    (mask & IN_ISDIR) != 0) {
 		/* a sub directory was changed: register those in
 		   inotify */
-		const auto &root_path = GetRoot().name;
-
-		const auto path_fs = uri_fs.IsNull()
-			? root_path
-			: (root_path / uri_fs);
-
-		RecursiveWatchSubdirectories(path_fs);
+		RecursiveWatchSubdirectories(GetPathFS());
 	}
 
 	if ((mask & (IN_CLOSE_WRITE|IN_MOVE|IN_DELETE)) != 0 ||
@@ -5,11 +5,18 @@
 
 #include "InotifyQueue.hxx"
 #include "event/InotifyManager.hxx"
+#include "config.h"
 
 #include <memory>
 
+#ifdef ENABLE_FANOTIFY
+#include <forward_list>
+#include <string_view>
+#endif
+
 class Path;
 class Storage;
+class FanotifyUpdate;
 
 /**
  * Glue code between InotifySource and InotifyQueue.
@@ -23,12 +30,33 @@ class InotifyUpdate final {
 	class Directory;
 	std::unique_ptr<Directory> root;
 
+#ifdef ENABLE_FANOTIFY
+	/**
+	 * If this is set, then the music directory is watched with
+	 * fanotify, and #root is not used.
+	 */
+	std::unique_ptr<FanotifyUpdate> fanotify;
+
+	/**
+	 * The roots of other file systems mounted inside the music
+	 * directory, which are not covered by #fanotify and are
+	 * watched with inotify.  They refer to exclude lists owned by
+	 * #fanotify, so they are declared after it.
+	 */
+	std::forward_list<Directory> mounts;
+#endif
+
 public:
 	InotifyUpdate(EventLoop &loop, UpdateService &update,
 		      unsigned _max_depth);
 	~InotifyUpdate() noexcept;
 
 	void Start(Path path);
+
+private:
+#ifdef ENABLE_FANOTIFY
+	void WatchMount(Path music_directory, std::string_view uri_fs) noexcept;
+#endif
 };
 
 /**
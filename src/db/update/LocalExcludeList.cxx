@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "LocalExcludeList.hxx"
+#include "ExcludeList.hxx"
+#include "input/InputStream.hxx"
+#include "input/Error.hxx"
+#include "input/LocalOpen.hxx"
+#include "input/WaitReady.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/Mutex.hxx"
+#include "Log.hxx"
+
+void
+LoadLocalExcludeList(ExcludeList &exclude_list, Path directory_fs) noexcept
+try {
+	Mutex mutex;
+	auto is = OpenLocalInputStream(directory_fs / Path::FromFS(".mpdignore"),
+				       mutex);
+	LockWaitReady(*is);
+	exclude_list.Load(std::move(is));
+} catch (...) {
+	if (!IsFileNotFound(std::current_exception()))
+		LogError(std::current_exception());
+}
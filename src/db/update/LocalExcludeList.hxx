@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+class Path;
+class ExcludeList;
+
+/**
+ * Load the ".mpdignore" file of a local directory into the given
+ * #ExcludeList.  A missing file is not an error; other errors are
+ * logged.
+ */
+void
+LoadLocalExcludeList(ExcludeList &exclude_list, Path directory_fs) noexcept;
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "PathTree.hxx"
+#include "util/IterableSplitString.hxx"
+
+void
+UpdatePathTree::Node::Collect(const std::string &uri,
+			      std::vector<std::string> &list) const noexcept
+{
+	if (pending) {
+		list.push_back(uri);
+		return;
+	}
+
+	for (const auto &[name, child] : children)
+		child.Collect(uri.empty() ? name : uri + '/' + name, list);
+}
+
+void
+UpdatePathTree::Insert(std::string_view uri_utf8) noexcept
+{
+	Node *node = &root, *parent = nullptr;
+
+	for (const std::string_view name : IterableSplitString(uri_utf8, '/')) {
+		if (node->pending)
+			/* already enqueued */
+			return;
+
+		if (name.empty())
+			continue;
+
+		parent = node;
+
+		auto i = node->children.find(name);
+		if (i == node->children.end())
+			i = node->children.emplace(name, Node{}).first;
+		node = &i->second;
+	}
+
+	if (node->pending)
+		return;
+
+	/* existing sub-paths of the new path are dequeued; updating
+	   the new path covers them */
+	node->SetPending();
+
+	if (parent != nullptr &&
+	    parent->children.size() >= coalesce_children)
+		parent->SetPending();
+}
+
+std::vector<std::string>
+UpdatePathTree::TakeAll() noexcept
+{
+	std::vector<std::string> list;
+	root.Collect({}, list);
+	root = {};
+	return list;
+}
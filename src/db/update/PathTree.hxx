@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <functional> // for std::less
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * A set of URIs scheduled to be updated, stored as a tree of path
+ * components.  Inserting a path which is already covered by a
+ * pending ancestor is a no-op, and inserting a path collapses all
+ * pending descendants, so both checks cost only one lookup per
+ * path component.
+ */
+class UpdatePathTree {
+	struct Node {
+		std::map<std::string, Node, std::less<>> children;
+
+		/**
+		 * If true, then this path shall be updated.  A
+		 * pending node never has children, because they are
+		 * covered by updating this path.
+		 */
+		bool pending = false;
+
+		/**
+		 * Mark this node as pending and discard all
+		 * descendants.
+		 */
+		void SetPending() noexcept {
+			pending = true;
+			children.clear();
+		}
+
+		void Collect(const std::string &uri,
+			     std::vector<std::string> &list) const noexcept;
+	};
+
+	/**
+	 * The root of the tree, representing the whole music
+	 * directory.
+	 */
+	Node root;
+
+	/**
+	 * If this many subdirectories of one directory are pending,
+	 * the whole directory is marked pending instead.
+	 */
+	std::size_t coalesce_children;
+
+public:
+	explicit UpdatePathTree(std::size_t _coalesce_children) noexcept
+		:coalesce_children(_coalesce_children) {}
+
+	bool empty() const noexcept {
+		return !root.pending && root.children.empty();
+	}
+
+	void Insert(std::string_view uri_utf8) noexcept;
+
+	/**
+	 * Remove all pending URIs from the tree and return them in
+	 * lexicographic order.  The root directory is represented by
+	 * an empty string.
+	 */
+	std::vector<std::string> TakeAll() noexcept;
+};
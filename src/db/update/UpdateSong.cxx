@@ -64,7 +64,15 @@ try {
 	} else if (info.mtime != song->mtime || walk_discard) {
 		FmtNotice(update_domain, "updating {}/{}",
 			  directory.GetPath(), name);
-		if (song->UpdateFile(storage, info))
+		const bool recognized = song->UpdateFile(storage, info);
+
+		{
+			const ScopeDatabaseLock protect;
+			song->print_cache.Clear();
+			InvalidateSongTargets();
+		}
+
+		if (recognized)
 			song->mark = true;
 		else
 			FmtDebug(update_domain,
@@ -11,6 +11,7 @@
 #include "db/plugins/simple/Song.hxx"
 #include "storage/StorageInterface.hxx"
 #include "ExcludeList.hxx"
+#include "AlbumArt.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/Traits.hxx"
 #include "fs/FileSystem.hxx"
@@ -21,12 +22,16 @@
 #include "util/StringCompare.hxx"
 #include "util/StringSplit.hxx"
 #include "util/UriExtract.hxx"
+#include "time/ChronoUtil.hxx"
 #include "Log.hxx"
 
 #include <cassert>
 #include <cerrno>
 #include <exception>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <string.h>
 #include <stdlib.h>
@@ -196,7 +201,8 @@ UpdateWalk::UpdateRegularFile(Directory &directory,
 void
 UpdateWalk::UpdateDirectoryChild(Directory &directory,
 				 const ExcludeList &exclude_list,
-				 const char *name, const StorageFileInfo &info) noexcept
+				 const char *name, const StorageFileInfo &info,
+				 bool trust_mtime) noexcept
 try {
 	assert(std::strchr(name, '/') == nullptr);
 
@@ -215,7 +221,7 @@ try {
 
 		assert(&directory == subdir->parent);
 
-		if (!UpdateDirectory(*subdir, exclude_list, info))
+		if (!UpdateDirectory(*subdir, exclude_list, info, trust_mtime))
 			editor.LockDeleteDirectory(subdir);
 	} else {
 		FmtDebug(update_domain,
@@ -331,15 +337,61 @@ LoadExcludeListOrLog(Storage &storage, const Directory &directory,
 	}
 }
 
+inline void
+UpdateWalk::UpdateUnmodifiedDirectory(Directory &directory,
+				      const ExcludeList &exclude_list) noexcept
+{
+	directory.ForEachChildSafe([&](Directory &child){
+		if (cancel || child.IsMount() || child.IsReallyAFile())
+			/* virtual directories are only checked when
+			   their parent gets enumerated */
+			return;
+
+		StorageFileInfo info;
+		if (!GetInfo(storage, child.GetPath(), info) ||
+		    !info.IsDirectory() ||
+		    !UpdateDirectory(child, exclude_list, info, true)) {
+			editor.LockDeleteDirectory(&child);
+			modified = true;
+		}
+	});
+}
+
+inline bool
+UpdateWalk::IsUnmodified(const Directory &directory,
+			 const StorageFileInfo &info,
+			 bool trust_mtime) const noexcept
+{
+	return trust_mtime && !walk_discard && directory.album_art_indexed &&
+		!IsNegative(directory.mtime) && directory.mtime == info.mtime;
+}
+
 bool
 UpdateWalk::UpdateDirectory(Directory &directory,
 			    const ExcludeList &exclude_list,
-			    const StorageFileInfo &info) noexcept
+			    const StorageFileInfo &info,
+			    bool trust_mtime) noexcept
 {
 	assert(info.IsDirectory());
 
 	directory_set_stat(directory, info);
 
+	if (IsUnmodified(directory, info, trust_mtime)) {
+		/* no entry was added, removed or renamed since the
+		   last update; skip enumerating and stat'ing the
+		   files, but look for changes in subdirectories */
+		ExcludeList child_exclude_list(exclude_list);
+		LoadExcludeListOrLog(storage, directory, child_exclude_list);
+
+		if (!child_exclude_list.IsEmpty())
+			RemoveExcludedFromDirectory(directory, child_exclude_list);
+
+		UpdateUnmodifiedDirectory(directory, child_exclude_list);
+
+		directory.mark = true;
+		return true;
+	}
+
 	std::unique_ptr<StorageDirectoryReader> reader;
 
 	try {
@@ -357,11 +409,22 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 
 	UnmarkAllIn(directory);
 
+	/* the most preferred album art file found in this directory
+	   (index into #album_art_names) */
+	std::size_t album_art = album_art_names.size();
+
+	/* subdirectories are visited after all files, so the storage
+	   can be told which ones will be opened (and list them in
+	   the background) */
+	std::vector<std::pair<std::string, StorageFileInfo>> subdirectories;
+
 	const char *name_utf8;
 	while (!cancel && (name_utf8 = reader->Read()) != nullptr) {
 		if (skip_path(name_utf8))
 			continue;
 
+		album_art = std::min(album_art, FindAlbumArtName(name_utf8));
+
 		{
 			const auto name_fs = AllocatedPath::FromUTF8(name_utf8);
 			if (name_fs.IsNull() || child_exclude_list.Check(name_fs))
@@ -379,17 +442,72 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 			continue;
 		}
 
-		UpdateDirectoryChild(directory, child_exclude_list, name_utf8, info2);
+		if (info2.IsDirectory()) {
+			subdirectories.emplace_back(name_utf8, info2);
+			continue;
+		}
+
+		UpdateDirectoryChild(directory, child_exclude_list, name_utf8, info2,
+				     config.trust_directory_mtime);
+	}
+
+	reader.reset();
+
+	for (const auto &[name, info2] : subdirectories) {
+		if (cancel)
+			break;
+
+		bool unmodified;
+
+		{
+			const ScopeDatabaseLock protect;
+			const Directory *child = directory.FindChild(name);
+			unmodified = child != nullptr &&
+				IsUnmodified(*child, info2,
+					     config.trust_directory_mtime);
+		}
+
+		if (!unmodified)
+			storage.PrefetchDirectory(PathTraitsUTF8::Build(directory.GetPath(),
+									name));
+	}
+
+	for (const auto &[name, info2] : subdirectories) {
+		if (cancel)
+			break;
+
+		UpdateDirectoryChild(directory, child_exclude_list,
+				     name.c_str(), info2,
+				     config.trust_directory_mtime);
 	}
 
 	PurgeDeletedFromDirectory(directory);
 
+	if (!cancel)
+		UpdateAlbumArt(directory,
+			       album_art < album_art_names.size()
+			       ? album_art_names[album_art]
+			       : std::string_view{});
+
 	directory.mtime = info.mtime;
 	directory.mark = true;
 
 	return true;
 }
 
+inline void
+UpdateWalk::UpdateAlbumArt(Directory &directory,
+			   std::string_view album_art) noexcept
+{
+	if (directory.album_art_indexed && directory.album_art == album_art)
+		return;
+
+	const ScopeDatabaseLock protect;
+	directory.album_art = album_art;
+	directory.album_art_indexed = true;
+	modified = true;
+}
+
 inline Directory *
 UpdateWalk::DirectoryMakeChildChecked(Directory &parent,
 				      const char *uri_utf8,
@@ -499,7 +617,11 @@ try {
 	}
 
 	const auto exclude_lists = LoadExcludeLists(storage, *parent);
-	UpdateDirectoryChild(*parent, exclude_lists.front(), name, info);
+	/* the directory named by the update request is always
+	   enumerated, because a file inside it may have been modified
+	   without changing the directory's modification time */
+	UpdateDirectoryChild(*parent, exclude_lists.front(), name, info,
+			     false);
 } catch (...) {
 	LogError(std::current_exception());
 }
@@ -525,7 +647,7 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard) noexcept
 
 		ExcludeList exclude_list;
 
-		UpdateDirectory(root, exclude_list, info);
+		UpdateDirectory(root, exclude_list, info, false);
 	}
 
 	{
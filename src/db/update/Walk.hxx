@@ -127,14 +127,45 @@ private:
 	bool UpdateRegularFile(Directory &directory,
 			       const char *name, const StorageFileInfo &info) noexcept;
 
+	/**
+	 * @param trust_mtime if true, then the directory's entries
+	 * may be assumed to be unmodified if its modification time
+	 * has not changed (see UpdateConfig::trust_directory_mtime)
+	 */
 	void UpdateDirectoryChild(Directory &directory,
 				  const ExcludeList &exclude_list,
 				  const char *name,
-				  const StorageFileInfo &info) noexcept;
+				  const StorageFileInfo &info,
+				  bool trust_mtime) noexcept;
+
+	/**
+	 * Visit the subdirectories of a directory whose entries are
+	 * assumed to be unmodified.
+	 */
+	void UpdateUnmodifiedDirectory(Directory &directory,
+				       const ExcludeList &exclude_list) noexcept;
+
+	/**
+	 * Will UpdateDirectory() skip enumerating this directory
+	 * because its modification time has not changed?
+	 */
+	[[gnu::pure]]
+	bool IsUnmodified(const Directory &directory,
+			  const StorageFileInfo &info,
+			  bool trust_mtime) const noexcept;
 
 	bool UpdateDirectory(Directory &directory,
 			     const ExcludeList &exclude_list,
-			     const StorageFileInfo &info) noexcept;
+			     const StorageFileInfo &info,
+			     bool trust_mtime) noexcept;
+
+	/**
+	 * Store the name of the album art file found in this
+	 * directory (or an empty string if there is none) in the
+	 * album art index.
+	 */
+	void UpdateAlbumArt(Directory &directory,
+			    std::string_view album_art) noexcept;
 
 	/**
 	 * Create the specified directory object if it does not exist
@@ -19,12 +19,16 @@
 #include "../DecoderAPI.hxx"
 #include "FfmpegMetaData.hxx"
 #include "FfmpegIo.hxx"
+#include "Mp4Scan.hxx"
 #include "pcm/Interleave.hxx"
 #include "tag/Builder.hxx"
 #include "tag/Handler.hxx"
 #include "tag/ReplayGainParser.hxx"
 #include "tag/MixRampParser.hxx"
 #include "input/InputStream.hxx"
+#include "io/FileRangeReader.hxx"
+#include "io/FileReader.hxx"
+#include "fs/Path.hxx"
 #include "pcm/CheckAudioFormat.hxx"
 #include "util/IterableSplitString.hxx"
 #include "util/ScopeExit.hxx"
@@ -40,6 +44,7 @@ extern "C" {
 #include <libavutil/frame.h>
 }
 
+#include <array>
 #include <cassert>
 
 #include <string.h>
@@ -659,6 +664,27 @@ ffmpeg_scan_stream(InputStream &is, TagHandler &handler)
 	return FfmpegScanStream(*f, handler);
 }
 
+static bool
+ffmpeg_scan_file(Path path_fs, TagHandler &handler) noexcept
+try {
+	/* MP4 files are very common, and their tags can be read
+	   without probing the file with libavformat; all other
+	   formats fall back to ffmpeg_scan_stream() */
+	FileReader reader{path_fs};
+
+	/* check the "ftyp" box with a small read, because
+	   FileRangeReader would read a whole chunk */
+	std::array<std::byte, MP4_HEADER_SIZE> header;
+	if (reader.ReadAt(0, header) != header.size() ||
+	    !IsMp4Header(header))
+		return false;
+
+	FileRangeReader file{std::move(reader)};
+	return ScanMp4Headers(file, handler);
+} catch (...) {
+	return false;
+}
+
 static void
 ffmpeg_uri_decode(DecoderClient &client, const char *uri)
 {
@@ -819,7 +845,8 @@ static const char *const ffmpeg_mime_types[] = {
 };
 
 constexpr DecoderPlugin ffmpeg_decoder_plugin =
-	DecoderPlugin("ffmpeg", ffmpeg_decode, ffmpeg_scan_stream)
+	DecoderPlugin("ffmpeg", ffmpeg_decode, ffmpeg_scan_stream,
+		      nullptr, ffmpeg_scan_file)
 	.WithInit(ffmpeg_init, ffmpeg_finish)
 	.WithProtocols(ffmpeg_protocols, ffmpeg_uri_decode)
 	.WithSuffixes(ffmpeg_suffixes)
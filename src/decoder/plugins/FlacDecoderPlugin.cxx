@@ -6,6 +6,8 @@
 #include "FlacDomain.hxx"
 #include "FlacCommon.hxx"
 #include "lib/xiph/FlacMetadataChain.hxx"
+#include "lib/xiph/FlacHeaderScan.hxx"
+#include "io/FileRangeReader.hxx"
 #include "OggCodec.hxx"
 #include "input/InputStream.hxx"
 #include "input/LocalOpen.hxx"
@@ -57,6 +59,16 @@ flac_write_cb(const FLAC__StreamDecoder *dec, const FLAC__Frame *frame,
 static bool
 flac_scan_file(Path path_fs, TagHandler &handler) noexcept
 {
+	/* try the lightweight parser first; it reads only the
+	   blocks we need */
+	try {
+		FileRangeReader file(path_fs);
+		if (ScanFlacHeaders(file, handler))
+			return true;
+	} catch (...) {
+		/* let libFLAC try again and report the error */
+	}
+
 	FlacMetadataChain chain;
 	const bool succeed = [&chain, &path_fs]() noexcept {
 		// read by NarrowPath
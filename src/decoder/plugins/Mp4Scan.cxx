@@ -0,0 +1,719 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Mp4Scan.hxx"
+#include "io/FileRangeReader.hxx"
+#include "pcm/CheckAudioFormat.hxx"
+#include "tag/Handler.hxx"
+#include "tag/Id3MusicBrainz.hxx"
+#include "tag/ParseName.hxx"
+#include "tag/Table.hxx"
+#include "util/SpanCast.hxx"
+
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr uint_least32_t
+FourCC(const char (&s)[5]) noexcept
+{
+	return (uint_least32_t((unsigned char)s[0]) << 24) |
+		(uint_least32_t((unsigned char)s[1]) << 16) |
+		(uint_least32_t((unsigned char)s[2]) << 8) |
+		uint_least32_t((unsigned char)s[3]);
+}
+
+struct Mp4Box {
+	uint_least32_t type;
+
+	/**
+	 * The file offsets of the payload (after the box header).
+	 */
+	uint_least64_t start, end;
+};
+
+struct Mp4AudioTrack {
+	uint_least64_t duration = 0;
+	uint_least32_t timescale = 0;
+
+	unsigned sample_rate = 0, channels = 0;
+	SampleFormat format = SampleFormat::UNDEFINED;
+};
+
+struct Mp4Info {
+	uint_least64_t duration = 0;
+	uint_least32_t timescale = 0;
+
+	std::optional<Mp4AudioTrack> track;
+
+	std::vector<std::pair<TagType, std::string>> tags;
+};
+
+/**
+ * A reader for the bit fields of an AudioSpecificConfig.
+ */
+class BitReader {
+	std::span<const std::byte> src;
+	std::size_t position = 0;
+	bool error = false;
+
+public:
+	explicit constexpr BitReader(std::span<const std::byte> _src) noexcept
+		:src(_src) {}
+
+	constexpr bool HasError() const noexcept {
+		return error;
+	}
+
+	constexpr unsigned Read(unsigned n_bits) noexcept {
+		unsigned value = 0;
+
+		for (unsigned i = 0; i < n_bits; ++i, ++position) {
+			if (position / 8 >= src.size()) {
+				error = true;
+				return 0;
+			}
+
+			const unsigned byte = unsigned(src[position / 8]);
+			value = (value << 1) | ((byte >> (7 - position % 8)) & 1);
+		}
+
+		return value;
+	}
+};
+
+} // anonymous namespace
+
+/**
+ * Refuse to read boxes larger than this into memory (e.g. tag
+ * values).
+ */
+static constexpr std::size_t MP4_MAX_PAYLOAD = 1024 * 1024;
+
+static constexpr unsigned
+ReadBE16(const std::byte *p) noexcept
+{
+	return (unsigned(p[0]) << 8) | unsigned(p[1]);
+}
+
+static constexpr uint_least32_t
+ReadBE32(const std::byte *p) noexcept
+{
+	return (uint_least32_t(p[0]) << 24) | (uint_least32_t(p[1]) << 16) |
+		(uint_least32_t(p[2]) << 8) | uint_least32_t(p[3]);
+}
+
+static constexpr uint_least64_t
+ReadBE64(const std::byte *p) noexcept
+{
+	return (uint_least64_t(ReadBE32(p)) << 32) | ReadBE32(p + 4);
+}
+
+/**
+ * Read the header of the box at the given offset.
+ *
+ * @param limit the end of the parent box
+ */
+static bool
+ReadBox(FileRangeReader &file, uint_least64_t offset, uint_least64_t limit,
+	Mp4Box &box)
+{
+	if (offset >= limit || limit - offset < 8)
+		return false;
+
+	const auto header = file.Read(offset, 16);
+	if (header.size() < 8)
+		return false;
+
+	uint_least64_t size = ReadBE32(header.data());
+	box.type = ReadBE32(header.data() + 4);
+	box.start = offset + 8;
+
+	if (size == 1) {
+		/* 64 bit size */
+		if (header.size() < 16)
+			return false;
+
+		size = ReadBE64(header.data() + 8);
+		box.start += 8;
+	} else if (size == 0)
+		/* the box extends to the end of its parent */
+		size = limit - offset;
+
+	if (size < box.start - offset || size > limit - offset)
+		return false;
+
+	box.end = offset + size;
+	return true;
+}
+
+/**
+ * Find the first box of the given type in the range [start, end).
+ */
+static std::optional<Mp4Box>
+FindBox(FileRangeReader &file, uint_least64_t start, uint_least64_t end,
+	uint_least32_t type)
+{
+	Mp4Box box;
+	for (auto offset = start; offset < end; offset = box.end) {
+		if (!ReadBox(file, offset, end, box))
+			break;
+
+		if (box.type == type)
+			return box;
+	}
+
+	return std::nullopt;
+}
+
+static std::optional<Mp4Box>
+FindChild(FileRangeReader &file, const Mp4Box &parent, uint_least32_t type)
+{
+	return FindBox(file, parent.start, parent.end, type);
+}
+
+/**
+ * Read the payload of the given box.
+ *
+ * @return the payload or an empty span if it is too large (or if
+ * the file is truncated)
+ */
+static std::span<const std::byte>
+ReadPayload(FileRangeReader &file, const Mp4Box &box)
+{
+	const uint_least64_t size = box.end - box.start;
+	if (size > MP4_MAX_PAYLOAD)
+		return {};
+
+	const auto payload = file.Read(box.start, size);
+	if (payload.size() < size)
+		return {};
+
+	return payload;
+}
+
+/**
+ * Parse the time scale and the duration of a "mvhd" or "mdhd" box.
+ */
+static bool
+ParseMediaHeader(std::span<const std::byte> src,
+		 uint_least32_t &timescale, uint_least64_t &duration) noexcept
+{
+	if (src.size() < 20)
+		return false;
+
+	if (src[0] == std::byte{1}) {
+		/* version 1 with 64 bit times */
+		if (src.size() < 32)
+			return false;
+
+		timescale = ReadBE32(src.data() + 20);
+		duration = ReadBE64(src.data() + 24);
+		if (duration == ~uint_least64_t{})
+			duration = 0;
+	} else {
+		timescale = ReadBE32(src.data() + 12);
+		duration = ReadBE32(src.data() + 16);
+		if (duration == 0xffffffff)
+			duration = 0;
+	}
+
+	return true;
+}
+
+/**
+ * Parse an ISO/IEC 14496-1 descriptor header.
+ */
+static bool
+ReadDescriptor(std::span<const std::byte> &src, unsigned expected_tag,
+	       std::span<const std::byte> &payload) noexcept
+{
+	if (src.empty() || unsigned(src[0]) != expected_tag)
+		return false;
+
+	std::size_t size = 0, i = 1;
+	while (true) {
+		if (i >= src.size() || i > 4)
+			return false;
+
+		const unsigned b = unsigned(src[i++]);
+		size = (size << 7) | (b & 0x7f);
+		if ((b & 0x80) == 0)
+			break;
+	}
+
+	if (src.size() - i < size)
+		return false;
+
+	payload = src.subspan(i, size);
+	src = src.subspan(i + size);
+	return true;
+}
+
+static unsigned
+ReadAacSampleRate(BitReader &r) noexcept
+{
+	static constexpr unsigned sample_rates[] = {
+		96000, 88200, 64000, 48000, 44100, 32000, 24000,
+		22050, 16000, 12000, 11025, 8000, 7350,
+	};
+
+	const unsigned index = r.Read(4);
+	if (index == 0xf)
+		return r.Read(24);
+
+	return index < std::size(sample_rates) ? sample_rates[index] : 0;
+}
+
+/**
+ * Parse the "esds" box of an AAC track and determine the format
+ * FFmpeg's AAC decoder will produce.
+ */
+static bool
+ParseEsds(std::span<const std::byte> src, Mp4AudioTrack &track) noexcept
+{
+	if (src.size() < 4)
+		return false;
+
+	/* skip version and flags */
+	src = src.subspan(4);
+
+	std::span<const std::byte> es;
+	if (!ReadDescriptor(src, 0x03, es) || es.size() < 3)
+		return false;
+
+	const unsigned es_flags = unsigned(es[2]);
+	es = es.subspan(3);
+
+	std::size_t skip = 0;
+	if (es_flags & 0x80)
+		/* dependsOn_ES_ID */
+		skip += 2;
+	if (es_flags & 0x40) {
+		/* URL */
+		if (es.size() <= skip)
+			return false;
+		skip += 1 + unsigned(es[skip]);
+	}
+	if (es_flags & 0x20)
+		/* OCR_ES_Id */
+		skip += 2;
+
+	if (es.size() < skip)
+		return false;
+	es = es.subspan(skip);
+
+	std::span<const std::byte> config;
+	if (!ReadDescriptor(es, 0x04, config) || config.size() < 13)
+		return false;
+
+	switch (unsigned(config[0])) {
+	case 0x40: /* MPEG-4 audio */
+	case 0x66: /* MPEG-2 AAC main */
+	case 0x67: /* MPEG-2 AAC LC */
+	case 0x68: /* MPEG-2 AAC SSR */
+		break;
+
+	default:
+		/* MP3 or something else */
+		return false;
+	}
+
+	config = config.subspan(13);
+
+	std::span<const std::byte> asc;
+	if (!ReadDescriptor(config, 0x05, asc))
+		return false;
+
+	BitReader r(asc);
+
+	unsigned object_type = r.Read(5);
+	if (object_type == 31)
+		object_type = 32 + r.Read(6);
+
+	unsigned sample_rate = ReadAacSampleRate(r);
+	const unsigned channel_config = r.Read(4);
+
+	if (object_type == 5 || object_type == 29) {
+		/* explicit SBR signalling: the decoder output
+		   has the extension sample rate */
+		sample_rate = ReadAacSampleRate(r);
+	} else if (object_type == 2 && sample_rate <= 24000) {
+		/* this may be HE-AAC with implicit SBR
+		   signalling, which can only be detected by
+		   decoding a frame */
+		return false;
+	}
+
+	if (r.HasError() || sample_rate == 0)
+		return false;
+
+	if (channel_config >= 1 && channel_config <= 6)
+		track.channels = channel_config;
+	else if (channel_config == 7)
+		track.channels = 8;
+	else if (channel_config != 0)
+		return false;
+
+	if (object_type == 29 && track.channels == 1)
+		/* parametric stereo */
+		track.channels = 2;
+
+	track.sample_rate = sample_rate;
+	track.format = SampleFormat::FLOAT;
+	return true;
+}
+
+/**
+ * Parse the "alac" box (the "magic cookie") of an ALAC track.
+ */
+static bool
+ParseAlacCookie(std::span<const std::byte> src, Mp4AudioTrack &track) noexcept
+{
+	/* version and flags, then the ALACSpecificConfig */
+	if (src.size() < 4 + 24)
+		return false;
+
+	const auto *cookie = src.data() + 4;
+	const unsigned bit_depth = unsigned(cookie[5]);
+	track.channels = unsigned(cookie[9]);
+	track.sample_rate = ReadBE32(cookie + 20);
+
+	/* FFmpeg's ALAC decoder produces 16 or 32 bit samples */
+	track.format = bit_depth == 16
+		? SampleFormat::S16
+		: SampleFormat::S32;
+	return true;
+}
+
+/**
+ * Parse the first sample entry of a "stsd" box.
+ */
+static bool
+ParseSampleDescription(FileRangeReader &file, const Mp4Box &stsd,
+		       Mp4AudioTrack &track)
+{
+	Mp4Box entry;
+	if (!ReadBox(file, stsd.start + 8, stsd.end, entry))
+		return false;
+
+	static constexpr std::size_t AUDIO_SAMPLE_ENTRY_SIZE = 28;
+	const auto src = file.Read(entry.start, AUDIO_SAMPLE_ENTRY_SIZE);
+	if (src.size() < AUDIO_SAMPLE_ENTRY_SIZE ||
+	    entry.end - entry.start < AUDIO_SAMPLE_ENTRY_SIZE)
+		return false;
+
+	if (ReadBE16(src.data() + 8) != 0)
+		/* QuickTime sound description version 1 or 2 */
+		return false;
+
+	track.channels = ReadBE16(src.data() + 16);
+
+	const Mp4Box children{
+		entry.type, entry.start + AUDIO_SAMPLE_ENTRY_SIZE, entry.end,
+	};
+
+	switch (entry.type) {
+	case FourCC("mp4a"):
+		if (const auto esds = FindChild(file, children, FourCC("esds")))
+			return ParseEsds(ReadPayload(file, *esds), track);
+		return false;
+
+	case FourCC("alac"):
+		if (const auto alac = FindChild(file, children, FourCC("alac")))
+			return ParseAlacCookie(ReadPayload(file, *alac), track);
+		return false;
+
+	default:
+		/* let FFmpeg handle all other codecs */
+		return false;
+	}
+}
+
+/**
+ * Parse a "trak" box.  If it is an audio track, its properties are
+ * stored in #track; other tracks are ignored.
+ *
+ * @return false if this is an unsupported (or malformed) audio
+ * track
+ */
+static bool
+ParseTrack(FileRangeReader &file, const Mp4Box &trak,
+	   std::optional<Mp4AudioTrack> &track)
+{
+	const auto mdia = FindChild(file, trak, FourCC("mdia"));
+	if (!mdia)
+		return true;
+
+	const auto hdlr = FindChild(file, *mdia, FourCC("hdlr"));
+	if (!hdlr)
+		return true;
+
+	const auto handler = ReadPayload(file, *hdlr);
+	if (handler.size() < 12 ||
+	    ReadBE32(handler.data() + 8) != FourCC("soun"))
+		return true;
+
+	Mp4AudioTrack t;
+
+	if (const auto mdhd = FindChild(file, *mdia, FourCC("mdhd"))) {
+		if (!ParseMediaHeader(ReadPayload(file, *mdhd),
+				      t.timescale, t.duration))
+			return false;
+	}
+
+	std::optional<Mp4Box> stsd;
+	if (const auto minf = FindChild(file, *mdia, FourCC("minf")))
+		if (const auto stbl = FindChild(file, *minf, FourCC("stbl")))
+			stsd = FindChild(file, *stbl, FourCC("stsd"));
+
+	if (!stsd || !ParseSampleDescription(file, *stsd, t))
+		return false;
+
+	track = t;
+	return true;
+}
+
+[[gnu::const]]
+static TagType
+Mp4AtomToTagType(uint_least32_t type) noexcept
+{
+	/* the same atoms libavformat/mov.c maps to tag names known
+	   to MPD */
+	switch (type) {
+	case FourCC("\xa9nam"): return TAG_TITLE;
+	case FourCC("\xa9""ART"): return TAG_ARTIST;
+	case FourCC("aART"): return TAG_ALBUM_ARTIST;
+	case FourCC("\xa9""alb"): return TAG_ALBUM;
+	case FourCC("\xa9""day"): return TAG_DATE;
+	case FourCC("\xa9gen"): return TAG_GENRE;
+	case FourCC("\xa9wrt"): return TAG_COMPOSER;
+	case FourCC("\xa9""cmt"): return TAG_COMMENT;
+	case FourCC("\xa9grp"): return TAG_GROUPING;
+	case FourCC("trkn"): return TAG_TRACK;
+	case FourCC("disk"): return TAG_DISC;
+	case FourCC("soal"): return TAG_ALBUM_SORT;
+	case FourCC("soar"): return TAG_ARTIST_SORT;
+	case FourCC("soaa"): return TAG_ALBUM_ARTIST_SORT;
+	case FourCC("sonm"): return TAG_TITLE_SORT;
+	default: return TAG_NUM_OF_ITEM_TYPES;
+	}
+}
+
+/**
+ * Extract the value of the first "data" box of an "ilst" item.
+ *
+ * @return false if the item is malformed
+ */
+static bool
+ReadItemValue(FileRangeReader &file, const Mp4Box &item,
+	      uint_least32_t type, std::string &value)
+{
+	const auto data = FindChild(file, item, FourCC("data"));
+	if (!data)
+		return true;
+
+	const auto src = ReadPayload(file, *data);
+	if (src.size() < 8)
+		return false;
+
+	const uint_least32_t data_type = ReadBE32(src.data()) & 0xffffff;
+	const auto payload = src.subspan(8);
+
+	if (type == FourCC("trkn") || type == FourCC("disk")) {
+		/* binary: padding, number, total */
+		if (payload.size() < 6)
+			return false;
+
+		const unsigned number = ReadBE16(payload.data() + 2);
+		const unsigned total = ReadBE16(payload.data() + 4);
+		if (total > 0)
+			value = fmt::format("{}/{}", number, total);
+		else
+			value = fmt::format("{}", number);
+		return true;
+	}
+
+	/* implicit (0) or UTF-8 (1); ignore everything else
+	   (e.g. UTF-16) */
+	if (data_type == 0 || data_type == 1)
+		value = ToStringView(payload);
+
+	return true;
+}
+
+/**
+ * Parse a freeform ("----") item and look up its name.
+ */
+static bool
+ParseFreeformItem(FileRangeReader &file, const Mp4Box &item,
+		  TagType &tag_type, std::string &value)
+{
+	tag_type = TAG_NUM_OF_ITEM_TYPES;
+
+	const auto name_box = FindChild(file, item, FourCC("name"));
+	if (!name_box)
+		return true;
+
+	const auto name = ReadPayload(file, *name_box);
+	if (name.size() < 4)
+		return false;
+
+	/* skip version and flags */
+	const std::string name_s{ToStringView(name.subspan(4))};
+
+	tag_type = tag_name_parse_i(name_s);
+	if (tag_type == TAG_NUM_OF_ITEM_TYPES)
+		tag_type = tag_table_lookup_i(musicbrainz_txxx_tags, name_s);
+	if (tag_type == TAG_NUM_OF_ITEM_TYPES)
+		return true;
+
+	return ReadItemValue(file, item, FourCC("----"), value);
+}
+
+static bool
+ParseItemList(FileRangeReader &file, const Mp4Box &ilst, Mp4Info &info)
+{
+	std::string value;
+
+	Mp4Box item;
+	for (auto offset = ilst.start; offset < ilst.end; offset = item.end) {
+		if (!ReadBox(file, offset, ilst.end, item))
+			return false;
+
+		value.clear();
+
+		TagType tag_type;
+		if (item.type == FourCC("----")) {
+			if (!ParseFreeformItem(file, item, tag_type, value))
+				return false;
+		} else if (item.type == FourCC("gnre")) {
+			/* an ID3v1 genre number; FFmpeg knows how to
+			   translate it */
+			return false;
+		} else {
+			tag_type = Mp4AtomToTagType(item.type);
+			if (tag_type != TAG_NUM_OF_ITEM_TYPES &&
+			    !ReadItemValue(file, item, item.type, value))
+				return false;
+		}
+
+		if (tag_type != TAG_NUM_OF_ITEM_TYPES && !value.empty())
+			info.tags.emplace_back(tag_type, std::move(value));
+	}
+
+	return true;
+}
+
+static bool
+ParseUserData(FileRangeReader &file, const Mp4Box &udta, Mp4Info &info)
+{
+	auto meta = FindChild(file, udta, FourCC("meta"));
+	if (!meta)
+		return true;
+
+	/* in ISO files, "meta" is a "full box" with version and
+	   flags; in QuickTime files, it is not */
+	const auto peek = file.Read(meta->start, 8);
+	if (peek.size() < 8)
+		return false;
+
+	if (ReadBE32(peek.data() + 4) != FourCC("hdlr"))
+		meta->start += 4;
+
+	const auto ilst = FindChild(file, *meta, FourCC("ilst"));
+	return !ilst || ParseItemList(file, *ilst, info);
+}
+
+static bool
+ParseMovie(FileRangeReader &file, const Mp4Box &moov, bool want_tags,
+	   Mp4Info &info)
+{
+	Mp4Box box;
+	for (auto offset = moov.start; offset < moov.end; offset = box.end) {
+		if (!ReadBox(file, offset, moov.end, box))
+			return false;
+
+		switch (box.type) {
+		case FourCC("mvhd"):
+			if (!ParseMediaHeader(ReadPayload(file, box),
+					      info.timescale, info.duration))
+				return false;
+			break;
+
+		case FourCC("trak"):
+			/* use the first audio track, just like
+			   FFmpeg's decoder plugin */
+			if (!info.track && !ParseTrack(file, box, info.track))
+				return false;
+			break;
+
+		case FourCC("udta"):
+			if (want_tags && !ParseUserData(file, box, info))
+				return false;
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool
+IsMp4Header(std::span<const std::byte, MP4_HEADER_SIZE> src) noexcept
+{
+	/* the box size is not checked here; ReadBox() does that */
+	return ReadBE32(src.data() + 4) == FourCC("ftyp");
+}
+
+bool
+ScanMp4Headers(FileRangeReader &file, TagHandler &handler)
+{
+	if (handler.WantPair() || handler.WantPicture())
+		/* not implemented; let FFmpeg do it */
+		return false;
+
+	const auto size = file.GetSize();
+
+	Mp4Box ftyp;
+	if (!ReadBox(file, 0, size, ftyp) || ftyp.type != FourCC("ftyp"))
+		return false;
+
+	/* the "moov" box may be located after "mdat"; walking the
+	   top-level box headers costs one read each */
+	const auto moov = FindBox(file, ftyp.end, size, FourCC("moov"));
+	if (!moov)
+		return false;
+
+	Mp4Info info;
+	if (!ParseMovie(file, *moov, handler.WantTag(), info) ||
+	    !info.track)
+		return false;
+
+	const auto &track = *info.track;
+
+	if (track.timescale > 0)
+		handler.OnDuration(SongTime::FromScale<uint64_t>(track.duration,
+								 track.timescale));
+	else if (info.timescale > 0)
+		handler.OnDuration(SongTime::FromScale<uint64_t>(info.duration,
+								 info.timescale));
+
+	try {
+		handler.OnAudioFormat(CheckAudioFormat(track.sample_rate,
+						       track.format,
+						       track.channels));
+	} catch (...) {
+	}
+
+	for (const auto &[type, value] : info.tags)
+		handler.OnTag(type, value);
+
+	return true;
+}
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+class FileRangeReader;
+class TagHandler;
+
+/**
+ * The number of bytes needed by IsMp4Header().
+ */
+static constexpr std::size_t MP4_HEADER_SIZE = 8;
+
+/**
+ * Does the file begin with a "ftyp" box, i.e. is it probably a MP4
+ * file?  This allows checking a file with one small read before
+ * ScanMp4Headers() is used.
+ */
+[[gnu::pure]]
+bool
+IsMp4Header(std::span<const std::byte, MP4_HEADER_SIZE> src) noexcept;
+
+/**
+ * Scan the duration, the audio format and the iTunes-style tags
+ * ("moov/udta/meta/ilst") of a MP4 file without libavformat.  Only
+ * the box headers and the few boxes needed are read; the sample
+ * tables and the media data are skipped.
+ *
+ * Only AAC and ALAC tracks are supported, and only the tags (no
+ * pairs, no pictures); in all other cases, this function returns
+ * false and the caller should fall back to FFmpeg.
+ *
+ * Throws on I/O error.
+ *
+ * @return false if the file is not supported (or malformed); in
+ * that case, nothing has been passed to the handler
+ */
+bool
+ScanMp4Headers(FileRangeReader &file, TagHandler &handler);
@@ -8,6 +8,7 @@
 #include "OpusTags.hxx"
 #include "lib/xiph/OggPacket.hxx"
 #include "lib/xiph/OggFind.hxx"
+#include "lib/xiph/OggHeaderScan.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "../DecoderAPI.hxx"
 #include "decoder/Reader.hxx"
@@ -16,6 +17,8 @@
 #include "tag/Handler.hxx"
 #include "tag/Builder.hxx"
 #include "input/InputStream.hxx"
+#include "io/FileRangeReader.hxx"
+#include "fs/Path.hxx"
 #include "Log.hxx"
 
 #include <opus.h>
@@ -490,6 +493,39 @@ mpd_opus_scan_stream(InputStream &is, TagHandler &handler)
 	return true;
 }
 
+static bool
+mpd_opus_scan_file(Path path_fs, TagHandler &handler) noexcept
+try {
+	FileRangeReader file(path_fs);
+	OggHeaders headers;
+	if (!ReadOggHeaders(file, 2, headers))
+		return false;
+
+	const auto &head = headers.packets[0], &tags = headers.packets[1];
+
+	unsigned channels, pre_skip;
+	signed output_gain;
+	if (head.size() < 8 || memcmp(head.data(), "OpusHead", 8) != 0 ||
+	    !ScanOpusHeader(head.data(), head.size(),
+			    channels, output_gain, pre_skip) ||
+	    !audio_valid_channel_count(channels) ||
+	    tags.size() < 8 || memcmp(tags.data(), "OpusTags", 8) != 0 ||
+	    !ScanOpusTags(tags.data(), tags.size(), nullptr, handler))
+		return false;
+
+	handler.OnAudioFormat(AudioFormat(opus_sample_rate,
+					  SampleFormat::S16, channels));
+
+	if (headers.last_granulepos >= int_least64_t(pre_skip))
+		handler.OnDuration(SongTime::FromScale<uint64_t>(headers.last_granulepos,
+								 opus_sample_rate));
+
+	return true;
+} catch (...) {
+	/* fall back to mpd_opus_scan_stream() */
+	return false;
+}
+
 const char *const opus_suffixes[] = {
 	"opus",
 	"ogg",
@@ -512,7 +548,8 @@ const char *const opus_mime_types[] = {
 } /* anonymous namespace */
 
 constexpr DecoderPlugin opus_decoder_plugin =
-	DecoderPlugin("opus", mpd_opus_stream_decode, mpd_opus_scan_stream)
+	DecoderPlugin("opus", mpd_opus_stream_decode, mpd_opus_scan_stream,
+		      nullptr, mpd_opus_scan_file)
 	.WithInit(mpd_opus_init)
 	.WithSuffixes(opus_suffixes)
 	.WithMimeTypes(opus_mime_types);
@@ -6,11 +6,14 @@
 #include "lib/xiph/VorbisComments.hxx"
 #include "lib/xiph/OggPacket.hxx"
 #include "lib/xiph/OggFind.hxx"
+#include "lib/xiph/OggHeaderScan.hxx"
 #include "VorbisDomain.hxx"
 #include "../DecoderAPI.hxx"
 #include "decoder/Features.h"
 #include "input/InputStream.hxx"
 #include "input/Reader.hxx"
+#include "io/FileRangeReader.hxx"
+#include "fs/Path.hxx"
 #include "OggCodec.hxx"
 #include "pcm/CheckAudioFormat.hxx"
 #include "pcm/Interleave.hxx"
@@ -404,6 +407,55 @@ vorbis_scan_stream(InputStream &is, TagHandler &handler)
 	return true;
 }
 
+static bool
+vorbis_scan_file(Path path_fs, TagHandler &handler) noexcept
+try {
+	/* read only the identification and comment headers (the
+	   setup header is not needed) and the last page */
+
+	FileRangeReader file(path_fs);
+	OggHeaders headers;
+	if (!ReadOggHeaders(file, 2, headers))
+		return false;
+
+	vorbis_info vi;
+	vorbis_info_init(&vi);
+	AtScopeExit(&) { vorbis_info_clear(&vi); };
+
+	vorbis_comment vc;
+	vorbis_comment_init(&vc);
+	AtScopeExit(&) { vorbis_comment_clear(&vc); };
+
+	for (std::size_t i = 0; i < headers.packets.size(); ++i) {
+		auto &data = headers.packets[i];
+
+		ogg_packet packet{};
+		packet.packet = (unsigned char *)data.data();
+		packet.bytes = data.size();
+		packet.b_o_s = i == 0;
+		packet.packetno = i;
+
+		if (vorbis_synthesis_headerin(&vi, &vc, &packet) != 0)
+			return false;
+	}
+
+	VorbisCommentScan(vc, handler);
+
+	if (headers.last_granulepos >= 0 && vi.rate > 0)
+		handler.OnDuration(SongTime::FromScale<uint64_t>(headers.last_granulepos,
+								 vi.rate));
+
+	try {
+		handler.OnAudioFormat(VorbisDecoder::CheckAudioFormat(vi));
+	} catch (...) {
+	}
+
+	return true;
+} catch (...) {
+	/* fall back to vorbis_scan_stream() */
+	return false;
+}
+
 static const char *const vorbis_suffixes[] = {
 	"ogg", "oga", nullptr
 };
@@ -421,7 +473,8 @@ static const char *const vorbis_mime_types[] = {
 };
 
 constexpr DecoderPlugin vorbis_decoder_plugin =
-	DecoderPlugin("vorbis", vorbis_stream_decode, vorbis_scan_stream)
+	DecoderPlugin("vorbis", vorbis_stream_decode, vorbis_scan_stream,
+		      nullptr, vorbis_scan_file)
 	.WithInit(vorbis_init)
 	.WithSuffixes(vorbis_suffixes)
 	.WithMimeTypes(vorbis_mime_types);
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "InstrumentedInputStream.hxx"
+#include "ProxyInputStream.hxx"
+#include "InputPlugin.hxx"
+#include "iostats/Registry.hxx"
+
+#include <string>
+
+class InstrumentedInputStream final : public ProxyInputStream {
+	IOStatsCounter &read_counter, &seek_counter;
+
+public:
+	InstrumentedInputStream(InputStreamPtr _input,
+				std::string_view source)
+		:ProxyInputStream(std::move(_input)),
+		 read_counter(GetIOStatsCounter(source, "read")),
+		 seek_counter(GetIOStatsCounter(source, "seek")) {
+		CopyAttributes();
+	}
+
+	/* virtual methods from InputStream */
+	void Seek(std::unique_lock<Mutex> &lock,
+		  offset_type new_offset) override {
+		IOStatsTimer timer{seek_counter};
+		ProxyInputStream::Seek(lock, new_offset);
+		timer.Commit();
+	}
+
+	size_t Read(std::unique_lock<Mutex> &lock,
+		    std::span<std::byte> dest) override {
+		IOStatsTimer timer{read_counter};
+		const size_t nbytes = ProxyInputStream::Read(lock, dest);
+		timer.Commit(nbytes);
+		return nbytes;
+	}
+};
+
+InputStreamPtr
+InstrumentInputStream(InputStreamPtr input, std::string_view source)
+{
+	return std::make_unique<InstrumentedInputStream>(std::move(input),
+							 source);
+}
+
+InputStreamPtr
+InstrumentInputStream(InputStreamPtr input, const InputPlugin &plugin)
+{
+	std::string source{"input:"};
+	source += plugin.name;
+	return InstrumentInputStream(std::move(input), source);
+}
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Ptr.hxx"
+
+#include <string_view>
+
+struct InputPlugin;
+
+/**
+ * Wrap an #InputStream in a proxy which records the number of bytes,
+ * the number of Read() and Seek() calls and their latency in the
+ * global I/O statistics (see iostats/Registry.hxx).
+ *
+ * @param source the statistics source name,
+ * e.g. "input:curl"
+ */
+InputStreamPtr
+InstrumentInputStream(InputStreamPtr input, std::string_view source);
+
+/**
+ * Wrap an #InputStream opened by the given plugin; the statistics
+ * source name is "input:" followed by the plugin name.
+ */
+InputStreamPtr
+InstrumentInputStream(InputStreamPtr input, const InputPlugin &plugin);
@@ -3,6 +3,7 @@
 
 #include "LocalOpen.hxx"
 #include "InputStream.hxx"
+#include "InstrumentedInputStream.hxx"
 #include "plugins/FileInputPlugin.hxx"
 #include "config.h"
 
@@ -24,6 +25,7 @@ InputStreamPtr
 OpenLocalInputStream(Path path, Mutex &mutex)
 {
 	InputStreamPtr is;
+	const char *source = "input:file";
 
 #ifdef ENABLE_ARCHIVE
 	try {
@@ -31,7 +33,8 @@ OpenLocalInputStream(Path path, Mutex &mutex)
 #ifdef HAVE_URING
 		is = OpenUringInputStream(path.c_str(), mutex);
 		if (is)
-			return is;
+			return InstrumentInputStream(std::move(is),
+						     "input:uring");
 #endif
 
 		is = OpenFileInputStream(path, mutex);
@@ -43,6 +46,8 @@ OpenLocalInputStream(Path path, Mutex &mutex)
 			is = OpenArchiveInputStream(path, mutex);
 			if (!is)
 				throw;
+
+			source = "input:archive";
 		} else
 			throw;
 	}
@@ -51,5 +56,5 @@ OpenLocalInputStream(Path path, Mutex &mutex)
 	assert(is);
 	assert(is->IsReady());
 
-	return is;
+	return InstrumentInputStream(std::move(is), source);
 }
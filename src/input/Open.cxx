@@ -4,6 +4,7 @@
 #include "InputStream.hxx"
 #include "Registry.hxx"
 #include "InputPlugin.hxx"
+#include "InstrumentedInputStream.hxx"
 #include "LocalOpen.hxx"
 #include "RewindInputStream.hxx"
 #include "WaitReady.hxx"
@@ -25,7 +26,8 @@ InputStream::Open(std::string_view url, Mutex &mutex)
 			continue;
 
 		if (auto is = plugin.open(url, mutex))
-			return input_rewind_open(std::move(is));
+			return input_rewind_open(InstrumentInputStream(std::move(is),
+								       plugin));
 	}
 
 	throw std::runtime_error("Unrecognized URI");
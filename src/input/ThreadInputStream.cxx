@@ -2,9 +2,11 @@
 // Copyright The Music Player Daemon Project
 
 #include "ThreadInputStream.hxx"
+#include "iostats/Registry.hxx"
 #include "thread/Name.hxx"
 
 #include <cassert>
+#include <string>
 
 #include <string.h>
 
@@ -15,7 +17,9 @@ ThreadInputStream::ThreadInputStream(const char *_plugin,
 	:InputStream(_uri, _mutex),
 	 plugin(_plugin),
 	 thread(BIND_THIS_METHOD(ThreadFunc)),
-	 allocation(_buffer_size)
+	 allocation(_buffer_size),
+	 stall_counter(GetIOStatsCounter(std::string{"input:"} + _plugin,
+					 "stall"))
 {
 	allocation.SetName("InputStream");
 	allocation.ForkCow(false);
@@ -172,22 +176,38 @@ ThreadInputStream::Read(std::unique_lock<Mutex> &lock,
 {
 	assert(!thread.IsInside());
 
+	std::chrono::steady_clock::time_point stall_start{};
+
+	const auto end_stall = [this, &stall_start](std::size_t nbytes, bool error){
+		if (stall_start == std::chrono::steady_clock::time_point{})
+			return;
+
+		const auto duration = std::chrono::steady_clock::now() - stall_start;
+		stall_duration += duration;
+		stall_counter.Add(duration, nbytes, error);
+	};
+
 	while (true) {
-		if (postponed_exception)
+		if (postponed_exception) {
+			end_stall(0, true);
 			std::rethrow_exception(postponed_exception);
-
-		if (IsSeeking()) {
-			caller_cond.wait(lock);
-			continue;
 		}
 
-		if (std::size_t nbytes = ReadFromBuffer(dest); nbytes > 0) {
-			wake_cond.notify_one();
-			return nbytes;
+		if (!IsSeeking()) {
+			std::size_t nbytes = ReadFromBuffer(dest);
+			if (nbytes > 0 || eof) {
+				end_stall(nbytes, false);
+
+				if (nbytes > 0)
+					wake_cond.notify_one();
+				return nbytes;
+			}
 		}
 
-		if (eof)
-			return 0;
+		if (stall_start == std::chrono::steady_clock::time_point{}) {
+			stall_start = std::chrono::steady_clock::now();
+			++stall_count;
+		}
 
 		caller_cond.wait(lock);
 	}
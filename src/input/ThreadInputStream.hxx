@@ -10,9 +10,12 @@
 #include "util/CircularBuffer.hxx"
 
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <exception>
 
+class IOStatsCounter;
+
 /**
  * Helper class for moving InputStream implementations with blocking
  * backend library implementation to a dedicated thread.  Data is
@@ -60,6 +63,24 @@ class ThreadInputStream : public InputStream {
 	 */
 	bool eof = false;
 
+	/**
+	 * The number of Read() calls which had to wait for the
+	 * thread because the buffer was empty.
+	 */
+	unsigned stall_count = 0;
+
+	/**
+	 * The total time Read() has waited for the thread.
+	 */
+	std::chrono::steady_clock::duration stall_duration{};
+
+	/**
+	 * Records each stalled Read() call and its duration in the
+	 * global I/O statistics (source "input:PLUGIN", operation
+	 * "stall").
+	 */
+	IOStatsCounter &stall_counter;
+
 public:
 	ThreadInputStream(const char *_plugin,
 			  std::string_view _uri, Mutex &_mutex,
@@ -99,6 +120,25 @@ protected:
 		InputStream::SetMimeType(_mime);
 	}
 
+	/**
+	 * Returns the number of Read() calls which were stalled
+	 * because the thread had not yet filled the buffer.
+	 *
+	 * Caller must lock the mutex (or call Stop() first).
+	 */
+	unsigned GetStallCount() const noexcept {
+		return stall_count;
+	}
+
+	/**
+	 * Returns the total time Read() was stalled.
+	 *
+	 * Caller must lock the mutex (or call Stop() first).
+	 */
+	std::chrono::steady_clock::duration GetStallDuration() const noexcept {
+		return stall_duration;
+	}
+
 	/* to be implemented by the plugin */
 
 	/**
@@ -11,16 +11,21 @@
 #include "../MaybeBufferedInputStream.hxx"
 #include "../AsyncInputStream.hxx"
 #include "../IcyInputStream.hxx"
+#include "../ProxyInputStream.hxx"
 #include "tag/IcyMetaDataParser.hxx"
 #include "../InputPlugin.hxx"
 #include "config/Block.hxx"
+#include "config/Parser.hxx"
 #include "tag/Builder.hxx"
 #include "tag/Tag.hxx"
 #include "lib/fmt/ToBuffer.hxx"
 #include "event/Call.hxx"
+#include "event/InjectEvent.hxx"
 #include "event/Loop.hxx"
+#include "thread/Cond.hxx"
 #include "util/CNumberParser.hxx"
 #include "util/Domain.hxx"
+#include "util/SparseBuffer.hxx"
 #include "util/StringCompare.hxx"
 #include "Log.hxx"
 #include "PluginUnavailable.hxx"
@@ -37,6 +42,8 @@
 
 #include <cassert>
 #include <cinttypes>
+#include <list>
+#include <optional>
 
 #include <string.h>
 
@@ -56,6 +63,17 @@ static const size_t CURL_MAX_BUFFERED = 512 * 1024;
  */
 static const size_t CURL_RESUME_AT = 384 * 1024;
 
+/**
+ * In segmented mode, each parallel request fetches a range of this
+ * many bytes.
+ */
+static constexpr size_t CURL_SEGMENT_SIZE = 1024 * 1024;
+
+/**
+ * The default for #segments_max_size.
+ */
+static constexpr uint_least64_t CURL_DEFAULT_SEGMENTS_MAX_SIZE = 128 * 1024 * 1024;
+
 class CurlInputStream final : public AsyncInputStream, CurlResponseHandler {
 	/* some buffers which were passed to libcurl, which we have
 	   too free */
@@ -142,6 +160,18 @@ static bool verify_peer, verify_host;
 /** Connection settings */
 static std::chrono::duration<long> connect_timeout;
 
+/**
+ * The number of parallel range requests for seekable resources; 0 or
+ * 1 disables the segmented mode.
+ */
+static unsigned segments;
+
+/**
+ * Files larger than this are not downloaded in segmented mode,
+ * because the whole file is kept in memory.
+ */
+static uint_least64_t segments_max_size = CURL_DEFAULT_SEGMENTS_MAX_SIZE;
+
 /**
  * CURLOPT_VERBOSE - verbose mode
  * DEFAULT 0, meaning disabled.
@@ -425,6 +455,13 @@ input_curl_init(EventLoop &event_loop, const ConfigBlock &block)
 	tcp_keepidle  = block.GetBlockValue("tcp_keepidle",default_tcp_keepidle);
 
 	tcp_keepintvl = block.GetBlockValue("tcp_keepintvl",default_tcp_keepintvl);
+
+	segments = block.GetBlockValue("segments", 0U);
+
+	if (const auto *param = block.GetBlockParam("segments_max_size"))
+		segments_max_size = param->With([](const char *s){
+			return ParseSize(s);
+		});
 }
 
 static void
@@ -617,6 +654,689 @@ CurlInputStream::Open(std::string_view url,
 	return std::make_unique<MaybeBufferedInputStream>(std::make_unique<IcyInputStream>(std::move(c), std::move(icy)));
 }
 
+/**
+ * An #InputStream which downloads a seekable resource with several
+ * parallel HTTP range requests into a #SparseBuffer.  Seeks are
+ * served from segments which have already been fetched, and the hole
+ * at the current read offset is always fetched first.
+ *
+ * The first request ("Range: bytes=0-") doubles as a probe: if the
+ * server does not respond with "206 Partial Content" and a total
+ * size, the resource is handed to a plain #CurlInputStream.
+ */
+class CurlSegmentedInputStream final : public ProxyInputStream {
+	class Segment;
+
+	/**
+	 * Additional request headers, needed to open the
+	 * #CurlInputStream in fallback mode.
+	 */
+	const Curl::Headers headers;
+
+	CurlSlist request_headers;
+
+	/**
+	 * Wakes up the I/O thread to start, resume and clean up
+	 * segment requests.
+	 */
+	InjectEvent schedule_event;
+
+	/**
+	 * Signalled when new data has been committed to #buffer or
+	 * when #mode or #postponed_exception changes.
+	 */
+	Cond cond;
+
+	/**
+	 * Only accessed in the I/O thread.
+	 */
+	std::list<std::unique_ptr<Segment>> active;
+
+	std::optional<SparseBuffer<std::byte>> buffer;
+
+	std::exception_ptr postponed_exception;
+
+	/**
+	 * The read offset at the time of the last OnSchedule() call.
+	 */
+	offset_type scheduled_offset = 0;
+
+	enum class Mode : uint_least8_t {
+		/**
+		 * Waiting for the response headers of the first
+		 * request.
+		 */
+		PROBE,
+
+		SEGMENTED,
+
+		/**
+		 * The server does not support range requests; the
+		 * resource is read from #input, which is a plain
+		 * #CurlInputStream.
+		 */
+		FALLBACK,
+	} mode = Mode::PROBE;
+
+public:
+	CurlSegmentedInputStream(EventLoop &event_loop, std::string_view _url,
+				 const Curl::Headers &_headers,
+				 Mutex &_mutex);
+
+	~CurlSegmentedInputStream() noexcept override;
+
+	static InputStreamPtr Open(std::string_view url,
+				   const Curl::Headers &headers,
+				   Mutex &mutex);
+
+	/* virtual methods from InputStream */
+	void Check() override;
+	void Seek(std::unique_lock<Mutex> &lock,
+		  offset_type new_offset) override;
+	bool IsEOF() const noexcept override;
+	bool IsAvailable() const noexcept override;
+	size_t Read(std::unique_lock<Mutex> &lock,
+		    std::span<std::byte> dest) override;
+
+private:
+	EventLoop &GetEventLoop() const noexcept {
+		return schedule_event.GetEventLoop();
+	}
+
+	/**
+	 * How far ahead of the read offset are segments fetched?
+	 */
+	offset_type GetReadAhead() const noexcept {
+		return offset_type(segments) * CURL_SEGMENT_SIZE * 2;
+	}
+
+	/**
+	 * Create a new request for the given range and add it to
+	 * #active.  The caller is responsible for starting it.
+	 *
+	 * Runs in the I/O thread.
+	 *
+	 * @param end_offset the end of the range or #UNKNOWN_SIZE to
+	 * request everything until the end of the resource
+	 */
+	Segment &AddSegment(offset_type start_offset, offset_type end_offset);
+
+	/**
+	 * Find the segment which will soon fetch the given offset.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	[[gnu::pure]]
+	const Segment *FindCovering(offset_type o) const noexcept;
+
+	/**
+	 * Decide which segments shall be started, resumed or
+	 * cancelled.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void Plan(std::list<std::unique_ptr<Segment>> &garbage,
+		  std::vector<Segment *> &to_start,
+		  std::vector<Segment *> &to_resume);
+
+	void OpenFallback() noexcept;
+
+	void SetError(std::exception_ptr e) noexcept;
+
+	/* callbacks from class Segment, invoked in the I/O thread */
+
+	/**
+	 * @return false if the request shall be stopped
+	 */
+	bool OnSegmentHeaders(Segment &segment, unsigned status,
+			      const Curl::Headers &response_headers);
+
+	enum class DataResult { CONSUMED, PAUSE, STOP };
+
+	DataResult OnSegmentData(Segment &segment,
+				 std::span<const std::byte> data) noexcept;
+
+	void OnSegmentError(std::exception_ptr e) noexcept;
+
+	void OnSchedule() noexcept;
+};
+
+/**
+ * One HTTP range request of a #CurlSegmentedInputStream.  All
+ * attributes are only accessed in the I/O thread.
+ */
+class CurlSegmentedInputStream::Segment final : CurlResponseHandler {
+	CurlSegmentedInputStream &parent;
+
+	CurlRequest request;
+
+public:
+	/**
+	 * The offset of the next byte to be received.
+	 */
+	offset_type position;
+
+	/**
+	 * The end of the requested range; #UNKNOWN_SIZE until the
+	 * first (open-ended) request has received its response
+	 * headers.
+	 */
+	offset_type end;
+
+	/**
+	 * Was the transfer paused because it is too far ahead of the
+	 * read offset?
+	 */
+	bool paused = false;
+
+	/**
+	 * Has the request ended?  It may be deleted now.
+	 */
+	bool finished = false;
+
+private:
+	/**
+	 * Was the request aborted on purpose, because its data is
+	 * not needed (anymore)?
+	 */
+	bool stopped = false;
+
+	struct Stopped {};
+
+public:
+	Segment(CurlSegmentedInputStream &_parent, CurlEasy &&easy,
+		offset_type _position, offset_type _end)
+		:parent(_parent),
+		 request(**curl_init, std::move(easy), *this),
+		 position(_position), end(_end) {}
+
+	void Start() {
+		request.Start();
+	}
+
+	void Resume() noexcept {
+		paused = false;
+		request.Resume();
+	}
+
+private:
+	/* virtual methods from CurlResponseHandler */
+	void OnHeaders(unsigned status, Curl::Headers &&headers) override {
+		if (!parent.OnSegmentHeaders(*this, status, headers)) {
+			stopped = true;
+			throw Stopped{};
+		}
+	}
+
+	void OnData(std::span<const std::byte> data) override {
+		switch (parent.OnSegmentData(*this, data)) {
+		case DataResult::CONSUMED:
+			break;
+
+		case DataResult::PAUSE:
+			paused = true;
+			throw CurlResponseHandler::Pause{};
+
+		case DataResult::STOP:
+			stopped = true;
+			throw Stopped{};
+		}
+	}
+
+	void OnEnd() override {
+		finished = true;
+		parent.schedule_event.Schedule();
+	}
+
+	void OnError(std::exception_ptr e) noexcept override {
+		finished = true;
+
+		if (stopped)
+			parent.schedule_event.Schedule();
+		else
+			parent.OnSegmentError(std::move(e));
+	}
+};
+
+inline
+CurlSegmentedInputStream::CurlSegmentedInputStream(EventLoop &event_loop,
+						   std::string_view _url,
+						   const Curl::Headers &_headers,
+						   Mutex &_mutex)
+	:ProxyInputStream(_url, _mutex),
+	 headers(_headers),
+	 schedule_event(event_loop, BIND_THIS_METHOD(OnSchedule))
+{
+	for (const auto &[key, header] : headers)
+		request_headers.Append((key + ":" += header).c_str());
+}
+
+CurlSegmentedInputStream::~CurlSegmentedInputStream() noexcept
+{
+	BlockingCall(GetEventLoop(), [this](){
+		schedule_event.Cancel();
+		active.clear();
+	});
+}
+
+CurlSegmentedInputStream::Segment &
+CurlSegmentedInputStream::AddSegment(offset_type start_offset,
+				     offset_type end_offset)
+{
+	auto easy = CreateEasy(GetURI(), request_headers.Get());
+	if (end_offset == UNKNOWN_SIZE)
+		easy.SetOption(CURLOPT_RANGE,
+			       FmtBuffer<40>("{}-"sv, start_offset).c_str());
+	else
+		easy.SetOption(CURLOPT_RANGE,
+			       FmtBuffer<64>("{}-{}"sv, start_offset,
+					     end_offset - 1).c_str());
+
+	active.emplace_back(std::make_unique<Segment>(*this, std::move(easy),
+						      start_offset, end_offset));
+	return *active.back();
+}
+
+/**
+ * Extract the total size from a "Content-Range" response header
+ * value such as "bytes 0-1023/4096".  Returns 0 if there is none.
+ */
+[[gnu::pure]]
+static offset_type
+ParseContentRangeSize(const char *s) noexcept
+{
+	const char *slash = strchr(s, '/');
+	if (slash == nullptr)
+		return 0;
+
+	char *endptr;
+	const offset_type value = ParseUint64(slash + 1, &endptr);
+	if (endptr == slash + 1 || *endptr != 0)
+		return 0;
+
+	return value;
+}
+
+bool
+CurlSegmentedInputStream::OnSegmentHeaders(Segment &segment, unsigned status,
+					   const Curl::Headers &response_headers)
+{
+	const std::scoped_lock protect{mutex};
+
+	if (mode != Mode::PROBE) {
+		if (status != 206)
+			throw HttpStatusError(status,
+					      FmtBuffer<64>("got HTTP status {} for range request",
+							    status).c_str());
+
+		return true;
+	}
+
+	/* the probe requests "bytes=0-", which is not satisfiable
+	   if the resource is empty; let a plain request handle
+	   that */
+	if (status != 416 && (status < 200 || status >= 300))
+		throw HttpStatusError(status,
+				      FmtBuffer<40>("got HTTP status {}",
+						    status).c_str());
+
+	offset_type total = 0;
+	if (status == 206) {
+		auto i = response_headers.find("content-range");
+		if (i != response_headers.end())
+			total = ParseContentRangeSize(i->second.c_str());
+	}
+
+	if (total == 0 || total > segments_max_size) {
+		FmtDebug(curl_domain, "Not downloading {:?} in segments",
+			 GetURI());
+		mode = Mode::FALLBACK;
+		cond.notify_all();
+		schedule_event.Schedule();
+		return false;
+	}
+
+	buffer.emplace(total);
+	buffer->SetName("CurlSegments");
+
+	size = total;
+	seekable = true;
+	segment.end = total;
+
+	auto i = response_headers.find("content-type");
+	if (i != response_headers.end())
+		SetMimeType(i->second.c_str());
+
+	mode = Mode::SEGMENTED;
+	SetReady();
+	cond.notify_all();
+	schedule_event.Schedule();
+	return true;
+}
+
+CurlSegmentedInputStream::DataResult
+CurlSegmentedInputStream::OnSegmentData(Segment &segment,
+					std::span<const std::byte> data) noexcept
+{
+	const std::scoped_lock protect{mutex};
+
+	assert(mode == Mode::SEGMENTED);
+
+	if (segment.position >= offset + GetReadAhead())
+		return DataResult::PAUSE;
+
+	bool committed = false;
+	DataResult result = DataResult::CONSUMED;
+
+	while (!data.empty() && segment.position < segment.end) {
+		auto w = buffer->Write(segment.position);
+		if (w.empty()) {
+			/* another segment has already fetched the
+			   following data */
+			result = DataResult::STOP;
+			break;
+		}
+
+		const std::size_t nbytes =
+			std::min<offset_type>({w.size(), data.size(),
+					       segment.end - segment.position});
+		std::copy_n(data.begin(), nbytes, w.begin());
+		buffer->Commit(segment.position, segment.position + nbytes);
+		segment.position += nbytes;
+		data = data.subspan(nbytes);
+		committed = true;
+	}
+
+	if (committed) {
+		cond.notify_all();
+		InvokeOnAvailable();
+	}
+
+	return result;
+}
+
+void
+CurlSegmentedInputStream::SetError(std::exception_ptr e) noexcept
+{
+	if (postponed_exception)
+		return;
+
+	postponed_exception = std::move(e);
+
+	if (!IsReady())
+		SetReady();
+	else
+		InvokeOnAvailable();
+
+	cond.notify_all();
+}
+
+void
+CurlSegmentedInputStream::OnSegmentError(std::exception_ptr e) noexcept
+{
+	const std::scoped_lock protect{mutex};
+	SetError(std::move(e));
+}
+
+inline const CurlSegmentedInputStream::Segment *
+CurlSegmentedInputStream::FindCovering(offset_type o) const noexcept
+{
+	for (const auto &s : active)
+		if (!s->finished && s->position <= o &&
+		    o < std::min(s->end, s->position + CURL_SEGMENT_SIZE))
+			return s.get();
+
+	return nullptr;
+}
+
+inline void
+CurlSegmentedInputStream::Plan(std::list<std::unique_ptr<Segment>> &garbage,
+			       std::vector<Segment *> &to_start,
+			       std::vector<Segment *> &to_resume)
+{
+	const offset_type window_end = std::min(size, offset + GetReadAhead());
+
+	for (auto &s : active)
+		if (s->paused && s->position < window_end)
+			to_resume.push_back(s.get());
+
+	/* the reader is waiting for the hole at the read offset:
+	   make room for it by cancelling the request which is
+	   farthest away */
+	if (active.size() >= segments && offset < size &&
+	    !buffer->Read(offset).HasData() && FindCovering(offset) == nullptr) {
+		const auto distance = [this](const auto &s){
+			return s->position >= offset
+				? s->position - offset
+				/* segments behind the read offset
+				   are useless for now */
+				: size + offset - s->position;
+		};
+
+		auto victim = std::max_element(active.begin(), active.end(),
+					       [&distance](const auto &a, const auto &b){
+						       return distance(a) < distance(b);
+					       });
+		std::erase(to_resume, victim->get());
+		garbage.splice(garbage.end(), active, victim);
+	}
+
+	/* start requests for the holes within the read-ahead
+	   window */
+	offset_type o = offset;
+	while (active.size() < segments && o < window_end) {
+		const auto r = buffer->Read(o);
+		if (r.undefined_size == 0) {
+			if (r.defined_buffer.empty())
+				break;
+
+			o += r.defined_buffer.size();
+			continue;
+		}
+
+		if (const auto *s = FindCovering(o)) {
+			o = std::min(s->end, s->position + CURL_SEGMENT_SIZE);
+			continue;
+		}
+
+		offset_type hole_end = std::min<offset_type>(o + r.undefined_size,
+							     o + CURL_SEGMENT_SIZE);
+		for (const auto &s : active)
+			if (!s->finished && s->position > o &&
+			    s->position < hole_end)
+				hole_end = s->position;
+
+		to_start.push_back(&AddSegment(o, hole_end));
+		o = hole_end;
+	}
+}
+
+void
+CurlSegmentedInputStream::OpenFallback() noexcept
+{
+	try {
+		auto is = CurlInputStream::Open(GetURI(), headers, mutex);
+
+		const std::scoped_lock protect{mutex};
+		SetInput(std::move(is));
+	} catch (...) {
+		const std::scoped_lock protect{mutex};
+		SetError(std::current_exception());
+	}
+}
+
+void
+CurlSegmentedInputStream::OnSchedule() noexcept
+{
+	std::list<std::unique_ptr<Segment>> garbage;
+	std::vector<Segment *> to_start, to_resume;
+	bool open_fallback = false;
+
+	{
+		const std::scoped_lock protect{mutex};
+
+		for (auto i = active.begin(); i != active.end();) {
+			auto next = std::next(i);
+			if ((*i)->finished)
+				garbage.splice(garbage.end(), active, i);
+			i = next;
+		}
+
+		if (postponed_exception) {
+		} else if (mode == Mode::FALLBACK) {
+			open_fallback = !input;
+		} else if (mode == Mode::SEGMENTED) {
+			scheduled_offset = offset;
+			Plan(garbage, to_start, to_resume);
+		}
+	}
+
+	/* libCURL may invoke callbacks which lock the mutex, so all
+	   of this must be done after releasing it */
+
+	garbage.clear();
+
+	if (open_fallback)
+		OpenFallback();
+
+	for (auto *s : to_resume)
+		s->Resume();
+
+	for (auto *s : to_start) {
+		try {
+			s->Start();
+		} catch (...) {
+			s->finished = true;
+			OnSegmentError(std::current_exception());
+		}
+	}
+}
+
+void
+CurlSegmentedInputStream::Check()
+{
+	if (postponed_exception)
+		std::rethrow_exception(postponed_exception);
+
+	ProxyInputStream::Check();
+}
+
+void
+CurlSegmentedInputStream::Seek(std::unique_lock<Mutex> &lock,
+			       offset_type new_offset)
+{
+	cond.wait(lock, [this]{
+		return mode != Mode::PROBE || postponed_exception;
+	});
+
+	Check();
+
+	if (mode == Mode::FALLBACK) {
+		ProxyInputStream::Seek(lock, new_offset);
+		return;
+	}
+
+	offset = new_offset;
+	schedule_event.Schedule();
+}
+
+bool
+CurlSegmentedInputStream::IsEOF() const noexcept
+{
+	switch (mode) {
+	case Mode::PROBE:
+		break;
+
+	case Mode::SEGMENTED:
+		return offset >= size;
+
+	case Mode::FALLBACK:
+		return ProxyInputStream::IsEOF();
+	}
+
+	return false;
+}
+
+bool
+CurlSegmentedInputStream::IsAvailable() const noexcept
+{
+	if (postponed_exception)
+		return true;
+
+	switch (mode) {
+	case Mode::PROBE:
+		break;
+
+	case Mode::SEGMENTED:
+		return offset >= size || buffer->Read(offset).HasData();
+
+	case Mode::FALLBACK:
+		return ProxyInputStream::IsAvailable();
+	}
+
+	return false;
+}
+
+size_t
+CurlSegmentedInputStream::Read(std::unique_lock<Mutex> &lock,
+			       std::span<std::byte> dest)
+{
+	bool scheduled = false;
+
+	while (true) {
+		Check();
+
+		if (mode == Mode::FALLBACK)
+			return ProxyInputStream::Read(lock, dest);
+
+		if (mode == Mode::SEGMENTED) {
+			if (offset >= size)
+				return 0;
+
+			const auto r = buffer->Read(offset);
+			if (r.HasData()) {
+				const std::size_t nbytes =
+					std::min(dest.size(),
+						 r.defined_buffer.size());
+				std::copy_n(r.defined_buffer.begin(), nbytes,
+					    dest.begin());
+				offset += nbytes;
+
+				/* let the I/O thread move the
+				   read-ahead window */
+				if (offset < scheduled_offset ||
+				    offset - scheduled_offset >= CURL_SEGMENT_SIZE / 4)
+					schedule_event.Schedule();
+
+				return nbytes;
+			}
+
+			if (!scheduled) {
+				schedule_event.Schedule();
+				scheduled = true;
+			}
+		}
+
+		cond.wait(lock);
+	}
+}
+
+inline InputStreamPtr
+CurlSegmentedInputStream::Open(std::string_view url,
+			       const Curl::Headers &headers,
+			       Mutex &mutex)
+{
+	auto c = std::make_unique<CurlSegmentedInputStream>((*curl_init)->GetEventLoop(),
+							    url, headers,
+							    mutex);
+
+	BlockingCall(c->GetEventLoop(), [&c](){
+		c->AddSegment(0, UNKNOWN_SIZE).Start();
+	});
+
+	return c;
+}
+
 InputStreamPtr
 OpenCurlInputStream(std::string_view uri, const Curl::Headers &headers,
 		    Mutex &mutex)
@@ -631,6 +1351,12 @@ input_curl_open(std::string_view url, Mutex &mutex)
 	    !StringStartsWithIgnoreCase(url, "https://"sv))
 		return nullptr;
 
+	/* only streams opened through the plugin (e.g. for
+	   playback) are downloaded in segments, but not those
+	   opened with OpenCurlInputStream() */
+	if (segments > 1)
+		return CurlSegmentedInputStream::Open(url, {}, mutex);
+
 	return CurlInputStream::Open(url, {}, mutex);
 }
 
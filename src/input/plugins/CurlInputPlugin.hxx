@@ -14,7 +14,10 @@ extern const struct InputPlugin input_plugin_curl;
 /**
  * Open a #CurlInputStream with custom request headers.
  *
- * This stream does not support Icy metadata.
+ * This stream does not support Icy metadata.  It is never
+ * downloaded in segments (see option "segments"), because it is
+ * used for scanning tags (e.g. by #CurlStorage), where the parallel
+ * requests and the buffer for the whole file would be wasted.
  *
  * Throws on error.
  */
@@ -6,30 +6,114 @@
 #include "../InputPlugin.hxx"
 #include "lib/nfs/Glue.hxx"
 #include "lib/nfs/FileReader.hxx"
+#include "config/Block.hxx"
+#include "config/Parser.hxx"
+
+#include <algorithm>
+#include <stdexcept>
 
 /**
  * Do not buffer more than this number of bytes.  It should be a
  * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * much, but doesn't cause stuttering on high-latency lines.  The
+ * buffer grows if the configured read pipeline needs more space.
  */
 static const size_t NFS_MAX_BUFFERED = 512 * 1024;
 
 /**
- * Resume the stream at this number of bytes after it has been paused.
+ * The default size of a single READ call.
+ */
+static constexpr size_t NFS_DEFAULT_READ_SIZE = 128 * 1024;
+
+/**
+ * The default for the maximum number of READ calls in flight.
+ */
+static constexpr unsigned NFS_DEFAULT_MAX_REQUESTS = 4;
+
+static size_t nfs_read_size = NFS_DEFAULT_READ_SIZE;
+static unsigned nfs_max_requests = NFS_DEFAULT_MAX_REQUESTS;
+
+/**
+ * Decides how many READ calls are kept in flight.  Similar to TCP
+ * Vegas, the window grows as long as the response time stays close
+ * to the lowest one observed (i.e. neither the server nor the
+ * network is saturated), and shrinks when requests start queueing
+ * up, because more requests would then only add latency.
  */
-static const size_t NFS_RESUME_AT = 384 * 1024;
+class NfsReadWindow {
+	using Duration = std::chrono::steady_clock::duration;
+
+	const unsigned max_size;
+
+	unsigned size;
+
+	Duration min_latency = Duration::max();
+
+	/**
+	 * Exponential moving average of the response time.
+	 */
+	Duration average_latency = Duration::zero();
+
+public:
+	explicit NfsReadWindow(unsigned _max_size) noexcept
+		:max_size(_max_size), size(std::min(2U, _max_size)) {}
+
+	unsigned GetSize() const noexcept {
+		return size;
+	}
+
+	void OnComplete(Duration latency) noexcept {
+		min_latency = std::min(min_latency, latency);
+		average_latency = average_latency == Duration::zero()
+			? latency
+			: (average_latency * 7 + latency) / 8;
+
+		if (average_latency <= min_latency * 3 / 2) {
+			if (size < max_size)
+				++size;
+		} else if (average_latency >= min_latency * 2) {
+			if (size > 1)
+				--size;
+		}
+	}
+};
 
 class NfsInputStream final : NfsFileReader, public AsyncInputStream {
+	/**
+	 * The offset of the next byte to be appended to the buffer.
+	 */
 	uint64_t next_offset;
 
+	/**
+	 * The offset of the next READ call.  The difference to
+	 * #next_offset is the number of bytes in flight.
+	 */
+	uint64_t read_offset;
+
+	const size_t read_size = nfs_read_size;
+
+	NfsReadWindow window{nfs_max_requests};
+
 	bool reconnect_on_resume = false, reconnecting = false;
 
+	static size_t GetBufferSize() noexcept {
+		return std::max(NFS_MAX_BUFFERED,
+				2 * nfs_max_requests * nfs_read_size);
+	}
+
+	/**
+	 * Resume when there is room for a whole window of requests.
+	 */
+	static size_t GetResumeAt() noexcept {
+		return GetBufferSize() - nfs_max_requests * nfs_read_size;
+	}
+
 public:
 	NfsInputStream(std::string_view _uri, Mutex &_mutex) noexcept
 		:AsyncInputStream(NfsFileReader::GetEventLoop(),
 				  _uri, _mutex,
-				  NFS_MAX_BUFFERED,
-				  NFS_RESUME_AT) {}
+				  GetBufferSize(),
+				  GetResumeAt()) {}
 
 	NfsInputStream(NfsConnection &_connection, std::string_view _path,
 		       Mutex &_mutex) noexcept
@@ -37,8 +121,8 @@ public:
 		 AsyncInputStream(NfsFileReader::GetEventLoop(),
 				  NfsFileReader::GetAbsoluteUri(),
 				  _mutex,
-				  NFS_MAX_BUFFERED,
-				  NFS_RESUME_AT) {}
+				  GetBufferSize(),
+				  GetResumeAt()) {}
 
 	~NfsInputStream() override {
 		DeferClose();
@@ -54,6 +138,9 @@ public:
 	}
 
 private:
+	/**
+	 * Submit READ calls until the window or the buffer is full.
+	 */
 	void DoRead();
 
 protected:
@@ -64,34 +151,39 @@ protected:
 private:
 	/* virtual methods from NfsFileReader */
 	void OnNfsFileOpen(uint64_t size) noexcept override;
-	void OnNfsFileRead(std::span<const std::byte> src) noexcept override;
+	void OnNfsFileRead(std::span<const std::byte> src,
+			   std::chrono::steady_clock::duration latency) noexcept override;
 	void OnNfsFileError(std::exception_ptr &&e) noexcept override;
 };
 
 void
 NfsInputStream::DoRead()
 {
-	assert(NfsFileReader::IsIdle());
-
-	int64_t remaining = size - next_offset;
-	if (remaining <= 0)
-		return;
-
-	const size_t buffer_space = GetBufferSpace();
-	if (buffer_space == 0) {
-		Pause();
-		return;
-	}
-
-	size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining, 32768),
-					 buffer_space);
-
-	try {
-		const ScopeUnlock unlock(mutex);
-		NfsFileReader::Read(next_offset, nbytes);
-	} catch (...) {
-		postponed_exception = std::current_exception();
-		InvokeOnAvailable();
+	while (NfsFileReader::GetPendingReads() < window.GetSize()) {
+		int64_t remaining = size - read_offset;
+		if (remaining <= 0)
+			return;
+
+		const size_t in_flight = read_offset - next_offset;
+		const size_t nbytes = std::min<uint64_t>(remaining, read_size);
+
+		/* data must fit into the buffer when it arrives */
+		if (GetBufferSpace() < in_flight + nbytes) {
+			if (in_flight == 0)
+				Pause();
+			return;
+		}
+
+		try {
+			const ScopeUnlock unlock(mutex);
+			NfsFileReader::Read(read_offset, nbytes);
+		} catch (...) {
+			postponed_exception = std::current_exception();
+			InvokeOnAvailable();
+			return;
+		}
+
+		read_offset += nbytes;
 	}
 }
 
@@ -105,6 +197,9 @@ NfsInputStream::DoResume()
 		reconnect_on_resume = false;
 		reconnecting = true;
 
+		/* all pending reads have been cancelled */
+		read_offset = next_offset;
+
 		ScopeUnlock unlock(mutex);
 
 		NfsFileReader::Close();
@@ -113,8 +208,6 @@ NfsInputStream::DoResume()
 		return;
 	}
 
-	assert(NfsFileReader::IsIdle());
-
 	DoRead();
 }
 
@@ -126,12 +219,9 @@ NfsInputStream::DoSeek(offset_type new_offset)
 		NfsFileReader::CancelRead();
 	}
 
-	next_offset = offset = new_offset;
+	next_offset = read_offset = offset = new_offset;
 	SeekDone();
 
-	if (!IsIdle())
-		CancelRead();
-
 	DoRead();
 }
 
@@ -150,17 +240,27 @@ NfsInputStream::OnNfsFileOpen(uint64_t _size) noexcept
 
 	size = _size;
 	seekable = true;
-	next_offset = 0;
+	next_offset = read_offset = 0;
 	SetReady();
 	DoRead();
 }
 
 void
-NfsInputStream::OnNfsFileRead(std::span<const std::byte> src) noexcept
+NfsInputStream::OnNfsFileRead(std::span<const std::byte> src,
+			      std::chrono::steady_clock::duration latency) noexcept
 {
 	const std::scoped_lock protect{mutex};
-	assert(!IsBufferFull());
-	assert(IsBufferFull() == (GetBufferSpace() == 0));
+	assert(src.size() <= GetBufferSpace());
+
+	window.OnComplete(latency);
+
+	if (src.empty()) {
+		/* the file was truncated after it was opened */
+		NfsFileReader::CancelRead();
+		postponed_exception = std::make_exception_ptr(std::runtime_error("Unexpected end of file"));
+		InvokeOnAvailable();
+		return;
+	}
 
 	AppendToBuffer(src);
 
@@ -201,8 +301,19 @@ NfsInputStream::OnNfsFileError(std::exception_ptr &&e) noexcept
  */
 
 static void
-input_nfs_init(EventLoop &event_loop, const ConfigBlock &)
+input_nfs_init(EventLoop &event_loop, const ConfigBlock &block)
 {
+	if (const auto *param = block.GetBlockParam("read_size"))
+		nfs_read_size = param->With([](const char *s){
+			const auto value = ParseSize(s);
+			if (value == 0)
+				throw std::invalid_argument("Must not be zero");
+			return value;
+		});
+
+	nfs_max_requests = block.GetPositiveValue("max_requests",
+						  NFS_DEFAULT_MAX_REQUESTS);
+
 	nfs_init(event_loop);
 }
 
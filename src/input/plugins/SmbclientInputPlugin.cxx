@@ -4,44 +4,87 @@
 #include "SmbclientInputPlugin.hxx"
 #include "lib/smbclient/Init.hxx"
 #include "lib/smbclient/Context.hxx"
-#include "../InputStream.hxx"
+#include "lib/smbclient/Domain.hxx"
+#include "../ThreadInputStream.hxx"
 #include "../InputPlugin.hxx"
 #include "../MaybeBufferedInputStream.hxx"
 #include "PluginUnavailable.hxx"
+#include "config/Block.hxx"
+#include "config/Parser.hxx"
 #include "system/Error.hxx"
+#include "Log.hxx"
 
 #include <libsmbclient.h>
 
-class SmbclientInputStream final : public InputStream {
+#include <algorithm>
+#include <stdexcept>
+
+static constexpr std::size_t KILOBYTE = 1024;
+
+/**
+ * The default size of the read-ahead buffer.
+ */
+static constexpr std::size_t SMBCLIENT_DEFAULT_BUFFER_SIZE = 1024 * KILOBYTE;
+
+/**
+ * The default size of a smbc_read() call.
+ */
+static constexpr std::size_t SMBCLIENT_DEFAULT_READ_SIZE = 128 * KILOBYTE;
+
+static std::size_t smbclient_buffer_size = SMBCLIENT_DEFAULT_BUFFER_SIZE;
+static std::size_t smbclient_read_size = SMBCLIENT_DEFAULT_READ_SIZE;
+
+/**
+ * Reads from the SMB share in a separate thread, so a slow server
+ * does not stall the decoder as long as the read-ahead buffer is not
+ * empty.
+ */
+class SmbclientInputStream final : public ThreadInputStream {
 	SmbclientContext ctx;
 	SMBCFILE *const handle;
 
+	const std::size_t read_size = smbclient_read_size;
+
+	/**
+	 * The file offset of the next smbc_read() call.  Only used
+	 * inside the thread.
+	 */
+	offset_type read_offset = 0;
+
+	/**
+	 * Statistics: the number of smbc_read() calls, and the total
+	 * time spent in them.  Only used inside the thread.
+	 */
+	unsigned read_count = 0;
+	std::chrono::steady_clock::duration read_duration{};
+
 public:
 	SmbclientInputStream(std::string &&_uri,
 			     Mutex &_mutex,
 			     SmbclientContext &&_ctx,
 			     SMBCFILE *_handle, const struct stat &st)
-		:InputStream(_uri, _mutex),
+		:ThreadInputStream(input_plugin_smbclient.name, _uri, _mutex,
+				   smbclient_buffer_size),
 		 ctx(std::move(_ctx)), handle(_handle)
 	{
 		seekable = true;
 		size = st.st_size;
-		SetReady();
+		Start();
 	}
 
 	~SmbclientInputStream() override {
+		Stop();
+		LogStatistics();
 		ctx.Close(handle);
 	}
 
-	/* virtual methods from InputStream */
+private:
+	void LogStatistics() const noexcept;
 
-	[[nodiscard]] bool IsEOF() const noexcept override {
-		return offset >= size;
-	}
-
-	size_t Read(std::unique_lock<Mutex> &lock,
-		    std::span<std::byte> dest) override;
-	void Seek(std::unique_lock<Mutex> &lock, offset_type offset) override;
+protected:
+	/* virtual methods from ThreadInputStream */
+	std::size_t ThreadRead(std::span<std::byte> dest) override;
+	void ThreadSeek(offset_type new_offset) override;
 };
 
 /*
@@ -49,9 +92,31 @@ public:
  *
  */
 
+static std::size_t
+GetSizeBlockValue(const ConfigBlock &block, const char *name,
+		  std::size_t default_value)
+{
+	const auto *param = block.GetBlockParam(name);
+	if (param == nullptr)
+		return default_value;
+
+	return param->With([](const char *s){
+		const auto value = ParseSize(s);
+		if (value == 0)
+			throw std::invalid_argument("Must not be zero");
+		return value;
+	});
+}
+
 static void
-input_smbclient_init(EventLoop &, const ConfigBlock &)
+input_smbclient_init(EventLoop &, const ConfigBlock &block)
 {
+	smbclient_buffer_size = GetSizeBlockValue(block, "buffer_size",
+						  SMBCLIENT_DEFAULT_BUFFER_SIZE);
+	smbclient_read_size = std::min(GetSizeBlockValue(block, "read_size",
+							 SMBCLIENT_DEFAULT_READ_SIZE),
+				       smbclient_buffer_size);
+
 	try {
 		SmbclientInit();
 	} catch (...) {
@@ -60,7 +125,7 @@ input_smbclient_init(EventLoop &, const ConfigBlock &)
 
 	// TODO: create one global SMBCCTX here?
 
-	// TODO: evaluate ConfigBlock, call smbc_setOption*()
+	// TODO: pass more settings from the ConfigBlock to smbc_setOption*()
 }
 
 static InputStreamPtr
@@ -87,39 +152,47 @@ input_smbclient_open(std::string_view _uri,
 							handle, st));
 }
 
-size_t
-SmbclientInputStream::Read(std::unique_lock<Mutex> &,
-			   std::span<std::byte> dest)
+void
+SmbclientInputStream::LogStatistics() const noexcept
 {
-	ssize_t nbytes;
+	using std::chrono::duration_cast, std::chrono::milliseconds;
+
+	FmtDebug(smbclient_domain,
+		 "{:?}: {} reads in {} ms; consumer stalled {} times for {} ms",
+		 GetURI(), read_count,
+		 duration_cast<milliseconds>(read_duration).count(),
+		 GetStallCount(),
+		 duration_cast<milliseconds>(GetStallDuration()).count());
+}
 
-	{
-		const ScopeUnlock unlock(mutex);
-		nbytes = ctx.Read(handle, dest.data(), dest.size());
-	}
+std::size_t
+SmbclientInputStream::ThreadRead(std::span<std::byte> dest)
+{
+	/* read whole aligned blocks; after a seek, the first read
+	   only goes up to the next block boundary */
+	const std::size_t max_size = read_size - read_offset % read_size;
+	if (dest.size() > max_size)
+		dest = dest.first(max_size);
+
+	const auto start = std::chrono::steady_clock::now();
+	const ssize_t nbytes = ctx.Read(handle, dest.data(), dest.size());
+	read_duration += std::chrono::steady_clock::now() - start;
+	++read_count;
 
 	if (nbytes < 0)
 		throw MakeErrno("smbc_read() failed");
 
-	offset += nbytes;
+	read_offset += nbytes;
 	return nbytes;
 }
 
 void
-SmbclientInputStream::Seek(std::unique_lock<Mutex> &,
-			   offset_type new_offset)
+SmbclientInputStream::ThreadSeek(offset_type new_offset)
 {
-	off_t result;
-
-	{
-		const ScopeUnlock unlock(mutex);
-		result = ctx.Seek(handle, new_offset);
-	}
-
-	if (result < 0)
+	if (ctx.Seek(handle, new_offset) < 0)
 		throw MakeErrno("smbc_lseek() failed");
 
-	offset = result;
+	read_offset = new_offset;
 }
 
 static constexpr const char *smbclient_prefixes[] = {
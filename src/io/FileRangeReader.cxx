@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "FileRangeReader.hxx"
+#include "fs/Path.hxx"
+
+#include <algorithm>
+
+FileRangeReader::FileRangeReader(FileReader &&_file) noexcept
+	:file(std::move(_file)), size(file.GetSize()) {}
+
+FileRangeReader::FileRangeReader(Path path)
+	:FileRangeReader(FileReader{path}) {}
+
+std::span<const std::byte>
+FileRangeReader::Read(uint_least64_t offset, std::size_t length)
+{
+	if (offset >= size)
+		return {};
+
+	length = std::min<uint_least64_t>(length, size - offset);
+
+	if (offset >= buffer_offset &&
+	    offset + length <= buffer_offset + buffer_fill)
+		return std::span<const std::byte>{buffer}
+			.subspan(offset - buffer_offset, length);
+
+	const std::size_t chunk = std::min<uint_least64_t>(std::max(length, CHUNK_SIZE),
+							   size - offset);
+	buffer.GrowDiscard(chunk);
+	const std::span<std::byte> dest{buffer};
+
+	buffer_offset = offset;
+	buffer_fill = 0;
+
+	while (buffer_fill < chunk) {
+		std::size_t nbytes = file.ReadAt(offset + buffer_fill,
+						 dest.subspan(buffer_fill,
+							      chunk - buffer_fill));
+		if (nbytes == 0)
+			/* the file has been truncated meanwhile */
+			break;
+
+		buffer_fill += nbytes;
+	}
+
+	return dest.first(std::min(length, buffer_fill));
+}
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "FileReader.hxx"
+#include "util/AllocatedArray.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * Random access to small ranges of a file, e.g. for parsing the
+ * headers of a song file.  The last chunk read from the file is
+ * kept in a buffer, so nearby ranges can be parsed without another
+ * system call; each cache miss is one pread().
+ */
+class FileRangeReader {
+	FileReader file;
+
+	const uint_least64_t size;
+
+	AllocatedArray<std::byte> buffer;
+
+	/**
+	 * The file offset of the first byte in #buffer.
+	 */
+	uint_least64_t buffer_offset = 0;
+
+	/**
+	 * The number of valid bytes in #buffer.
+	 */
+	std::size_t buffer_fill = 0;
+
+public:
+	/**
+	 * The minimum number of bytes read from the file at a time.
+	 */
+	static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+	explicit FileRangeReader(FileReader &&_file) noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	explicit FileRangeReader(Path path);
+
+	uint_least64_t GetSize() const noexcept {
+		return size;
+	}
+
+	/**
+	 * Read the given range of the file.
+	 *
+	 * Throws on I/O error.
+	 *
+	 * @return the data; it may be shorter than requested if the
+	 * end of the file was reached; it remains valid until the
+	 * next call
+	 */
+	std::span<const std::byte> Read(uint_least64_t offset,
+					 std::size_t length);
+};
@@ -41,6 +41,26 @@ FileReader::Read(std::span<std::byte> dest)
 	return nbytes;
 }
 
+std::size_t
+FileReader::ReadAt(uint_least64_t offset, std::span<std::byte> dest)
+{
+	assert(IsDefined());
+
+	OVERLAPPED overlapped{};
+	overlapped.Offset = DWORD(offset);
+	overlapped.OffsetHigh = DWORD(offset >> 32);
+
+	DWORD nbytes;
+	if (!ReadFile(handle, dest.data(), dest.size(), &nbytes, &overlapped)) {
+		if (GetLastError() == ERROR_HANDLE_EOF)
+			return 0;
+
+		throw MakeLastError("Failed to read from file");
+	}
+
+	return nbytes;
+}
+
 void
 FileReader::Seek(off_t offset)
 {
@@ -88,6 +108,18 @@ FileReader::Read(std::span<std::byte> dest)
 	return nbytes;
 }
 
+std::size_t
+FileReader::ReadAt(uint_least64_t offset, std::span<std::byte> dest)
+{
+	assert(IsDefined());
+
+	ssize_t nbytes = fd.ReadAt(offset, dest);
+	if (nbytes < 0)
+		throw MakeErrno("Failed to read from file");
+
+	return nbytes;
+}
+
 void
 FileReader::Seek(off_t offset)
 {
@@ -97,6 +97,17 @@ public:
 	void Seek(off_t offset);
 	void Skip(off_t offset);
 
+	/**
+	 * Read data at the given offset without moving the file
+	 * pointer.
+	 *
+	 * Throws on error.
+	 *
+	 * @return the number of bytes read; 0 at the end of the
+	 * file
+	 */
+	std::size_t ReadAt(uint_least64_t offset, std::span<std::byte> dest);
+
 	/* virtual methods from class Reader */
 	std::size_t Read(std::span<std::byte> dest) override;
 };
@@ -75,6 +75,16 @@ public:
 		return io_uring_get_sqe(&ring);
 	}
 
+	/**
+	 * Returns the number of submit queue entries which have not
+	 * yet been consumed by the kernel.
+	 *
+	 * @see io_uring_sq_ready()
+	 */
+	unsigned GetSubmitQueueReady() const noexcept {
+		return io_uring_sq_ready(&ring);
+	}
+
 	/**
 	 * Submit all pending entries from the submit queue to the
 	 * kernel using io_uring_submit().
@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * A copy of the values of an #IOStatsCounter at one point in time.
+ */
+struct IOStatsSnapshot {
+	using Duration = std::chrono::steady_clock::duration;
+
+	/**
+	 * The number of histogram buckets.  Bucket 0 counts
+	 * operations which took less than one microsecond, bucket i
+	 * counts [2^(i-1), 2^i) microseconds, and the last bucket
+	 * counts everything longer than that (more than 4 seconds).
+	 */
+	static constexpr std::size_t N_BUCKETS = 24;
+
+	uint_least64_t count = 0, bytes = 0, errors = 0;
+
+	/**
+	 * The accumulated duration of all operations.
+	 */
+	Duration duration{};
+
+	std::array<uint_least64_t, N_BUCKETS> histogram{};
+
+	/**
+	 * Subtract an older snapshot of the same counter, leaving
+	 * only what happened in between.
+	 */
+	constexpr IOStatsSnapshot &operator-=(const IOStatsSnapshot &other) noexcept {
+		count -= other.count;
+		bytes -= other.bytes;
+		errors -= other.errors;
+		duration -= other.duration;
+		for (std::size_t i = 0; i < N_BUCKETS; ++i)
+			histogram[i] -= other.histogram[i];
+		return *this;
+	}
+
+	[[gnu::const]]
+	static constexpr std::size_t GetBucket(Duration d) noexcept {
+		const auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+		if (us <= 0)
+			return 0;
+
+		const std::size_t i = std::bit_width(static_cast<uint_least64_t>(us));
+		return i < N_BUCKETS ? i : N_BUCKETS - 1;
+	}
+
+	/**
+	 * Returns the (exclusive) upper bound of the given bucket.
+	 * For the last bucket, this is its lower bound.
+	 */
+	[[gnu::const]]
+	static constexpr Duration GetBucketLimit(std::size_t i) noexcept {
+		if (i >= N_BUCKETS - 1)
+			i = N_BUCKETS - 2;
+
+		return std::chrono::microseconds{uint_least64_t{1} << i};
+	}
+
+	/**
+	 * Estimate a percentile from the histogram.  The result is
+	 * the upper bound of the bucket containing it.
+	 *
+	 * @param p a value between 0 and 1
+	 */
+	[[gnu::pure]]
+	Duration GetPercentile(double p) const noexcept;
+};
+
+/**
+ * Collects statistics about one kind of I/O operation: the number of
+ * operations, bytes transferred, errors and a latency histogram.
+ *
+ * All methods are lock-free and may be called from any thread.
+ */
+class IOStatsCounter {
+	using Duration = IOStatsSnapshot::Duration;
+
+	std::atomic_uint_least64_t count{0}, bytes{0}, errors{0};
+
+	/**
+	 * The accumulated duration in nanoseconds.
+	 */
+	std::atomic_uint_least64_t nanoseconds{0};
+
+	std::array<std::atomic_uint_least64_t, IOStatsSnapshot::N_BUCKETS> histogram{};
+
+public:
+	IOStatsCounter() noexcept = default;
+	IOStatsCounter(const IOStatsCounter &) = delete;
+	IOStatsCounter &operator=(const IOStatsCounter &) = delete;
+
+	/**
+	 * Record one completed operation.
+	 */
+	void Add(Duration duration, uint_least64_t nbytes=0,
+		 bool error=false) noexcept {
+		constexpr auto relaxed = std::memory_order_relaxed;
+
+		count.fetch_add(1, relaxed);
+		if (nbytes > 0)
+			bytes.fetch_add(nbytes, relaxed);
+		if (error)
+			errors.fetch_add(1, relaxed);
+
+		nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(),
+				      relaxed);
+		histogram[IOStatsSnapshot::GetBucket(duration)].fetch_add(1, relaxed);
+	}
+
+	[[gnu::pure]]
+	IOStatsSnapshot GetSnapshot() const noexcept;
+};
+
+/**
+ * Measures the duration of one operation and records it in an
+ * #IOStatsCounter.  If Commit() was not called until destruction
+ * (i.e. an exception was thrown), the operation is recorded as an
+ * error.
+ */
+class IOStatsTimer {
+	IOStatsCounter &counter;
+
+	const std::chrono::steady_clock::time_point start =
+		std::chrono::steady_clock::now();
+
+	bool committed = false;
+
+public:
+	explicit IOStatsTimer(IOStatsCounter &_counter) noexcept
+		:counter(_counter) {}
+
+	~IOStatsTimer() noexcept {
+		if (!committed)
+			counter.Add(std::chrono::steady_clock::now() - start,
+				    0, true);
+	}
+
+	IOStatsTimer(const IOStatsTimer &) = delete;
+	IOStatsTimer &operator=(const IOStatsTimer &) = delete;
+
+	void Commit(uint_least64_t nbytes=0) noexcept {
+		committed = true;
+		counter.Add(std::chrono::steady_clock::now() - start, nbytes);
+	}
+};
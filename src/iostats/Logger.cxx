@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Logger.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <tuple>
+
+static constexpr Domain iostats_domain("iostats");
+
+IOStatsLogger::IOStatsLogger(EventLoop &event_loop,
+			     Event::Duration _interval) noexcept
+	:interval(_interval),
+	 timer_event(event_loop, BIND_THIS_METHOD(OnTimeout))
+{
+	timer_event.Schedule(interval);
+}
+
+[[gnu::pure]]
+static const IOStatsSnapshot *
+FindSnapshot(const std::vector<IOStatsEntry> &v,
+	     const IOStatsEntry &key) noexcept
+{
+	/* both vectors are sorted by (source, operation) */
+	const auto i = std::lower_bound(v.begin(), v.end(), key,
+					[](const IOStatsEntry &a, const IOStatsEntry &b){
+						return std::tie(a.source, a.operation) <
+							std::tie(b.source, b.operation);
+					});
+	if (i == v.end() || i->source != key.source ||
+	    i->operation != key.operation)
+		return nullptr;
+
+	return &i->snapshot;
+}
+
+static constexpr double
+ToMilliseconds(IOStatsSnapshot::Duration d) noexcept
+{
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void
+IOStatsLogger::OnTimeout() noexcept
+{
+	auto current = CollectIOStats();
+
+	for (const auto &i : current) {
+		IOStatsSnapshot delta = i.snapshot;
+		if (const auto *p = FindSnapshot(previous, i))
+			delta -= *p;
+
+		if (delta.count == 0)
+			continue;
+
+		FmtInfo(iostats_domain,
+			"{} {}: count={} bytes={} errors={} avg={:.3f}ms p50={:.3f}ms p99={:.3f}ms",
+			i.source, i.operation,
+			delta.count, delta.bytes, delta.errors,
+			ToMilliseconds(delta.duration) / delta.count,
+			ToMilliseconds(delta.GetPercentile(0.5)),
+			ToMilliseconds(delta.GetPercentile(0.99)));
+	}
+
+	previous = std::move(current);
+	timer_event.Schedule(interval);
+}
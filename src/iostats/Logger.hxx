@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Registry.hxx"
+#include "event/FarTimerEvent.hxx"
+
+#include <vector>
+
+/**
+ * Periodically logs the I/O statistics which have been collected
+ * since the previous dump.
+ */
+class IOStatsLogger final {
+	const Event::Duration interval;
+
+	FarTimerEvent timer_event;
+
+	/**
+	 * The snapshot taken at the previous dump.
+	 */
+	std::vector<IOStatsEntry> previous;
+
+public:
+	IOStatsLogger(EventLoop &event_loop,
+		      Event::Duration _interval) noexcept;
+
+private:
+	void OnTimeout() noexcept;
+};
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Registry.hxx"
+#include "thread/Mutex.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+IOStatsSnapshot::Duration
+IOStatsSnapshot::GetPercentile(double p) const noexcept
+{
+	if (count == 0)
+		return {};
+
+	const auto rank = std::max<uint_least64_t>(std::ceil(p * count), 1);
+
+	uint_least64_t sum = 0;
+	for (std::size_t i = 0; i < N_BUCKETS; ++i) {
+		sum += histogram[i];
+		if (sum >= rank)
+			return GetBucketLimit(i);
+	}
+
+	return GetBucketLimit(N_BUCKETS - 1);
+}
+
+IOStatsSnapshot
+IOStatsCounter::GetSnapshot() const noexcept
+{
+	constexpr auto relaxed = std::memory_order_relaxed;
+
+	IOStatsSnapshot s;
+	s.count = count.load(relaxed);
+	s.bytes = bytes.load(relaxed);
+	s.errors = errors.load(relaxed);
+	s.duration = std::chrono::duration_cast<Duration>(std::chrono::nanoseconds{nanoseconds.load(relaxed)});
+
+	for (std::size_t i = 0; i < histogram.size(); ++i)
+		s.histogram[i] = histogram[i].load(relaxed);
+
+	return s;
+}
+
+namespace {
+
+struct IOStatsRegistry {
+	Mutex mutex;
+
+	/**
+	 * Key is (source, operation).  std::map never moves its
+	 * elements, therefore references to the counters remain
+	 * valid.
+	 */
+	std::map<std::pair<std::string, std::string>, IOStatsCounter,
+		 std::less<>> counters;
+};
+
+} // anonymous namespace
+
+/**
+ * The registry is never freed, because counters may still be used
+ * by objects destroyed after static destructors have run.
+ */
+static IOStatsRegistry &io_stats_registry = *new IOStatsRegistry();
+
+IOStatsCounter &
+GetIOStatsCounter(std::string_view source, std::string_view operation)
+{
+	auto &registry = io_stats_registry;
+	const std::scoped_lock lock{registry.mutex};
+
+	auto [i, _] = registry.counters.try_emplace(std::pair{std::string{source},
+							      std::string{operation}});
+	return i->second;
+}
+
+std::vector<IOStatsEntry>
+CollectIOStats()
+{
+	auto &registry = io_stats_registry;
+	const std::scoped_lock lock{registry.mutex};
+
+	std::vector<IOStatsEntry> result;
+	result.reserve(registry.counters.size());
+
+	for (const auto &[key, counter] : registry.counters)
+		result.push_back({key.first, key.second, counter.GetSnapshot()});
+
+	return result;
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Counter.hxx"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Look up (or create) the global #IOStatsCounter for the given
+ * source (e.g. "input:curl" or "storage:nfs://server/music") and
+ * operation (e.g. "read").  The returned reference remains valid
+ * until the process exits.
+ *
+ * This function is thread-safe, but it locks a mutex; callers should
+ * look up counters once and keep the reference.
+ */
+IOStatsCounter &
+GetIOStatsCounter(std::string_view source, std::string_view operation);
+
+struct IOStatsEntry {
+	std::string source, operation;
+
+	IOStatsSnapshot snapshot;
+};
+
+/**
+ * Obtain a snapshot of all counters, sorted by source and
+ * operation.
+ */
+std::vector<IOStatsEntry>
+CollectIOStats();
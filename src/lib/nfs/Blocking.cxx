@@ -6,27 +6,58 @@
 #include "event/Call.hxx"
 
 void
-BlockingNfsOperation::Run()
+BlockingNfsOperation::Begin() noexcept
 {
 	/* subscribe to the connection, which will invoke either
 	   OnNfsConnectionReady() or OnNfsConnectionFailed() */
 	BlockingCall(connection.GetEventLoop(),
 		    [this](){ connection.AddLease(*this); });
+}
 
+void
+BlockingNfsOperation::Wait()
+{
 	/* wait for completion */
-	if (!LockWaitFinished())
+	if (!LockWaitFinished()) {
+		Cancel();
 		throw std::runtime_error("Timeout");
+	}
 
 	/* check for error */
 	if (error)
 		std::rethrow_exception(std::move(error));
 }
 
+void
+BlockingNfsOperation::Cancel() noexcept
+{
+	/* after the operation has finished, the connection may be
+	   gone already, so don't touch it */
+	if (IsFinished())
+		return;
+
+	BlockingCall(connection.GetEventLoop(), [this](){
+		const std::scoped_lock protect{mutex};
+		if (finished)
+			return;
+
+		/* the lease is still registered until the operation
+		   finishes */
+		connection.RemoveLease(*this);
+
+		if (started)
+			connection.Cancel(*this, nullptr, {});
+
+		finished = true;
+	});
+}
+
 void
 BlockingNfsOperation::OnNfsConnectionReady() noexcept
 {
 	try {
 		Start();
+		started = true;
 	} catch (...) {
 		error = std::current_exception();
 		connection.RemoveLease(*this);
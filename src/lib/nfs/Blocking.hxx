@@ -17,6 +17,10 @@ class NfsConnection;
  * Utility class to implement a blocking NFS call using the libnfs
  * async API.  The actual method call is deferred to the #EventLoop
  * thread, and method Run() waits for completion.
+ *
+ * Alternatively, Begin() submits the operation without waiting,
+ * which allows several operations to run in parallel; Wait() picks
+ * up the result later.
  */
 class BlockingNfsOperation : protected NfsCallback, NfsLease {
 	static constexpr std::chrono::steady_clock::duration timeout =
@@ -27,6 +31,12 @@ class BlockingNfsOperation : protected NfsCallback, NfsLease {
 
 	bool finished;
 
+	/**
+	 * Has Start() been called successfully?  Only accessed in
+	 * the #EventLoop thread.
+	 */
+	bool started = false;
+
 	std::exception_ptr error;
 
 protected:
@@ -39,7 +49,37 @@ public:
 	/**
 	 * Throws std::runtime_error on error.
 	 */
-	void Run();
+	void Run() {
+		Begin();
+		Wait();
+	}
+
+	/**
+	 * Submit the operation to the #EventLoop thread, but do not
+	 * wait for its completion.  Call Wait() or Cancel() later.
+	 */
+	void Begin() noexcept;
+
+	/**
+	 * Wait for the completion of an operation submitted with
+	 * Begin().
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void Wait();
+
+	bool IsFinished() noexcept {
+		const std::scoped_lock protect{mutex};
+		return finished;
+	}
+
+	/**
+	 * Cancel an operation submitted with Begin() unless it has
+	 * finished already.  Afterwards, this object may be
+	 * destructed.  This must not be called inside the
+	 * #EventLoop thread.
+	 */
+	void Cancel() noexcept;
 
 private:
 	bool LockWaitFinished() noexcept {
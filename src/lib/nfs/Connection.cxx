@@ -53,6 +53,8 @@ NfsConnection::CancellableCallback::OpenDirectory(nfs_context *ctx,
 {
 	assert(connection.GetEventLoop().IsInside());
 
+	open_directory = true;
+
 	int result = nfs_opendir_async(ctx, path, Callback, this);
 	if (result < 0)
 		throw NfsClientError(ctx, "nfs_opendir_async() failed");
@@ -72,17 +74,19 @@ NfsConnection::CancellableCallback::Open(nfs_context *ctx,
 
 inline void
 NfsConnection::CancellableCallback::Stat(nfs_context *ctx,
-					 struct nfsfh *fh)
+					 struct nfsfh *_fh)
 {
 	assert(connection.GetEventLoop().IsInside());
 
+	fh = _fh;
+
 	int result = nfs_fstat64_async(ctx, fh, Callback, this);
 	if (result < 0)
 		throw NfsClientError(ctx, "nfs_fstat_async() failed");
 }
 
 inline void
-NfsConnection::CancellableCallback::Read(nfs_context *ctx, struct nfsfh *fh,
+NfsConnection::CancellableCallback::Read(nfs_context *ctx, struct nfsfh *_fh,
 					 uint64_t offset,
 #ifdef LIBNFS_API_2
 					 std::span<std::byte> dest
@@ -93,6 +97,8 @@ NfsConnection::CancellableCallback::Read(nfs_context *ctx, struct nfsfh *fh,
 {
 	assert(connection.GetEventLoop().IsInside());
 
+	fh = _fh;
+
 	int result = nfs_pread_async(ctx, fh,
 #ifdef LIBNFS_API_2
 				     dest.data(), dest.size(),
@@ -107,7 +113,7 @@ NfsConnection::CancellableCallback::Read(nfs_context *ctx, struct nfsfh *fh,
 }
 
 inline void
-NfsConnection::CancellableCallback::CancelAndScheduleClose(struct nfsfh *fh,
+NfsConnection::CancellableCallback::CancelAndScheduleClose(struct nfsfh *_close_fh,
 							   DisposablePointer &&_dispose_value) noexcept
 {
 	assert(connection.GetEventLoop().IsInside());
@@ -115,7 +121,7 @@ NfsConnection::CancellableCallback::CancelAndScheduleClose(struct nfsfh *fh,
 	assert(close_fh == nullptr);
 	assert(!dispose_value);
 
-	close_fh = fh;
+	close_fh = _close_fh;
 	dispose_value = std::move(_dispose_value);
 
 	Cancel();
@@ -172,11 +178,26 @@ NfsConnection::CancellableCallback::Callback(int err, void *data) noexcept
 			assert(close_fh == nullptr);
 
 			if (err >= 0) {
-				auto *fh = (struct nfsfh *)data;
-				connection.Close(fh);
+				auto *new_fh = (struct nfsfh *)data;
+				connection.Close(new_fh);
 			}
-		} else if (close_fh != nullptr)
-			connection.DeferClose(close_fh);
+		} else if (open_directory) {
+			/* same for nfs_opendir_async() */
+			if (err >= 0)
+				connection.CloseDirectory((struct nfsdir *)data);
+		} else if (close_fh != nullptr) {
+			/* if there are more (cancelled) operations
+			   on this file handle, the last one closes
+			   it */
+			bool taken = false;
+			connection.callbacks.ForEach([this, &taken](CancellableCallback &c){
+				if (!taken && &c != this)
+					taken = c.TakeOverClose(close_fh);
+			});
+
+			if (!taken)
+				connection.DeferClose(close_fh);
+		}
 
 		connection.callbacks.Remove(*this);
 	}
@@ -302,7 +323,7 @@ NfsConnection::OpenDirectory(const char *path, NfsCallback &callback)
 	assert(GetEventLoop().IsInside());
 	assert(!callbacks.Contains(callback));
 
-	auto &c = callbacks.Add(callback, *this, true);
+	auto &c = callbacks.Add(callback, *this, false);
 	try {
 		c.OpenDirectory(context, path);
 	} catch (...) {
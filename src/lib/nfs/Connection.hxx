@@ -36,6 +36,19 @@ class NfsConnection {
 		 */
 		const bool open;
 
+		/**
+		 * Is this a nfs_opendir_async() operation?  If yes,
+		 * then a cancelled operation needs to close the new
+		 * directory handle.
+		 */
+		bool open_directory = false;
+
+		/**
+		 * The file handle this operation works on (for
+		 * fstat() and read operations).
+		 */
+		struct nfsfh *fh = nullptr;
+
 		/**
 		 * The file handle scheduled to be closed as soon as
 		 * the operation finishes.
@@ -60,8 +73,8 @@ class NfsConnection {
 		void Lstat(nfs_context *context, const char *path);
 		void OpenDirectory(nfs_context *context, const char *path);
 		void Open(nfs_context *context, const char *path, int flags);
-		void Stat(nfs_context *context, struct nfsfh *fh);
-		void Read(nfs_context *context, struct nfsfh *fh,
+		void Stat(nfs_context *context, struct nfsfh *_fh);
+		void Read(nfs_context *context, struct nfsfh *_fh,
 			  uint64_t offset,
 #ifdef LIBNFS_API_2
 			  std::span<std::byte> dest
@@ -74,9 +87,28 @@ class NfsConnection {
 		 * Cancel the operation and schedule a call to
 		 * nfs_close_async() with the given file handle.
 		 */
-		void CancelAndScheduleClose(struct nfsfh *fh,
+		void CancelAndScheduleClose(struct nfsfh *_close_fh,
 					    DisposablePointer &&_dispose_value) noexcept;
 
+		/**
+		 * Another cancelled operation on the given file
+		 * handle has finished, and the file handle was
+		 * scheduled to be closed.  If this cancelled operation
+		 * works on the same file handle, it takes over the
+		 * nfs_close_async() call, because the file handle must
+		 * not be closed while libnfs still uses it.
+		 *
+		 * @return true if the close call has been taken over
+		 */
+		bool TakeOverClose(struct nfsfh *_fh) noexcept {
+			if (!IsCancelled() || fh != _fh ||
+			    close_fh != nullptr)
+				return false;
+
+			close_fh = _fh;
+			return true;
+		}
+
 		/**
 		 * Called by NfsConnection::DestroyContext() right
 		 * before nfs_destroy_context().  This object is given
@@ -234,7 +266,9 @@ public:
 	 * Not thread-safe.
 	 *
 	 * @param fh if not nullptr, then close this NFS file handle
-	 * after cancellation completes
+	 * after cancellation completes; if there are more cancelled
+	 * operations on the same file handle, it is closed after
+	 * the last one has completed
 	 * @param dispose_value an arbitrary value that will be
 	 * disposed of after cancellation completes
 	 */
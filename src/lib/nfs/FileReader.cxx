@@ -40,6 +40,7 @@ NfsFileReader::NfsFileReader(NfsConnection &_connection,
 NfsFileReader::~NfsFileReader() noexcept
 {
 	assert(state == State::INITIAL);
+	assert(reads.empty());
 }
 
 std::string
@@ -76,20 +77,15 @@ NfsFileReader::CancelOrClose() noexcept
 	       state != State::DEFER);
 
 	if (state == State::IDLE)
-		/* no async operation in progress: can close
-		   immediately */
-		connection->Close(fh);
-	else if (state > State::OPEN) {
+		/* cancel all read operations; the file handle is
+		   closed after the last one has finished, or
+		   immediately if there are none */
+		CancelAllReads(fh);
+	else if (state > State::OPEN)
 		/* one async operation in progress: cancel it and
 		   defer the nfs_close_async() call */
-		DisposablePointer dispose_value{};
-
-#ifdef LIBNFS_API_2
-		dispose_value = ToDeleteArray(read_buffer.release());
-#endif
-
-		connection->Cancel(*this, fh, std::move(dispose_value));
-	} else if (state > State::MOUNT)
+		connection->Cancel(*this, fh, {});
+	else if (state > State::MOUNT)
 		/* we don't have a file handle yet - just cancel the
 		   async operation */
 		connection->Cancel(*this, nullptr, {});
@@ -140,36 +136,154 @@ NfsFileReader::Open(const char *uri)
 	defer_open.Schedule();
 }
 
+inline void
+NfsFileReader::SubmitRead(decltype(reads)::iterator position,
+			  uint64_t offset, std::size_t size)
+{
+	auto request = std::make_unique<ReadRequest>(*this, offset, size);
+
+#ifdef LIBNFS_API_2
+	// TODO read into caller-provided buffer
+	request->buffer = std::make_unique_for_overwrite<std::byte[]>(size);
+	connection->Read(fh, offset, {request->buffer.get(), size}, *request);
+#else
+	connection->Read(fh, offset, size, *request);
+#endif
+
+	reads.insert(position, *request.release());
+}
+
 void
 NfsFileReader::Read(uint64_t offset, size_t size)
 {
 	assert(state == State::IDLE);
 
+	SubmitRead(reads.end(), offset, size);
+}
+
+inline void
+NfsFileReader::CancelRead(ReadRequest &request, nfsfh *close_fh) noexcept
+{
+	assert(!request.completed);
+
+	DisposablePointer dispose_value{};
+
 #ifdef LIBNFS_API_2
-	assert(!read_buffer);
-	// TOOD read into caller-provided buffer
-	read_buffer = std::make_unique_for_overwrite<std::byte[]>(size);
-	connection->Read(fh, offset, {read_buffer.get(), size}, *this);
-#else
-	connection->Read(fh, offset, size, *this);
+	dispose_value = ToDeleteArray(request.buffer.release());
 #endif
 
-	state = State::READ;
+	connection->Cancel(request, close_fh, std::move(dispose_value));
+}
+
+void
+NfsFileReader::CancelAllReads(nfsfh *close_fh) noexcept
+{
+	reads.clear_and_dispose([this, &close_fh](ReadRequest *request){
+		if (!request->completed)
+			/* only one of the cancelled requests gets the
+			   file handle; NfsConnection passes it on to
+			   the one which finishes last */
+			CancelRead(*request, std::exchange(close_fh, nullptr));
+
+		delete request;
+	});
+
+	if (close_fh != nullptr)
+		connection->Close(close_fh);
 }
 
 void
 NfsFileReader::CancelRead() noexcept
 {
-	if (state == State::READ) {
-		DisposablePointer dispose_value{};
+	CancelAllReads(nullptr);
+}
 
-#ifdef LIBNFS_API_2
-		assert(read_buffer);
-		dispose_value = ToDeleteArray(read_buffer.release());
+void
+NfsFileReader::ReadRequest::OnNfsCallback(unsigned status, void *data) noexcept
+{
+	latency = std::chrono::steady_clock::now() - start_time;
+	reader.OnReadComplete(*this, static_cast<std::size_t>(status), data);
+}
+
+void
+NfsFileReader::ReadRequest::OnNfsError(std::exception_ptr &&e) noexcept
+{
+	latency = std::chrono::steady_clock::now() - start_time;
+	reader.OnReadError(*this, std::move(e));
+}
+
+inline void
+NfsFileReader::OnReadComplete(ReadRequest &request, std::size_t nbytes,
+			      const void *data) noexcept
+{
+	assert(state == State::IDLE);
+	assert(!request.completed);
+
+	request.completed = true;
+	request.nbytes = nbytes;
+
+	if (nbytes > 0 && nbytes < request.size) {
+		/* short read: request the rest, to be delivered
+		   right after this one */
+		try {
+			SubmitRead(std::next(reads.iterator_to(request)),
+				   request.offset + nbytes,
+				   request.size - nbytes);
+		} catch (...) {
+			request.error = std::current_exception();
+		}
+	}
+
+	if (&request != &reads.front()) {
+		/* a preceding request is still pending */
+#ifndef LIBNFS_API_2
+		if (nbytes > 0 && !request.error) {
+			request.buffer = std::make_unique_for_overwrite<std::byte[]>(nbytes);
+			std::memcpy(request.buffer.get(), data, nbytes);
+		}
 #endif
 
-		connection->Cancel(*this, nullptr, std::move(dispose_value));
-		state = State::IDLE;
+		return;
+	}
+
+	FlushReads(data);
+}
+
+inline void
+NfsFileReader::OnReadError(ReadRequest &request,
+			   std::exception_ptr &&e) noexcept
+{
+	assert(state == State::IDLE);
+	assert(!request.completed);
+
+	request.completed = true;
+	request.error = std::move(e);
+
+	if (&request == &reads.front())
+		FlushReads(nullptr);
+}
+
+void
+NfsFileReader::FlushReads(const void *data) noexcept
+{
+	/* note: the OnNfsFileRead() call may submit new requests or
+	   cancel all of them, so the list needs to be checked again
+	   after each call */
+
+	while (!reads.empty() && reads.front().completed) {
+		const std::unique_ptr<ReadRequest> request{&reads.pop_front()};
+
+		if (request->error) {
+			CancelAllReads(nullptr);
+			OnNfsFileError(std::move(request->error));
+			return;
+		}
+
+		const auto *src = request->buffer
+			? request->buffer.get()
+			: static_cast<const std::byte *>(std::exchange(data, nullptr));
+
+		OnNfsFileRead({src, request->nbytes}, request->latency);
 	}
 }
 
@@ -241,23 +355,8 @@ NfsFileReader::StatCallback(const struct nfs_stat_64 *st) noexcept
 	OnNfsFileOpen(st->nfs_size);
 }
 
-inline void
-NfsFileReader::ReadCallback(std::size_t nbytes, const void *data) noexcept
-{
-#ifdef LIBNFS_API_2
-	(void)data;
-
-	assert(read_buffer);
-	const auto buffer = std::move(read_buffer);
-
-	OnNfsFileRead({buffer.get(), nbytes});
-#else
-	OnNfsFileRead({static_cast<const std::byte *>(data), nbytes});
-#endif
-}
-
 void
-NfsFileReader::OnNfsCallback(unsigned status, void *data) noexcept
+NfsFileReader::OnNfsCallback(unsigned, void *data) noexcept
 {
 	switch (std::exchange(state, State::IDLE)) {
 	case State::INITIAL:
@@ -273,10 +372,6 @@ NfsFileReader::OnNfsCallback(unsigned status, void *data) noexcept
 	case State::STAT:
 		StatCallback((const struct nfs_stat_64 *)data);
 		break;
-
-	case State::READ:
-		ReadCallback(static_cast<std::size_t>(status), data);
-		break;
 	}
 }
 
@@ -300,10 +395,6 @@ NfsFileReader::OnNfsError(std::exception_ptr &&e) noexcept
 		connection->Close(fh);
 		state = State::INITIAL;
 		break;
-
-	case State::READ:
-		state = State::IDLE;
-		break;
 	}
 
 	OnNfsFileError(std::move(e));
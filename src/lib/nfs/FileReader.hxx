@@ -7,17 +7,16 @@
 #include "Lease.hxx"
 #include "Callback.hxx"
 #include "event/InjectEvent.hxx"
+#include "util/IntrusiveList.hxx"
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <exception>
+#include <memory>
 #include <span>
 #include <string>
 
-#ifdef LIBNFS_API_2
-#include <memory>
-#endif
-
 struct nfsfh;
 struct nfs_stat_64;
 class NfsConnection;
@@ -37,10 +36,54 @@ class NfsFileReader : NfsLease, NfsCallback {
 		MOUNT,
 		OPEN,
 		STAT,
-		READ,
 		IDLE,
 	};
 
+	/**
+	 * One read operation submitted by Read().
+	 */
+	class ReadRequest final : public IntrusiveListHook<>, public NfsCallback {
+		NfsFileReader &reader;
+
+		const std::chrono::steady_clock::time_point start_time =
+			std::chrono::steady_clock::now();
+
+	public:
+		const uint64_t offset;
+		const std::size_t size;
+
+		/**
+		 * The time it took to complete this request.
+		 */
+		std::chrono::steady_clock::duration latency;
+
+		/**
+		 * With libnfs API 2, this is the destination buffer
+		 * of the read operation.  With API 1, the data gets
+		 * copied here if this request completes before its
+		 * predecessors.
+		 */
+		std::unique_ptr<std::byte[]> buffer;
+
+		std::size_t nbytes = 0;
+
+		std::exception_ptr error;
+
+		/**
+		 * Has the libnfs operation finished?
+		 */
+		bool completed = false;
+
+		ReadRequest(NfsFileReader &_reader,
+			    uint64_t _offset, std::size_t _size) noexcept
+			:reader(_reader), offset(_offset), size(_size) {}
+
+	private:
+		/* virtual methods from NfsCallback */
+		void OnNfsCallback(unsigned status, void *data) noexcept override;
+		void OnNfsError(std::exception_ptr &&e) noexcept override;
+	};
+
 	State state = State::INITIAL;
 
 	std::string server, export_name, path;
@@ -54,9 +97,12 @@ class NfsFileReader : NfsLease, NfsCallback {
 	 */
 	InjectEvent defer_open;
 
-#ifdef LIBNFS_API_2
-	std::unique_ptr<std::byte[]> read_buffer;
-#endif
+	/**
+	 * Read requests submitted by Read() which have not yet been
+	 * delivered to OnNfsFileRead(), in the order of submission.
+	 */
+	IntrusiveList<ReadRequest, IntrusiveListBaseHookTraits<ReadRequest>,
+		      IntrusiveListOptions{.constant_time_size = true}> reads;
 
 public:
 	NfsFileReader() noexcept;
@@ -83,8 +129,12 @@ public:
 
 	/**
 	 * Attempt to read from the file.  This may only be done after
-	 * OnNfsFileOpen() has been called.  Only one read operation
-	 * may be performed at a time.
+	 * OnNfsFileOpen() has been called.  More read operations may
+	 * be submitted before this one completes; they are performed
+	 * in parallel, but their results are delivered to
+	 * OnNfsFileRead() in the order they were submitted.  Short
+	 * reads are completed transparently with another read
+	 * request.
 	 *
 	 * This method is not thread-safe and must be called from
 	 * within the I/O thread.
@@ -94,15 +144,23 @@ public:
 	void Read(uint64_t offset, size_t size);
 
 	/**
-	 * Cancel the most recent Read() call.
+	 * Cancel all pending Read() calls.
 	 *
 	 * This method is not thread-safe and must be called from
 	 * within the I/O thread.
 	 */
 	void CancelRead() noexcept;
 
+	/**
+	 * @return the number of Read() calls whose result has not
+	 * yet been delivered
+	 */
+	std::size_t GetPendingReads() const noexcept {
+		return reads.size();
+	}
+
 	bool IsIdle() const noexcept {
-		return state == State::IDLE;
+		return state == State::IDLE && reads.empty();
 	}
 
 protected:
@@ -119,8 +177,12 @@ protected:
 	 * A Read() has completed successfully.
 	 *
 	 * This method will be called from within the I/O thread.
+	 *
+	 * @param latency the time it took the server to respond to
+	 * this request
 	 */
-	virtual void OnNfsFileRead(std::span<const std::byte> src) noexcept = 0;
+	virtual void OnNfsFileRead(std::span<const std::byte> src,
+				   std::chrono::steady_clock::duration latency) noexcept = 0;
 
 	/**
 	 * An error has occurred, which can be either while waiting
@@ -138,7 +200,44 @@ private:
 
 	void OpenCallback(nfsfh *_fh) noexcept;
 	void StatCallback(const struct nfs_stat_64 *st) noexcept;
-	void ReadCallback(std::size_t nbytes, const void *data) noexcept;
+
+	/**
+	 * Submit a new #ReadRequest and insert it into #reads
+	 * before the given position.
+	 *
+	 * Throws on error.
+	 */
+	void SubmitRead(decltype(reads)::iterator position,
+			uint64_t offset, std::size_t size);
+
+	/**
+	 * Cancel one #ReadRequest which has not completed yet.
+	 */
+	void CancelRead(ReadRequest &request, nfsfh *close_fh) noexcept;
+
+	/**
+	 * Cancel and delete all #ReadRequest instances.
+	 *
+	 * @param close_fh if not nullptr, then close this file handle
+	 * after the last pending request has been cancelled (or
+	 * right now if there are no pending requests)
+	 */
+	void CancelAllReads(nfsfh *close_fh) noexcept;
+
+	void OnReadComplete(ReadRequest &request, std::size_t nbytes,
+			    const void *data) noexcept;
+	void OnReadError(ReadRequest &request,
+			 std::exception_ptr &&e) noexcept;
+
+	/**
+	 * Deliver all completed requests at the front of #reads to
+	 * OnNfsFileRead().
+	 *
+	 * @param data the data of the front request if it has not
+	 * been copied (with libnfs API 1, the data pointer is only
+	 * valid inside the libnfs callback)
+	 */
+	void FlushReads(const void *data) noexcept;
 
 	/* virtual methods from NfsLease */
 	void OnNfsConnectionReady() noexcept final;
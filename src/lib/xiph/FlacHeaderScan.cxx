@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "FlacHeaderScan.hxx"
+#include "FlacStreamInfo.hxx"
+#include "ScanVorbisComment.hxx"
+#include "io/FileRangeReader.hxx"
+#include "tag/Handler.hxx"
+#include "util/PackedLittleEndian.hxx"
+#include "util/SpanCast.hxx"
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace {
+
+enum class FlacBlockType : unsigned {
+	STREAMINFO = 0,
+	VORBIS_COMMENT = 4,
+};
+
+} // anonymous namespace
+
+static constexpr uint_least32_t
+ReadBE24(const std::byte *p) noexcept
+{
+	return (uint_least32_t(p[0]) << 16) | (uint_least32_t(p[1]) << 8) |
+		uint_least32_t(p[2]);
+}
+
+/**
+ * Determine the size of an ID3v2 tag at the beginning of the file
+ * (which is not allowed by the FLAC specification, but is found in
+ * the wild and is skipped by libFLAC).
+ */
+static uint_least64_t
+GetId3v2Size(std::span<const std::byte> src) noexcept
+{
+	if (src.size() < 10 || std::memcmp(src.data(), "ID3", 3) != 0)
+		return 0;
+
+	/* the size is a "syncsafe" integer (7 bits per byte) */
+	uint_least32_t size = 0;
+	for (unsigned i = 6; i < 10; ++i)
+		size = (size << 7) | (uint_least32_t(src[i]) & 0x7f);
+
+	size += 10;
+
+	if ((unsigned(src[5]) & 0x10) != 0)
+		/* footer present */
+		size += 10;
+
+	return size;
+}
+
+/**
+ * Parse a list of Vorbis comments (vendor string, comment count and
+ * the comments), i.e. the contents of a VORBIS_COMMENT block.
+ *
+ * @return false if the list is malformed
+ */
+static bool
+ParseVorbisComments(std::span<const std::byte> src,
+		    std::vector<std::string_view> &comments) noexcept
+{
+	const auto read_string = [&src](std::string_view &value){
+		if (src.size() < 4)
+			return false;
+
+		const std::size_t length = *(const PackedLE32 *)(const void *)src.data();
+		src = src.subspan(4);
+		if (src.size() < length)
+			return false;
+
+		value = ToStringView(src.first(length));
+		src = src.subspan(length);
+		return true;
+	};
+
+	std::string_view vendor;
+	if (!read_string(vendor) || src.size() < 4)
+		return false;
+
+	uint_least32_t n = *(const PackedLE32 *)(const void *)src.data();
+	src = src.subspan(4);
+
+	/* each comment needs at least 4 bytes */
+	if (n > src.size() / 4)
+		return false;
+
+	comments.reserve(n);
+
+	while (n-- > 0) {
+		std::string_view comment;
+		if (!read_string(comment))
+			return false;
+
+		comments.push_back(comment);
+	}
+
+	return true;
+}
+
+bool
+ScanFlacHeaders(FileRangeReader &file, TagHandler &handler)
+{
+	if (handler.WantPicture())
+		/* not implemented; let libFLAC do it */
+		return false;
+
+	uint_least64_t offset = GetId3v2Size(file.Read(0, 10));
+
+	auto marker = file.Read(offset, 4);
+	if (marker.size() < 4 || std::memcmp(marker.data(), "fLaC", 4) != 0)
+		return false;
+
+	offset += 4;
+
+	std::optional<FlacStreamInfo> stream_info;
+
+	while (true) {
+		const auto header = file.Read(offset, 4);
+		if (header.size() < 4)
+			return false;
+
+		const bool is_last = (unsigned(header[0]) & 0x80) != 0;
+		const auto type = FlacBlockType(unsigned(header[0]) & 0x7f);
+		const std::size_t length = ReadBE24(header.data() + 1);
+		offset += 4;
+
+		if (type == FlacBlockType::STREAMINFO) {
+			stream_info = ParseFlacStreamInfo(file.Read(offset, length));
+			if (!stream_info)
+				return false;
+		} else if (type == FlacBlockType::VORBIS_COMMENT) {
+			if (!stream_info)
+				/* STREAMINFO must be the first block */
+				return false;
+
+			const auto block = file.Read(offset, length);
+			std::vector<std::string_view> comments;
+			if (block.size() < length ||
+			    !ParseVorbisComments(block, comments))
+				return false;
+
+			ScanFlacStreamInfo(*stream_info, handler);
+			for (const auto comment : comments)
+				ScanVorbisComment(comment, handler);
+			return true;
+		}
+
+		offset += length;
+
+		if (is_last) {
+			if (!stream_info)
+				return false;
+
+			/* no VORBIS_COMMENT block */
+			ScanFlacStreamInfo(*stream_info, handler);
+			return true;
+		}
+	}
+}
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+class FileRangeReader;
+class TagHandler;
+
+/**
+ * Scan the STREAMINFO and VORBIS_COMMENT blocks of a FLAC file
+ * without libFLAC.  Only the metadata block headers and these two
+ * blocks are read, which is usually one read (two if there is a
+ * large PICTURE block before the VORBIS_COMMENT block).
+ *
+ * Pictures are not supported; this function returns false if the
+ * handler wants them.
+ *
+ * Throws on I/O error.
+ *
+ * @return false if the file is not supported (or malformed); in
+ * that case, nothing has been passed to the handler
+ */
+bool
+ScanFlacHeaders(FileRangeReader &file, TagHandler &handler);
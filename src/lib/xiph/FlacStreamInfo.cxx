@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "FlacStreamInfo.hxx"
+#include "FlacAudioFormat.hxx"
+#include "pcm/CheckAudioFormat.hxx"
+#include "tag/Handler.hxx"
+
+std::optional<FlacStreamInfo>
+ParseFlacStreamInfo(std::span<const std::byte> src) noexcept
+{
+	if (src.size() < 34)
+		return std::nullopt;
+
+	/* skip min/max block size and min/max frame size */
+	const auto *p = src.data() + 10;
+
+	FlacStreamInfo info;
+	info.sample_rate = (unsigned(p[0]) << 12) | (unsigned(p[1]) << 4) |
+		(unsigned(p[2]) >> 4);
+	info.channels = ((unsigned(p[2]) >> 1) & 0x7) + 1;
+	info.bits_per_sample = (((unsigned(p[2]) & 0x1) << 4) |
+				(unsigned(p[3]) >> 4)) + 1;
+	info.total_samples = (uint_least64_t(unsigned(p[3]) & 0xf) << 32) |
+		(uint_least64_t(p[4]) << 24) | (uint_least64_t(p[5]) << 16) |
+		(uint_least64_t(p[6]) << 8) | uint_least64_t(p[7]);
+	return info;
+}
+
+void
+ScanFlacStreamInfo(const FlacStreamInfo &info, TagHandler &handler) noexcept
+{
+	if (info.sample_rate > 0)
+		handler.OnDuration(SongTime::FromScale<uint64_t>(info.total_samples,
+								 info.sample_rate));
+
+	try {
+		handler.OnAudioFormat(CheckAudioFormat(info.sample_rate,
+						       FlacSampleFormat(info.bits_per_sample),
+						       info.channels));
+	} catch (...) {
+	}
+}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+class TagHandler;
+
+/**
+ * The relevant attributes of a FLAC STREAMINFO block.  Unlike
+ * libFLAC's FLAC__StreamMetadata_StreamInfo, this can be used without
+ * libFLAC.
+ */
+struct FlacStreamInfo {
+	uint_least64_t total_samples;
+	unsigned sample_rate, channels, bits_per_sample;
+};
+
+/**
+ * Parse the contents of a raw STREAMINFO block (without the
+ * metadata block header).
+ *
+ * @return std::nullopt if the block is too short
+ */
+[[gnu::pure]]
+std::optional<FlacStreamInfo>
+ParseFlacStreamInfo(std::span<const std::byte> src) noexcept;
+
+/**
+ * Pass the duration and the audio format to the #TagHandler.
+ */
+void
+ScanFlacStreamInfo(const FlacStreamInfo &info, TagHandler &handler) noexcept;
@@ -2,9 +2,8 @@
 // Copyright The Music Player Daemon Project
 
 #include "FlacStreamMetadata.hxx"
-#include "FlacAudioFormat.hxx"
+#include "FlacStreamInfo.hxx"
 #include "ScanVorbisComment.hxx"
-#include "pcm/CheckAudioFormat.hxx"
 #include "tag/Handler.hxx"
 #include "tag/Builder.hxx"
 #include "tag/Tag.hxx"
@@ -13,8 +12,6 @@
 #include "tag/ReplayGainInfo.hxx"
 #include "tag/ReplayGainParser.hxx"
 
-#include <cassert>
-
 using std::string_view_literals::operator""sv;
 
 static std::string_view
@@ -59,29 +56,16 @@ flac_scan_comments(const FLAC__StreamMetadata_VorbisComment *comment,
 		ScanVorbisComment(ToStringView(comment->comments[i]), handler);
 }
 
-[[gnu::pure]]
-static inline SongTime
-flac_duration(const FLAC__StreamMetadata_StreamInfo *stream_info) noexcept
-{
-	assert(stream_info->sample_rate > 0);
-
-	return SongTime::FromScale<uint64_t>(stream_info->total_samples,
-					     stream_info->sample_rate);
-}
-
 static void
 Scan(const FLAC__StreamMetadata_StreamInfo &stream_info,
      TagHandler &handler) noexcept
 {
-	if (stream_info.sample_rate > 0)
-		handler.OnDuration(flac_duration(&stream_info));
-
-	try {
-		handler.OnAudioFormat(CheckAudioFormat(stream_info.sample_rate,
-						       FlacSampleFormat(stream_info.bits_per_sample),
-						       stream_info.channels));
-	} catch (...) {
-	}
+	ScanFlacStreamInfo({
+			.total_samples = stream_info.total_samples,
+			.sample_rate = stream_info.sample_rate,
+			.channels = stream_info.channels,
+			.bits_per_sample = stream_info.bits_per_sample,
+		}, handler);
 }
 
 static void
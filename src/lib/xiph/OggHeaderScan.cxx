@@ -0,0 +1,270 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "OggHeaderScan.hxx"
+#include "io/FileRangeReader.hxx"
+#include "util/PackedLittleEndian.hxx"
+
+#include <algorithm>
+#include <array>
+#include <cstddef> // for offsetof()
+#include <cstring>
+#include <span>
+
+/**
+ * The fixed part of an Ogg page header, followed by the lacing
+ * values.
+ */
+struct OggPageHeaderData {
+	char capture_pattern[4];
+	uint8_t version, flags;
+	PackedLE64 granulepos;
+	PackedLE32 serial, sequence, crc;
+	uint8_t n_segments;
+};
+
+static_assert(sizeof(OggPageHeaderData) == 27);
+static_assert(alignof(OggPageHeaderData) == 1);
+
+static constexpr std::size_t OGG_PAGE_HEADER_SIZE = sizeof(OggPageHeaderData);
+
+/**
+ * Refuse to collect header packets larger than this; this protects
+ * against malformed files.  Embedded cover art in the comment
+ * packet is the only thing which can get large.
+ */
+static constexpr std::size_t OGG_MAX_HEADER_SIZE = 64 * 1024 * 1024;
+
+static constexpr unsigned OGG_FLAG_BOS = 0x02;
+
+static constexpr auto
+MakeOggCrcTable() noexcept
+{
+	/* CRC-32 with the polynomial 0x04c11db7, not reflected */
+	std::array<uint_least32_t, 256> table{};
+	for (uint_least32_t i = 0; i < table.size(); ++i) {
+		uint_least32_t r = i << 24;
+		for (unsigned j = 0; j < 8; ++j)
+			r = (r & 0x80000000) != 0
+				? (r << 1) ^ 0x04c11db7
+				: r << 1;
+		table[i] = r & 0xffffffff;
+	}
+
+	return table;
+}
+
+static constexpr auto ogg_crc_table = MakeOggCrcTable();
+
+static constexpr uint_least32_t
+UpdateOggCrc(uint_least32_t crc, std::span<const std::byte> src) noexcept
+{
+	for (const auto b : src)
+		crc = ((crc << 8) & 0xffffffff) ^
+			ogg_crc_table[((crc >> 24) ^ unsigned(b)) & 0xff];
+	return crc;
+}
+
+/**
+ * A parsed Ogg page header.
+ */
+struct OggPageHeader {
+	int_least64_t granulepos;
+	uint_least32_t serial;
+	unsigned flags;
+
+	/**
+	 * The checksum stored in the header.
+	 */
+	uint_least32_t crc;
+
+	/**
+	 * The lacing values of all segments.
+	 */
+	std::span<const std::byte> lacing;
+
+	std::size_t header_size, body_size;
+
+	/**
+	 * Parse the header at the beginning of the given buffer.
+	 *
+	 * @return false if this is not a valid page header or if the
+	 * buffer is too small for the header
+	 */
+	bool Parse(std::span<const std::byte> src) noexcept {
+		if (src.size() < OGG_PAGE_HEADER_SIZE)
+			return false;
+
+		const auto &data = *(const OggPageHeaderData *)(const void *)src.data();
+		if (std::memcmp(data.capture_pattern, "OggS", 4) != 0 ||
+		    data.version != 0)
+			return false;
+
+		flags = data.flags;
+		granulepos = int_least64_t(uint64_t{data.granulepos});
+		serial = data.serial;
+		crc = data.crc;
+
+		header_size = OGG_PAGE_HEADER_SIZE + data.n_segments;
+		if (src.size() < header_size)
+			return false;
+
+		lacing = src.subspan(OGG_PAGE_HEADER_SIZE, data.n_segments);
+
+		body_size = 0;
+		for (const auto i : lacing)
+			body_size += std::size_t(i);
+
+		return true;
+	}
+
+	/**
+	 * Verify the checksum of the page.  The checksum is
+	 * calculated over the whole page with the CRC field set to
+	 * zero.
+	 *
+	 * @param src the whole page, beginning with the header
+	 * which was passed to Parse()
+	 */
+	[[gnu::pure]]
+	bool CheckCrc(std::span<const std::byte> src) const noexcept {
+		static constexpr std::size_t crc_offset =
+			offsetof(OggPageHeaderData, crc);
+		static constexpr std::byte zero[4]{};
+
+		uint_least32_t c = UpdateOggCrc(0, src.first(crc_offset));
+		c = UpdateOggCrc(c, zero);
+		c = UpdateOggCrc(c, src.subspan(crc_offset + sizeof(zero),
+					       header_size + body_size - crc_offset - sizeof(zero)));
+		return c == crc;
+	}
+};
+
+/**
+ * Read the page at the given offset.  Each call to
+ * FileRangeReader::Read() is usually served from its buffer.
+ *
+ * @return the whole page or an empty span if there is no valid page
+ */
+static std::span<const std::byte>
+ReadPage(FileRangeReader &file, uint_least64_t offset,
+	 OggPageHeader &page)
+{
+	if (!page.Parse(file.Read(offset, OGG_PAGE_HEADER_SIZE + 255)))
+		return {};
+
+	const std::size_t page_size = page.header_size + page.body_size;
+	const auto src = file.Read(offset, page_size);
+	if (src.size() < page_size)
+		/* truncated file */
+		return {};
+
+	/* parse again, because the previous buffer may have been
+	   invalidated */
+	page.Parse(src);
+	if (!page.CheckCrc(src))
+		return {};
+
+	return src;
+}
+
+static bool
+ReadHeaderPackets(FileRangeReader &file, std::size_t n_packets,
+		  std::vector<std::vector<std::byte>> &packets,
+		  uint_least32_t &serial)
+{
+	uint_least64_t offset = 0;
+
+	std::vector<std::byte> packet;
+	std::size_t total_size = 0;
+
+	while (packets.size() < n_packets) {
+		OggPageHeader page;
+		const auto src = ReadPage(file, offset, page);
+		if (src.empty())
+			return false;
+
+		if (offset == 0) {
+			if ((page.flags & OGG_FLAG_BOS) == 0)
+				return false;
+
+			serial = page.serial;
+		}
+
+		offset += src.size();
+		if (page.serial != serial)
+			/* a page of another (multiplexed) stream */
+			continue;
+
+		total_size += page.body_size;
+		if (total_size > OGG_MAX_HEADER_SIZE)
+			return false;
+
+		auto body = src.subspan(page.header_size, page.body_size);
+		for (const auto i : page.lacing) {
+			const std::size_t length = std::size_t(i);
+			packet.insert(packet.end(), body.begin(),
+				      std::next(body.begin(), length));
+			body = body.subspan(length);
+
+			if (length < 255) {
+				/* this segment concludes the packet */
+				packets.emplace_back(std::move(packet));
+				packet.clear();
+
+				if (packets.size() == n_packets)
+					break;
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Find the granule position of the last page of the given stream
+ * in the last #FileRangeReader::CHUNK_SIZE bytes of the file.
+ */
+static int_least64_t
+FindLastGranulePos(FileRangeReader &file, uint_least32_t serial)
+{
+	const auto size = file.GetSize();
+	const uint_least64_t tail_offset =
+		size - std::min<uint_least64_t>(size, FileRangeReader::CHUNK_SIZE);
+	const auto tail = file.Read(tail_offset, FileRangeReader::CHUNK_SIZE);
+
+	int_least64_t granulepos = -1;
+
+	for (std::size_t i = 0; i + OGG_PAGE_HEADER_SIZE <= tail.size();) {
+		OggPageHeader page;
+		if (!page.Parse(tail.subspan(i)) ||
+		    page.header_size + page.body_size > tail.size() - i ||
+		    !page.CheckCrc(tail.subspan(i))) {
+			/* not a page boundary (or a truncated or
+			   corrupt page); resynchronize at the next
+			   capture pattern */
+			++i;
+			continue;
+		}
+
+		if (page.serial == serial && page.granulepos >= 0)
+			granulepos = page.granulepos;
+
+		i += page.header_size + page.body_size;
+	}
+
+	return granulepos;
+}
+
+bool
+ReadOggHeaders(FileRangeReader &file, std::size_t n_packets,
+	       OggHeaders &headers)
+{
+	uint_least32_t serial;
+	headers.packets.clear();
+	if (!ReadHeaderPackets(file, n_packets, headers.packets, serial))
+		return false;
+
+	headers.last_granulepos = FindLastGranulePos(file, serial);
+	return true;
+}
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class FileRangeReader;
+
+/**
+ * The header packets of the first logical bitstream of an Ogg file
+ * and its last granule position, obtained by ReadOggHeaders().
+ */
+struct OggHeaders {
+	/**
+	 * The first packets of the stream; the first one is the
+	 * "beginning of stream" packet.
+	 */
+	std::vector<std::vector<std::byte>> packets;
+
+	/**
+	 * The granule position of the last page of the stream or -1
+	 * if it was not found near the end of the file.
+	 */
+	int_least64_t last_granulepos = -1;
+};
+
+/**
+ * Read the first packets of the first logical bitstream and its
+ * last granule position, without decoding the whole page sequence
+ * with libogg: this parses the pages at the beginning and in the
+ * last 64 kB of the file only, which is usually just two reads.  It
+ * is meant for scanning the tags of a local file quickly.
+ *
+ * Page checksums are verified: a corrupt page at the beginning
+ * makes this function fail, and corrupt pages near the end are
+ * skipped while looking for the last granule position.
+ *
+ * Throws on I/O error.
+ *
+ * @param n_packets the number of packets to be read
+ * @return false if the file is not a valid Ogg file or if it has
+ * less than the requested number of packets
+ */
+bool
+ReadOggHeaders(FileRangeReader &file, std::size_t n_packets,
+	       OggHeaders &headers);
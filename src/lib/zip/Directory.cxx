@@ -0,0 +1,295 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Directory.hxx"
+#include "io/FileDescriptor.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "system/Error.hxx"
+#include "util/PackedLittleEndian.hxx"
+#include "util/SpanCast.hxx"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+/*
+ * The on-disk structures, see APPNOTE.TXT section 4.3.
+ */
+
+static constexpr uint32_t ZIP_LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static constexpr uint32_t ZIP_CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+static constexpr uint32_t ZIP_EOCD_SIGNATURE = 0x06054b50;
+static constexpr uint32_t ZIP64_EOCD_SIGNATURE = 0x06064b50;
+static constexpr uint32_t ZIP64_EOCD_LOCATOR_SIGNATURE = 0x07064b50;
+
+static constexpr uint16_t ZIP64_EXTRA_ID = 0x0001;
+
+struct ZipLocalHeader {
+	PackedLE32 signature;
+	PackedLE16 version_needed, flags, method, time, date;
+	PackedLE32 crc, compressed_size, size;
+	PackedLE16 name_length, extra_length;
+};
+
+static_assert(sizeof(ZipLocalHeader) == 30);
+
+struct ZipCentralHeader {
+	PackedLE32 signature;
+	PackedLE16 version_made_by, version_needed, flags, method, time, date;
+	PackedLE32 crc, compressed_size, size;
+	PackedLE16 name_length, extra_length, comment_length;
+	PackedLE16 disk, internal_attributes;
+	PackedLE32 external_attributes, header_offset;
+};
+
+static_assert(sizeof(ZipCentralHeader) == 46);
+
+struct ZipEndOfCentralDirectory {
+	PackedLE32 signature;
+	PackedLE16 disk, directory_disk, disk_entries, entries;
+	PackedLE32 directory_size, directory_offset;
+	PackedLE16 comment_length;
+};
+
+static_assert(sizeof(ZipEndOfCentralDirectory) == 22);
+
+struct Zip64EndOfCentralDirectoryLocator {
+	PackedLE32 signature, directory_disk;
+	PackedLE64 offset;
+	PackedLE32 total_disks;
+};
+
+static_assert(sizeof(Zip64EndOfCentralDirectoryLocator) == 20);
+
+struct Zip64EndOfCentralDirectory {
+	PackedLE32 signature;
+	PackedLE64 record_size;
+	PackedLE16 version_made_by, version_needed;
+	PackedLE32 disk, directory_disk;
+	PackedLE64 disk_entries, entries;
+	PackedLE64 directory_size, directory_offset;
+};
+
+static_assert(sizeof(Zip64EndOfCentralDirectory) == 56);
+
+/**
+ * Refuse to load central directories larger than this; this is a
+ * sanity limit against corrupt files.
+ */
+static constexpr std::size_t MAX_DIRECTORY_SIZE = 64 * 1024 * 1024;
+
+void
+ZipReadFull(FileDescriptor fd, uint_least64_t offset,
+	    std::span<std::byte> dest)
+{
+	while (!dest.empty()) {
+		ssize_t nbytes = fd.ReadAt(offset, dest);
+		if (nbytes <= 0) {
+			if (nbytes < 0)
+				throw MakeErrno("Failed to read ZIP file");
+			throw std::runtime_error("Unexpected end of ZIP file");
+		}
+
+		offset += nbytes;
+		dest = dest.subspan(nbytes);
+	}
+}
+
+template<typename T>
+static T
+ReadStruct(FileDescriptor fd, uint_least64_t offset)
+{
+	T value;
+	ZipReadFull(fd, offset, ReferenceAsWritableBytes(value));
+	return value;
+}
+
+template<typename T>
+static const T *
+CastStruct(std::span<const std::byte> src) noexcept
+{
+	if (src.size() < sizeof(T))
+		return nullptr;
+
+	return reinterpret_cast<const T *>(src.data());
+}
+
+/**
+ * Locate the "end of central directory" record.  It is at the end of
+ * the file, followed by a variable-length comment.
+ *
+ * @return the offset of the record within the file
+ */
+static uint_least64_t
+FindEndOfCentralDirectory(FileDescriptor fd, uint_least64_t file_size,
+			  ZipEndOfCentralDirectory &eocd)
+{
+	constexpr std::size_t max_tail = sizeof(eocd) + 0xffff;
+
+	if (file_size < sizeof(eocd))
+		throw std::runtime_error("Not a ZIP file");
+
+	const std::size_t tail_size = std::min<uint_least64_t>(file_size, max_tail);
+	const uint_least64_t tail_offset = file_size - tail_size;
+	const auto tail = std::make_unique<std::byte[]>(tail_size);
+	ZipReadFull(fd, tail_offset, {tail.get(), tail_size});
+
+	/* search backwards, so the comment (which may contain the
+	   signature by accident) is skipped */
+	for (std::size_t i = tail_size - sizeof(eocd);; --i) {
+		std::memcpy(&eocd, tail.get() + i, sizeof(eocd));
+		if (eocd.signature == ZIP_EOCD_SIGNATURE &&
+		    i + sizeof(eocd) + eocd.comment_length == tail_size)
+			return tail_offset + i;
+
+		if (i == 0)
+			break;
+	}
+
+	throw std::runtime_error("Not a ZIP file");
+}
+
+/**
+ * Parse the ZIP64 "extended information" extra field and replace
+ * the 32 bit values which were set to 0xffffffff.
+ */
+static void
+ApplyZip64Extra(std::span<const std::byte> extra, ZipEntry &entry,
+		bool size_overflow, bool compressed_size_overflow,
+		bool header_offset_overflow) noexcept
+{
+	struct ExtraHeader {
+		PackedLE16 id, size;
+	};
+
+	while (const auto *header = CastStruct<ExtraHeader>(extra)) {
+		extra = extra.subspan(sizeof(*header));
+		if (extra.size() < header->size)
+			break;
+
+		auto data = extra.first(header->size);
+		extra = extra.subspan(header->size);
+
+		if (header->id != ZIP64_EXTRA_ID)
+			continue;
+
+		/* the values are present only if the corresponding
+		   32 bit field overflowed, in this order */
+		auto next = [&data](uint_least64_t &dest){
+			if (const auto *v = CastStruct<PackedLE64>(data)) {
+				dest = *v;
+				data = data.subspan(sizeof(*v));
+			}
+		};
+
+		if (size_overflow)
+			next(entry.size);
+		if (compressed_size_overflow)
+			next(entry.compressed_size);
+		if (header_offset_overflow)
+			next(entry.header_offset);
+		break;
+	}
+}
+
+ZipDirectory::ZipDirectory(FileDescriptor fd)
+{
+	const off_t file_size = fd.GetSize();
+	if (file_size < 0)
+		throw MakeErrno("Failed to get ZIP file size");
+
+	ZipEndOfCentralDirectory eocd;
+	const uint_least64_t eocd_offset =
+		FindEndOfCentralDirectory(fd, file_size, eocd);
+
+	uint_least64_t n_entries = eocd.entries;
+	uint_least64_t directory_size = eocd.directory_size;
+	uint_least64_t directory_offset = eocd.directory_offset;
+
+	if ((n_entries == 0xffff || directory_size == 0xffffffff ||
+	     directory_offset == 0xffffffff) &&
+	    eocd_offset >= sizeof(Zip64EndOfCentralDirectoryLocator)) {
+		const auto locator =
+			ReadStruct<Zip64EndOfCentralDirectoryLocator>(fd, eocd_offset - sizeof(Zip64EndOfCentralDirectoryLocator));
+		if (locator.signature == ZIP64_EOCD_LOCATOR_SIGNATURE) {
+			const auto eocd64 =
+				ReadStruct<Zip64EndOfCentralDirectory>(fd, locator.offset);
+			if (eocd64.signature != ZIP64_EOCD_SIGNATURE)
+				throw std::runtime_error("Malformed ZIP64 end of central directory");
+
+			n_entries = eocd64.entries;
+			directory_size = eocd64.directory_size;
+			directory_offset = eocd64.directory_offset;
+		}
+	}
+
+	if (directory_size > MAX_DIRECTORY_SIZE ||
+	    directory_offset + directory_size > uint_least64_t(file_size))
+		throw std::runtime_error("Malformed ZIP central directory");
+
+	/* read the whole central directory at once */
+	const auto buffer = std::make_unique<std::byte[]>(directory_size);
+	std::span<const std::byte> src{buffer.get(), directory_size};
+	ZipReadFull(fd, directory_offset, {buffer.get(), directory_size});
+
+	entries.reserve(std::min<uint_least64_t>(n_entries,
+						  directory_size / sizeof(ZipCentralHeader)));
+
+	while (const auto *header = CastStruct<ZipCentralHeader>(src)) {
+		if (header->signature != ZIP_CENTRAL_HEADER_SIGNATURE)
+			break;
+
+		src = src.subspan(sizeof(*header));
+
+		const std::size_t variable_size = header->name_length +
+			header->extra_length + header->comment_length;
+		if (src.size() < variable_size)
+			throw std::runtime_error("Malformed ZIP central directory");
+
+		const auto name = ToStringView(src.first(header->name_length));
+		const auto extra = src.subspan(header->name_length,
+					       header->extra_length);
+		src = src.subspan(variable_size);
+
+		auto &entry = entries.emplace_back(ZipEntry{
+			.name = std::string{name},
+			.header_offset = header->header_offset,
+			.compressed_size = header->compressed_size,
+			.size = header->size,
+			.method = ZipMethod(uint16_t(header->method)),
+			.flags = header->flags,
+		});
+
+		ApplyZip64Extra(extra, entry,
+				header->size == 0xffffffff,
+				header->compressed_size == 0xffffffff,
+				header->header_offset == 0xffffffff);
+	}
+
+	by_name.reserve(entries.size());
+	for (std::size_t i = 0; i < entries.size(); ++i)
+		/* if there are duplicates, the first one wins */
+		by_name.emplace(entries[i].name, i);
+}
+
+const ZipEntry *
+ZipDirectory::Find(std::string_view name) const noexcept
+{
+	auto i = by_name.find(name);
+	return i != by_name.end()
+		? &entries[i->second]
+		: nullptr;
+}
+
+uint_least64_t
+ReadZipDataOffset(FileDescriptor fd, const ZipEntry &entry)
+{
+	const auto header = ReadStruct<ZipLocalHeader>(fd, entry.header_offset);
+	if (header.signature != ZIP_LOCAL_HEADER_SIGNATURE)
+		throw FmtRuntimeError("Malformed local header of {:?} in ZIP file",
+				      entry.name);
+
+	return entry.header_offset + sizeof(header) +
+		header.name_length + header.extra_length;
+}
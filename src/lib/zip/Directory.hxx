@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class FileDescriptor;
+
+/**
+ * Compression methods which are supported by this library.  Other
+ * values may occur in #ZipEntry::method, too.
+ */
+enum class ZipMethod : uint_least16_t {
+	STORED = 0,
+	DEFLATED = 8,
+};
+
+/**
+ * One file in the central directory of a ZIP archive.
+ */
+struct ZipEntry {
+	std::string name;
+
+	/**
+	 * The offset of the local file header within the archive.
+	 */
+	uint_least64_t header_offset;
+
+	uint_least64_t compressed_size;
+
+	/**
+	 * The uncompressed size.
+	 */
+	uint_least64_t size;
+
+	ZipMethod method;
+
+	uint_least16_t flags;
+
+	bool IsDirectory() const noexcept {
+		return name.ends_with('/');
+	}
+
+	bool IsEncrypted() const noexcept {
+		return flags & 0x1;
+	}
+};
+
+/**
+ * The parsed central directory of a ZIP archive.  It is read once
+ * with a few large reads from the end of the file; entries can then
+ * be looked up by name without touching the file again.
+ */
+class ZipDirectory {
+	std::vector<ZipEntry> entries;
+
+	/**
+	 * Maps names to indexes in #entries.  The keys point into the
+	 * #ZipEntry::name strings.
+	 */
+	std::unordered_map<std::string_view, std::size_t> by_name;
+
+public:
+	/**
+	 * Read the central directory of the given ZIP file.
+	 *
+	 * Throws on I/O error or if the file is not a valid ZIP
+	 * archive.
+	 */
+	explicit ZipDirectory(FileDescriptor fd);
+
+	ZipDirectory(const ZipDirectory &) = delete;
+	ZipDirectory &operator=(const ZipDirectory &) = delete;
+
+	const auto &GetEntries() const noexcept {
+		return entries;
+	}
+
+	[[gnu::pure]]
+	const ZipEntry *Find(std::string_view name) const noexcept;
+
+	[[gnu::pure]]
+	std::size_t GetIndex(const ZipEntry &entry) const noexcept {
+		return &entry - entries.data();
+	}
+};
+
+/**
+ * Read the local file header of the given entry and determine where
+ * its data begins.
+ *
+ * Throws on error.
+ */
+uint_least64_t
+ReadZipDataOffset(FileDescriptor fd, const ZipEntry &entry);
+
+/**
+ * Read exactly the given number of bytes at the given file offset.
+ *
+ * Throws on error (including premature end of file).
+ */
+void
+ZipReadFull(FileDescriptor fd, uint_least64_t offset,
+	    std::span<std::byte> dest);
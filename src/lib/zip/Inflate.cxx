@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Inflate.hxx"
+#include "lib/zlib/Error.hxx"
+#include "system/Error.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+
+const ZipInflateIndex::Checkpoint *
+ZipInflateIndex::Find(uint_least64_t out_offset) const noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	auto i = std::upper_bound(checkpoints.begin(), checkpoints.end(),
+				  out_offset,
+				  [](uint_least64_t offset, const Checkpoint &c){
+					  return offset < c.out_offset;
+				  });
+	if (i == checkpoints.begin())
+		return nullptr;
+
+	return &*std::prev(i);
+}
+
+bool
+ZipInflateIndex::Wants(uint_least64_t out_offset) const noexcept
+{
+	const std::scoped_lock lock{mutex};
+	return _Wants(out_offset);
+}
+
+void
+ZipInflateIndex::Add(Checkpoint &&checkpoint) noexcept
+{
+	const std::scoped_lock lock{mutex};
+	if (_Wants(checkpoint.out_offset))
+		checkpoints.emplace_back(std::move(checkpoint));
+}
+
+ZipInflateReader::ZipInflateReader(FileDescriptor _fd,
+				   uint_least64_t _data_offset,
+				   uint_least64_t _compressed_size,
+				   uint_least64_t _size,
+				   ZipInflateIndex &_index)
+	:fd(_fd), data_offset(_data_offset),
+	 compressed_size(_compressed_size), size(_size),
+	 index(_index)
+{
+	/* negative windowBits: raw "deflate" data without zlib
+	   header */
+	int result = inflateInit2(&z, -MAX_WBITS);
+	if (result != Z_OK)
+		throw MakeZlibError(result, "inflateInit2() failed");
+}
+
+void
+ZipInflateReader::Restart()
+{
+	int result = inflateReset(&z);
+	if (result != Z_OK)
+		throw MakeZlibError(result, "inflateReset() failed");
+
+	z.next_in = nullptr;
+	z.avail_in = 0;
+	in_position = 0;
+	out_position = 0;
+	eof = false;
+}
+
+void
+ZipInflateReader::Restore(const ZipInflateIndex::Checkpoint &checkpoint)
+{
+	Restart();
+
+	in_position = checkpoint.in_offset;
+
+	if (checkpoint.bits > 0) {
+		/* feed the remaining bits of the partially
+		   consumed byte */
+		std::byte b;
+		if (fd.ReadAt(data_offset + in_position - 1, {&b, 1}) != 1)
+			throw std::runtime_error("Failed to read ZIP file");
+
+		int result = inflatePrime(&z, checkpoint.bits,
+					  std::to_integer<int>(b) >> (8 - checkpoint.bits));
+		if (result != Z_OK)
+			throw MakeZlibError(result, "inflatePrime() failed");
+	}
+
+	int result = inflateSetDictionary(&z, checkpoint.window.get(),
+					  checkpoint.window_size);
+	if (result != Z_OK)
+		throw MakeZlibError(result, "inflateSetDictionary() failed");
+
+	out_position = checkpoint.out_offset;
+}
+
+inline void
+ZipInflateReader::FillInput()
+{
+	assert(in_position < compressed_size);
+
+	const std::size_t max_size =
+		std::min<uint_least64_t>(input.size(),
+					 compressed_size - in_position);
+
+	ssize_t nbytes = fd.ReadAt(data_offset + in_position,
+				   std::as_writable_bytes(std::span{input}.first(max_size)));
+	if (nbytes <= 0) {
+		if (nbytes < 0)
+			throw MakeErrno("Failed to read ZIP file");
+		throw std::runtime_error("Unexpected end of ZIP file");
+	}
+
+	in_position += nbytes;
+	z.next_in = input.data();
+	z.avail_in = nbytes;
+}
+
+inline void
+ZipInflateReader::OnBlockBoundary() noexcept
+{
+	/* bit 7 of data_type is set at the end of a block header;
+	   bit 6 is set if this was the last block, which makes no
+	   sense as a checkpoint */
+	if ((z.data_type & 128) == 0 || (z.data_type & 64) != 0 ||
+	    !index.Wants(out_position))
+		return;
+
+	ZipInflateIndex::Checkpoint c{
+		.in_offset = in_position - z.avail_in,
+		.out_offset = out_position,
+		.bits = unsigned(z.data_type & 7),
+		.window_size = 0,
+		.window = std::make_unique_for_overwrite<Bytef[]>(32768),
+	};
+
+	uInt window_size = 32768;
+	if (inflateGetDictionary(&z, c.window.get(), &window_size) != Z_OK)
+		return;
+
+	c.window_size = window_size;
+	index.Add(std::move(c));
+}
+
+std::size_t
+ZipInflateReader::Read(std::span<std::byte> dest)
+{
+	if (eof || out_position >= size || dest.empty())
+		return 0;
+
+	if (dest.size() > size - out_position)
+		dest = dest.first(size - out_position);
+
+	z.next_out = reinterpret_cast<Bytef *>(dest.data());
+	z.avail_out = dest.size();
+
+	while (z.avail_out > 0) {
+		if (z.avail_in == 0 && in_position < compressed_size)
+			FillInput();
+
+		const auto avail_out = z.avail_out;
+
+		/* Z_BLOCK stops at each block boundary, where a
+		   checkpoint can be recorded */
+		int result = inflate(&z, Z_BLOCK);
+		out_position += avail_out - z.avail_out;
+
+		if (result == Z_STREAM_END) {
+			eof = true;
+			break;
+		}
+
+		if (result == Z_BUF_ERROR && z.avail_in == 0)
+			throw std::runtime_error("Unexpected end of compressed ZIP entry");
+
+		if (result != Z_OK)
+			throw MakeZlibError(result, "inflate() failed");
+
+		OnBlockBoundary();
+	}
+
+	return dest.size() - z.avail_out;
+}
+
+inline void
+ZipInflateReader::Skip(uint_least64_t nbytes)
+{
+	std::array<std::byte, 16384> discard;
+
+	while (nbytes > 0) {
+		std::size_t n = Read(std::span{discard}.first(std::min<uint_least64_t>(nbytes, discard.size())));
+		if (n == 0)
+			throw std::runtime_error("Unexpected end of compressed ZIP entry");
+
+		nbytes -= n;
+	}
+}
+
+void
+ZipInflateReader::Seek(uint_least64_t offset)
+{
+	if (offset > size)
+		throw std::invalid_argument("Seek beyond end of ZIP entry");
+
+	if (offset == out_position)
+		return;
+
+	/* jump to the nearest checkpoint if seeking backwards, or
+	   if there is a checkpoint between the current position and
+	   the seek target */
+	const auto *checkpoint = index.Find(offset);
+	if (offset < out_position) {
+		if (checkpoint != nullptr)
+			Restore(*checkpoint);
+		else
+			Restart();
+	} else if (checkpoint != nullptr &&
+		   checkpoint->out_offset > out_position)
+		Restore(*checkpoint);
+
+	Skip(offset - out_position);
+}
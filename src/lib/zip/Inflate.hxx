@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "io/FileDescriptor.hxx"
+#include "thread/Mutex.hxx"
+
+#include <zlib.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <span>
+
+/**
+ * A list of positions within a "deflate" stream where decompression
+ * can be resumed, each with a copy of the 32 kB history window.
+ * Checkpoints are recorded at block boundaries while decompressing
+ * (like zlib's "zran" example), so seeking only needs to inflate the
+ * data between the nearest checkpoint and the seek target.
+ *
+ * One instance is shared by all #ZipInflateReader objects reading
+ * the same ZIP entry.  This class is thread-safe.
+ */
+class ZipInflateIndex {
+public:
+	struct Checkpoint {
+		/**
+		 * The offset of the first compressed byte which has
+		 * not been consumed completely.
+		 */
+		uint_least64_t in_offset;
+
+		/**
+		 * The uncompressed offset.
+		 */
+		uint_least64_t out_offset;
+
+		/**
+		 * The number of bits of the byte before #in_offset
+		 * which have not yet been consumed.
+		 */
+		unsigned bits;
+
+		std::size_t window_size;
+		std::unique_ptr<Bytef[]> window;
+	};
+
+	/**
+	 * The minimum distance between two checkpoints (in
+	 * uncompressed bytes).
+	 */
+	static constexpr uint_least64_t SPAN = 1024 * 1024;
+
+private:
+	mutable Mutex mutex;
+
+	/**
+	 * Sorted by #Checkpoint::out_offset.  This is a std::deque
+	 * because references to its elements remain valid when new
+	 * ones are appended.
+	 */
+	std::deque<Checkpoint> checkpoints;
+
+public:
+	[[gnu::pure]]
+	std::size_t size() const noexcept {
+		const std::scoped_lock lock{mutex};
+		return checkpoints.size();
+	}
+
+	/**
+	 * Find the last checkpoint at or before the given
+	 * uncompressed offset.  The returned object is immutable and
+	 * remains valid as long as this index exists.
+	 *
+	 * @return the checkpoint or nullptr if there is none
+	 */
+	[[gnu::pure]]
+	const Checkpoint *Find(uint_least64_t out_offset) const noexcept;
+
+	/**
+	 * Is a new checkpoint at this uncompressed offset wanted?
+	 */
+	[[gnu::pure]]
+	bool Wants(uint_least64_t out_offset) const noexcept;
+
+	/**
+	 * Add a new checkpoint.  It is ignored if it does not qualify
+	 * (anymore), e.g. because another reader has added one
+	 * meanwhile.
+	 */
+	void Add(Checkpoint &&checkpoint) noexcept;
+
+private:
+	bool _Wants(uint_least64_t out_offset) const noexcept {
+		return checkpoints.empty()
+			? out_offset >= SPAN
+			: out_offset >= checkpoints.back().out_offset + SPAN;
+	}
+};
+
+/**
+ * Decompress a "deflate" compressed ZIP entry with random access.
+ * Data is read from the file with pread(), so multiple readers can
+ * share one file descriptor.
+ *
+ * This class is not thread-safe.
+ */
+class ZipInflateReader {
+	const FileDescriptor fd;
+
+	/**
+	 * The file offset of the compressed data.
+	 */
+	const uint_least64_t data_offset;
+
+	const uint_least64_t compressed_size;
+
+	/**
+	 * The uncompressed size.
+	 */
+	const uint_least64_t size;
+
+	ZipInflateIndex &index;
+
+	z_stream z{};
+
+	/**
+	 * The offset (relative to #data_offset) of the next
+	 * compressed byte to be read into #input.
+	 */
+	uint_least64_t in_position = 0;
+
+	/**
+	 * The current uncompressed offset.
+	 */
+	uint_least64_t out_position = 0;
+
+	bool eof = false;
+
+	std::array<Bytef, 16384> input;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	ZipInflateReader(FileDescriptor _fd, uint_least64_t _data_offset,
+			 uint_least64_t _compressed_size,
+			 uint_least64_t _size,
+			 ZipInflateIndex &_index);
+
+	~ZipInflateReader() noexcept {
+		inflateEnd(&z);
+	}
+
+	ZipInflateReader(const ZipInflateReader &) = delete;
+	ZipInflateReader &operator=(const ZipInflateReader &) = delete;
+
+	uint_least64_t GetOffset() const noexcept {
+		return out_position;
+	}
+
+	/**
+	 * Throws on error.
+	 *
+	 * @return the number of bytes written to #dest; 0 at the end
+	 * of the entry
+	 */
+	std::size_t Read(std::span<std::byte> dest);
+
+	/**
+	 * Throws on error.
+	 */
+	void Seek(uint_least64_t offset);
+
+private:
+	void Restart();
+	void Restore(const ZipInflateIndex::Checkpoint &checkpoint);
+	void FillInput();
+	void Skip(uint_least64_t nbytes);
+
+	/**
+	 * Called after inflate() has stopped at a block boundary.
+	 */
+	void OnBlockBoundary() noexcept;
+};
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "BinaryRecords.hxx"
+#include "time/ISO8601.hxx"
+#include "util/StringBuffer.hxx"
+
+inline void
+BinaryRecordEncoder::AppendVarint(uint_least64_t value) noexcept
+{
+	while (value >= 0x80) {
+		buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+
+	buffer.push_back(static_cast<char>(value));
+}
+
+inline void
+BinaryRecordEncoder::AppendLiteral(std::string_view s) noexcept
+{
+	AppendVarint(s.size());
+	buffer.append(s);
+}
+
+void
+BinaryRecordEncoder::AppendHeader(std::string_view key, Type type) noexcept
+{
+	if (auto i = keys.find(key); i != keys.end()) {
+		AppendVarint(((i->second + 1) << 2) | uint_least64_t(type));
+		return;
+	}
+
+	keys.emplace(key, keys.size());
+
+	AppendVarint(uint_least64_t(type));
+	AppendLiteral(key);
+}
+
+void
+BinaryRecordEncoder::String(std::string_view key, std::string_view value,
+			    bool intern) noexcept
+{
+	AppendHeader(key, Type::STRING);
+
+	if (intern) {
+		if (auto i = strings.find(value); i != strings.end()) {
+			AppendVarint((uint_least64_t(i->second) << 2) |
+				     uint_least64_t(StringMode::REFERENCE));
+			return;
+		}
+
+		if (strings.size() < MAX_STRINGS) {
+			strings.emplace(value, strings.size());
+
+			AppendVarint((uint_least64_t(value.size()) << 2) |
+				     uint_least64_t(StringMode::INTERN));
+			buffer.append(value);
+			return;
+		}
+	}
+
+	AppendVarint((uint_least64_t(value.size()) << 2) |
+		     uint_least64_t(StringMode::LITERAL));
+	buffer.append(value);
+}
+
+void
+BinaryRecordEncoder::Unsigned(std::string_view key,
+			      uint_least64_t value) noexcept
+{
+	AppendHeader(key, Type::UNSIGNED);
+	AppendVarint(value);
+}
+
+void
+BinaryRecordEncoder::Time(std::string_view key,
+			  std::chrono::system_clock::time_point t) noexcept
+{
+	const auto s = std::chrono::duration_cast<std::chrono::seconds>(t.time_since_epoch()).count();
+	if (s >= 0) {
+		AppendHeader(key, Type::TIME);
+		AppendVarint(s);
+		return;
+	}
+
+	StringBuffer<64> iso8601;
+	try {
+		iso8601 = FormatISO8601(t);
+	} catch (...) {
+		return;
+	}
+
+	String(key, iso8601.c_str());
+}
+
+void
+BinaryRecordEncoder::Duration(std::string_view key,
+			      std::chrono::milliseconds value) noexcept
+{
+	AppendHeader(key, Type::DURATION);
+	AppendVarint(value.count() > 0 ? value.count() : 0);
+}
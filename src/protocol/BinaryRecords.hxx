@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * Encoder for the compact binary response format which clients can
+ * enable with the protocol feature "binary_records".  Each item
+ * corresponds to one "NAME: VALUE" line of the text protocol.
+ *
+ * An item begins with a varint header; its lowest two bits are the
+ * value type (see #Type), the remaining bits are a key reference:
+ * zero means a new key name follows as a string literal (varint
+ * length and the bytes) and is appended to the key table; otherwise
+ * it is the 1-based index into the key table.
+ *
+ * Integer values are varints.  String values begin with a varint
+ * whose lowest two bits describe it (see #StringMode); the remaining
+ * bits are the length of the literal which follows or the 0-based
+ * index into the string table.
+ *
+ * Both tables are per response; they are reset after each command.
+ */
+class BinaryRecordEncoder {
+	/**
+	 * Stop interning strings after this many; this limits the
+	 * memory used by both sides.
+	 */
+	static constexpr std::size_t MAX_STRINGS = 65536;
+
+	struct StringHash {
+		using is_transparent = void;
+
+		[[gnu::pure]]
+		std::size_t operator()(std::string_view s) const noexcept {
+			return std::hash<std::string_view>{}(s);
+		}
+	};
+
+	using Table = std::unordered_map<std::string, std::size_t,
+					 StringHash, std::equal_to<>>;
+
+	Table keys, strings;
+
+	std::string buffer;
+
+public:
+	enum class Type : uint_least8_t {
+		STRING = 0,
+		UNSIGNED = 1,
+
+		/**
+		 * Seconds since the epoch (unsigned).
+		 */
+		TIME = 2,
+
+		/**
+		 * Milliseconds (unsigned).
+		 */
+		DURATION = 3,
+	};
+
+	enum class StringMode : uint_least8_t {
+		LITERAL = 0,
+
+		/**
+		 * A literal which is also appended to the string
+		 * table.
+		 */
+		INTERN = 1,
+
+		REFERENCE = 2,
+	};
+
+	/**
+	 * @param intern allow interning the value; should be set for
+	 * values which are likely to be repeated in this response
+	 */
+	void String(std::string_view key, std::string_view value,
+		    bool intern=false) noexcept;
+
+	void Unsigned(std::string_view key, uint_least64_t value) noexcept;
+
+	/**
+	 * Encode a time stamp.  Time stamps before the epoch are
+	 * encoded as ISO8601 strings.
+	 */
+	void Time(std::string_view key,
+		  std::chrono::system_clock::time_point t) noexcept;
+
+	void Duration(std::string_view key,
+		      std::chrono::milliseconds value) noexcept;
+
+	std::size_t GetSize() const noexcept {
+		return buffer.size();
+	}
+
+	std::string_view GetBuffer() const noexcept {
+		return buffer;
+	}
+
+	/**
+	 * Remove the given number of bytes from the beginning of the
+	 * buffer (after they have been sent).
+	 */
+	void Consume(std::size_t n) noexcept {
+		buffer.erase(0, n);
+	}
+
+private:
+	void AppendVarint(uint_least64_t value) noexcept;
+	void AppendLiteral(std::string_view s) noexcept;
+	void AppendHeader(std::string_view key, Type type) noexcept;
+};
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ChangeLog.hxx"
+
+#include <algorithm>
+
+std::optional<std::vector<QueueChangeLog::Range>>
+QueueChangeLog::Find(uint32_t version,
+		     unsigned start, unsigned end) const noexcept
+{
+	if (version <= evicted_version)
+		return std::nullopt;
+
+	std::vector<Range> ranges;
+
+	const auto Append = [&ranges, start, end](unsigned a, unsigned b){
+		a = std::max(a, start);
+		b = std::min(b, end);
+		if (a < b)
+			ranges.emplace_back(a, b);
+	};
+
+	Append(0, unversioned_end);
+
+	/* walk backwards from the newest record until the first one
+	   which is older than the given version */
+	for (std::size_t i = n_records; i > 0; --i) {
+		const auto &record = records[(head + i - 1) % CAPACITY];
+		if (record.version < version)
+			break;
+
+		Append(record.start, record.end);
+	}
+
+	if (ranges.size() < 2)
+		return ranges;
+
+	std::sort(ranges.begin(), ranges.end());
+
+	/* merge overlapping ranges */
+	auto dest = ranges.begin();
+	for (auto i = std::next(dest); i != ranges.end(); ++i) {
+		if (i->first <= dest->second)
+			dest->second = std::max(dest->second, i->second);
+		else
+			*++dest = *i;
+	}
+
+	ranges.erase(std::next(dest), ranges.end());
+	return ranges;
+}
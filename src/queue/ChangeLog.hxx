@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/**
+ * A ring buffer of recent modifications to the #Queue; each record
+ * is a range of positions and the queue version at the time of the
+ * modification.  It allows finding the songs which are newer than a
+ * given version (for "plchanges") without comparing the version of
+ * each song in the queue.
+ *
+ * The recorded positions are not adjusted when songs are moved
+ * later, because each move marks all shifted positions as modified,
+ * i.e. it adds another record.  The result is therefore a superset;
+ * the caller still needs to check the version of each candidate.
+ */
+class QueueChangeLog {
+	struct Record {
+		uint32_t version;
+		unsigned start, end;
+	};
+
+	static constexpr std::size_t CAPACITY = 1024;
+
+	std::array<Record, CAPACITY> records;
+
+	/**
+	 * The index of the oldest record in #records.
+	 */
+	std::size_t head = 0;
+
+	/**
+	 * The number of valid records.
+	 */
+	std::size_t n_records = 0;
+
+	/**
+	 * The version of the most recently evicted record.  The log
+	 * is incomplete for all versions up to this one.
+	 */
+	uint32_t evicted_version = 0;
+
+	/**
+	 * The positions [0, unversioned_end) may contain songs
+	 * whose version was reset to zero after the version counter
+	 * has wrapped; these are always considered modified.
+	 */
+	unsigned unversioned_end = 0;
+
+public:
+	using Range = std::pair<unsigned, unsigned>;
+
+	/**
+	 * Record a modification.  The versions passed to this
+	 * method must be monotonic (until the next Reset() call).
+	 */
+	void Add(uint32_t version, unsigned start, unsigned end) noexcept {
+		if (start >= end)
+			return;
+
+		if (n_records > 0) {
+			/* merge with the previous record if possible
+			   (e.g. many songs appended with one
+			   command) */
+			auto &last = records[(head + n_records - 1) % CAPACITY];
+			if (last.version == version &&
+			    start <= last.end && end >= last.start) {
+				if (start < last.start)
+					last.start = start;
+				if (end > last.end)
+					last.end = end;
+				return;
+			}
+		}
+
+		if (n_records == CAPACITY) {
+			evicted_version = records[head].version;
+			head = (head + 1) % CAPACITY;
+			--n_records;
+		}
+
+		records[(head + n_records) % CAPACITY] = {version, start, end};
+		++n_records;
+	}
+
+	/**
+	 * Forget all records after the version counter has wrapped
+	 * and all song versions have been reset to zero.
+	 *
+	 * @param length the current length of the queue
+	 */
+	void Reset(unsigned length) noexcept {
+		head = n_records = 0;
+		evicted_version = 0;
+		unversioned_end = length;
+	}
+
+	/**
+	 * The queue has been cleared; there are no more songs with a
+	 * version reset to zero.
+	 */
+	void ClearUnversioned() noexcept {
+		unversioned_end = 0;
+	}
+
+	/**
+	 * Find the (sorted and non-overlapping) position ranges
+	 * which may contain songs newer than the given version,
+	 * clipped to [start, end).
+	 *
+	 * @return the ranges or std::nullopt if the log does not go
+	 * back far enough
+	 */
+	std::optional<std::vector<Range>> Find(uint32_t version,
+					       unsigned start,
+					       unsigned end) const noexcept;
+};
@@ -9,6 +9,8 @@
 #include "queue/Queue.hxx"
 #include "config.h"
 
+#include <span>
+
 enum TagType : uint8_t;
 struct Tag;
 struct RangeArg;
@@ -211,6 +213,18 @@ public:
 	 */
 	unsigned AppendSong(PlayerControl &pc, DetachedSong &&song);
 
+	/**
+	 * Append many songs at once.  This is cheaper than calling
+	 * AppendSong() for each one, because the queued song and the
+	 * queue version are only updated once.
+	 *
+	 * Throws PlaylistError if the queue would be too large.  This
+	 * method itself appends either all songs or none; callers
+	 * which want to keep the songs that fit (like
+	 * AddFromDatabase()) must pass only those.
+	 */
+	void AppendSongs(PlayerControl &pc, std::span<DetachedSong> songs);
+
 	/**
 	 * Throws #std::runtime_error on error.
 	 *
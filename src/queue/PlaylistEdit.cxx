@@ -15,6 +15,8 @@
 #include "song/DetachedSong.hxx"
 #include "SongLoader.hxx"
 
+#include <algorithm>
+
 #include <stdlib.h>
 
 void
@@ -103,6 +105,42 @@ playlist::AppendSong(PlayerControl &pc, DetachedSong &&song)
 	return id;
 }
 
+void
+playlist::AppendSongs(PlayerControl &pc, std::span<DetachedSong> songs)
+{
+	if (songs.empty())
+		return;
+
+	if (songs.size() > queue.max_length - queue.GetLength())
+		throw PlaylistError(PlaylistResult::TOO_LARGE,
+				    "Playlist is too large");
+
+	const DetachedSong *const queued_song = GetQueuedSong();
+
+	for (auto &song : songs)
+		queue.Append(std::move(song), 0);
+
+	if (queue.random) {
+		/* shuffle the new songs into the list of remaining
+		   songs to play */
+
+		unsigned start;
+		if (queued >= 0)
+			start = queued + 1;
+		else
+			start = current + 1;
+
+		const unsigned end = queue.GetLength();
+		const unsigned n = std::min<std::size_t>(songs.size(),
+							 end - start);
+		if (start < end)
+			queue.ShuffleOrderLastWithPriority(start, end, n);
+	}
+
+	UpdateQueuedSong(pc, queued_song);
+	OnModified();
+}
+
 unsigned
 playlist::AppendURI(PlayerControl &pc, const SongLoader &loader,
 		    const char *uri)
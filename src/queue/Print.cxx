@@ -29,12 +29,12 @@ queue_print_song_info(Response &r, const Queue &queue,
 		      unsigned position)
 {
 	song_print_info(r, queue.Get(position));
-	r.Fmt("Pos: {}\nId: {}\n",
-	      position, queue.PositionToId(position));
+	r.WriteItem("Pos", position);
+	r.WriteItem("Id", queue.PositionToId(position));
 
 	uint8_t priority = queue.GetPriorityAtPosition(position);
 	if (priority != 0)
-		r.Fmt("Prio: {}\n", priority);
+		r.WriteItem("Prio", priority);
 }
 
 void
@@ -69,9 +69,10 @@ queue_print_changes_info(Response &r, const Queue &queue,
 	assert(start <= end);
 	assert(end <= queue.GetLength());
 
-	for (unsigned i = start; i < end; i++)
-		if (queue.IsNewerAtPosition(i, version))
-			queue_print_song_info(r, queue, i);
+	for (const auto &[a, b] : queue.FindChangedRanges(version, start, end))
+		for (unsigned i = a; i < b; i++)
+			if (queue.IsNewerAtPosition(i, version))
+				queue_print_song_info(r, queue, i);
 }
 
 void
@@ -82,10 +83,11 @@ queue_print_changes_position(Response &r, const Queue &queue,
 	assert(start <= end);
 	assert(end <= queue.GetLength());
 
-	for (unsigned i = start; i < end; i++)
-		if (queue.IsNewerAtPosition(i, version))
-			r.Fmt("cpos: {}\nId: {}\n",
-			      i, queue.PositionToId(i));
+	for (const auto &[a, b] : queue.FindChangedRanges(version, start, end))
+		for (unsigned i = a; i < b; i++)
+			if (queue.IsNewerAtPosition(i, version))
+				r.Fmt("cpos: {}\nId: {}\n",
+				      i, queue.PositionToId(i));
 }
 
 [[gnu::pure]]
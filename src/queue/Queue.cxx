@@ -9,8 +9,6 @@
 
 Queue::Queue(unsigned _max_length) noexcept
 	:max_length(_max_length),
-	 items(new Item[max_length]),
-	 order(new unsigned[max_length]),
 	 id_table(max_length * HASH_MULT)
 {
 }
@@ -18,9 +16,6 @@ Queue::Queue(unsigned _max_length) noexcept
 Queue::~Queue() noexcept
 {
 	Clear();
-
-	delete[] items;
-	delete[] order;
 }
 
 LightSong
@@ -58,20 +53,36 @@ Queue::IncrementVersion() noexcept
 	version++;
 
 	if (version >= max) {
-		for (unsigned i = 0; i < length; i++)
-			items[i].version = 0;
+		positions.ClearStamps();
+		change_log.Reset(length);
 
 		version = 1;
 	}
 }
 
+std::vector<QueueChangeLog::Range>
+Queue::FindChangedRanges(uint32_t _version,
+			 unsigned start, unsigned end) const noexcept
+{
+	assert(start <= end);
+	assert(end <= length);
+
+	if (_version <= version)
+		if (auto ranges = change_log.Find(_version, start, end))
+			return std::move(*ranges);
+
+	/* fall back to a full scan */
+	std::vector<QueueChangeLog::Range> ranges;
+	if (start < end)
+		ranges.emplace_back(start, end);
+	return ranges;
+}
+
 void
 Queue::ModifyAtOrder(unsigned _order) noexcept
 {
-	assert(_order < length);
-
-	unsigned position = order[_order];
-	ModifyAtPosition(position);
+	Node &node = GetOrderNode(_order);
+	ModifyNode(node, SequenceTree::IndexOf(node.position_hook));
 }
 
 unsigned
@@ -79,16 +90,19 @@ Queue::Append(DetachedSong &&song, uint8_t priority) noexcept
 {
 	assert(!IsFull());
 
-	const unsigned position = length++;
-	const unsigned id = id_table.Insert(position);
+	auto *node = new Node();
+	const unsigned id = id_table.Insert(*node);
 
-	auto &item = items[position];
+	auto &item = node->item;
 	item.song = new DetachedSong(std::move(song));
 	item.id = id;
-	item.version = version;
 	item.priority = priority;
 
-	order[position] = position;
+	node->position_hook.stamp = version;
+	positions.PushBack(node->position_hook);
+	orders.PushBack(node->order_hook);
+	change_log.Add(version, length, length + 1);
+	++length;
 
 	return id;
 }
@@ -96,114 +110,68 @@ Queue::Append(DetachedSong &&song, uint8_t priority) noexcept
 void
 Queue::SwapPositions(unsigned position1, unsigned position2) noexcept
 {
-	unsigned id1 = items[position1].id;
-	unsigned id2 = items[position2].id;
+	/* swap the payload, but leave the nodes (and therefore the
+	   "order" list) where they are */
+
+	Node &node1 = GetPositionNode(position1);
+	Node &node2 = GetPositionNode(position2);
 
-	std::swap(items[position1], items[position2]);
+	std::swap(node1.item, node2.item);
 
-	items[position1].version = version;
-	items[position2].version = version;
+	ModifyNode(node1, position1);
+	ModifyNode(node2, position2);
 
-	id_table.Move(id1, position2);
-	id_table.Move(id2, position1);
+	id_table.Replace(node1.item.id, node1);
+	id_table.Replace(node2.item.id, node2);
 }
 
 void
-Queue::MovePostion(unsigned from, unsigned to) noexcept
+Queue::SwapOrders(unsigned order1, unsigned order2) noexcept
 {
-	const Item tmp = items[from];
-
-	/* move songs to one less in from->to */
-
-	for (unsigned i = from; i < to; i++)
-		MoveItemTo(i + 1, i);
+	if (order1 == order2)
+		return;
 
-	/* move songs to one more in to->from */
+	if (order1 > order2)
+		std::swap(order1, order2);
 
-	for (unsigned i = from; i > to; i--)
-		MoveItemTo(i - 1, i);
+	orders.Move(order2, order1);
+	orders.Move(order1 + 1, order2);
+}
 
-	/* put song at _to_ */
+void
+Queue::MovePostion(unsigned from, unsigned to) noexcept
+{
+	positions.Move(from, to);
 
-	id_table.Move(tmp.id, to);
-	items[to] = tmp;
-	items[to].version = version;
+	/* all songs between the two positions have moved */
+	ModifyPositionRange(std::min(from, to), std::max(from, to) + 1);
 
-	/* now deal with order */
+	/* in random mode, the "order" list follows the songs, but
+	   outside of random mode, it follows the positions */
 
-	if (random) {
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] > from && order[i] <= to)
-				order[i]--;
-			else if (order[i] < from &&
-				 order[i] >= to)
-				order[i]++;
-			else if (from == order[i])
-				order[i] = to;
-		}
-	}
+	if (!random)
+		orders.Move(from, to);
 }
 
 void
 Queue::MoveRange(unsigned start, unsigned end, unsigned to) noexcept
 {
-	const auto tmp = std::make_unique_for_overwrite<Item[]>(end - start);
-
-	// Copy the original block [start,end-1]
-	for (unsigned i = start; i < end; i++)
-		tmp[i - start] = items[i];
-
-	// If to > start, we need to move to-start items to start, starting from end
-	for (unsigned i = end; i < end + to - start; i++)
-		MoveItemTo(i, start + i - end);
-
-	// If to < start, we need to move start-to items to newend (= end + to - start), starting from to
-	// This is the same as moving items from start-1 to to (decreasing), with start-1 going to end-1
-	// We have to iterate in this order to avoid writing over something we haven't yet moved
-	for (int i = start - 1; i >= int(to); i--)
-		MoveItemTo(i, i + end - start);
-
-	// Copy the original block back in, starting at to.
-	for (unsigned i = start; i< end; i++)
-	{
-		id_table.Move(tmp[i - start].id, to + i - start);
-		items[to + i - start] = tmp[i-start];
-		items[to + i - start].version = version;
-	}
+	positions.MoveRange(start, end, to);
 
-	if (random) {
-		// Update the positions in the queue.
-		// Note that the ranges for these cases are the same as the ranges of
-		// the loops above.
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] >= end && order[i] < to + end - start)
-				order[i] -= end - start;
-			else if (order[i] < start &&
-				 order[i] >= to)
-				order[i] += end - start;
-			else if (start <= order[i] && order[i] < end)
-				order[i] += to - start;
-		}
-	}
+	ModifyPositionRange(std::min(start, to),
+			    std::max(end, to + end - start));
+
+	if (!random)
+		orders.MoveRange(start, end, to);
 }
 
 unsigned
 Queue::MoveOrder(unsigned from_order, unsigned to_order) noexcept
 {
 	assert(from_order < length);
-	assert(to_order <= length);
-
-	const unsigned from_position = OrderToPosition(from_order);
+	assert(to_order < length);
 
-	if (from_order < to_order) {
-		for (unsigned i = from_order; i < to_order; ++i)
-			order[i] = order[i + 1];
-	} else {
-		for (unsigned i = from_order; i > to_order; --i)
-			order[i] = order[i - 1];
-	}
-
-	order[to_order] = from_position;
+	orders.Move(from_order, to_order);
 	return to_order;
 }
 
@@ -230,66 +198,82 @@ Queue::DeletePosition(unsigned position) noexcept
 {
 	assert(position < length);
 
-	delete items[position].song;
-
-	const unsigned id = PositionToId(position);
-	const unsigned _order = PositionToOrder(position);
+	Node &node = GetPositionNode(position);
 
+	positions.Erase(node.position_hook);
+	orders.Erase(node.order_hook);
 	--length;
 
-	/* release the song id */
-
-	id_table.Erase(id);
-
-	/* delete song from songs array */
-
-	for (unsigned i = position; i < length; i++)
-		MoveItemTo(i + 1, i);
-
-	/* delete the entry from the order array */
+	/* all following songs have moved */
+	ModifyPositionRange(position, length);
 
-	for (unsigned i = _order; i < length; i++)
-		order[i] = order[i + 1];
+	/* release the song id */
 
-	/* readjust values in the order array */
+	id_table.Erase(node.item.id);
 
-	for (unsigned i = 0; i < length; i++)
-		if (order[i] > position)
-			--order[i];
+	delete node.item.song;
+	delete &node;
 }
 
 void
 Queue::Clear() noexcept
 {
-	for (unsigned i = 0; i < length; i++) {
-		Item *item = &items[i];
+	orders.clear();
+	positions.clear_and_dispose([this](SequenceTree::Hook &hook){
+		Node &node = Node::FromPosition(hook);
 
-		delete item->song;
+		id_table.Erase(node.item.id);
 
-		id_table.Erase(item->id);
-	}
+		delete node.item.song;
+		delete &node;
+	});
 
 	length = 0;
+	change_log.ClearUnversioned();
 	last_loaded_playlist.clear();
 }
 
-static void
-queue_sort_order_by_priority(Queue *queue,
-			     unsigned start, unsigned end) noexcept
+void
+Queue::RestoreOrder() noexcept
+{
+	std::vector<SequenceTree::Hook *> hooks;
+	hooks.reserve(length);
+
+	for (auto *i = positions.empty() ? nullptr : &positions.At(0);
+	     i != nullptr; i = SequenceTree::Next(*i))
+		hooks.push_back(&Node::FromPosition(*i).order_hook);
+
+	orders.Assign(hooks);
+}
+
+std::vector<Queue::Node *>
+Queue::GetOrderRange(unsigned start, unsigned end) const noexcept
 {
-	assert(queue != nullptr);
-	assert(queue->random);
 	assert(start <= end);
-	assert(end <= queue->length);
+	assert(end <= length);
 
-	auto cmp = [queue](unsigned a_pos, unsigned b_pos){
-		const Queue::Item &a = queue->items[a_pos];
-		const Queue::Item &b = queue->items[b_pos];
+	std::vector<Node *> nodes;
+	nodes.reserve(end - start);
 
-		return a.priority > b.priority;
-	};
+	if (start < end)
+		for (auto *i = &orders.At(start); nodes.size() < end - start;
+		     i = SequenceTree::Next(*i))
+			nodes.push_back(&Node::FromOrder(*i));
 
-	std::stable_sort(queue->order + start, queue->order + end, cmp);
+	return nodes;
+}
+
+void
+Queue::ReplaceOrderRange(unsigned start,
+			 std::span<Node *const> nodes) noexcept
+{
+	std::vector<SequenceTree::Hook *> hooks;
+	hooks.reserve(nodes.size());
+
+	for (Node *node : nodes)
+		hooks.push_back(&node->order_hook);
+
+	orders.Replace(start, hooks);
 }
 
 void
@@ -299,8 +283,12 @@ Queue::ShuffleOrderRange(unsigned start, unsigned end) noexcept
 	assert(start <= end);
 	assert(end <= length);
 
+	auto nodes = GetOrderRange(start, end);
+
 	rand.AutoCreate();
-	std::shuffle(order + start, order + end, rand);
+	std::shuffle(nodes.begin(), nodes.end(), rand);
+
+	ReplaceOrderRange(start, nodes);
 }
 
 /**
@@ -317,28 +305,31 @@ Queue::ShuffleOrderRangeWithPriority(unsigned start, unsigned end) noexcept
 	if (start == end)
 		return;
 
+	auto nodes = GetOrderRange(start, end);
+
 	/* first group the range by priority */
-	queue_sort_order_by_priority(this, start, end);
+	std::stable_sort(nodes.begin(), nodes.end(),
+			 [](const Node *a, const Node *b){
+				 return a->item.priority > b->item.priority;
+			 });
 
 	/* now shuffle each priority group */
-	unsigned group_start = start;
-	uint8_t group_priority = GetOrderPriority(start);
-
-	for (unsigned i = start + 1; i < end; ++i) {
-		const uint8_t priority = GetOrderPriority(i);
-		assert(priority <= group_priority);
+	rand.AutoCreate();
 
-		if (priority != group_priority) {
+	auto group_start = nodes.begin();
+	for (auto i = group_start; i != nodes.end(); ++i) {
+		if ((*i)->item.priority != (*group_start)->item.priority) {
 			/* start of a new group - shuffle the one that
 			   has just ended */
-			ShuffleOrderRange(group_start, i);
+			std::shuffle(group_start, i, rand);
 			group_start = i;
-			group_priority = priority;
 		}
 	}
 
 	/* shuffle the last group */
-	ShuffleOrderRange(group_start, end);
+	std::shuffle(group_start, nodes.end(), rand);
+
+	ReplaceOrderRange(start, nodes);
 }
 
 void
@@ -357,24 +348,46 @@ Queue::ShuffleOrderFirst(unsigned start, unsigned end) noexcept
 }
 
 void
-Queue::ShuffleOrderLastWithPriority(unsigned start, unsigned end) noexcept
+Queue::ShuffleOrderLastWithPriority(unsigned start, unsigned end,
+				    unsigned n) noexcept
 {
 	assert(end <= length);
 	assert(start < end);
+	assert(n >= 1);
+	assert(n <= end - start);
 
 	/* skip all items at the start which have a higher priority,
 	   because the last item shall only be shuffled within its
 	   priority group */
-	const auto last_priority = items[OrderToPosition(end - 1)].priority;
-	while (items[OrderToPosition(start)].priority != last_priority) {
+	const auto last_priority = GetOrderItem(end - 1).priority;
+	for (auto *i = &orders.At(start);
+	     Node::FromOrder(*i).item.priority != last_priority;
+	     i = SequenceTree::Next(*i)) {
 		++start;
 		assert(start < end);
 	}
 
 	rand.AutoCreate();
 
-	std::uniform_int_distribution<unsigned> distribution(start, end - 1);
-	SwapOrders(end - 1, distribution(rand));
+	if (n == 1) {
+		std::uniform_int_distribution<unsigned> distribution(start, end - 1);
+		SwapOrders(end - 1, distribution(rand));
+		return;
+	}
+
+	/* many songs: do the same swaps on a copy of the range and
+	   replace it at once */
+
+	auto nodes = GetOrderRange(start, end);
+
+	for (std::size_t i = nodes.size() - n; i < nodes.size(); ++i) {
+		assert(nodes[i]->item.priority == last_priority);
+
+		std::uniform_int_distribution<std::size_t> distribution(0, i);
+		std::swap(nodes[i], nodes[distribution(rand)]);
+	}
+
+	ReplaceOrderRange(start, nodes);
 }
 
 void
@@ -400,10 +413,14 @@ Queue::FindPriorityOrder(unsigned start_order, uint8_t priority,
 	assert(random);
 	assert(start_order <= length);
 
-	for (unsigned i = start_order; i < length; ++i) {
-		const unsigned position = OrderToPosition(i);
-		const Item *item = &items[position];
-		if (item->priority <= priority && i != exclude_order)
+	if (start_order == length)
+		return length;
+
+	unsigned i = start_order;
+	for (auto *hook = &orders.At(start_order); hook != nullptr;
+	     hook = SequenceTree::Next(*hook), ++i) {
+		const Item &item = Node::FromOrder(*hook).item;
+		if (item.priority <= priority && i != exclude_order)
 			return i;
 	}
 
@@ -416,10 +433,14 @@ Queue::CountSamePriority(unsigned start_order, uint8_t priority) const noexcept
 	assert(random);
 	assert(start_order <= length);
 
-	for (unsigned i = start_order; i < length; ++i) {
-		const unsigned position = OrderToPosition(i);
-		const Item *item = &items[position];
-		if (item->priority != priority)
+	if (start_order == length)
+		return 0;
+
+	unsigned i = start_order;
+	for (auto *hook = &orders.At(start_order); hook != nullptr;
+	     hook = SequenceTree::Next(*hook), ++i) {
+		const Item &item = Node::FromOrder(*hook).item;
+		if (item.priority != priority)
 			return i - start_order;
 	}
 
@@ -432,12 +453,13 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order,
 {
 	assert(position < length);
 
-	Item *item = &items[position];
+	Node &node = GetPositionNode(position);
+	Item *item = &node.item;
 	uint8_t old_priority = item->priority;
 	if (old_priority == priority)
 		return false;
 
-	item->version = version;
+	ModifyNode(node, position);
 	item->priority = priority;
 
 	if (!random || !reorder)
@@ -456,10 +478,8 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order,
 			   increased and is now bigger than the
 			   current one's */
 
-			const unsigned after_position =
-				OrderToPosition(after_order);
 			const Item *after_item =
-				&items[after_position];
+				&GetOrderItem(after_order);
 			if (priority <= old_priority ||
 			    priority <= after_item->priority)
 				/* priority hasn't become bigger */
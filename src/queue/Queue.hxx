@@ -4,14 +4,19 @@
 #ifndef MPD_QUEUE_HXX
 #define MPD_QUEUE_HXX
 
+#include "ChangeLog.hxx"
 #include "IdTable.hxx"
+#include "SequenceTree.hxx"
 #include "SingleMode.hxx"
 #include "ConsumeMode.hxx"
+#include "util/Cast.hxx"
 #include "util/LazyRandomEngine.hxx"
 
 #include <cassert>
 #include <cstdint>
+#include <span>
 #include <utility>
+#include <vector>
 
 struct LightSong;
 class DetachedSong;
@@ -25,6 +30,11 @@ class DetachedSong;
  * - the position in the queue
  * - the unique id (which stays the same, regardless of moves)
  * - the order number (which only differs from "position" in random mode)
+ *
+ * Both the "position" and the "order" lists are #SequenceTree
+ * instances, therefore inserting, moving and deleting songs takes
+ * O(log n) instead of moving all following array elements; looking
+ * up a song by position or order number is O(log n) as well.
  */
 struct Queue {
 	/**
@@ -43,9 +53,6 @@ struct Queue {
 		/** the unique id of this item in the queue */
 		unsigned id;
 
-		/** when was this item last changed? */
-		uint32_t version;
-
 		/**
 		 * The priority of this item, between 0 and 255.  High
 		 * priority value means that this song gets played first in
@@ -54,6 +61,25 @@ struct Queue {
 		uint8_t priority;
 	};
 
+	/**
+	 * The allocation of one #Item which is linked in both
+	 * #SequenceTree instances.  The stamp of #position_hook is
+	 * the queue version when this position was last changed.
+	 */
+	struct Node {
+		SequenceTree::Hook position_hook, order_hook;
+
+		Item item;
+
+		static Node &FromPosition(SequenceTree::Hook &hook) noexcept {
+			return ContainerCast(hook, &Node::position_hook);
+		}
+
+		static Node &FromOrder(SequenceTree::Hook &hook) noexcept {
+			return ContainerCast(hook, &Node::order_hook);
+		}
+	};
+
 	/** configured maximum length of the queue */
 	const unsigned max_length;
 
@@ -64,13 +90,16 @@ struct Queue {
 	uint32_t version = 1;
 
 	/** all songs in "position" order */
-	Item *const items;
+	SequenceTree positions;
+
+	/** all songs in "order" order */
+	SequenceTree orders;
 
-	/** map order numbers to positions */
-	unsigned *const order;
+	/** map song ids to nodes */
+	IdTable<Node> id_table;
 
-	/** map song ids to positions */
-	IdTable id_table;
+	/** recent modifications, for FindChangedRanges() */
+	QueueChangeLog change_log;
 
 	/** repeat playback when the end of the queue has been
 	    reached? */
@@ -133,46 +162,44 @@ struct Queue {
 		return _order < length;
 	}
 
+	[[gnu::pure]]
 	int IdToPosition(unsigned id) const noexcept {
-		return id_table.IdToPosition(id);
+		const Node *node = id_table.Lookup(id);
+		return node != nullptr
+			? (int)SequenceTree::IndexOf(node->position_hook)
+			: -1;
 	}
 
+	[[gnu::pure]]
 	int PositionToId(unsigned position) const noexcept {
-		assert(position < length);
-
-		return items[position].id;
+		return GetItem(position).id;
 	}
 
 	[[gnu::pure]]
 	unsigned OrderToPosition(unsigned _order) const noexcept {
-		assert(_order < length);
-
-		return order[_order];
+		return SequenceTree::IndexOf(GetOrderNode(_order).position_hook);
 	}
 
 	[[gnu::pure]]
 	unsigned PositionToOrder(unsigned position) const noexcept {
-		assert(position < length);
-
-		for (unsigned i = 0;; ++i) {
-			assert(i < length);
-
-			if (order[i] == position)
-				return i;
-		}
+		return SequenceTree::IndexOf(GetPositionNode(position).order_hook);
 	}
 
 	[[gnu::pure]]
 	uint8_t GetPriorityAtPosition(unsigned position) const noexcept {
-		assert(position < length);
+		return GetItem(position).priority;
+	}
 
-		return items[position].priority;
+	[[gnu::pure]]
+	const Item &GetItem(unsigned position) const noexcept {
+		return GetPositionNode(position).item;
 	}
 
+	[[gnu::pure]]
 	const Item &GetOrderItem(unsigned i) const noexcept {
 		assert(IsValidOrder(i));
 
-		return items[OrderToPosition(i)];
+		return GetOrderNode(i).item;
 	}
 
 	uint8_t GetOrderPriority(unsigned i) const noexcept {
@@ -183,9 +210,7 @@ struct Queue {
 	 * Returns the song at the specified position.
 	 */
 	DetachedSong &Get(unsigned position) const noexcept {
-		assert(position < length);
-
-		return *items[position].song;
+		return *GetItem(position).song;
 	}
 
 	/**
@@ -197,7 +222,7 @@ struct Queue {
 	 * Returns the song at the specified order number.
 	 */
 	DetachedSong &GetOrder(unsigned _order) const noexcept {
-		return Get(OrderToPosition(_order));
+		return *GetOrderItem(_order).song;
 	}
 
 	/**
@@ -206,13 +231,28 @@ struct Queue {
 	 */
 	bool IsNewerAtPosition(unsigned position,
 			       uint32_t _version) const noexcept {
-		assert(position < length);
-
+		const auto item_version =
+			SequenceTree::GetStamp(GetPositionNode(position).position_hook);
 		return _version > version ||
-			items[position].version >= _version ||
-			items[position].version == 0;
+			item_version >= _version ||
+			item_version == 0;
 	}
 
+	/**
+	 * Find the (sorted and non-overlapping) position ranges
+	 * within [start, end) which may contain songs newer than the
+	 * specified version.  The caller still needs to check each
+	 * position with IsNewerAtPosition().
+	 *
+	 * This is usually proportional to the number of recent
+	 * modifications; if the version is too old for the change
+	 * log, the whole range is returned.
+	 */
+	[[gnu::pure]]
+	std::vector<QueueChangeLog::Range> FindChangedRanges(uint32_t _version,
+							     unsigned start,
+							     unsigned end) const noexcept;
+
 	/**
 	 * Returns the order number following the specified one.  This takes
 	 * end of queue and "repeat" mode into account.
@@ -234,9 +274,7 @@ struct Queue {
 	 * number.
 	 */
 	void ModifyAtPosition(unsigned position) noexcept {
-		assert(position < length);
-
-		items[position].version = version;
+		ModifyNode(GetPositionNode(position), position);
 	}
 
 	/**
@@ -266,9 +304,7 @@ struct Queue {
 	/**
 	 * Swaps two songs, addressed by their order number.
 	 */
-	void SwapOrders(unsigned order1, unsigned order2) noexcept {
-		std::swap(order[order1], order[order2]);
-	}
+	void SwapOrders(unsigned order1, unsigned order2) noexcept;
 
 	/**
 	 * Moves a song to a new position in the "order" list.
@@ -318,10 +354,7 @@ struct Queue {
 	/**
 	 * Initializes the "order" array, and restores "normal" order.
 	 */
-	void RestoreOrder() noexcept {
-		for (unsigned i = 0; i < length; ++i)
-			order[i] = i;
-	}
+	void RestoreOrder() noexcept;
 
 	/**
 	 * Shuffle the order of items in the specified range, ignoring
@@ -349,8 +382,14 @@ struct Queue {
 	 * specified (order) range; only songs which match this song's
 	 * priority are considered.  This is used in random mode after
 	 * a song has been appended by Append().
+	 *
+	 * @param n the number of songs at the end of the range to be
+	 * shuffled (one after another, as if this method had been
+	 * called after each Append() call); they must all have the
+	 * same priority
 	 */
-	void ShuffleOrderLastWithPriority(unsigned start, unsigned end) noexcept;
+	void ShuffleOrderLastWithPriority(unsigned start, unsigned end,
+					  unsigned n=1) noexcept;
 
 	/**
 	 * Shuffles a (position) range in the queue.  The songs are physically
@@ -365,14 +404,47 @@ struct Queue {
 			      uint8_t priority, int after_order) noexcept;
 
 private:
-	void MoveItemTo(unsigned from, unsigned to) noexcept {
-		unsigned from_id = items[from].id;
+	[[gnu::pure]]
+	Node &GetPositionNode(unsigned position) const noexcept {
+		assert(position < length);
 
-		items[to] = items[from];
-		items[to].version = version;
-		id_table.Move(from_id, to);
+		return Node::FromPosition(positions.At(position));
 	}
 
+	[[gnu::pure]]
+	Node &GetOrderNode(unsigned _order) const noexcept {
+		assert(_order < length);
+
+		return Node::FromOrder(orders.At(_order));
+	}
+
+	/**
+	 * Mark all songs in the specified (position) range as
+	 * "modified", e.g. because their position has changed.
+	 */
+	void ModifyPositionRange(unsigned start, unsigned end) noexcept {
+		positions.RaiseStamp(start, end, version);
+		change_log.Add(version, start, end);
+	}
+
+	void ModifyNode(Node &node, unsigned position) noexcept {
+		SequenceTree::RaiseStamp(node.position_hook, version);
+		change_log.Add(version, position, position + 1);
+	}
+
+	/**
+	 * Returns the nodes in the specified (order) range.
+	 */
+	std::vector<Node *> GetOrderRange(unsigned start,
+					  unsigned end) const noexcept;
+
+	/**
+	 * Replace the nodes in the "order" list beginning at the
+	 * specified order number.
+	 */
+	void ReplaceOrderRange(unsigned start,
+			       std::span<Node *const> nodes) noexcept;
+
 	/**
 	 * Find the first item that has this specified priority or
 	 * higher.
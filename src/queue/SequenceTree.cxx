@@ -0,0 +1,307 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "SequenceTree.hxx"
+
+#include <algorithm>
+#include <cassert>
+
+inline void
+SequenceTree::Update(Hook &hook) noexcept
+{
+	hook.size = 1 + Size(hook.left) + Size(hook.right);
+
+	if (hook.left != nullptr)
+		hook.left->parent = &hook;
+	if (hook.right != nullptr)
+		hook.right->parent = &hook;
+}
+
+inline void
+SequenceTree::PushStamp(Hook &hook) noexcept
+{
+	const auto pending = hook.pending_stamp;
+	if (pending == 0)
+		return;
+
+	hook.pending_stamp = 0;
+
+	RaiseStamp(hook, pending);
+
+	if (hook.left != nullptr && pending > hook.left->pending_stamp)
+		hook.left->pending_stamp = pending;
+	if (hook.right != nullptr && pending > hook.right->pending_stamp)
+		hook.right->pending_stamp = pending;
+}
+
+void
+SequenceTree::PushAllStamps(Hook *hook) noexcept
+{
+	if (hook == nullptr)
+		return;
+
+	PushStamp(*hook);
+	PushAllStamps(hook->left);
+	PushAllStamps(hook->right);
+}
+
+void
+SequenceTree::ClearStamps(Hook *hook) noexcept
+{
+	if (hook == nullptr)
+		return;
+
+	hook->stamp = hook->pending_stamp = 0;
+	ClearStamps(hook->left);
+	ClearStamps(hook->right);
+}
+
+SequenceTree::SplitResult
+SequenceTree::Split(Hook *tree, std::size_t n) noexcept
+{
+	if (tree == nullptr)
+		return {nullptr, nullptr};
+
+	PushStamp(*tree);
+
+	if (Size(tree->left) >= n) {
+		auto [a, b] = Split(tree->left, n);
+		tree->left = b;
+		Update(*tree);
+		return {a, tree};
+	} else {
+		auto [a, b] = Split(tree->right, n - Size(tree->left) - 1);
+		tree->right = a;
+		Update(*tree);
+		return {tree, b};
+	}
+}
+
+SequenceTree::Hook *
+SequenceTree::Merge(Hook *a, Hook *b) noexcept
+{
+	if (a == nullptr)
+		return b;
+	if (b == nullptr)
+		return a;
+
+	if (a->weight > b->weight) {
+		PushStamp(*a);
+		a->right = Merge(a->right, b);
+		Update(*a);
+		return a;
+	} else {
+		PushStamp(*b);
+		b->left = Merge(a, b->left);
+		Update(*b);
+		return b;
+	}
+}
+
+SequenceTree::Hook *
+SequenceTree::Build(std::span<Hook *const> hooks) noexcept
+{
+	/* build a Cartesian tree in O(n): the "right spine" is the
+	   path from the most recently added node up to the root;
+	   nodes which get popped from it are complete */
+
+	Hook *last = nullptr;
+
+	for (Hook *hook : hooks) {
+		InitHook(*hook);
+
+		Hook *child = nullptr;
+		while (last != nullptr && last->weight <= hook->weight) {
+			Update(*last);
+			child = last;
+			last = last->parent;
+		}
+
+		hook->left = child;
+		if (child != nullptr)
+			child->parent = hook;
+
+		hook->parent = last;
+		if (last != nullptr)
+			last->right = hook;
+
+		last = hook;
+	}
+
+	if (last == nullptr)
+		return nullptr;
+
+	while (true) {
+		Update(*last);
+		if (last->parent == nullptr)
+			return last;
+		last = last->parent;
+	}
+}
+
+SequenceTree::Hook &
+SequenceTree::At(std::size_t i) const noexcept
+{
+	assert(i < size());
+
+	Hook *hook = root;
+	while (true) {
+		assert(hook != nullptr);
+
+		const std::size_t left_size = Size(hook->left);
+		if (i < left_size)
+			hook = hook->left;
+		else if (i == left_size)
+			return *hook;
+		else {
+			i -= left_size + 1;
+			hook = hook->right;
+		}
+	}
+}
+
+std::size_t
+SequenceTree::IndexOf(const Hook &hook) noexcept
+{
+	std::size_t i = Size(hook.left);
+
+	for (const Hook *child = &hook, *parent = hook.parent;
+	     parent != nullptr;
+	     child = parent, parent = parent->parent)
+		if (parent->right == child)
+			i += Size(parent->left) + 1;
+
+	return i;
+}
+
+SequenceTree::Hook *
+SequenceTree::Next(const Hook &hook) noexcept
+{
+	if (hook.right != nullptr) {
+		Hook *i = hook.right;
+		while (i->left != nullptr)
+			i = i->left;
+		return i;
+	}
+
+	const Hook *child = &hook;
+	Hook *parent = hook.parent;
+	while (parent != nullptr && parent->right == child) {
+		child = parent;
+		parent = parent->parent;
+	}
+
+	return parent;
+}
+
+void
+SequenceTree::Insert(std::size_t i, Hook &hook) noexcept
+{
+	assert(i <= size());
+
+	InitHook(hook);
+
+	auto [a, b] = Split(root, i);
+	SetRoot(Merge(Merge(a, &hook), b));
+}
+
+void
+SequenceTree::Erase(Hook &hook) noexcept
+{
+	/* the stamps pending in the ancestors will not apply to this
+	   node after it has been unlinked */
+	hook.stamp = GetStamp(hook);
+	PushStamp(hook);
+
+	Hook *const parent = hook.parent;
+	Hook *const merged = Merge(hook.left, hook.right);
+
+	if (parent == nullptr) {
+		assert(root == &hook);
+		SetRoot(merged);
+		return;
+	}
+
+	if (parent->left == &hook)
+		parent->left = merged;
+	else
+		parent->right = merged;
+
+	if (merged != nullptr)
+		merged->parent = parent;
+
+	for (Hook *i = parent; i != nullptr; i = i->parent)
+		--i->size;
+}
+
+void
+SequenceTree::Move(std::size_t from, std::size_t to) noexcept
+{
+	assert(from < size());
+	assert(to < size());
+
+	if (from == to)
+		return;
+
+	Hook &hook = At(from);
+	Erase(hook);
+	Insert(to, hook);
+}
+
+void
+SequenceTree::MoveRange(std::size_t start, std::size_t end,
+			std::size_t to) noexcept
+{
+	assert(start <= end);
+	assert(end <= size());
+	assert(to + (end - start) <= size());
+
+	if (start == to || start == end)
+		return;
+
+	auto [a, rest] = Split(root, start);
+	auto [range, c] = Split(rest, end - start);
+	auto [x, y] = Split(Merge(a, c), to);
+	SetRoot(Merge(Merge(x, range), y));
+}
+
+void
+SequenceTree::Replace(std::size_t start,
+		      std::span<Hook *const> hooks) noexcept
+{
+	assert(start + hooks.size() <= size());
+
+	auto [a, rest] = Split(root, start);
+	auto [old, c] = Split(rest, hooks.size());
+	PushAllStamps(old);
+
+	SetRoot(Merge(Merge(a, Build(hooks)), c));
+}
+
+void
+SequenceTree::RaiseStamp(std::size_t start, std::size_t end,
+			 uint_least32_t value) noexcept
+{
+	assert(start <= end);
+	assert(end <= size());
+
+	if (start == end)
+		return;
+
+	auto [a, rest] = Split(root, start);
+	auto [range, c] = Split(rest, end - start);
+	if (value > range->pending_stamp)
+		range->pending_stamp = value;
+	SetRoot(Merge(Merge(a, range), c));
+}
+
+uint_least32_t
+SequenceTree::GetStamp(const Hook &hook) noexcept
+{
+	auto value = std::max(hook.stamp, hook.pending_stamp);
+
+	for (const Hook *i = hook.parent; i != nullptr; i = i->parent)
+		value = std::max(value, i->pending_stamp);
+
+	return value;
+}
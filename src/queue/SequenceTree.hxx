@@ -0,0 +1,251 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * An intrusive sequence container with O(log n) access by index,
+ * insertion, removal and moving of ranges.  It is an implicit treap
+ * (a randomized balanced binary tree keyed by the position in the
+ * sequence); each node knows the size of its subtree, and the index
+ * of a node can be determined by walking up to the root.
+ *
+ * Additionally, each node carries a "stamp" (e.g. a version number)
+ * which can be raised for a whole range in O(log n); the new value
+ * is stored in the root of the range's subtree and is pushed down
+ * lazily.
+ *
+ * This class does not own the hooks; it is the caller's
+ * responsibility to keep them alive while they are linked.
+ */
+class SequenceTree {
+public:
+	struct Hook {
+		Hook *parent, *left, *right;
+
+		/**
+		 * The number of nodes in this subtree (including this
+		 * one).
+		 */
+		uint_least32_t size;
+
+		/**
+		 * A random number; the tree is a max-heap with
+		 * regards to this attribute.
+		 */
+		uint_least32_t weight;
+
+		/**
+		 * The stamp of this node (unless #pending_stamp or
+		 * the #pending_stamp of an ancestor is larger).  Must
+		 * be initialized by the caller before this hook is
+		 * linked for the first time.
+		 */
+		uint_least32_t stamp;
+
+		/**
+		 * A stamp which applies to the whole subtree and
+		 * which has not yet been pushed down to the
+		 * children.
+		 */
+		uint_least32_t pending_stamp;
+	};
+
+private:
+	Hook *root = nullptr;
+
+	/**
+	 * State of the xorshift generator for Hook::weight.
+	 */
+	uint_least32_t random_state = 0x9e3779b9;
+
+public:
+	SequenceTree() noexcept = default;
+
+	SequenceTree(const SequenceTree &) = delete;
+	SequenceTree &operator=(const SequenceTree &) = delete;
+
+	std::size_t size() const noexcept {
+		return Size(root);
+	}
+
+	bool empty() const noexcept {
+		return root == nullptr;
+	}
+
+	/**
+	 * Unlink all nodes (without touching them).
+	 */
+	void clear() noexcept {
+		root = nullptr;
+	}
+
+	/**
+	 * Unlink all nodes and invoke the given disposer on each of
+	 * them (in no particular order).
+	 */
+	template<typename D>
+	void clear_and_dispose(D &&disposer) noexcept {
+		Dispose(root, disposer);
+		root = nullptr;
+	}
+
+	/**
+	 * Returns the node at the given index.
+	 */
+	[[gnu::pure]]
+	Hook &At(std::size_t i) const noexcept;
+
+	/**
+	 * Returns the index of the given (linked) node.
+	 */
+	[[gnu::pure]]
+	static std::size_t IndexOf(const Hook &hook) noexcept;
+
+	/**
+	 * Returns the node following the given one or nullptr if this
+	 * is the last one.  Iterating over all nodes this way takes
+	 * O(n).
+	 */
+	[[gnu::pure]]
+	static Hook *Next(const Hook &hook) noexcept;
+
+	/**
+	 * Insert a node so it gets the given index.
+	 */
+	void Insert(std::size_t i, Hook &hook) noexcept;
+
+	void PushBack(Hook &hook) noexcept {
+		Insert(size(), hook);
+	}
+
+	void Erase(Hook &hook) noexcept;
+
+	/**
+	 * Move the node at index #from so it gets index #to.
+	 */
+	void Move(std::size_t from, std::size_t to) noexcept;
+
+	/**
+	 * Move the range [start, end) so it begins at index #to
+	 * (after the move).
+	 */
+	void MoveRange(std::size_t start, std::size_t end,
+		       std::size_t to) noexcept;
+
+	/**
+	 * Replace the nodes beginning at index #start with the given
+	 * ones (usually the same nodes in a different order).  The
+	 * old nodes are unlinked, but not touched.
+	 */
+	void Replace(std::size_t start, std::span<Hook *const> hooks) noexcept;
+
+	/**
+	 * Unlink all nodes (without touching them) and link the given
+	 * ones instead.
+	 */
+	void Assign(std::span<Hook *const> hooks) noexcept {
+		SetRoot(Build(hooks));
+	}
+
+	/**
+	 * Raise the stamp of all nodes in the range [start, end) to
+	 * at least the given value.
+	 */
+	void RaiseStamp(std::size_t start, std::size_t end,
+			uint_least32_t value) noexcept;
+
+	/**
+	 * Returns the stamp of the given (linked) node.
+	 */
+	[[gnu::pure]]
+	static uint_least32_t GetStamp(const Hook &hook) noexcept;
+
+	/**
+	 * Raise the stamp of the given (linked) node to at least the
+	 * given value.
+	 */
+	static void RaiseStamp(Hook &hook, uint_least32_t value) noexcept {
+		if (value > hook.stamp)
+			hook.stamp = value;
+	}
+
+	/**
+	 * Reset the stamps of all nodes to zero.
+	 */
+	void ClearStamps() noexcept {
+		ClearStamps(root);
+	}
+
+private:
+	static constexpr std::size_t Size(const Hook *hook) noexcept {
+		return hook != nullptr ? hook->size : 0;
+	}
+
+	uint_least32_t NextWeight() noexcept {
+		auto x = random_state;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		return random_state = x;
+	}
+
+	void InitHook(Hook &hook) noexcept {
+		hook.parent = hook.left = hook.right = nullptr;
+		hook.size = 1;
+		hook.weight = NextWeight();
+		hook.pending_stamp = 0;
+	}
+
+	static void Update(Hook &hook) noexcept;
+
+	/**
+	 * Apply #Hook::pending_stamp to this node and pass it on to
+	 * its children.
+	 */
+	static void PushStamp(Hook &hook) noexcept;
+
+	/**
+	 * Push all pending stamps in this subtree down to the
+	 * nodes.
+	 */
+	static void PushAllStamps(Hook *hook) noexcept;
+
+	static void ClearStamps(Hook *hook) noexcept;
+
+	template<typename D>
+	static void Dispose(Hook *hook, D &disposer) noexcept {
+		if (hook == nullptr)
+			return;
+
+		Dispose(hook->left, disposer);
+		Dispose(hook->right, disposer);
+		disposer(*hook);
+	}
+
+	struct SplitResult {
+		Hook *first, *second;
+	};
+
+	/**
+	 * Split the given tree into the first #n nodes and the rest.
+	 */
+	static SplitResult Split(Hook *tree, std::size_t n) noexcept;
+
+	static Hook *Merge(Hook *a, Hook *b) noexcept;
+
+	/**
+	 * Build a new tree from the given (unlinked) nodes in O(n).
+	 */
+	Hook *Build(std::span<Hook *const> hooks) noexcept;
+
+	void SetRoot(Hook *hook) noexcept {
+		root = hook;
+		if (root != nullptr)
+			root->parent = nullptr;
+	}
+};
@@ -11,6 +11,8 @@
 #include "AddedSinceSongFilter.hxx"
 #include "AudioFormatSongFilter.hxx"
 #include "PrioritySongFilter.hxx"
+#include "StickerSongFilter.hxx"
+#include "sticker/Column.hxx"
 #include "pcm/AudioParser.hxx"
 #include "tag/ParseName.hxx"
 #include "tag/Type.hxx"
@@ -316,15 +318,100 @@ ParseStringFilter(const char *&s, bool fold_case)
 	};
 }
 
+static constexpr bool
+IsStickerNameChar(char ch) noexcept
+{
+	return IsAlphaNumericASCII(ch) || ch == '_' || ch == '-' || ch == '.';
+}
+
+static StickerSongFilter::Operator
+ExpectStickerOperator(const char *&s)
+{
+	using Operator = StickerSongFilter::Operator;
+
+	Operator op;
+	if (s[0] == '=' && s[1] == '=') {
+		op = Operator::EQUALS;
+		s += 2;
+	} else if (s[0] == '!' && s[1] == '=') {
+		op = Operator::NOT_EQUALS;
+		s += 2;
+	} else if (s[0] == '<' && s[1] == '=') {
+		op = Operator::LESS_EQUALS;
+		s += 2;
+	} else if (s[0] == '>' && s[1] == '=') {
+		op = Operator::GREATER_EQUALS;
+		s += 2;
+	} else if (s[0] == '<') {
+		op = Operator::LESS;
+		++s;
+	} else if (s[0] == '>') {
+		op = Operator::GREATER;
+		++s;
+	} else
+		throw FmtRuntimeError("Unknown sticker operator: {}", s);
+
+	s = StripLeft(s);
+	return op;
+}
+
+/**
+ * Parse the rest of a "(sticker:NAME OP VALUE)" expression (after
+ * "sticker:").
+ *
+ * Throws on error.
+ */
+static ISongFilterPtr
+ParseStickerExpression(const char *&s, StickerColumnProvider *stickers)
+{
+	if (stickers == nullptr)
+		throw std::runtime_error("No sticker database");
+
+	const char *name_end = s;
+	while (IsStickerNameChar(*name_end))
+		++name_end;
+
+	if (name_end == s)
+		throw std::runtime_error("Sticker name expected");
+
+	const std::string_view name{s, name_end};
+	s = StripLeft(name_end);
+
+	const auto op = ExpectStickerOperator(s);
+	auto column = stickers->GetSongStickerColumn(std::string{name});
+
+	ISongFilterPtr result;
+	if (IsQuote(*s)) {
+		result = std::make_unique<StickerSongFilter>(name, std::move(column), op,
+							     ExpectQuoted(s));
+	} else {
+		char *endptr;
+		const auto value = strtoll(s, &endptr, 10);
+		if (endptr == s)
+			throw std::runtime_error("Number or quoted string expected");
+
+		s = StripLeft(endptr);
+		result = std::make_unique<StickerSongFilter>(name, std::move(column), op,
+							     int64_t(value));
+	}
+
+	if (*s != ')')
+		throw std::runtime_error("')' expected");
+	s = StripLeft(s + 1);
+
+	return result;
+}
+
 ISongFilterPtr
-SongFilter::ParseExpression(const char *&s, bool fold_case)
+SongFilter::ParseExpression(const char *&s, bool fold_case,
+			    StickerColumnProvider *stickers)
 {
 	assert(*s == '(');
 
 	s = StripLeft(s + 1);
 
 	if (*s == '(') {
-		auto first = ParseExpression(s, fold_case);
+		auto first = ParseExpression(s, fold_case, stickers);
 		if (*s == ')') {
 			s = StripLeft(s + 1);
 			return first;
@@ -337,7 +424,7 @@ SongFilter::ParseExpression(const char *&s, bool fold_case)
 		and_filter->AddItem(std::move(first));
 
 		while (true) {
-			and_filter->AddItem(ParseExpression(s, fold_case));
+			and_filter->AddItem(ParseExpression(s, fold_case, stickers));
 
 			if (*s == ')') {
 				s = StripLeft(s + 1);
@@ -355,7 +442,7 @@ SongFilter::ParseExpression(const char *&s, bool fold_case)
 		if (*s != '(')
 			throw std::runtime_error("'(' expected");
 
-		auto inner = ParseExpression(s, fold_case);
+		auto inner = ParseExpression(s, fold_case, stickers);
 		if (*s != ')')
 			throw std::runtime_error("')' expected");
 		s = StripLeft(s + 1);
@@ -363,6 +450,11 @@ SongFilter::ParseExpression(const char *&s, bool fold_case)
 		return std::make_unique<NotSongFilter>(std::move(inner));
 	}
 
+	if (const char *after_sticker = StringAfterPrefix(s, "sticker:")) {
+		s = after_sticker;
+		return ParseStickerExpression(s, stickers);
+	}
+
 	auto type = ExpectFilterType(s);
 
 	if (type == LOCATE_TAG_MODIFIED_SINCE) {
@@ -497,7 +589,8 @@ SongFilter::Parse(const char *tag_string, const char *value, bool fold_case)
 }
 
 void
-SongFilter::Parse(std::span<const char *const> args, bool fold_case)
+SongFilter::Parse(std::span<const char *const> args, bool fold_case,
+		  StickerColumnProvider *stickers)
 {
 	if (args.empty())
 		throw std::runtime_error("Incorrect number of filter arguments");
@@ -507,7 +600,7 @@ SongFilter::Parse(std::span<const char *const> args, bool fold_case)
 			const char *s = args.front();
 			args = args.subspan(1);
 			const char *end = s;
-			auto f = ParseExpression(end, fold_case);
+			auto f = ParseExpression(end, fold_case, stickers);
 			if (*end != 0)
 				throw std::runtime_error("Unparsed garbage after expression");
 
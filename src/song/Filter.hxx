@@ -28,6 +28,7 @@
 
 enum TagType : uint8_t;
 struct LightSong;
+class StickerColumnProvider;
 
 class SongFilter {
 	AndSongFilter and_filter;
@@ -49,15 +50,21 @@ public:
 	std::string ToExpression() const noexcept;
 
 private:
-	static ISongFilterPtr ParseExpression(const char *&s, bool fold_case=false);
+	static ISongFilterPtr ParseExpression(const char *&s, bool fold_case,
+					      StickerColumnProvider *stickers);
 
 	void Parse(const char *tag, const char *value, bool fold_case=false);
 
 public:
 	/**
 	 * Throws on error.
+	 *
+	 * @param stickers an object which provides sticker values
+	 * for "(sticker:NAME OP VALUE)" expressions; if nullptr, then
+	 * such expressions are rejected
 	 */
-	void Parse(std::span<const char *const> args, bool fold_case=false);
+	void Parse(std::span<const char *const> args, bool fold_case=false,
+		   StickerColumnProvider *stickers=nullptr);
 
 	void Optimize() noexcept;
 
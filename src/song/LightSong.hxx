@@ -11,6 +11,7 @@
 #include <chrono>
 
 struct Tag;
+class SongPrintCache;
 
 /**
  * A reference to a song file.  Unlike the other "Song" classes in the
@@ -40,6 +41,14 @@ struct LightSong {
 	 */
 	const char *real_uri = nullptr;
 
+	/**
+	 * The name of the album art file in the song's directory
+	 * according to the database's album art index, or an empty
+	 * string if there is none.  If this attribute is nullptr,
+	 * then this is unknown.
+	 */
+	const char *album_art = nullptr;
+
 	/**
 	 * Metadata.
 	 */
@@ -74,6 +83,13 @@ struct LightSong {
 	 */
 	AudioFormat audio_format = AudioFormat::Undefined();
 
+	/**
+	 * If this is not nullptr, then song_print_info() may use (and
+	 * fill) this cache.  Only set by the database while its lock
+	 * is held.
+	 */
+	SongPrintCache *print_cache = nullptr;
+
 	/**
 	 * Copy of Queue::Item::priority.
 	 */
@@ -90,10 +106,12 @@ struct LightSong {
 	LightSong(const LightSong &src, const Tag &_tag) noexcept
 		:directory(src.directory), uri(src.uri),
 		 real_uri(src.real_uri),
+		 album_art(src.album_art),
 		 tag(_tag),
 		 mtime(src.mtime),
 		 start_time(src.start_time), end_time(src.end_time),
-		 audio_format(src.audio_format) {}
+		 audio_format(src.audio_format),
+		 print_cache(src.print_cache) {}
 
 	[[gnu::pure]]
 	std::string GetURI() const noexcept {
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "tag/Mask.hxx"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * A cache for the pre-rendered output of song_print_info() for one
+ * song.  Since the output depends on the client's "tagtypes"
+ * setting, a few variants are kept, and the oldest one is replaced
+ * when another one is needed.
+ *
+ * This object does no locking; the owner is responsible for
+ * serializing access and for calling Clear() when the song gets
+ * modified.
+ */
+class SongPrintCache {
+	static constexpr std::size_t MAX_VARIANTS = 3;
+
+	struct Variant {
+		TagMask tag_mask;
+
+		bool base;
+
+		/**
+		 * The pre-rendered response text.  An empty string
+		 * means this variant is unused.
+		 */
+		std::string text;
+	};
+
+	struct Variants {
+		std::array<Variant, MAX_VARIANTS> items;
+
+		/**
+		 * The index of the item to be replaced next.
+		 */
+		std::size_t next = 0;
+	};
+
+	/**
+	 * Allocated on demand, so an unused cache costs only one
+	 * pointer.
+	 */
+	std::unique_ptr<Variants> variants;
+
+public:
+	/**
+	 * @return the cached text or an empty string if there is no
+	 * matching variant
+	 */
+	[[gnu::pure]]
+	std::string_view Get(TagMask tag_mask, bool base) const noexcept {
+		if (variants)
+			for (const auto &i : variants->items)
+				if (!i.text.empty() &&
+				    i.tag_mask == tag_mask && i.base == base)
+					return i.text;
+
+		return {};
+	}
+
+	void Put(TagMask tag_mask, bool base, std::string &&text) noexcept {
+		if (!variants)
+			variants = std::make_unique<Variants>();
+
+		auto &i = variants->items[variants->next];
+		variants->next = (variants->next + 1) % MAX_VARIANTS;
+
+		i.tag_mask = tag_mask;
+		i.base = base;
+		i.text = std::move(text);
+	}
+
+	void Clear() noexcept {
+		variants.reset();
+	}
+};
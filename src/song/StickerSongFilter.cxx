@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "StickerSongFilter.hxx"
+#include "Escape.hxx"
+#include "LightSong.hxx"
+#include "sticker/Column.hxx"
+
+#include <fmt/format.h>
+
+#include <stdlib.h>
+
+static constexpr const char *
+ToString(StickerSongFilter::Operator op) noexcept
+{
+	using Operator = StickerSongFilter::Operator;
+
+	switch (op) {
+	case Operator::EQUALS:
+		return "==";
+
+	case Operator::NOT_EQUALS:
+		return "!=";
+
+	case Operator::LESS:
+		return "<";
+
+	case Operator::LESS_EQUALS:
+		return "<=";
+
+	case Operator::GREATER:
+		return ">";
+
+	case Operator::GREATER_EQUALS:
+		return ">=";
+	}
+
+	return "";
+}
+
+template<typename T>
+static constexpr bool
+Compare(StickerSongFilter::Operator op, const T &a, const T &b) noexcept
+{
+	using Operator = StickerSongFilter::Operator;
+
+	switch (op) {
+	case Operator::EQUALS:
+		return a == b;
+
+	case Operator::NOT_EQUALS:
+		return a != b;
+
+	case Operator::LESS:
+		return a < b;
+
+	case Operator::LESS_EQUALS:
+		return a <= b;
+
+	case Operator::GREATER:
+		return a > b;
+
+	case Operator::GREATER_EQUALS:
+		return a >= b;
+	}
+
+	return false;
+}
+
+std::string
+StickerSongFilter::ToExpression() const noexcept
+{
+	if (integer)
+		return fmt::format("(sticker:{} {} {})",
+				   name, ToString(op), int_value);
+
+	return fmt::format("(sticker:{} {} \"{}\")",
+			   name, ToString(op), EscapeFilterString(value));
+}
+
+bool
+StickerSongFilter::Match(const LightSong &song) const noexcept
+{
+	const auto *v = column->Find(song.directory, song.uri);
+	if (v == nullptr)
+		return false;
+
+	if (integer)
+		return Compare<int64_t>(op, strtoll(v->c_str(), nullptr, 10),
+					int_value);
+
+	return Compare<std::string_view>(op, *v, value);
+}
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "ISongFilter.hxx"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+class StickerColumn;
+
+/**
+ * Compares the value of a song sticker, e.g. "(sticker:rating >= 4)".
+ * The values are looked up in a #StickerColumn, i.e. matching does
+ * not query the sticker database.  Songs which don't have the
+ * sticker never match.
+ */
+class StickerSongFilter final : public ISongFilter {
+public:
+	enum class Operator : uint_least8_t {
+		EQUALS,
+		NOT_EQUALS,
+		LESS,
+		LESS_EQUALS,
+		GREATER,
+		GREATER_EQUALS,
+	};
+
+private:
+	std::string name;
+
+	std::shared_ptr<const StickerColumn> column;
+
+	Operator op;
+
+	/**
+	 * If true, then the value is compared as an integer (like
+	 * "CAST(value AS INT)" in SQL); else as a string.
+	 */
+	bool integer;
+
+	int64_t int_value;
+
+	std::string value;
+
+public:
+	/**
+	 * Compare the sticker value with an integer.
+	 */
+	StickerSongFilter(std::string_view _name,
+			  std::shared_ptr<const StickerColumn> _column,
+			  Operator _op, int64_t _value) noexcept
+		:name(_name), column(std::move(_column)), op(_op),
+		 integer(true), int_value(_value) {}
+
+	/**
+	 * Compare the sticker value with a string.
+	 */
+	StickerSongFilter(std::string_view _name,
+			  std::shared_ptr<const StickerColumn> _column,
+			  Operator _op, std::string &&_value) noexcept
+		:name(_name), column(std::move(_column)), op(_op),
+		 integer(false), int_value(0), value(std::move(_value)) {}
+
+	/* virtual methods from ISongFilter */
+	ISongFilterPtr Clone() const noexcept override {
+		return std::make_unique<StickerSongFilter>(*this);
+	}
+
+	std::string ToExpression() const noexcept override;
+	bool Match(const LightSong &song) const noexcept override;
+};
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Column.hxx"
+#include "util/StringStrip.hxx"
+
+#include <fmt/format.h>
+
+#include <cstdint>
+#include <variant>
+
+#include <stdlib.h>
+
+using Number = std::variant<int64_t, double>;
+
+/**
+ * Convert a string to a number the way SQLite does in arithmetic
+ * expressions: a numeric prefix is used, and everything else
+ * evaluates to 0.
+ */
+[[gnu::pure]]
+static Number
+ParseNumber(std::string_view s) noexcept
+{
+	/* null-terminate the string for strtoll() and strtod() */
+	const std::string buffer{StripLeft(s)};
+	const char *p = buffer.c_str();
+
+	char *int_end;
+	const long long i = strtoll(p, &int_end, 10);
+
+	char *double_end;
+	const double d = strtod(p, &double_end);
+
+	if (double_end > int_end)
+		return d;
+
+	return int64_t(i);
+}
+
+[[gnu::pure]]
+static double
+ToDouble(Number n) noexcept
+{
+	return std::visit([](auto value){ return double(value); }, n);
+}
+
+[[gnu::pure]]
+static std::string
+FormatNumber(Number n) noexcept
+{
+	if (const auto *i = std::get_if<int64_t>(&n))
+		return fmt::format("{}", *i);
+
+	/* like SQLite, always include a decimal point in the text
+	   representation of a REAL value */
+	auto s = fmt::format("{:.15g}", std::get<double>(n));
+	if (s.find_first_of(".eIn") == s.npos)
+		s += ".0";
+	return s;
+}
+
+[[gnu::pure]]
+static Number
+AddNumbers(Number a, Number b, bool negative) noexcept
+{
+	if (const auto *ai = std::get_if<int64_t>(&a)) {
+		if (const auto *bi = std::get_if<int64_t>(&b)) {
+			int64_t result;
+			if (!(negative
+			      ? __builtin_sub_overflow(*ai, *bi, &result)
+			      : __builtin_add_overflow(*ai, *bi, &result)))
+				return result;
+		}
+	}
+
+	return negative
+		? ToDouble(a) - ToDouble(b)
+		: ToDouble(a) + ToDouble(b);
+}
+
+void
+StickerColumn::Add(std::string_view uri, std::string_view operand,
+		   bool negative)
+{
+	auto i = values.find(uri);
+	if (i == values.end()) {
+		/* the INSERT in STICKER_SQL_INC/STICKER_SQL_DEC
+		   stores the operand as-is */
+		Set(uri, operand);
+		return;
+	}
+
+	i->second = FormatNumber(AddNumbers(ParseNumber(i->second),
+					    ParseNumber(operand),
+					    negative));
+}
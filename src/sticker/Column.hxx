@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "util/djb_hash.hxx"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * An in-memory copy of the values of one sticker name of all songs,
+ * indexed by song URI.  It allows evaluating sticker conditions in a
+ * #SongFilter without querying SQLite for each song.
+ *
+ * Instances are owned by #StickerDatabase, which keeps them up to
+ * date.
+ */
+class StickerColumn {
+	/**
+	 * A song URI split into the directory and the name relative
+	 * to it (like #LightSong), which can be looked up without
+	 * concatenating the two.
+	 */
+	struct SplitURI {
+		std::string_view directory, name;
+
+		[[gnu::pure]]
+		bool operator==(std::string_view uri) const noexcept {
+			return uri.size() == directory.size() + 1 + name.size() &&
+				uri.starts_with(directory) &&
+				uri[directory.size()] == '/' &&
+				uri.ends_with(name);
+		}
+	};
+
+	struct Hash {
+		using is_transparent = void;
+
+		[[gnu::pure]]
+		std::size_t operator()(std::string_view s) const noexcept {
+			return djb_hash(std::as_bytes(std::span{s}));
+		}
+
+		[[gnu::pure]]
+		std::size_t operator()(SplitURI s) const noexcept {
+			std::size_t hash = djb_hash(std::as_bytes(std::span{s.directory}));
+			hash = djb_hash_update(hash, std::byte{'/'});
+			return djb_hash(std::as_bytes(std::span{s.name}), hash);
+		}
+	};
+
+	struct Equal {
+		using is_transparent = void;
+
+		[[gnu::pure]]
+		bool operator()(std::string_view a, std::string_view b) const noexcept {
+			return a == b;
+		}
+
+		[[gnu::pure]]
+		bool operator()(SplitURI a, std::string_view b) const noexcept {
+			return a == b;
+		}
+
+		[[gnu::pure]]
+		bool operator()(std::string_view a, SplitURI b) const noexcept {
+			return b == a;
+		}
+	};
+
+	std::unordered_map<std::string, std::string, Hash, Equal> values;
+
+public:
+	[[gnu::pure]]
+	std::size_t size() const noexcept {
+		return values.size();
+	}
+
+	/**
+	 * @return the value or nullptr if the song has no such
+	 * sticker
+	 */
+	[[gnu::pure]]
+	const std::string *Find(std::string_view uri) const noexcept {
+		auto i = values.find(uri);
+		return i != values.end()
+			? &i->second
+			: nullptr;
+	}
+
+	/**
+	 * Look up a song by its directory (nullptr for none) and its
+	 * URI relative to that, like #LightSong.  This is faster than
+	 * calling LightSong::GetURI(), which allocates a string.
+	 *
+	 * @return the value or nullptr if the song has no such
+	 * sticker
+	 */
+	[[gnu::pure]]
+	const std::string *Find(const char *directory,
+				std::string_view uri) const noexcept {
+		if (directory == nullptr)
+			return Find(uri);
+
+		auto i = values.find(SplitURI{directory, uri});
+		return i != values.end()
+			? &i->second
+			: nullptr;
+	}
+
+	void Clear() noexcept {
+		values.clear();
+	}
+
+	void Set(std::string_view uri, std::string_view value) {
+		values.insert_or_assign(std::string{uri}, std::string{value});
+	}
+
+	/**
+	 * Add (or subtract, if #negative is true) a number to the
+	 * value, emulating SQLite's "value + ?" arithmetic on text
+	 * values.  A missing value is initialized with the operand.
+	 */
+	void Add(std::string_view uri, std::string_view operand,
+		 bool negative);
+
+	void Erase(std::string_view uri) noexcept {
+		if (auto i = values.find(uri); i != values.end())
+			values.erase(i);
+	}
+};
+
+/**
+ * Interface which allows SongFilter::Parse() to obtain a
+ * #StickerColumn.
+ */
+class StickerColumnProvider {
+protected:
+	~StickerColumnProvider() noexcept = default;
+
+public:
+	/**
+	 * Returns the #StickerColumn for the given sticker name
+	 * (of type "song"), loading it if it is not yet in memory.
+	 * The provider keeps the column up to date for as long as
+	 * the caller holds the pointer; it may discard columns which
+	 * are not referenced by anybody else.
+	 *
+	 * Throws on error.
+	 */
+	virtual std::shared_ptr<const StickerColumn> GetSongStickerColumn(const std::string &name) = 0;
+};
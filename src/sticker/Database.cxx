@@ -3,10 +3,12 @@
 
 #include "Database.hxx"
 #include "Sticker.hxx"
+#include "WriteQueue.hxx"
 #include "lib/sqlite/Util.hxx"
 #include "fs/Path.hxx"
 #include "fs/NarrowPath.hxx"
 #include "Idle.hxx"
+#include "util/CharUtil.hxx"
 #include "util/StringCompare.hxx"
 #include "util/ScopeExit.hxx"
 
@@ -20,22 +22,6 @@
 
 using namespace Sqlite;
 
-enum sticker_sql_find {
-	STICKER_SQL_FIND,
-	STICKER_SQL_FIND_VALUE,
-	STICKER_SQL_FIND_LT,
-	STICKER_SQL_FIND_GT,
-
-	STICKER_SQL_FIND_EQ_INT,
-	STICKER_SQL_FIND_LT_INT,
-	STICKER_SQL_FIND_GT_INT,
-
-	STICKER_SQL_FIND_CONTAINS,
-	STICKER_SQL_FIND_STARTS_WITH,
-
-	STICKER_SQL_FIND_COUNT
-};
-
 enum sticker_sql {
 	STICKER_SQL_GET,
 	STICKER_SQL_LIST,
@@ -51,39 +37,14 @@ enum sticker_sql {
 	STICKER_SQL_NAMES_TYPES_BY_TYPE,
 	STICKER_SQL_INC,
 	STICKER_SQL_DEC,
+	STICKER_SQL_FIND_NAME,
+	STICKER_SQL_SAVEPOINT,
+	STICKER_SQL_RELEASE,
+	STICKER_SQL_ROLLBACK_TO,
 
 	STICKER_SQL_COUNT
 };
 
-static constexpr auto sticker_sql_find = std::array {
-	//[STICKER_SQL_FIND] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=?",
-
-	//[STICKER_SQL_FIND_VALUE] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value=?",
-
-	//[STICKER_SQL_FIND_LT] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value<?",
-
-	//[STICKER_SQL_FIND_GT] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value>?",
-
-	//[STICKER_SQL_FIND_EQ_INT] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND CAST(value AS INT)=?",
-
-	//[STICKER_SQL_FIND_LT_INT] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND CAST(value AS INT)<?",
-
-	//[STICKER_SQL_FIND_GT_INT] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND CAST(value AS INT)>?",
-
-	//[STICKER_SQL_FIND_CONTAINS] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value LIKE ('%' || ? || '%')",
-
-	//[STICKER_SQL_FIND_STARTS_WITH] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value LIKE (? || '%')",
-};
-
 static constexpr auto sticker_sql = std::array {
 	//[STICKER_SQL_GET] =
 	"SELECT value FROM sticker WHERE type=? AND uri=? AND name=?",
@@ -128,6 +89,18 @@ static constexpr auto sticker_sql = std::array {
 	"INSERT INTO sticker (type, uri, name, value) VALUES (?, ?, ?, ?) "
 	"ON CONFLICT(type, uri, name) DO "
 	"UPDATE set value = value - ?",
+
+	//[STICKER_SQL_FIND_NAME] =
+	"SELECT uri,value FROM sticker WHERE type=? AND name=?",
+
+	//[STICKER_SQL_SAVEPOINT] =
+	"SAVEPOINT store",
+
+	//[STICKER_SQL_RELEASE] =
+	"RELEASE store",
+
+	//[STICKER_SQL_ROLLBACK_TO] =
+	"ROLLBACK TO store",
 };
 
 static constexpr const char sticker_sql_create[] =
@@ -139,14 +112,44 @@ static constexpr const char sticker_sql_create[] =
 	");"
 	"CREATE UNIQUE INDEX IF NOT EXISTS"
 	" sticker_value ON sticker(type, uri, name);"
+	/* for "sticker find" with a name, with or without a base
+	   URI; the base URI is matched case-insensitively (like the
+	   "LIKE" operator which was used before) */
+	"DROP INDEX IF EXISTS sticker_name;"
+	"CREATE INDEX IF NOT EXISTS"
+	" sticker_name_nocase ON sticker(type, name, uri COLLATE NOCASE);"
 	"";
 
+/**
+ * Let readers and the writer (see #StickerWriteQueue) access the
+ * database concurrently, and don't sync the file system on every
+ * commit (only at checkpoints; in WAL mode, this is still safe
+ * against database corruption).
+ */
+static constexpr const char sticker_sql_pragmas[] =
+	"PRAGMA journal_mode=WAL;"
+	"PRAGMA synchronous=NORMAL;";
+
+/**
+ * How long shall a connection wait for a lock held by another
+ * connection before failing with SQLITE_BUSY?
+ */
+static constexpr int sticker_busy_timeout_ms = 5000;
+
 StickerDatabase::StickerDatabase(const char *_path)
 	:path(_path),
 	 db(path.c_str())
 {
 	int ret;
 
+	sqlite3_busy_timeout(db, sticker_busy_timeout_ms);
+
+	ret = sqlite3_exec(db, sticker_sql_pragmas,
+			   nullptr, nullptr, nullptr);
+	if (ret != SQLITE_OK)
+		throw SqliteError(db, ret,
+				  "Failed to configure sticker database");
+
 	/* create the table and index */
 
 	ret = sqlite3_exec(db, sticker_sql_create,
@@ -167,8 +170,17 @@ StickerDatabase::StickerDatabase(const char *_path)
 StickerDatabase::StickerDatabase(Path _path)
 	:StickerDatabase(NarrowPath{_path}) {}
 
+StickerDatabase::StickerDatabase(StickerDatabase &&) noexcept = default;
+
+StickerDatabase &
+StickerDatabase::operator=(StickerDatabase &&) noexcept = default;
+
 StickerDatabase::~StickerDatabase() noexcept
 {
+	/* commit pending modifications before closing the
+	   database */
+	write_queue.reset();
+
 	if (db == nullptr)
 		return;
 
@@ -179,6 +191,31 @@ StickerDatabase::~StickerDatabase() noexcept
 	}
 }
 
+void
+StickerDatabase::EnableWriteQueue()
+{
+	assert(!write_queue);
+
+	write_queue = std::make_unique<StickerWriteQueue>(*this);
+}
+
+void
+StickerDatabase::ApplyCommitted()
+{
+	for (const auto &m : write_queue->TakeCommitted())
+		UpdateSongStickerColumn(m);
+}
+
+void
+StickerDatabase::FlushWriteQueue()
+{
+	if (!write_queue)
+		return;
+
+	write_queue->Flush();
+	ApplyCommitted();
+}
+
 std::string
 StickerDatabase::LoadValue(const char *type, const char *uri, const char *name)
 {
@@ -191,6 +228,8 @@ StickerDatabase::LoadValue(const char *type, const char *uri, const char *name)
 	if (StringIsEmpty(name))
 		return {};
 
+	FlushWriteQueue();
+
 	BindAll(s, type, uri, name);
 
 	AtScopeExit(s) {
@@ -214,6 +253,8 @@ StickerDatabase::ListValues(std::map<std::string, std::string, std::less<>> &tab
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
+	FlushWriteQueue();
+
 	BindAll(s, type, uri);
 
 	AtScopeExit(s) {
@@ -228,18 +269,11 @@ StickerDatabase::ListValues(std::map<std::string, std::string, std::less<>> &tab
 	});
 }
 
-void
-StickerDatabase::StoreValue(const char *type, const char *uri,
-			    const char *name, const char *value)
+inline void
+StickerDatabase::ExecuteStore(sqlite3_stmt *s, const char *type,
+			      const char *uri,
+			      const char *name, const char *value)
 {
-	assert(type != nullptr);
-	assert(uri != nullptr);
-	assert(name != nullptr);
-	assert(*name != 0);
-	assert(value != nullptr);
-
-	sqlite3_stmt *const s = stmt[STICKER_SQL_SET];
-
 	BindAll(s, type, uri, name, value, value);
 
 	AtScopeExit(s) {
@@ -248,55 +282,85 @@ StickerDatabase::StoreValue(const char *type, const char *uri,
 	};
 
 	ExecuteCommand(s);
-	idle_add(IDLE_STICKER);
 }
 
-void
-StickerDatabase::IncValue(const char *type, const char *uri,
-			  const char *name, const char *value)
+static constexpr unsigned
+ToStatement(StickerDatabase::Modification::Operation operation) noexcept
 {
-	sqlite3_stmt *const s = stmt[STICKER_SQL_INC];
+	using Operation = StickerDatabase::Modification::Operation;
 
-	assert(type != nullptr);
-	assert(uri != nullptr);
-	assert(name != nullptr);
-	assert(*name != 0);
-	assert(value != nullptr);
+	switch (operation) {
+	case Operation::SET:
+		return STICKER_SQL_SET;
 
-	BindAll(s, type, uri, name, value, value);
+	case Operation::INC:
+		return STICKER_SQL_INC;
 
-	AtScopeExit(s) {
-		sqlite3_reset(s);
-		sqlite3_clear_bindings(s);
-	};
+	case Operation::DEC:
+		return STICKER_SQL_DEC;
+	}
 
-	ExecuteCommand(s);
-	idle_add(IDLE_STICKER);
+	std::unreachable();
 }
 
 void
-StickerDatabase::DecValue(const char *type, const char *uri,
-			  const char *name, const char *value)
+StickerDatabase::Store(Modification::Operation operation,
+		       const char *type, const char *uri,
+		       const char *name, const char *value)
 {
-	sqlite3_stmt *const s = stmt[STICKER_SQL_DEC];
-
 	assert(type != nullptr);
 	assert(uri != nullptr);
 	assert(name != nullptr);
 	assert(*name != 0);
 	assert(value != nullptr);
 
-	BindAll(s, type, uri, name, value, value);
-
-	AtScopeExit(s) {
-		sqlite3_reset(s);
-		sqlite3_clear_bindings(s);
-	};
+	Modification m{operation, type, uri, name, value};
+
+	if (write_queue && !write_queue->HasFailed()) {
+		/* the #StickerColumn is updated by ApplyCommitted()
+		   after the modification has been committed; do it
+		   here for earlier ones, so they don't pile up */
+		ApplyCommitted();
+		write_queue->Push(std::move(m));
+	} else {
+		/* after the write queue has failed, modifications
+		   are executed synchronously, so the client sees the
+		   error */
+		FlushWriteQueue();
+
+		ExecuteStore(stmt[ToStatement(operation)],
+			     type, uri, name, value);
+		UpdateSongStickerColumn(m);
+
+		if (write_queue)
+			/* the database works again */
+			write_queue->ClearFailed();
+	}
 
-	ExecuteCommand(s);
 	idle_add(IDLE_STICKER);
 }
 
+void
+StickerDatabase::StoreValue(const char *type, const char *uri,
+			    const char *name, const char *value)
+{
+	Store(Modification::Operation::SET, type, uri, name, value);
+}
+
+void
+StickerDatabase::IncValue(const char *type, const char *uri,
+			  const char *name, const char *value)
+{
+	Store(Modification::Operation::INC, type, uri, name, value);
+}
+
+void
+StickerDatabase::DecValue(const char *type, const char *uri,
+			  const char *name, const char *value)
+{
+	Store(Modification::Operation::DEC, type, uri, name, value);
+}
+
 bool
 StickerDatabase::Delete(const char *type, const char *uri)
 {
@@ -305,6 +369,8 @@ StickerDatabase::Delete(const char *type, const char *uri)
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
+	FlushWriteQueue();
+
 	BindAll(s, type, uri);
 
 	AtScopeExit(s) {
@@ -313,8 +379,14 @@ StickerDatabase::Delete(const char *type, const char *uri)
 	};
 
 	bool modified = ExecuteModified(s);
-	if (modified)
+	if (modified) {
+		if (StringIsEqual(type, "song"))
+			for (auto &[name, c] : song_columns)
+				c.column->Erase(uri);
+
 		idle_add(IDLE_STICKER);
+	}
+
 	return modified;
 }
 
@@ -328,6 +400,8 @@ StickerDatabase::DeleteValue(const char *type, const char *uri,
 	assert(uri != nullptr);
 	assert(name != nullptr);
 
+	FlushWriteQueue();
+
 	BindAll(s, type, uri, name);
 
 	AtScopeExit(s) {
@@ -336,8 +410,15 @@ StickerDatabase::DeleteValue(const char *type, const char *uri,
 	};
 
 	bool modified = ExecuteModified(s);
-	if (modified)
+	if (modified) {
+		if (StringIsEqual(type, "song"))
+			if (auto i = song_columns.find(name);
+			    i != song_columns.end())
+				i->second.column->Erase(uri);
+
 		idle_add(IDLE_STICKER);
+	}
+
 	return modified;
 }
 
@@ -351,6 +432,77 @@ StickerDatabase::Load(const char *type, const char *uri)
 	return s;
 }
 
+/**
+ * Returns the SQL condition for the sticker value (with one
+ * parameter, except for #StickerOperator::EXISTS).
+ */
+static constexpr const char *
+FindValueCondition(StickerOperator op) noexcept
+{
+	switch (op) {
+	case StickerOperator::EXISTS:
+		return "";
+
+	case StickerOperator::EQUALS:
+		return " AND value=?";
+
+	case StickerOperator::LESS_THAN:
+		return " AND value<?";
+
+	case StickerOperator::GREATER_THAN:
+		return " AND value>?";
+
+	case StickerOperator::EQUALS_INT:
+		return " AND CAST(value AS INT)=?";
+
+	case StickerOperator::LESS_THAN_INT:
+		return " AND CAST(value AS INT)<?";
+
+	case StickerOperator::GREATER_THAN_INT:
+		return " AND CAST(value AS INT)>?";
+
+	case StickerOperator::CONTAINS:
+		return " AND value LIKE ('%' || ? || '%')";
+
+	case StickerOperator::STARTS_WITH:
+		return " AND value LIKE (? || '%')";
+	}
+
+	std::unreachable();
+}
+
+/**
+ * Calculate the smallest string which is greater than all strings
+ * starting with the given prefix in SQLite's "NOCASE" collation
+ * (i.e. memcmp() after folding ASCII upper case letters to lower
+ * case).  Returns an empty string if there is no such string (the
+ * prefix consists only of 0xff bytes).
+ */
+static std::string
+PrefixUpperBound(std::string_view prefix) noexcept
+{
+	std::string result{prefix};
+	for (auto &ch : result)
+		ch = ToLowerASCII(ch);
+
+	while (!result.empty()) {
+		auto &last = reinterpret_cast<unsigned char &>(result.back());
+		if (last < 0xff) {
+			++last;
+
+			/* no folded character is an upper case
+			   letter, so the next one after '@' is '[' */
+			if (IsUpperAlphaASCII(last))
+				last = '[';
+			break;
+		}
+
+		result.pop_back();
+	}
+
+	return result;
+}
+
 sqlite3_stmt *
 StickerDatabase::BindFind(const char *type, const char *base_uri,
 			  const char *name,
@@ -360,8 +512,20 @@ StickerDatabase::BindFind(const char *type, const char *base_uri,
 	assert(type != nullptr);
 	assert(name != nullptr);
 
-	if (base_uri == nullptr)
-		base_uri = "";
+	/* instead of "uri LIKE (? || '%')", which cannot use an
+	   index, look up the URI prefix as a range; "NOCASE" keeps
+	   LIKE's case-insensitivity for ASCII letters and matches the
+	   collation of the "sticker_name_nocase" index */
+	const bool has_base = !StringIsEmpty(base_uri);
+	const auto base_end = has_base
+		? PrefixUpperBound(base_uri)
+		: std::string{};
+
+	const char *const uri_condition = !has_base
+		? ""
+		: base_end.empty()
+		? " AND uri>=? COLLATE NOCASE"
+		: " AND uri>=? COLLATE NOCASE AND uri<? COLLATE NOCASE";
 
 	auto order_by = StringIsEmpty(sort)
 		? std::string()
@@ -375,75 +539,42 @@ StickerDatabase::BindFind(const char *type, const char *base_uri,
 			? fmt::format("LIMIT -1 OFFSET {}", window.start)
 			: fmt::format("LIMIT {} OFFSET {}", window.Count(), window.start);
 
-	std::string sql_str;
-	sqlite3_stmt *sql;
-
-	switch (op) {
-	case StickerOperator::EXISTS:
-		sql_str = fmt::format("{} {} {}",
-			sticker_sql_find[STICKER_SQL_FIND], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
-		BindAll(sql, type, base_uri, name);
-		return sql;
-
-	case StickerOperator::EQUALS:
-		sql_str = fmt::format("{} {} {}",
-			sticker_sql_find[STICKER_SQL_FIND_VALUE], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
-		BindAll(sql, type, base_uri, name, value);
-		return sql;
-
-	case StickerOperator::LESS_THAN:
-		sql_str = fmt::format("{} {} {}",
-			sticker_sql_find[STICKER_SQL_FIND_LT], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
-		BindAll(sql, type, base_uri, name, value);
-		return sql;
-
-	case StickerOperator::GREATER_THAN:
-		sql_str = fmt::format("{} {} {}",
-			sticker_sql_find[STICKER_SQL_FIND_GT], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
-		BindAll(sql, type, base_uri, name, value);
-		return sql;
+	const auto sql_str =
+		fmt::format("SELECT uri,value FROM sticker WHERE type=? AND name=?{}{} {} {}",
+			    uri_condition, FindValueCondition(op),
+			    order_by, offset);
 
-	case StickerOperator::EQUALS_INT:
-		sql_str = fmt::format("{} {} {}",
-			sticker_sql_find[STICKER_SQL_FIND_EQ_INT], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
-		BindAll(sql, type, base_uri, name, value);
-		return sql;
+	sqlite3_stmt *const sql = Prepare(db, sql_str.c_str());
 
-	case StickerOperator::LESS_THAN_INT:
-		sql_str = fmt::format("{} {} {}",
-			sticker_sql_find[STICKER_SQL_FIND_LT_INT], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
-		BindAll(sql, type, base_uri, name, value);
-		return sql;
-
-	case StickerOperator::GREATER_THAN_INT:
-		sql_str = fmt::format("{} {} {}",
-			sticker_sql_find[STICKER_SQL_FIND_GT_INT], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
-		BindAll(sql, type, base_uri, name, value);
-		return sql;
-
-	case StickerOperator::CONTAINS:
-		sql_str = fmt::format("{} {} {}",
-			sticker_sql_find[STICKER_SQL_FIND_CONTAINS], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
-		BindAll(sql, type, base_uri, name, value);
-		return sql;
+	try {
+		unsigned i = 1;
+		Bind(sql, i++, type);
+		Bind(sql, i++, name);
+
+		if (has_base) {
+			Bind(sql, i++, base_uri);
+			if (!base_end.empty()) {
+				/* SQLITE_TRANSIENT because base_end
+				   goes out of scope before the
+				   statement is executed */
+				int result = sqlite3_bind_text(sql, i++,
+							       base_end.data(),
+							       base_end.size(),
+							       SQLITE_TRANSIENT);
+				if (result != SQLITE_OK)
+					throw SqliteError(sql, result,
+							  "sqlite3_bind_text() failed");
+			}
+		}
 
-	case StickerOperator::STARTS_WITH:
-		sql_str = fmt::format("{} {} {}",
-			sticker_sql_find[STICKER_SQL_FIND_STARTS_WITH], order_by, offset);
-		sql = Prepare(db, sql_str.c_str());
-		BindAll(sql, type, base_uri, name, value);
-		return sql;
+		if (op != StickerOperator::EXISTS)
+			Bind(sql, i++, value);
+	} catch (...) {
+		sqlite3_finalize(sql);
+		throw;
 	}
 
-	std::unreachable();
+	return sql;
 }
 
 void
@@ -456,6 +587,8 @@ StickerDatabase::Find(const char *type, const char *base_uri, const char *name,
 {
 	assert(func != nullptr);
 
+	FlushWriteQueue();
+
 	sqlite3_stmt *const s = BindFind(type, base_uri, name, op, value, sort, descending, window);
 	assert(s != nullptr);
 
@@ -473,6 +606,8 @@ StickerDatabase::Find(const char *type, const char *base_uri, const char *name,
 std::list<StickerDatabase::StickerTypeUriPair>
 StickerDatabase::GetUniqueStickers()
 {
+	FlushWriteQueue();
+
 	auto result = std::list<StickerTypeUriPair>{};
 	sqlite3_stmt *const s = stmt[STICKER_SQL_DISTINCT_TYPE_URI];
 	assert(s != nullptr);
@@ -491,6 +626,8 @@ StickerDatabase::Names(void (*func)(const char *value, void *user_data), void *u
 {
 	assert(func != nullptr);
 
+	FlushWriteQueue();
+
 	sqlite3_stmt *const s = stmt[STICKER_SQL_NAMES];
 	assert(s != nullptr);
 
@@ -508,6 +645,8 @@ StickerDatabase::NamesTypes(const char *type, void (*func)(const char *value, co
 {
 	assert(func != nullptr);
 
+	FlushWriteQueue();
+
 	sqlite3_stmt *const s = type == nullptr
 		? stmt[STICKER_SQL_NAMES_TYPES]
 		: stmt[STICKER_SQL_NAMES_TYPES_BY_TYPE];
@@ -557,3 +696,162 @@ StickerDatabase::BatchDeleteNoIdle(const std::list<StickerTypeUriPair> &stickers
 		std::throw_with_nested(std::runtime_error{"failed to batch-delete stickers"});
 	}
 }
+
+/**
+ * Execute a statement without parameters and reset it.
+ *
+ * Throws #SqliteError on error.
+ */
+static void
+ExecuteReset(sqlite3_stmt *s)
+{
+	AtScopeExit(s) {
+		sqlite3_reset(s);
+	};
+
+	ExecuteCommand(s);
+}
+
+std::vector<std::exception_ptr>
+StickerDatabase::BatchStoreNoIdle(const std::vector<Modification> &modifications)
+{
+	sqlite3_stmt *const begin = stmt[STICKER_SQL_TRANSACTION_BEGIN];
+	sqlite3_stmt *const rollback = stmt[STICKER_SQL_TRANSACTION_ROLLBACK];
+	sqlite3_stmt *const commit = stmt[STICKER_SQL_TRANSACTION_COMMIT];
+	sqlite3_stmt *const savepoint = stmt[STICKER_SQL_SAVEPOINT];
+	sqlite3_stmt *const release = stmt[STICKER_SQL_RELEASE];
+	sqlite3_stmt *const rollback_to = stmt[STICKER_SQL_ROLLBACK_TO];
+
+	std::vector<std::exception_ptr> errors;
+	errors.reserve(modifications.size());
+
+	try {
+		ExecuteReset(begin);
+
+		for (const auto &m : modifications) {
+			ExecuteReset(savepoint);
+
+			try {
+				ExecuteStore(stmt[ToStatement(m.operation)],
+					     m.type.c_str(), m.uri.c_str(),
+					     m.name.c_str(), m.value.c_str());
+				errors.emplace_back();
+			} catch (...) {
+				if (sqlite3_get_autocommit(db))
+					/* some errors (e.g. SQLITE_FULL)
+					   roll back the whole
+					   transaction */
+					throw;
+
+				errors.emplace_back(std::current_exception());
+				ExecuteReset(rollback_to);
+			}
+
+			ExecuteReset(release);
+		}
+
+		ExecuteReset(commit);
+	} catch (...) {
+		// see BatchDeleteNoIdle()
+		ExecuteBusy(rollback);
+		sqlite3_reset(rollback);
+		std::throw_with_nested(std::runtime_error{"failed to batch-store stickers"});
+	}
+
+	return errors;
+}
+
+void
+StickerDatabase::LoadSongStickerColumn(StickerColumn &column, const char *name)
+{
+	sqlite3_stmt *const s = stmt[STICKER_SQL_FIND_NAME];
+
+	BindAll(s, "song", name);
+
+	AtScopeExit(s) {
+		sqlite3_reset(s);
+		sqlite3_clear_bindings(s);
+	};
+
+	column.Clear();
+
+	ExecuteForEach(s, [s, &column](){
+		column.Set((const char *)sqlite3_column_text(s, 0),
+			   (const char *)sqlite3_column_text(s, 1));
+	});
+}
+
+void
+StickerDatabase::EvictSongStickerColumns() noexcept
+{
+	while (song_columns.size() >= MAX_SONG_COLUMNS) {
+		auto oldest = song_columns.end();
+		for (auto i = song_columns.begin(); i != song_columns.end(); ++i)
+			if (i->second.column.use_count() == 1 &&
+			    (oldest == song_columns.end() ||
+			     i->second.last_used < oldest->second.last_used))
+				oldest = i;
+
+		if (oldest == song_columns.end())
+			/* all columns are in use */
+			break;
+
+		song_columns.erase(oldest);
+	}
+}
+
+std::shared_ptr<const StickerColumn>
+StickerDatabase::GetSongStickerColumn(const std::string &name)
+{
+	/* this applies committed modifications to the cached
+	   columns */
+	FlushWriteQueue();
+
+	if (auto i = song_columns.find(name); i != song_columns.end()) {
+		i->second.last_used = ++column_clock;
+		return i->second.column;
+	}
+
+	auto column = std::make_shared<StickerColumn>();
+	LoadSongStickerColumn(*column, name.c_str());
+
+	EvictSongStickerColumns();
+	song_columns.emplace(name, CachedColumn{column, ++column_clock});
+	return column;
+}
+
+void
+StickerDatabase::ReloadSongStickerColumns()
+{
+	FlushWriteQueue();
+
+	/* reload in place, because SongFilter instances may refer
+	   to the columns */
+	for (auto &[name, c] : song_columns)
+		LoadSongStickerColumn(*c.column, name.c_str());
+}
+
+void
+StickerDatabase::UpdateSongStickerColumn(const Modification &m)
+{
+	if (m.type != "song")
+		return;
+
+	auto i = song_columns.find(m.name);
+	if (i == song_columns.end())
+		return;
+
+	auto &column = *i->second.column;
+
+	switch (m.operation) {
+	case Modification::Operation::SET:
+		column.Set(m.uri, m.value);
+		break;
+
+	case Modification::Operation::INC:
+	case Modification::Operation::DEC:
+		column.Add(m.uri, m.value,
+			   m.operation == Modification::Operation::DEC);
+		break;
+	}
+}
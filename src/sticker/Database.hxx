@@ -27,19 +27,25 @@
 #define MPD_STICKER_DATABASE_HXX
 
 #include "Match.hxx"
+#include "Column.hxx"
 #include "lib/sqlite/Database.hxx"
 #include "protocol/RangeArg.hxx"
 
 #include <sqlite3.h>
 
+#include <cstdint>
+#include <exception>
 #include <map>
+#include <memory>
 #include <string>
 #include <list>
+#include <vector>
 
 class Path;
 struct Sticker;
+class StickerWriteQueue;
 
-class StickerDatabase {
+class StickerDatabase final : public StickerColumnProvider {
 	enum SQL {
 		  SQL_GET,
 		  SQL_LIST,
@@ -55,6 +61,10 @@ class StickerDatabase {
 		  SQL_NAMES_TYPES_BY_TYPE,
 		  STICKER_SQL_INC,
 		  STICKER_SQL_DEC,
+		  SQL_FIND_NAME,
+		  SQL_SAVEPOINT,
+		  SQL_RELEASE,
+		  SQL_ROLLBACK_TO,
 
 		  SQL_COUNT
 	};
@@ -80,6 +90,40 @@ class StickerDatabase {
 	Sqlite::Database db;
 	sqlite3_stmt *stmt[SQL_COUNT];
 
+	/**
+	 * If set, then StoreValue(), IncValue() and DecValue() are
+	 * committed asynchronously by this object.  See
+	 * EnableWriteQueue().
+	 */
+	std::unique_ptr<StickerWriteQueue> write_queue;
+
+	/**
+	 * Keep at most this number of #StickerColumn instances;
+	 * beyond that, the least recently used ones which are not
+	 * referenced by a #SongFilter are discarded.
+	 */
+	static constexpr std::size_t MAX_SONG_COLUMNS = 8;
+
+	struct CachedColumn {
+		std::shared_ptr<StickerColumn> column;
+
+		/**
+		 * The value of #column_clock when this column was
+		 * last requested.
+		 */
+		uint_least64_t last_used;
+	};
+
+	/**
+	 * In-memory copies of sticker values (of type "song") which
+	 * have been requested by GetSongStickerColumn().  They are
+	 * updated by all modifications on this connection after they
+	 * have been committed.
+	 */
+	std::map<std::string, CachedColumn, std::less<>> song_columns;
+
+	uint_least64_t column_clock = 0;
+
 	explicit StickerDatabase(const char *_path);
 
 public:
@@ -91,8 +135,8 @@ public:
 	StickerDatabase(Path path);
 	~StickerDatabase() noexcept;
 
-	StickerDatabase(StickerDatabase &&) noexcept = default;
-	StickerDatabase &operator=(StickerDatabase &&) noexcept = default;
+	StickerDatabase(StickerDatabase &&) noexcept;
+	StickerDatabase &operator=(StickerDatabase &&) noexcept;
 
 	/**
 	 * Open another connection to the same database file.
@@ -102,6 +146,15 @@ public:
 		return StickerDatabase{path.c_str()};
 	}
 
+	/**
+	 * Commit modifications in a background thread, batching many
+	 * of them in one transaction.  All methods which read from
+	 * this connection wait for pending modifications first.
+	 *
+	 * Throws on error.
+	 */
+	void EnableWriteQueue();
+
 	/**
 	 * Returns one value from an object's sticker record.  Returns an
 	 * empty string if the value doesn't exist.
@@ -206,7 +259,93 @@ public:
 	 */
 	void BatchDeleteNoIdle(const std::list<StickerTypeUriPair> &stickers);
 
+	/**
+	 * A modification submitted to the #StickerWriteQueue.
+	 */
+	struct Modification {
+		enum class Operation : uint_least8_t {
+			SET,
+			INC,
+			DEC,
+		};
+
+		Operation operation;
+
+		std::string type, uri, name, value;
+	};
+
+	/**
+	 * Apply modifications in one transaction.  Each modification
+	 * is wrapped in a SAVEPOINT, so one which fails is rolled
+	 * back without discarding the others.
+	 *
+	 * Throws if the transaction as a whole fails; in that case,
+	 * nothing has been applied.
+	 *
+	 * @return one element for each modification: nullptr if it
+	 * has been applied, or the error which made it fail
+	 */
+	std::vector<std::exception_ptr> BatchStoreNoIdle(const std::vector<Modification> &modifications);
+
+	/**
+	 * Reload all #StickerColumn instances from the database.
+	 * This needs to be called after stickers have been modified
+	 * by another connection (e.g. #StickerCleanupService).
+	 *
+	 * Throws on error.
+	 */
+	void ReloadSongStickerColumns();
+
+	/* virtual methods from class StickerColumnProvider */
+	std::shared_ptr<const StickerColumn> GetSongStickerColumn(const std::string &name) override;
+
 private:
+	/**
+	 * Load a #StickerColumn from the database.  The caller is
+	 * responsible for calling FlushWriteQueue() first.
+	 */
+	void LoadSongStickerColumn(StickerColumn &column, const char *name);
+
+	/**
+	 * Discard the least recently used columns which are not
+	 * referenced by anybody else, to make room for a new one.
+	 */
+	void EvictSongStickerColumns() noexcept;
+
+	/**
+	 * Apply a modification to the #StickerColumn (if one exists
+	 * for this sticker name).
+	 */
+	void UpdateSongStickerColumn(const Modification &m);
+
+	/**
+	 * Wait for all modifications submitted to the
+	 * #StickerWriteQueue to be committed, and apply them to the
+	 * #StickerColumn instances.
+	 */
+	void FlushWriteQueue();
+
+	/**
+	 * Apply the modifications which have been committed by the
+	 * #StickerWriteQueue to the #StickerColumn instances.
+	 */
+	void ApplyCommitted();
+
+	/**
+	 * Execute one of #STICKER_SQL_SET, #STICKER_SQL_INC,
+	 * #STICKER_SQL_DEC.
+	 */
+	void ExecuteStore(sqlite3_stmt *s, const char *type, const char *uri,
+			  const char *name, const char *value);
+
+	/**
+	 * Submit a modification to the #StickerWriteQueue or, if there
+	 * is none, execute it right now.
+	 */
+	void Store(Modification::Operation operation,
+		   const char *type, const char *uri,
+		   const char *name, const char *value);
+
 	void ListValues(std::map<std::string, std::string, std::less<>> &table,
 			const char *type, const char *uri);
 
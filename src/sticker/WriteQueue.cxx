@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "WriteQueue.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "thread/Name.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+static constexpr Domain sticker_domain{"sticker"};
+
+StickerWriteQueue::StickerWriteQueue(const StickerDatabase &_db)
+	:db(_db.Reopen())
+{
+}
+
+StickerWriteQueue::~StickerWriteQueue() noexcept
+{
+	if (!thread.IsDefined())
+		return;
+
+	{
+		const std::scoped_lock lock{mutex};
+		quit = true;
+		cond.notify_one();
+	}
+
+	thread.Join();
+}
+
+void
+StickerWriteQueue::Push(StickerDatabase::Modification &&m)
+{
+	if (!thread.IsDefined())
+		thread.Start();
+
+	const std::scoped_lock lock{mutex};
+	const bool was_empty = pending.empty();
+	pending.emplace_back(std::move(m));
+	if (was_empty)
+		cond.notify_one();
+}
+
+void
+StickerWriteQueue::Flush() noexcept
+{
+	std::unique_lock lock{mutex};
+	if (pending.empty() && !busy)
+		return;
+
+	flush = true;
+	cond.notify_one();
+	done_cond.wait(lock, [this]{ return pending.empty() && !busy; });
+}
+
+void
+StickerWriteQueue::Run() noexcept
+{
+	SetThreadName("sticker_write");
+
+	std::vector<StickerDatabase::Modification> batch;
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		cond.wait(lock, [this]{ return quit || !pending.empty(); });
+
+		if (pending.empty())
+			/* quit */
+			break;
+
+		/* collect more modifications for this
+		   transaction */
+		cond.wait_for(lock, COMMIT_DELAY,
+			      [this]{ return quit || flush; });
+
+		batch.swap(pending);
+		flush = false;
+		busy = true;
+		lock.unlock();
+
+		bool batch_failed = false;
+		std::vector<std::exception_ptr> errors;
+
+		try {
+			errors = db.BatchStoreNoIdle(batch);
+
+			for (std::size_t i = 0; i < batch.size(); ++i) {
+				if (!errors[i])
+					continue;
+
+				const auto &m = batch[i];
+				FmtError(sticker_domain,
+					 "failed to store sticker {:?} of {} {:?}: {}",
+					 m.name, m.type, m.uri, errors[i]);
+				batch_failed = true;
+			}
+
+			FmtDebug(sticker_domain, "committed {} modifications",
+				 batch.size());
+		} catch (...) {
+			FmtError(sticker_domain,
+				 "failed to commit {} modifications: {}",
+				 batch.size(), std::current_exception());
+			batch_failed = true;
+		}
+
+		lock.lock();
+
+		if (!errors.empty()) {
+			/* the transaction has been committed; pass the
+			   successful modifications to the main thread */
+			for (std::size_t i = 0; i < batch.size(); ++i)
+				if (!errors[i] && batch[i].type == "song")
+					committed.emplace_back(std::move(batch[i]));
+		}
+
+		batch.clear();
+
+		if (batch_failed)
+			failed = true;
+		busy = false;
+		done_cond.notify_all();
+	}
+}
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Database.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+/**
+ * Collects sticker modifications and writes them to the database in
+ * a background thread, many of them in one transaction.  This keeps
+ * SQLite's disk synchronization off the main thread, and it
+ * amortizes it over all modifications which arrive within
+ * #COMMIT_DELAY.
+ *
+ * The client which submitted a modification has already received
+ * its response, so errors can only be logged.  After an error,
+ * HasFailed() tells #StickerDatabase to execute further
+ * modifications synchronously, which reports errors to the client,
+ * until one of them succeeds.
+ */
+class StickerWriteQueue {
+	/**
+	 * Wait this long for more modifications before committing
+	 * the transaction.
+	 */
+	static constexpr std::chrono::milliseconds COMMIT_DELAY{100};
+
+	/**
+	 * A separate connection used only by the thread.
+	 */
+	StickerDatabase db;
+
+	Thread thread{BIND_THIS_METHOD(Run)};
+
+	mutable Mutex mutex;
+
+	/**
+	 * Wakes up the thread.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled by the thread after each transaction.
+	 */
+	Cond done_cond;
+
+	/**
+	 * Modifications which have not yet been picked up by the
+	 * thread.  Protected by #mutex.
+	 */
+	std::vector<StickerDatabase::Modification> pending;
+
+	/**
+	 * Modifications of "song" stickers which have been committed
+	 * successfully, to be applied to the #StickerColumn
+	 * instances by TakeCommitted().  Protected by #mutex.
+	 */
+	std::vector<StickerDatabase::Modification> committed;
+
+	/**
+	 * Is the thread currently committing a batch?  Protected by
+	 * #mutex.
+	 */
+	bool busy = false;
+
+	/**
+	 * Has somebody asked to commit #pending right now (instead of
+	 * waiting for #COMMIT_DELAY)?  Protected by #mutex.
+	 */
+	bool flush = false;
+
+	/**
+	 * Shall the thread exit (after committing #pending)?
+	 * Protected by #mutex.
+	 */
+	bool quit = false;
+
+	/**
+	 * Has a modification failed?  See HasFailed().  Protected by
+	 * #mutex.
+	 */
+	bool failed = false;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	explicit StickerWriteQueue(const StickerDatabase &_db);
+
+	/**
+	 * Commits all pending modifications and stops the thread.
+	 */
+	~StickerWriteQueue() noexcept;
+
+	StickerWriteQueue(const StickerWriteQueue &) = delete;
+	StickerWriteQueue &operator=(const StickerWriteQueue &) = delete;
+
+	/**
+	 * Submit a modification; the thread is started if it is not
+	 * already running.
+	 */
+	void Push(StickerDatabase::Modification &&m);
+
+	/**
+	 * Wait until all submitted modifications have been committed
+	 * (or have failed).  This is called before reading from
+	 * another connection, which would otherwise not see them.
+	 */
+	void Flush() noexcept;
+
+	/**
+	 * Returns (and clears) the list of modifications of "song"
+	 * stickers which have been committed, in the order they were
+	 * submitted.  Modifications which have failed are never
+	 * returned.
+	 */
+	std::vector<StickerDatabase::Modification> TakeCommitted() noexcept {
+		const std::scoped_lock lock{mutex};
+		return std::exchange(committed, {});
+	}
+
+	/**
+	 * Has a modification failed since the last ClearFailed()
+	 * call?  If yes, then the caller should stop submitting
+	 * modifications and execute them synchronously, until the
+	 * database works again.
+	 */
+	bool HasFailed() const noexcept {
+		const std::scoped_lock lock{mutex};
+		return failed;
+	}
+
+	/**
+	 * A synchronous modification has succeeded after
+	 * HasFailed(); resume submitting modifications.
+	 */
+	void ClearFailed() noexcept {
+		const std::scoped_lock lock{mutex};
+		failed = false;
+	}
+
+private:
+	void Run() noexcept;
+};
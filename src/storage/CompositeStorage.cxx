@@ -282,6 +282,16 @@ CompositeStorage::OpenDirectory(std::string_view uri)
 							  directory->children);
 }
 
+void
+CompositeStorage::PrefetchDirectory(std::string_view uri) noexcept
+{
+	const std::scoped_lock protect{mutex};
+
+	auto f = FindStorage(uri);
+	if (f.directory->storage != nullptr)
+		f.directory->storage->PrefetchDirectory(f.uri);
+}
+
 std::string
 CompositeStorage::MapUTF8(std::string_view uri) const noexcept
 {
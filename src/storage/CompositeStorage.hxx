@@ -121,6 +121,8 @@ public:
 
 	std::unique_ptr<StorageDirectoryReader> OpenDirectory(std::string_view uri) override;
 
+	void PrefetchDirectory(std::string_view uri) noexcept override;
+
 	std::string MapUTF8(std::string_view uri) const noexcept override;
 
 	AllocatedPath MapFS(std::string_view uri) const noexcept override;
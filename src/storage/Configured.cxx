@@ -4,6 +4,7 @@
 #include "Configured.hxx"
 #include "Registry.hxx"
 #include "StorageInterface.hxx"
+#include "InstrumentedStorage.hxx"
 #include "plugins/LocalStorage.hxx"
 #include "config/Data.hxx"
 #include "fs/AllocatedPath.hxx"
@@ -41,7 +42,8 @@ CreateConfiguredStorageLocal(const ConfigData &config)
 
 	path.ChopSeparators();
 	CheckDirectoryReadable(path);
-	return CreateLocalStorage(path);
+	return InstrumentStorage(CreateLocalStorage(path),
+				 path.ToUTF8().c_str());
 }
 
 std::unique_ptr<Storage>
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "InstrumentedStorage.hxx"
+#include "StorageInterface.hxx"
+#include "FileInfo.hxx"
+#include "input/InputStream.hxx"
+#include "input/InstrumentedInputStream.hxx"
+#include "iostats/Registry.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "util/UriUtil.hxx"
+
+#include <string>
+
+class InstrumentedStorage final : public Storage {
+	const std::unique_ptr<Storage> storage;
+
+	const std::string source;
+
+	IOStatsCounter &get_info_counter, &open_directory_counter,
+		&open_file_counter;
+
+public:
+	InstrumentedStorage(std::unique_ptr<Storage> &&_storage,
+			    std::string &&_source)
+		:storage(std::move(_storage)), source(std::move(_source)),
+		 get_info_counter(GetIOStatsCounter(source, "get_info")),
+		 open_directory_counter(GetIOStatsCounter(source, "open_directory")),
+		 open_file_counter(GetIOStatsCounter(source, "open_file")) {}
+
+	/* virtual methods from class Storage */
+	StorageFileInfo GetInfo(std::string_view uri_utf8, bool follow) override {
+		IOStatsTimer timer{get_info_counter};
+		auto info = storage->GetInfo(uri_utf8, follow);
+		timer.Commit();
+		return info;
+	}
+
+	std::unique_ptr<StorageDirectoryReader> OpenDirectory(std::string_view uri_utf8) override {
+		IOStatsTimer timer{open_directory_counter};
+		auto reader = storage->OpenDirectory(uri_utf8);
+		timer.Commit();
+		return reader;
+	}
+
+	void PrefetchDirectory(std::string_view uri_utf8) noexcept override {
+		storage->PrefetchDirectory(uri_utf8);
+	}
+
+	std::string MapUTF8(std::string_view uri_utf8) const noexcept override {
+		return storage->MapUTF8(uri_utf8);
+	}
+
+	AllocatedPath MapFS(std::string_view uri_utf8) const noexcept override {
+		return storage->MapFS(uri_utf8);
+	}
+
+	std::string_view MapToRelativeUTF8(std::string_view uri_utf8) const noexcept override {
+		return storage->MapToRelativeUTF8(uri_utf8);
+	}
+
+	InputStreamPtr OpenFile(std::string_view uri_utf8, Mutex &mutex) override {
+		IOStatsTimer timer{open_file_counter};
+		auto is = storage->OpenFile(uri_utf8, mutex);
+		timer.Commit();
+		return InstrumentInputStream(std::move(is), source);
+	}
+};
+
+std::unique_ptr<Storage>
+InstrumentStorage(std::unique_ptr<Storage> storage, const char *uri)
+{
+	std::string source{"storage:"};
+	if (auto safe_uri = uri_remove_auth(uri); !safe_uri.empty())
+		source += safe_uri;
+	else
+		source += uri;
+
+	return std::make_unique<InstrumentedStorage>(std::move(storage),
+						     std::move(source));
+}
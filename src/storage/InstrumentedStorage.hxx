@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+class Storage;
+
+/**
+ * Wrap a #Storage in a proxy which records the number of GetInfo(),
+ * OpenDirectory() and OpenFile() calls and their latency in the
+ * global I/O statistics (see iostats/Registry.hxx).  Streams opened
+ * with OpenFile() are instrumented as well.
+ *
+ * @param uri the storage URI (or local path); credentials are
+ * removed before it is used as statistics source name
+ */
+std::unique_ptr<Storage>
+InstrumentStorage(std::unique_ptr<Storage> storage, const char *uri);
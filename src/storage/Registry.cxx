@@ -4,6 +4,7 @@
 #include "Registry.hxx"
 #include "StoragePlugin.hxx"
 #include "StorageInterface.hxx"
+#include "InstrumentedStorage.hxx"
 #include "plugins/LocalStorage.hxx"
 #include "plugins/UdisksStorage.hxx"
 #include "plugins/SmbclientStorage.hxx"
@@ -65,7 +66,7 @@ CreateStorageURI(EventLoop &event_loop, const char *uri)
 
 		auto storage = plugin.create_uri(event_loop, uri);
 		if (storage != nullptr)
-			return storage;
+			return InstrumentStorage(std::move(storage), uri);
 	}
 
 	return nullptr;
@@ -47,6 +47,13 @@ public:
 	[[nodiscard]]
 	virtual std::unique_ptr<StorageDirectoryReader> OpenDirectory(std::string_view uri_utf8) = 0;
 
+	/**
+	 * A hint that OpenDirectory() will soon be called for the
+	 * given directory.  Storages with a high latency may start
+	 * listing it in the background.
+	 */
+	virtual void PrefetchDirectory([[maybe_unused]] std::string_view uri_utf8) noexcept {}
+
 	/**
 	 * Map the given relative URI to an absolute URI.
 	 */
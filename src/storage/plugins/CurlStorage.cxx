@@ -20,6 +20,7 @@
 #include "lib/expat/ExpatParser.hxx"
 #include "lib/fmt/ToBuffer.hxx"
 #include "fs/Traits.hxx"
+#include "event/Call.hxx"
 #include "event/InjectEvent.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
@@ -30,33 +31,114 @@
 #include "util/StringSplit.hxx"
 #include "util/UriExtract.hxx"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <deque>
+#include <list>
 #include <memory>
 #include <string>
 #include <utility>
 
 using std::string_view_literals::operator""sv;
 
+class HttpListDirectoryOperation;
+
 class CurlStorage final : public Storage {
+	/**
+	 * The maximum number of directory listings which are
+	 * prefetched (running or finished, but not yet consumed).
+	 */
+	static constexpr std::size_t MAX_PREFETCH = 16;
+
+	/**
+	 * A prefetched listing which has not been used after this
+	 * duration is discarded.  The caller has probably skipped
+	 * it (e.g. because the database update was cancelled), and
+	 * it may be outdated by now.
+	 */
+	static constexpr std::chrono::steady_clock::duration PREFETCH_EXPIRY =
+		std::chrono::minutes(1);
+
 	const std::string base;
 
 	CurlInit curl;
 
+	/**
+	 * Protects #prefetching, #prefetch_queue and
+	 * #prefetch_insert.
+	 */
+	Mutex prefetch_mutex;
+
+	/**
+	 * PROPFIND requests which were started in the background,
+	 * because the caller (usually the database update) has
+	 * announced them with PrefetchDirectory().  Oldest first.
+	 */
+	std::list<std::unique_ptr<HttpListDirectoryOperation>> prefetching;
+
+	/**
+	 * Collection URIs which shall be prefetched as soon as there
+	 * is room in #prefetching.  Subdirectories of the most
+	 * recently listed directory are at the front, because a
+	 * depth-first walk visits them first.
+	 */
+	std::deque<std::string> prefetch_queue;
+
+	/**
+	 * The position in #prefetch_queue where PrefetchDirectory()
+	 * inserts the next URI.  OpenDirectory() resets it to the
+	 * front.
+	 */
+	std::size_t prefetch_insert = 0;
+
 public:
 	CurlStorage(EventLoop &_loop, const char *_base)
 		:base(_base),
 		 curl(_loop) {}
 
+	~CurlStorage() noexcept override;
+
 	/* virtual methods from class Storage */
 	StorageFileInfo GetInfo(std::string_view uri_utf8, bool follow) override;
 
 	std::unique_ptr<StorageDirectoryReader> OpenDirectory(std::string_view uri_utf8) override;
 
+	void PrefetchDirectory(std::string_view uri_utf8) noexcept override;
+
 	[[nodiscard]] std::string MapUTF8(std::string_view uri_utf8) const noexcept override;
 
 	[[nodiscard]] std::string_view MapToRelativeUTF8(std::string_view uri_utf8) const noexcept override;
 
 	InputStreamPtr OpenFile(std::string_view uri_utf8, Mutex &mutex) override;
+
+private:
+	/**
+	 * Remove a prefetched (or still running) listing of the
+	 * given collection URI from #prefetching and return it.
+	 * Returns nullptr if there is none.
+	 *
+	 * Caller must lock #prefetch_mutex.
+	 */
+	std::unique_ptr<HttpListDirectoryOperation> TakePrefetched(std::string_view uri) noexcept;
+
+	/**
+	 * Discard finished listings from #prefetching which have
+	 * expired (see #PREFETCH_EXPIRY).
+	 *
+	 * Caller must lock #prefetch_mutex.
+	 */
+	void ExpirePrefetched() noexcept;
+
+	/**
+	 * Start prefetching the queued URIs while there is room in
+	 * #prefetching.  If that fails (i.e. out of memory), the
+	 * queue is discarded, and OpenDirectory() lists the
+	 * remaining directories synchronously.
+	 *
+	 * Caller must lock #prefetch_mutex.
+	 */
+	void StartPrefetch() noexcept;
 };
 
 std::string
@@ -108,6 +190,25 @@ public:
 		defer_start.Schedule();
 	}
 
+	/**
+	 * Has the transfer finished (successfully or not)?
+	 */
+	bool IsDone() noexcept {
+		const std::scoped_lock lock{mutex};
+		return done;
+	}
+
+	/**
+	 * Stop the transfer if it is still running.  This must not be
+	 * called inside the IOThread.
+	 */
+	void Cancel() noexcept {
+		BlockingCall(defer_start.GetEventLoop(), [this]{
+			defer_start.Cancel();
+			request.Stop();
+		});
+	}
+
 	void Wait() {
 		std::unique_lock lock{mutex};
 		cond.wait(lock, [this]{ return done; });
@@ -280,6 +381,8 @@ public:
 	using BlockingHttpRequest::GetEasy;
 	using BlockingHttpRequest::DeferStart;
 	using BlockingHttpRequest::Wait;
+	using BlockingHttpRequest::IsDone;
+	using BlockingHttpRequest::Cancel;
 
 protected:
 	virtual void OnDavResponse(DavResponse &&r) = 0;
@@ -478,24 +581,40 @@ UriPathOrSlash(const char *uri) noexcept
  * Obtain a directory listing using WebDAV PROPFIND.
  */
 class HttpListDirectoryOperation final : public PropfindOperation {
+	/**
+	 * The (escaped) collection URI.
+	 */
+	const std::string uri;
+
 	const std::string base_path;
 
+	const std::chrono::steady_clock::time_point created =
+		std::chrono::steady_clock::now();
+
 	MemoryStorageDirectoryReader::List entries;
 
 public:
-	HttpListDirectoryOperation(CurlGlobal &curl, const char *uri)
-		:PropfindOperation(curl, uri, 1),
-		 base_path(CurlUnescape(GetEasy(), UriPathOrSlash(uri))) {}
+	HttpListDirectoryOperation(CurlGlobal &curl, std::string &&_uri)
+		:PropfindOperation(curl, _uri.c_str(), 1),
+		 uri(std::move(_uri)),
+		 base_path(CurlUnescape(GetEasy(), UriPathOrSlash(uri.c_str()))) {}
 
-	std::unique_ptr<StorageDirectoryReader> Perform() {
-		DeferStart();
-		Wait();
-		return ToReader();
+	const std::string &GetUri() const noexcept {
+		return uri;
 	}
 
-private:
-	std::unique_ptr<StorageDirectoryReader> ToReader() {
-		return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
+	[[gnu::pure]]
+	bool IsOlderThan(std::chrono::steady_clock::time_point t) const noexcept {
+		return created < t;
+	}
+
+	/**
+	 * Wait for the response and return the entries.  The
+	 * transfer must have been started with DeferStart().
+	 */
+	MemoryStorageDirectoryReader::List WaitEntries() {
+		Wait();
+		return std::move(entries);
 	}
 
 	/**
@@ -549,6 +668,83 @@ protected:
 	}
 };
 
+CurlStorage::~CurlStorage() noexcept
+{
+	for (auto &i : prefetching)
+		i->Cancel();
+}
+
+inline std::unique_ptr<HttpListDirectoryOperation>
+CurlStorage::TakePrefetched(std::string_view uri) noexcept
+{
+	auto i = std::find_if(prefetching.begin(), prefetching.end(),
+			      [uri](const auto &op){
+				      return op->GetUri() == uri;
+			      });
+	if (i == prefetching.end())
+		return nullptr;
+
+	auto op = std::move(*i);
+	prefetching.erase(i);
+	return op;
+}
+
+void
+CurlStorage::ExpirePrefetched() noexcept
+{
+	const auto expired = std::chrono::steady_clock::now() - PREFETCH_EXPIRY;
+
+	prefetching.remove_if([expired](const auto &op){
+		return op->IsOlderThan(expired) && op->IsDone();
+	});
+}
+
+void
+CurlStorage::StartPrefetch() noexcept
+try {
+	ExpirePrefetched();
+
+	/* listings which are finished but not yet used are kept,
+	   because the caller has announced that it will open them;
+	   OpenDirectory() continues here after it has taken one */
+	while (!prefetch_queue.empty() && prefetching.size() < MAX_PREFETCH) {
+		/* allocate the list node before starting the
+		   transfer, so it cannot get lost */
+		auto &op = prefetching.emplace_back(std::make_unique<HttpListDirectoryOperation>(*curl,
+												  std::move(prefetch_queue.front())));
+		prefetch_queue.pop_front();
+		if (prefetch_insert > 0)
+			--prefetch_insert;
+
+		op->DeferStart();
+	}
+} catch (...) {
+	prefetch_queue.clear();
+	prefetch_insert = 0;
+}
+
+void
+CurlStorage::PrefetchDirectory(std::string_view uri_utf8) noexcept
+try {
+	std::string uri = MapUTF8(uri_utf8);
+
+	/* collection URIs must end with a slash */
+	if (uri.back() != '/')
+		uri.push_back('/');
+
+	const std::scoped_lock lock{prefetch_mutex};
+
+	/* keep the order in which the caller announces the
+	   directories */
+	prefetch_queue.emplace(prefetch_queue.begin() + prefetch_insert,
+			       std::move(uri));
+	++prefetch_insert;
+
+	StartPrefetch();
+} catch (...) {
+	/* out of memory: don't prefetch this one */
+}
+
 std::unique_ptr<StorageDirectoryReader>
 CurlStorage::OpenDirectory(std::string_view uri_utf8)
 {
@@ -558,7 +754,36 @@ CurlStorage::OpenDirectory(std::string_view uri_utf8)
 	if (uri.back() != '/')
 		uri.push_back('/');
 
-	return HttpListDirectoryOperation(*curl, uri.c_str()).Perform();
+	std::unique_ptr<HttpListDirectoryOperation> op;
+
+	{
+		const std::scoped_lock lock{prefetch_mutex};
+		ExpirePrefetched();
+		op = TakePrefetched(uri);
+
+		/* in a depth-first walk, this directory is usually
+		   the next one in the queue */
+		if (!prefetch_queue.empty() && prefetch_queue.front() == uri)
+			prefetch_queue.pop_front();
+
+		/* the caller is about to announce the subdirectories
+		   of this directory, and it will visit them before
+		   the ones announced earlier */
+		prefetch_insert = 0;
+
+		/* a slot may have become free */
+		StartPrefetch();
+	}
+
+	if (!op) {
+		op = std::make_unique<HttpListDirectoryOperation>(*curl,
+								  std::move(uri));
+		op->DeferStart();
+	}
+
+	auto entries = op->WaitEntries();
+
+	return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
 }
 
 static std::unique_ptr<Storage>
@@ -30,7 +30,12 @@ extern "C" {
 
 #include <fmt/core.h>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <deque>
+#include <list>
+#include <memory>
 #include <string>
 
 #include <sys/stat.h>
@@ -38,9 +43,26 @@ extern "C" {
 
 using std::string_view_literals::operator""sv;
 
+class NfsListDirectoryOperation;
+
 class NfsStorage final
 	: public Storage, NfsLease {
 
+	/**
+	 * The maximum number of directory listings which are
+	 * prefetched (running or finished, but not yet consumed).
+	 */
+	static constexpr std::size_t MAX_PREFETCH = 16;
+
+	/**
+	 * A prefetched listing which has not been used after this
+	 * duration is discarded.  The caller has probably skipped
+	 * it (e.g. because the database update was cancelled), and
+	 * it may be outdated by now.
+	 */
+	static constexpr std::chrono::steady_clock::duration PREFETCH_EXPIRY =
+		std::chrono::minutes(1);
+
 	enum class State {
 		INITIAL, CONNECTING, READY, DELAY,
 	};
@@ -66,6 +88,34 @@ class NfsStorage final
 	State state = State::CONNECTING;
 	std::exception_ptr last_exception;
 
+	/**
+	 * Protects #prefetching, #prefetch_queue and
+	 * #prefetch_insert.
+	 */
+	Mutex prefetch_mutex;
+
+	/**
+	 * Directory listings which were started in the background,
+	 * because the caller (usually the database update) has
+	 * announced them with PrefetchDirectory().  Oldest first.
+	 */
+	std::list<std::unique_ptr<NfsListDirectoryOperation>> prefetching;
+
+	/**
+	 * NFS paths which shall be prefetched as soon as there is
+	 * room in #prefetching.  Subdirectories of the most recently
+	 * listed directory are at the front, because a depth-first
+	 * walk visits them first.
+	 */
+	std::deque<std::string> prefetch_queue;
+
+	/**
+	 * The position in #prefetch_queue where PrefetchDirectory()
+	 * inserts the next path.  OpenDirectory() resets it to the
+	 * front.
+	 */
+	std::size_t prefetch_insert = 0;
+
 public:
 	NfsStorage(const char *_url, NfsConnection &_connection)
 		:url(_url),
@@ -79,10 +129,7 @@ public:
 		});
 	}
 
-	~NfsStorage() override {
-		BlockingCall(GetEventLoop(), [this](){ Disconnect(); });
-		nfs_finish();
-	}
+	~NfsStorage() override;
 
 	NfsStorage(const NfsStorage &) = delete;
 	NfsStorage &operator=(const NfsStorage &) = delete;
@@ -92,6 +139,8 @@ public:
 
 	std::unique_ptr<StorageDirectoryReader> OpenDirectory(std::string_view uri_utf8) override;
 
+	void PrefetchDirectory(std::string_view uri_utf8) noexcept override;
+
 	[[nodiscard]] std::string MapUTF8(std::string_view uri_utf8) const noexcept override;
 
 	[[nodiscard]] std::string_view MapToRelativeUTF8(std::string_view uri_utf8) const noexcept override;
@@ -137,6 +186,33 @@ private:
 		return defer_connect.GetEventLoop();
 	}
 
+	/**
+	 * Remove a prefetched (or still running) listing of the
+	 * given NFS path from #prefetching and return it.  Returns
+	 * nullptr if there is none.
+	 *
+	 * Caller must lock #prefetch_mutex.
+	 */
+	std::unique_ptr<NfsListDirectoryOperation> TakePrefetched(std::string_view path) noexcept;
+
+	/**
+	 * Discard finished listings from #prefetching which have
+	 * expired (see #PREFETCH_EXPIRY).
+	 *
+	 * Caller must lock #prefetch_mutex.
+	 */
+	void ExpirePrefetched() noexcept;
+
+	/**
+	 * Start prefetching the queued paths while there is room in
+	 * #prefetching.  If that fails (i.e. out of memory), the
+	 * queue is discarded, and OpenDirectory() lists the
+	 * remaining directories synchronously.
+	 *
+	 * Caller must lock #prefetch_mutex.
+	 */
+	void StartPrefetch() noexcept;
+
 	void SetState(State _state) noexcept {
 		assert(GetEventLoop().IsInside());
 
@@ -349,22 +425,39 @@ Copy(StorageFileInfo &info, const struct nfsdirent &ent)
 }
 
 class NfsListDirectoryOperation final : public BlockingNfsOperation {
-	const char *const path;
+	const std::string path;
+
+	const std::chrono::steady_clock::time_point created =
+		std::chrono::steady_clock::now();
 
 	MemoryStorageDirectoryReader::List entries;
 
 public:
 	NfsListDirectoryOperation(NfsConnection &_connection,
-				  const char *_path)
-		:BlockingNfsOperation(_connection), path(_path) {}
+				  std::string &&_path)
+		:BlockingNfsOperation(_connection), path(std::move(_path)) {}
+
+	const std::string &GetPath() const noexcept {
+		return path;
+	}
 
-	std::unique_ptr<StorageDirectoryReader> ToReader() {
-		return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
+	[[gnu::pure]]
+	bool IsOlderThan(std::chrono::steady_clock::time_point t) const noexcept {
+		return created < t;
+	}
+
+	/**
+	 * Wait for the listing and return the entries.  The
+	 * operation must have been submitted with Begin().
+	 */
+	MemoryStorageDirectoryReader::List WaitEntries() {
+		Wait();
+		return std::move(entries);
 	}
 
 protected:
 	void Start() override {
-		connection.OpenDirectory(path, *this);
+		connection.OpenDirectory(path.c_str(), *this);
 	}
 
 	void HandleResult([[maybe_unused]] unsigned status,
@@ -407,17 +500,140 @@ NfsListDirectoryOperation::CollectEntries(struct nfsdir *dir)
 	}
 }
 
+NfsStorage::~NfsStorage()
+{
+	for (auto &i : prefetching)
+		i->Cancel();
+
+	BlockingCall(GetEventLoop(), [this](){ Disconnect(); });
+	nfs_finish();
+}
+
+inline std::unique_ptr<NfsListDirectoryOperation>
+NfsStorage::TakePrefetched(std::string_view path) noexcept
+{
+	auto i = std::find_if(prefetching.begin(), prefetching.end(),
+			      [path](const auto &op){
+				      return op->GetPath() == path;
+			      });
+	if (i == prefetching.end())
+		return nullptr;
+
+	auto op = std::move(*i);
+	prefetching.erase(i);
+	return op;
+}
+
+void
+NfsStorage::ExpirePrefetched() noexcept
+{
+	const auto expired = std::chrono::steady_clock::now() - PREFETCH_EXPIRY;
+
+	prefetching.remove_if([expired](const auto &op){
+		return op->IsOlderThan(expired) && op->IsFinished();
+	});
+}
+
+void
+NfsStorage::StartPrefetch() noexcept
+try {
+	ExpirePrefetched();
+
+	/* listings which are finished but not yet used are kept,
+	   because the caller has announced that it will open them;
+	   OpenDirectory() continues here after it has taken one */
+	while (!prefetch_queue.empty() && prefetching.size() < MAX_PREFETCH) {
+
+		/* allocate the list node before submitting the
+		   operation, so it cannot get lost */
+		auto &op = prefetching.emplace_back(std::make_unique<NfsListDirectoryOperation>(*connection,
+											       std::move(prefetch_queue.front())));
+		prefetch_queue.pop_front();
+		if (prefetch_insert > 0)
+			--prefetch_insert;
+
+		op->Begin();
+	}
+} catch (...) {
+	prefetch_queue.clear();
+	prefetch_insert = 0;
+}
+
+void
+NfsStorage::PrefetchDirectory(std::string_view uri_utf8) noexcept
+try {
+	{
+		const std::scoped_lock protect{mutex};
+		if (state != State::CONNECTING && state != State::READY)
+			/* OpenDirectory() will report the error */
+			return;
+	}
+
+	std::string path = UriToNfsPath(uri_utf8);
+
+	const std::scoped_lock lock{prefetch_mutex};
+
+	/* keep the order in which the caller announces the
+	   directories */
+	prefetch_queue.emplace(prefetch_queue.begin() + prefetch_insert,
+			       std::move(path));
+	++prefetch_insert;
+
+	StartPrefetch();
+} catch (...) {
+	/* the name cannot be converted to the file system charset,
+	   or out of memory: don't prefetch this one */
+}
+
 std::unique_ptr<StorageDirectoryReader>
 NfsStorage::OpenDirectory(std::string_view uri_utf8)
 {
-	const std::string path = UriToNfsPath(uri_utf8);
+	std::string path = UriToNfsPath(uri_utf8);
 
 	WaitConnected();
 
-	NfsListDirectoryOperation operation(*connection, path.c_str());
-	operation.Run();
+	std::unique_ptr<NfsListDirectoryOperation> op;
+
+	{
+		const std::scoped_lock lock{prefetch_mutex};
+		ExpirePrefetched();
+		op = TakePrefetched(path);
+
+		/* in a depth-first walk, this directory is usually
+		   the next one in the queue */
+		if (!prefetch_queue.empty() && prefetch_queue.front() == path)
+			prefetch_queue.pop_front();
+
+		/* the caller is about to announce the subdirectories
+		   of this directory, and it will visit them before
+		   the ones announced earlier */
+		prefetch_insert = 0;
+
+		/* a slot may have become free */
+		StartPrefetch();
+	}
+
+	MemoryStorageDirectoryReader::List entries;
+
+	if (op) {
+		try {
+			entries = op->WaitEntries();
+		} catch (...) {
+			/* the prefetch may have failed because the
+			   connection was lost meanwhile; try again
+			   below */
+			op.reset();
+		}
+	}
+
+	if (!op) {
+		op = std::make_unique<NfsListDirectoryOperation>(*connection,
+								 std::move(path));
+		op->Begin();
+		entries = op->WaitEntries();
+	}
 
-	return operation.ToReader();
+	return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
 }
 
 static std::unique_ptr<Storage>
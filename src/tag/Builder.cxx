@@ -20,7 +20,6 @@ TagBuilder::TagBuilder(const Tag &other) noexcept
 	const std::size_t n = other.num_items;
 	if (n > 0) {
 		items.reserve(other.num_items);
-		const std::scoped_lock protect{tag_pool_lock};
 		for (std::size_t i = 0; i != n; ++i)
 			items.push_back(tag_pool_dup_item(other.items[i]));
 	}
@@ -54,7 +53,6 @@ TagBuilder::operator=(const TagBuilder &other) noexcept
 		items = other.items;
 
 		/* increment the tag pool refcounters */
-		const std::scoped_lock protect{tag_pool_lock};
 		for (auto &i : items)
 			i = tag_pool_dup_item(i);
 	}
@@ -170,7 +168,6 @@ TagBuilder::Complement(const Tag &other) noexcept
 
 		items.reserve(items.size() + n);
 
-		const std::scoped_lock protect{tag_pool_lock};
 		for (std::size_t i = 0; i != n; ++i) {
 			TagItem *item = other.items[i];
 			if (!present[item->type])
@@ -182,14 +179,7 @@ TagBuilder::Complement(const Tag &other) noexcept
 void
 TagBuilder::AddItemUnchecked(TagType type, std::string_view value) noexcept
 {
-	TagItem *i;
-
-	{
-		const std::scoped_lock protect{tag_pool_lock};
-		i = tag_pool_get_item(type, value);
-	}
-
-	items.push_back(i);
+	items.push_back(tag_pool_get_item(type, value));
 }
 
 inline void
@@ -222,16 +212,8 @@ TagBuilder::AddEmptyItem(TagType type) noexcept
 void
 TagBuilder::RemoveAll() noexcept
 {
-	if (items.empty())
-		/* don't acquire the tag_pool_lock if we're not going
-		   to call tag_pool_put_item() anyway */
-		return;
-
-	{
-		const std::scoped_lock protect{tag_pool_lock};
-		for (auto i : items)
-			tag_pool_put_item(i);
-	}
+	for (auto i : items)
+		tag_pool_put_item(i);
 
 	items.clear();
 }
@@ -239,14 +221,8 @@ TagBuilder::RemoveAll() noexcept
 void
 TagBuilder::RemoveType(TagType type) noexcept
 {
-	if (items.empty())
-		/* don't acquire the tag_pool_lock if we're not going
-		   to call tag_pool_put_item() anyway */
-		return;
-
 	const auto begin = items.begin(), end = items.end();
 
-	const std::scoped_lock protect{tag_pool_lock};
 	items.erase(std::remove_if(begin, end,
 				   [type](TagItem *item) {
 					   if (item->type != type)
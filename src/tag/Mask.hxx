@@ -64,6 +64,8 @@ public:
 		return *this;
 	}
 
+	constexpr bool operator==(const TagMask &) const noexcept = default;
+
 	constexpr bool TestAny() const noexcept {
 		return value != 0;
 	}
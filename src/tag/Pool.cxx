@@ -3,86 +3,211 @@
 
 #include "Pool.hxx"
 #include "Item.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Cast.hxx"
 #include "util/djb_hash.hxx"
-#include "util/IntrusiveHashSet.hxx"
 #include "util/SpanCast.hxx"
 #include "util/VarSize.hxx"
 
 #include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <cstdint>
-#include <limits>
 
-Mutex tag_pool_lock;
+struct TagPoolItem {
+	/**
+	 * The next item in the same hash bucket.
+	 */
+	TagPoolItem *next;
 
-struct TagPoolKey {
-	std::string_view value;
-	TagType type;
+	/**
+	 * The full hash of #item, for resizing the table without
+	 * hashing all values again.
+	 */
+	const std::size_t hash;
 
-	friend constexpr auto operator<=>(const TagPoolKey &,
-					  const TagPoolKey &) noexcept = default;
+	/**
+	 * The reference counter.  It is only incremented from zero
+	 * and only decremented to zero while holding the lock of the
+	 * #TagPoolShard, because in these cases, the item may get
+	 * resurrected or deleted.
+	 */
+	std::atomic_uint_least32_t ref{1};
 
-	struct Hash {
-		[[gnu::pure]]
-		std::size_t operator()(const TagPoolKey &key) const noexcept {
-			return djb_hash(AsBytes(key.value)) ^ key.type;
-		}
-	};
-};
-
-struct TagPoolItem {
-	IntrusiveHashSetHook<IntrusiveHookMode::NORMAL> hash_set_hook;
-	uint8_t ref = 1;
 	TagItem item;
 
-	static constexpr unsigned MAX_REF = std::numeric_limits<decltype(ref)>::max();
-
-	TagPoolItem(TagType type,
-		    std::string_view value) noexcept {
+	TagPoolItem(std::size_t _hash, TagType type,
+		    std::string_view value) noexcept
+		:hash(_hash) {
 		item.type = type;
 		*std::copy(value.begin(), value.end(), item.value) = 0;
 	}
 
-	static TagPoolItem *Create(TagType type,
+	static TagPoolItem *Create(std::size_t hash, TagType type,
 				   std::string_view value) noexcept;
 
-	struct GetKey {
-		[[gnu::pure]]
-		constexpr TagPoolKey operator()(const TagItem &i) const noexcept {
-			return { i.value, i.type };
-		}
-
-		[[gnu::pure]]
-		constexpr TagPoolKey operator()(const TagPoolItem &i) const noexcept {
-			return operator()(i.item);
-		}
-	};
-
-	struct CanIncrementRef {
-		constexpr bool operator()(const TagPoolItem &i) const noexcept {
-			return i.ref < MAX_REF;
-		}
-	};
+	[[gnu::pure]]
+	bool Equals(TagType type, std::string_view value) const noexcept {
+		return item.type == type && value == item.value;
+	}
 };
 
 TagPoolItem *
-TagPoolItem::Create(TagType type,
+TagPoolItem::Create(std::size_t hash, TagType type,
 		    std::string_view value) noexcept
 {
 	TagPoolItem *dummy;
 	return NewVarSize<TagPoolItem>(sizeof(dummy->item.value),
 				       value.size() + 1,
-				       type,
+				       hash, type,
 				       value);
 }
 
-static IntrusiveHashSet<TagPoolItem, 16384,
-	IntrusiveHashSetOperators<TagPoolItem, TagPoolItem::GetKey,
-				  TagPoolKey::Hash,
-				  std::equal_to<TagPoolKey>>,
-	IntrusiveHashSetMemberHookTraits<&TagPoolItem::hash_set_hook>,
-	IntrusiveHashSetOptions{.zero_initialized = true}> tag_pool;
+[[gnu::pure]]
+static std::size_t
+TagPoolHash(TagType type, std::string_view value) noexcept
+{
+	return djb_hash(AsBytes(value)) ^ type;
+}
+
+/**
+ * One part of the tag pool with its own lock and its own hash
+ * table, which grows as needed.  Items are assigned to shards by
+ * their hash, so unrelated threads rarely contend on the same lock.
+ */
+/**
+ * The number of #TagPoolShard instances.  The lowest bits of the
+ * hash choose the shard (see GetShard()), and the bits above them
+ * choose the bucket within the shard.
+ */
+static constexpr std::size_t N_SHARDS = 16;
+static_assert(std::has_single_bit(N_SHARDS));
+
+/**
+ * The number of hash bits used by GetShard().
+ */
+static constexpr unsigned SHARD_BITS = std::countr_zero(N_SHARDS);
+
+class TagPoolShard {
+	static constexpr std::size_t INITIAL_BUCKETS = 1024;
+
+	Mutex mutex;
+
+	/**
+	 * The hash table.  This is a plain pointer (and is never
+	 * freed) because this object has static storage duration, and
+	 * global #Tag instances may still be destructed after it.
+	 */
+	TagPoolItem **buckets = nullptr;
+
+	/**
+	 * The number of buckets; always a power of two (or zero
+	 * before the first insertion).
+	 */
+	std::size_t n_buckets = 0;
+
+	std::size_t n_items = 0;
+
+public:
+	TagItem *Get(std::size_t hash, TagType type,
+		     std::string_view value) noexcept;
+
+	void Put(TagPoolItem &item) noexcept;
+
+private:
+	TagPoolItem *&Bucket(std::size_t hash) const noexcept {
+		/* the lower bits of the hash have been used to choose
+		   the shard; use the bits above them */
+		return buckets[(hash >> SHARD_BITS) & (n_buckets - 1)];
+	}
+
+	void Grow() noexcept;
+};
+
+TagItem *
+TagPoolShard::Get(std::size_t hash, TagType type,
+		  std::string_view value) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	if (n_buckets > 0) {
+		for (auto *i = Bucket(hash); i != nullptr; i = i->next) {
+			if (i->hash == hash && i->Equals(type, value)) {
+				/* this may resurrect an item whose
+				   last reference is just being
+				   released by Put(), which is waiting
+				   for the lock */
+				i->ref.fetch_add(1, std::memory_order_relaxed);
+				return &i->item;
+			}
+		}
+	}
+
+	if (n_items >= n_buckets)
+		Grow();
+
+	auto *item = TagPoolItem::Create(hash, type, value);
+	auto &bucket = Bucket(hash);
+	item->next = bucket;
+	bucket = item;
+	++n_items;
+
+	return &item->item;
+}
+
+void
+TagPoolShard::Put(TagPoolItem &item) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	if (item.ref.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		/* resurrected by Get() */
+		return;
+
+	auto **p = &Bucket(item.hash);
+	while (*p != &item) {
+		assert(*p != nullptr);
+		p = &(*p)->next;
+	}
+
+	*p = item.next;
+	--n_items;
+
+	DeleteVarSize(&item);
+}
+
+void
+TagPoolShard::Grow() noexcept
+{
+	const std::size_t old_n_buckets = n_buckets;
+	TagPoolItem **const old_buckets = buckets;
+
+	n_buckets = old_n_buckets > 0
+		? old_n_buckets * 2
+		: INITIAL_BUCKETS;
+	buckets = new TagPoolItem *[n_buckets]();
+
+	for (std::size_t b = 0; b < old_n_buckets; ++b) {
+		for (auto *i = old_buckets[b]; i != nullptr;) {
+			auto *next = i->next;
+			auto &bucket = Bucket(i->hash);
+			i->next = bucket;
+			bucket = i;
+			i = next;
+		}
+	}
+
+	delete[] old_buckets;
+}
+
+static std::array<TagPoolShard, N_SHARDS> tag_pool;
+
+static TagPoolShard &
+GetShard(std::size_t hash) noexcept
+{
+	return tag_pool[hash % N_SHARDS];
+}
 
 static constexpr TagPoolItem *
 TagItemToPoolItem(TagItem *item) noexcept
@@ -93,18 +218,8 @@ TagItemToPoolItem(TagItem *item) noexcept
 TagItem *
 tag_pool_get_item(TagType type, std::string_view value) noexcept
 {
-	const auto [position, inserted] =
-		tag_pool.insert_check_if(TagPoolKey{value, type},
-					 TagPoolItem::CanIncrementRef{});
-
-	if (inserted) {
-		auto *pool_item = TagPoolItem::Create(type, value);
-		tag_pool.insert_commit(position, *pool_item);
-		return &pool_item->item;
-	} else {
-		++position->ref;
-		return &position->item;
-	}
+	const std::size_t hash = TagPoolHash(type, value);
+	return GetShard(hash).Get(hash, type, value);
 }
 
 TagItem *
@@ -112,29 +227,31 @@ tag_pool_dup_item(TagItem *item) noexcept
 {
 	TagPoolItem *pool_item = TagItemToPoolItem(item);
 
-	assert(pool_item->ref > 0);
+	/* the caller owns a reference, therefore the item cannot be
+	   deleted concurrently, and no lock is needed */
+	[[maybe_unused]] const auto old_ref =
+		pool_item->ref.fetch_add(1, std::memory_order_relaxed);
+	assert(old_ref > 0);
 
-	if (pool_item->ref < TagPoolItem::MAX_REF) {
-		++pool_item->ref;
-		return item;
-	} else {
-		/* the reference counter overflows above MAX_REF;
-		   obtain a reference to a different TagPoolItem which
-		   isn't yet "full" */
-		return tag_pool_get_item(item->type, item->value);
-	}
+	return item;
 }
 
 void
 tag_pool_put_item(TagItem *item) noexcept
 {
 	TagPoolItem *const pool_item = TagItemToPoolItem(item);
-	assert(pool_item->ref > 0);
-	--pool_item->ref;
 
-	if (pool_item->ref > 0)
-		return;
+	/* decrement without the lock unless this may be the last
+	   reference */
+	auto ref = pool_item->ref.load(std::memory_order_relaxed);
+	while (ref > 1) {
+		if (pool_item->ref.compare_exchange_weak(ref, ref - 1,
+							 std::memory_order_release,
+							 std::memory_order_relaxed))
+			return;
+	}
+
+	assert(ref == 1);
 
-	tag_pool.erase(tag_pool.iterator_to(*pool_item));
-	DeleteVarSize(pool_item);
+	GetShard(pool_item->hash).Put(*pool_item);
 }
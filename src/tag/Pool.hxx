@@ -4,15 +4,11 @@
 #ifndef MPD_TAG_POOL_HXX
 #define MPD_TAG_POOL_HXX
 
-#include "thread/Mutex.hxx"
-
 #include <cstdint>
 #include <string_view>
 
 enum TagType : uint8_t;
 
-extern Mutex tag_pool_lock;
-
 struct TagItem;
 
 [[nodiscard]]
@@ -24,7 +24,6 @@ Tag::Clear() noexcept
 
 	if (num_items > 0) {
 		assert(items != nullptr);
-		const std::scoped_lock protect{tag_pool_lock};
 		for (unsigned i = 0; i < num_items; ++i)
 			tag_pool_put_item(items[i]);
 		num_items = 0;
@@ -41,7 +40,6 @@ Tag::Tag(const Tag &other) noexcept
 	if (num_items > 0) {
 		items = new TagItem *[num_items];
 
-		const std::scoped_lock protect{tag_pool_lock};
 		for (unsigned i = 0; i < num_items; i++)
 			items[i] = tag_pool_dup_item(other.items[i]);
 	}
@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+
+/**
+ * An allocator for many small objects of the same type.  Memory is
+ * obtained in large blocks ("slabs") which are carved into slots;
+ * freed slots are kept in a list for reuse.  Compared to the general
+ * purpose allocator, this saves the per-allocation overhead and keeps
+ * objects allocated together close to each other in memory.
+ *
+ * All slabs are released when the last object is freed.
+ *
+ * This class is not thread-safe.
+ *
+ * @param T the object type (only its size and alignment are used)
+ * @param SLOTS_PER_SLAB the number of objects in one slab
+ */
+template<typename T, std::size_t SLOTS_PER_SLAB>
+class SlabAllocator {
+	union Slot {
+		Slot *next;
+
+		alignas(T) std::byte value[sizeof(T)];
+	};
+
+	struct Slab {
+		Slab *next;
+
+		Slot slots[SLOTS_PER_SLAB];
+	};
+
+	/**
+	 * A linked list of all slabs; the first one is the one
+	 * #n_bumped refers to.
+	 */
+	Slab *slabs = nullptr;
+
+	/**
+	 * The number of slots of the first slab which have ever been
+	 * handed out.  Slots beyond this have never been touched
+	 * and are not in the #available list.
+	 */
+	std::size_t n_bumped = SLOTS_PER_SLAB;
+
+	/**
+	 * The number of slabs in the #slabs list.
+	 */
+	std::size_t n_slabs = 0;
+
+	/**
+	 * The number of slots currently allocated.
+	 */
+	std::size_t n_allocated = 0;
+
+	/**
+	 * A linked list of freed slots.
+	 */
+	Slot *available = nullptr;
+
+public:
+	SlabAllocator() noexcept = default;
+
+	~SlabAllocator() noexcept {
+		/* if there are still objects (e.g. because a global
+		   object was not destructed before this one), leak
+		   the memory instead of invalidating them */
+		if (n_allocated == 0)
+			ReleaseAll();
+	}
+
+	SlabAllocator(const SlabAllocator &) = delete;
+	SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+	/**
+	 * @return the number of objects currently allocated
+	 */
+	std::size_t GetCount() const noexcept {
+		return n_allocated;
+	}
+
+	/**
+	 * @return the number of bytes currently obtained from the
+	 * general purpose allocator
+	 */
+	std::size_t GetMemoryUsage() const noexcept {
+		return n_slabs * sizeof(Slab);
+	}
+
+	/**
+	 * @return the memory usage divided by the number of objects,
+	 * i.e. the size of one object plus its share of the unused
+	 * slots and the slab headers; 0 if there are no objects
+	 */
+	std::size_t GetMemoryPerObject() const noexcept {
+		return n_allocated > 0
+			? GetMemoryUsage() / n_allocated
+			: 0;
+	}
+
+	/**
+	 * Allocate uninitialized memory for one object.
+	 *
+	 * Throws std::bad_alloc on error.
+	 */
+	[[gnu::malloc]] [[gnu::returns_nonnull]]
+	void *Allocate() {
+		Slot *slot;
+
+		if (available != nullptr) {
+			slot = available;
+			available = slot->next;
+		} else {
+			if (n_bumped == SLOTS_PER_SLAB) {
+				auto *slab = new Slab;
+				slab->next = slabs;
+				slabs = slab;
+				++n_slabs;
+				n_bumped = 0;
+			}
+
+			slot = &slabs->slots[n_bumped++];
+		}
+
+		++n_allocated;
+		return slot->value;
+	}
+
+	/**
+	 * Free memory returned by Allocate().  A nullptr argument is
+	 * ignored (like operator delete).
+	 */
+	void Free(void *p) noexcept {
+		if (p == nullptr)
+			return;
+
+		assert(n_allocated > 0);
+
+		auto *slot = reinterpret_cast<Slot *>(p);
+		slot->next = available;
+		available = slot;
+
+		if (--n_allocated == 0)
+			/* give the memory back */
+			ReleaseAll();
+	}
+
+private:
+	void ReleaseAll() noexcept {
+		assert(n_allocated == 0);
+
+		while (slabs != nullptr) {
+			auto *slab = slabs;
+			slabs = slab->next;
+			delete slab;
+		}
+
+		n_slabs = 0;
+		n_bumped = SLOTS_PER_SLAB;
+		available = nullptr;
+	}
+};
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "protocol/BinaryRecords.hxx"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using std::string_view_literals::operator""sv;
+
+/**
+ * A reference decoder for the format produced by
+ * #BinaryRecordEncoder which converts items back to text lines.
+ */
+class BinaryRecordDecoder {
+	std::string_view src;
+
+	std::vector<std::string> keys, strings;
+
+public:
+	explicit BinaryRecordDecoder(std::string_view _src) noexcept
+		:src(_src) {}
+
+	bool IsEnd() const noexcept {
+		return src.empty();
+	}
+
+	std::string Next() {
+		const auto header = ReadVarint();
+		const auto type = BinaryRecordEncoder::Type(header & 3);
+
+		std::string line;
+		if (const auto key_ref = header >> 2; key_ref == 0)
+			line = keys.emplace_back(ReadBytes(ReadVarint()));
+		else
+			line = keys.at(key_ref - 1);
+
+		line += ": ";
+
+		switch (type) {
+		case BinaryRecordEncoder::Type::STRING:
+			line += ReadString();
+			break;
+
+		case BinaryRecordEncoder::Type::UNSIGNED:
+			line += std::to_string(ReadVarint());
+			break;
+
+		case BinaryRecordEncoder::Type::TIME:
+			line += "@" + std::to_string(ReadVarint());
+			break;
+
+		case BinaryRecordEncoder::Type::DURATION:
+			line += std::to_string(ReadVarint()) + "ms";
+			break;
+		}
+
+		return line;
+	}
+
+private:
+	uint_least64_t ReadVarint() {
+		uint_least64_t value = 0;
+		for (unsigned shift = 0;; shift += 7) {
+			if (src.empty())
+				throw std::runtime_error("Truncated varint");
+
+			const auto b = static_cast<unsigned char>(src.front());
+			src.remove_prefix(1);
+
+			value |= uint_least64_t(b & 0x7f) << shift;
+			if ((b & 0x80) == 0)
+				return value;
+		}
+	}
+
+	std::string ReadBytes(std::size_t n) {
+		if (src.size() < n)
+			throw std::runtime_error("Truncated string");
+
+		std::string result{src.substr(0, n)};
+		src.remove_prefix(n);
+		return result;
+	}
+
+	std::string ReadString() {
+		const auto v = ReadVarint();
+		switch (BinaryRecordEncoder::StringMode(v & 3)) {
+		case BinaryRecordEncoder::StringMode::LITERAL:
+			return ReadBytes(v >> 2);
+
+		case BinaryRecordEncoder::StringMode::INTERN:
+			return strings.emplace_back(ReadBytes(v >> 2));
+
+		case BinaryRecordEncoder::StringMode::REFERENCE:
+			return strings.at(v >> 2);
+		}
+
+		throw std::runtime_error("Bad string mode");
+	}
+};
+
+TEST(BinaryRecords, RoundTrip)
+{
+	BinaryRecordEncoder e;
+	e.String("file", "a/b.flac");
+	e.String("Artist", "Foo", true);
+	e.Unsigned("Pos", 0);
+	e.Duration("duration", std::chrono::milliseconds{123456});
+	e.Time("Last-Modified",
+	       std::chrono::system_clock::time_point{std::chrono::seconds{1700000000}});
+	e.String("file", "a/c.flac");
+	e.String("Artist", "Foo", true);
+	e.Unsigned("Pos", 300);
+
+	BinaryRecordDecoder d{e.GetBuffer()};
+	EXPECT_EQ(d.Next(), "file: a/b.flac");
+	EXPECT_EQ(d.Next(), "Artist: Foo");
+	EXPECT_EQ(d.Next(), "Pos: 0");
+	EXPECT_EQ(d.Next(), "duration: 123456ms");
+	EXPECT_EQ(d.Next(), "Last-Modified: @1700000000");
+	EXPECT_EQ(d.Next(), "file: a/c.flac");
+	EXPECT_EQ(d.Next(), "Artist: Foo");
+	EXPECT_EQ(d.Next(), "Pos: 300");
+	EXPECT_TRUE(d.IsEnd());
+}
+
+TEST(BinaryRecords, Compact)
+{
+	BinaryRecordEncoder e;
+	e.String("Album", "A rather long album title", true);
+	const std::size_t first = e.GetSize();
+
+	/* the key and the interned value are references now */
+	e.String("Album", "A rather long album title", true);
+	EXPECT_EQ(e.GetSize() - first, 2U);
+}
+
+TEST(BinaryRecords, Consume)
+{
+	BinaryRecordEncoder e;
+	e.String("file", "x");
+	e.String("file", "y");
+
+	const std::string all{e.GetBuffer()};
+	e.Consume(3);
+	EXPECT_EQ(e.GetBuffer(), std::string_view{all}.substr(3));
+}
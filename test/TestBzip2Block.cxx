@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "archive/plugins/Bzip2Block.hxx"
+
+#include <gtest/gtest.h>
+
+#include <bzlib.h>
+
+#include <random>
+#include <vector>
+
+static std::vector<std::byte>
+MakeContents(std::size_t size)
+{
+	std::minstd_rand rng;
+	std::vector<std::byte> result(size);
+	for (auto &i : result)
+		i = std::byte('a' + rng() % 16);
+	return result;
+}
+
+static std::vector<std::byte>
+Compress(std::span<const std::byte> src, int block_size)
+{
+	std::vector<std::byte> result(src.size() + src.size() / 100 + 600);
+	unsigned size = result.size();
+	EXPECT_EQ(BZ2_bzBuffToBuffCompress(reinterpret_cast<char *>(result.data()),
+					   &size,
+					   const_cast<char *>(reinterpret_cast<const char *>(src.data())),
+					   src.size(), block_size, 0, 0),
+		  BZ_OK);
+	result.resize(size);
+	return result;
+}
+
+static std::vector<std::byte>
+DecodeAll(std::span<const std::byte> compressed, std::size_t &n_blocks)
+{
+	Bzip2BlockScanner scanner;
+
+	/* feed in odd chunk sizes */
+	for (std::size_t i = 0; i < compressed.size(); i += 1000)
+		scanner.Feed(compressed.subspan(i, std::min<std::size_t>(1000, compressed.size() - i)));
+
+	const auto blocks = scanner.Finish();
+	n_blocks = blocks.size();
+
+	std::vector<std::byte> result;
+	for (const auto &block : blocks) {
+		const auto data = Bzip2DecodeBlock(block,
+						   compressed.subspan(block.GetByteOffset(),
+								      block.GetByteSize()));
+		result.insert(result.end(), data.begin(), data.end());
+	}
+
+	return result;
+}
+
+TEST(Bzip2Block, Single)
+{
+	const auto contents = MakeContents(1000);
+	const auto compressed = Compress(contents, 9);
+
+	std::size_t n_blocks;
+	EXPECT_EQ(DecodeAll(compressed, n_blocks), contents);
+	EXPECT_EQ(n_blocks, 1U);
+}
+
+TEST(Bzip2Block, Multiple)
+{
+	/* 100 kB blocks */
+	const auto contents = MakeContents(1024 * 1024);
+	const auto compressed = Compress(contents, 1);
+
+	std::size_t n_blocks;
+	EXPECT_EQ(DecodeAll(compressed, n_blocks), contents);
+	EXPECT_GE(n_blocks, 10U);
+}
+
+TEST(Bzip2Block, MultiStream)
+{
+	/* concatenated streams, like pbzip2 generates them */
+	const auto a = MakeContents(300000), b = MakeContents(12345);
+	auto compressed = Compress(a, 1);
+	const auto compressed_b = Compress(b, 2);
+	compressed.insert(compressed.end(),
+			  compressed_b.begin(), compressed_b.end());
+
+	auto expected = a;
+	expected.insert(expected.end(), b.begin(), b.end());
+
+	std::size_t n_blocks;
+	EXPECT_EQ(DecodeAll(compressed, n_blocks), expected);
+	EXPECT_GE(n_blocks, 4U);
+}
+
+TEST(Bzip2Block, Truncated)
+{
+	const auto contents = MakeContents(1000);
+	const auto compressed = Compress(contents, 9);
+
+	Bzip2BlockScanner scanner;
+	scanner.Feed(std::span{compressed}.first(compressed.size() - 8));
+	EXPECT_THROW(scanner.Finish(), std::runtime_error);
+}
@@ -0,0 +1,425 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Tests for the segmented download mode of the "curl" input plugin,
+ * using a local HTTP stand-in server which supports (or refuses)
+ * range requests and records how the client used it.
+ */
+
+#include "input/Init.hxx"
+#include "input/InputStream.hxx"
+#include "input/WaitReady.hxx"
+#include "input/plugins/CurlInputPlugin.hxx"
+#include "config/Data.hxx"
+#include "config/Block.hxx"
+#include "event/Thread.hxx"
+#include "thread/Mutex.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using std::string_view_literals::operator""sv;
+
+/**
+ * A minimal HTTP/1.1 server which serves one resource and handles
+ * one request per connection.
+ */
+class RangeServer {
+	const std::vector<std::byte> &body;
+
+	const bool support_ranges;
+
+	int listen_fd;
+	unsigned port;
+
+	std::atomic_bool quit{false};
+
+	std::mutex workers_mutex;
+	std::vector<std::thread> workers;
+
+	std::thread thread;
+
+public:
+	std::atomic_uint n_requests{0}, n_range_requests{0};
+	std::atomic_uint concurrent{0}, max_concurrent{0};
+
+	/**
+	 * The values of all "Range" request headers.
+	 */
+	std::vector<std::string> ranges;
+	std::mutex ranges_mutex;
+
+	RangeServer(const std::vector<std::byte> &_body, bool _support_ranges)
+		:body(_body), support_ranges(_support_ranges)
+	{
+		listen_fd = socket(AF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0);
+		if (listen_fd < 0)
+			throw std::runtime_error("socket() failed");
+
+		struct sockaddr_in sin{};
+		sin.sin_family = AF_INET;
+		sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		socklen_t length = sizeof(sin);
+		if (bind(listen_fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 ||
+		    listen(listen_fd, 16) < 0 ||
+		    getsockname(listen_fd, (struct sockaddr *)&sin, &length) < 0)
+			throw std::runtime_error("bind() failed");
+
+		port = ntohs(sin.sin_port);
+
+		thread = std::thread([this]{ Run(); });
+	}
+
+	~RangeServer() noexcept {
+		quit = true;
+		thread.join();
+
+		for (auto &i : workers)
+			i.join();
+
+		close(listen_fd);
+	}
+
+	std::string GetURL() const {
+		return "http://127.0.0.1:" + std::to_string(port) + "/file.dsf";
+	}
+
+private:
+	void Run() noexcept {
+		while (!quit) {
+			struct pollfd pfd{listen_fd, POLLIN, 0};
+			if (poll(&pfd, 1, 50) <= 0)
+				continue;
+
+			int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+			if (fd < 0)
+				continue;
+
+			const std::scoped_lock lock{workers_mutex};
+			workers.emplace_back([this, fd]{
+				HandleConnection(fd);
+				close(fd);
+			});
+		}
+	}
+
+	static bool SendAll(int fd, const void *data, std::size_t size) noexcept {
+		const auto *p = static_cast<const std::byte *>(data);
+		while (size > 0) {
+			ssize_t nbytes = send(fd, p, size, MSG_NOSIGNAL);
+			if (nbytes <= 0)
+				return false;
+
+			p += nbytes;
+			size -= nbytes;
+		}
+
+		return true;
+	}
+
+	void HandleConnection(int fd) noexcept {
+		std::string request;
+		char buffer[4096];
+		while (request.find("\r\n\r\n") == request.npos) {
+			ssize_t nbytes = recv(fd, buffer, sizeof(buffer), 0);
+			if (nbytes <= 0)
+				return;
+
+			request.append(buffer, nbytes);
+		}
+
+		++n_requests;
+
+		const unsigned c = ++concurrent;
+		unsigned m = max_concurrent;
+		while (c > m && !max_concurrent.compare_exchange_weak(m, c)) {}
+
+		std::size_t start = 0, end = body.size();
+		bool partial = false, unsatisfiable = false;
+
+		if (auto i = request.find("Range: bytes="); i != request.npos) {
+			++n_range_requests;
+
+			{
+				const std::scoped_lock lock{ranges_mutex};
+				ranges.emplace_back(request, i + 13,
+						    request.find("\r\n", i) - i - 13);
+			}
+
+			if (support_ranges) {
+				unsigned long long first, last;
+				int n = sscanf(request.c_str() + i + 13, "%llu-%llu",
+					       &first, &last);
+				if (n >= 1 && first < body.size()) {
+					start = first;
+					if (n == 2 && last < body.size())
+						end = last + 1;
+					partial = true;
+				} else if (n >= 1) {
+					start = end;
+					unsatisfiable = true;
+				}
+			}
+		}
+
+		/* simulate a high-latency link */
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+		std::string header = unsatisfiable
+			? "HTTP/1.1 416 Range Not Satisfiable\r\n"
+			: partial
+			? "HTTP/1.1 206 Partial Content\r\n"
+			: "HTTP/1.1 200 OK\r\n";
+		header += "Content-Type: audio/x-dsf\r\n";
+		header += "Connection: close\r\n";
+		header += "Content-Length: " + std::to_string(end - start) + "\r\n";
+		if (support_ranges)
+			header += "Accept-Ranges: bytes\r\n";
+		if (partial)
+			header += "Content-Range: bytes " + std::to_string(start) +
+				"-" + std::to_string(end - 1) + "/" +
+				std::to_string(body.size()) + "\r\n";
+		else if (unsatisfiable)
+			header += "Content-Range: bytes */" +
+				std::to_string(body.size()) + "\r\n";
+		header += "\r\n";
+
+		if (SendAll(fd, header.data(), header.size())) {
+			/* limit the bandwidth of each connection */
+			constexpr std::size_t CHUNK = 64 * 1024;
+			for (std::size_t i = start; i < end && !quit; i += CHUNK) {
+				if (!SendAll(fd, body.data() + i,
+					     std::min(CHUNK, end - i)))
+					break;
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+
+		--concurrent;
+	}
+};
+
+static std::vector<std::byte>
+MakeBody(std::size_t size)
+{
+	std::vector<std::byte> body(size);
+	uint32_t x = 1;
+	for (auto &i : body) {
+		x = x * 1103515245 + 12345;
+		i = static_cast<std::byte>(x >> 16);
+	}
+
+	return body;
+}
+
+static void
+ReadFully(InputStream &is, std::span<std::byte> dest)
+{
+	while (!dest.empty()) {
+		std::size_t nbytes = is.LockRead(dest);
+		ASSERT_GT(nbytes, 0U);
+		dest = dest.subspan(nbytes);
+	}
+}
+
+class CurlInputStreamTest : public ::testing::Test {
+	EventThread io_thread;
+
+	std::unique_ptr<ScopeInputPluginsInit> input_plugins_init;
+
+protected:
+	void SetUp() override {
+		ConfigData config;
+
+		ConfigBlock block;
+		block.AddBlockParam("plugin", "curl");
+		block.AddBlockParam("segments", "4");
+		block.AddBlockParam("segments_max_size", "10 MB");
+		config.AddBlock(ConfigBlockOption::INPUT, std::move(block));
+
+		io_thread.Start();
+		input_plugins_init = std::make_unique<ScopeInputPluginsInit>(config,
+									     io_thread.GetEventLoop());
+	}
+
+	void TearDown() override {
+		input_plugins_init.reset();
+	}
+};
+
+TEST_F(CurlInputStreamTest, Segmented)
+{
+	const auto body = MakeBody(5 * 1024 * 1024 + 1234);
+	RangeServer server(body, true);
+
+	Mutex mutex;
+	auto is = InputStream::OpenReady(server.GetURL(), mutex);
+	EXPECT_TRUE(is->IsSeekable());
+	ASSERT_TRUE(is->KnownSize());
+	EXPECT_EQ(is->GetSize(), body.size());
+	EXPECT_EQ(is->GetMimeType(), "audio/x-dsf"sv);
+
+	std::vector<std::byte> buffer(body.size());
+	ReadFully(*is, buffer);
+	EXPECT_EQ(buffer, body);
+
+	{
+		const std::scoped_lock lock{mutex};
+		EXPECT_TRUE(is->IsEOF());
+	}
+
+	/* seeking backwards is served from the buffer */
+	const unsigned n_requests = server.n_requests;
+	is->LockSeek(1000);
+
+	std::vector<std::byte> chunk(4096);
+	ReadFully(*is, chunk);
+	EXPECT_TRUE(std::equal(chunk.begin(), chunk.end(),
+			       body.begin() + 1000));
+	EXPECT_EQ(server.n_requests, n_requests);
+
+	is.reset();
+
+	EXPECT_GT(server.n_range_requests, 1U);
+	EXPECT_GE(server.max_concurrent, 2U);
+
+	/* the probe requests everything, the others request at most
+	   one segment within the resource */
+	ASSERT_FALSE(server.ranges.empty());
+	EXPECT_EQ(server.ranges.front(), "0-");
+	for (std::size_t i = 1; i < server.ranges.size(); ++i) {
+		unsigned long long first, last;
+		ASSERT_EQ(sscanf(server.ranges[i].c_str(), "%llu-%llu",
+				 &first, &last), 2) << server.ranges[i];
+		EXPECT_LE(first, last);
+		EXPECT_LT(last, body.size());
+		EXPECT_LE(last - first + 1, 1024U * 1024U);
+	}
+}
+
+TEST_F(CurlInputStreamTest, SeekAhead)
+{
+	const auto body = MakeBody(8 * 1024 * 1024);
+	RangeServer server(body, true);
+
+	Mutex mutex;
+	auto is = InputStream::OpenReady(server.GetURL(), mutex);
+	ASSERT_TRUE(is->IsSeekable());
+
+	/* seek far beyond the read-ahead window; the hole at the new
+	   offset must be fetched right away */
+	const std::size_t offset = body.size() - 100000;
+	is->LockSeek(offset);
+
+	std::vector<std::byte> buffer(body.size() - offset);
+	ReadFully(*is, buffer);
+	EXPECT_TRUE(std::equal(buffer.begin(), buffer.end(),
+			       body.begin() + offset));
+
+	is->LockSeek(4096);
+	std::vector<std::byte> chunk(65536);
+	ReadFully(*is, chunk);
+	EXPECT_TRUE(std::equal(chunk.begin(), chunk.end(),
+			       body.begin() + 4096));
+}
+
+TEST_F(CurlInputStreamTest, NoRanges)
+{
+	const auto body = MakeBody(256 * 1024);
+	RangeServer server(body, false);
+
+	Mutex mutex;
+	auto is = InputStream::OpenReady(server.GetURL(), mutex);
+	EXPECT_FALSE(is->IsSeekable());
+
+	std::vector<std::byte> buffer(body.size());
+	ReadFully(*is, buffer);
+	EXPECT_EQ(buffer, body);
+
+	is.reset();
+
+	/* the probe request and the plain request */
+	EXPECT_EQ(server.n_requests, 2U);
+}
+
+TEST_F(CurlInputStreamTest, Empty)
+{
+	/* the probe gets "416 Range Not Satisfiable" */
+	const std::vector<std::byte> body;
+	RangeServer server(body, true);
+
+	Mutex mutex;
+	auto is = InputStream::OpenReady(server.GetURL(), mutex);
+
+	std::byte buffer[16];
+	EXPECT_EQ(is->LockRead(buffer), 0U);
+
+	{
+		const std::scoped_lock lock{mutex};
+		EXPECT_TRUE(is->IsEOF());
+	}
+
+	is.reset();
+
+	/* the probe request and the plain request */
+	EXPECT_EQ(server.n_requests, 2U);
+	EXPECT_EQ(server.n_range_requests, 1U);
+}
+
+TEST_F(CurlInputStreamTest, TooLarge)
+{
+	/* larger than "segments_max_size" */
+	const auto body = MakeBody(11 * 1024 * 1024);
+	RangeServer server(body, true);
+
+	Mutex mutex;
+	auto is = InputStream::OpenReady(server.GetURL(), mutex);
+
+	std::vector<std::byte> buffer(body.size());
+	ReadFully(*is, buffer);
+	EXPECT_EQ(buffer, body);
+
+	is.reset();
+
+	EXPECT_EQ(server.n_requests, 2U);
+	EXPECT_EQ(server.n_range_requests, 1U);
+}
+
+TEST_F(CurlInputStreamTest, NotForScanning)
+{
+	/* streams opened by storage plugins for scanning tags are
+	   never downloaded in segments */
+	const auto body = MakeBody(256 * 1024);
+	RangeServer server(body, true);
+
+	Mutex mutex;
+	auto is = OpenCurlInputStream(server.GetURL(), {}, mutex);
+	LockWaitReady(*is);
+
+	std::vector<std::byte> buffer(body.size());
+	ReadFully(*is, buffer);
+	EXPECT_EQ(buffer, body);
+
+	is.reset();
+
+	EXPECT_EQ(server.n_requests, 1U);
+	EXPECT_EQ(server.n_range_requests, 0U);
+}
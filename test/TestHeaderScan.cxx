@@ -0,0 +1,529 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "lib/xiph/FlacHeaderScan.hxx"
+#include "lib/xiph/OggHeaderScan.hxx"
+#include "decoder/plugins/Mp4Scan.hxx"
+#include "io/FileRangeReader.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "tag/Handler.hxx"
+#include "tag/Type.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "util/SpanCast.hxx"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdio.h>
+
+using std::string_literals::operator""s;
+using std::string_view_literals::operator""sv;
+
+namespace {
+
+class RecordTagHandler final : public NullTagHandler {
+public:
+	std::optional<SongTime> duration;
+	std::optional<AudioFormat> audio_format;
+	std::vector<std::pair<TagType, std::string>> tags;
+
+	explicit RecordTagHandler(unsigned _want_mask=0) noexcept
+		:NullTagHandler(WANT_DURATION|WANT_TAG|WANT_AUDIO_FORMAT|
+				_want_mask) {}
+
+	void OnDuration(SongTime _duration) noexcept override {
+		duration = _duration;
+	}
+
+	void OnTag(TagType type, std::string_view value) noexcept override {
+		tags.emplace_back(type, value);
+	}
+
+	void OnAudioFormat(AudioFormat af) noexcept override {
+		audio_format = af;
+	}
+};
+
+class TemporaryFile {
+	static inline unsigned counter = 0;
+
+	const AllocatedPath path;
+
+public:
+	explicit TemporaryFile(std::string_view contents)
+		:path(AllocatedPath::FromFS(testing::TempDir() +
+					    "/TestHeaderScan" +
+					    std::to_string(++counter)))
+	{
+		FILE *file = fopen(path.c_str(), "wb");
+		EXPECT_NE(file, nullptr);
+		fwrite(contents.data(), 1, contents.size(), file);
+		fclose(file);
+	}
+
+	~TemporaryFile() noexcept {
+		remove(path.c_str());
+	}
+
+	Path GetPath() const noexcept {
+		return path;
+	}
+};
+
+void
+AppendBE16(std::string &dest, unsigned value)
+{
+	dest.push_back(char(value >> 8));
+	dest.push_back(char(value));
+}
+
+void
+AppendBE32(std::string &dest, uint_least32_t value)
+{
+	AppendBE16(dest, value >> 16);
+	AppendBE16(dest, value & 0xffff);
+}
+
+void
+AppendLE32(std::string &dest, uint_least32_t value)
+{
+	for (unsigned i = 0; i < 4; ++i)
+		dest.push_back(char(value >> (8 * i)));
+}
+
+void
+AppendLE64(std::string &dest, uint_least64_t value)
+{
+	AppendLE32(dest, value & 0xffffffff);
+	AppendLE32(dest, value >> 32);
+}
+
+std::string
+MakeVorbisComments(std::initializer_list<std::string_view> comments)
+{
+	std::string result;
+	AppendLE32(result, 6);
+	result += "vendor"sv;
+	AppendLE32(result, comments.size());
+	for (const auto i : comments) {
+		AppendLE32(result, i.size());
+		result += i;
+	}
+	return result;
+}
+
+} // anonymous namespace
+
+/**
+ * Build a FLAC file header: 44.1 kHz, 16 bit, stereo, 10 seconds.
+ */
+static std::string
+MakeFlacHeader()
+{
+	std::string result = "fLaC";
+
+	/* STREAMINFO */
+	result.push_back(0x00);
+	result.append({0, 0, 34});
+	AppendBE16(result, 4096);
+	AppendBE16(result, 4096);
+	result.append(6, '\0');
+	/* 20 bits sample rate, 3 bits channels-1, 5 bits bps-1, 36 bits total samples */
+	const uint_least64_t packed = (uint_least64_t(44100) << 44) |
+		(uint_least64_t(2 - 1) << 41) | (uint_least64_t(16 - 1) << 36) |
+		441000;
+	AppendBE32(result, packed >> 32);
+	AppendBE32(result, packed & 0xffffffff);
+	result.append(16, '\0'); // MD5
+
+	/* PADDING */
+	result.push_back(0x01);
+	result.append({0, 0x01, 0x00});
+	result.append(256, '\0');
+
+	return result;
+}
+
+TEST(FlacHeaderScan, Basic)
+{
+	std::string flac = MakeFlacHeader();
+
+	const auto comments = MakeVorbisComments({"ARTIST=Foo"sv, "TITLE=Bar"sv, "junk"sv});
+	flac.push_back(char(0x80 | 4)); // last block, VORBIS_COMMENT
+	flac.push_back(0);
+	AppendBE16(flac, comments.size());
+	flac += comments;
+	flac.append(1000, '\xff'); // audio frames
+
+	TemporaryFile file(flac);
+	FileRangeReader reader(file.GetPath());
+
+	RecordTagHandler handler;
+	ASSERT_TRUE(ScanFlacHeaders(reader, handler));
+	EXPECT_EQ(handler.duration, SongTime::FromS(10U));
+	EXPECT_EQ(handler.audio_format, AudioFormat(44100, SampleFormat::S16, 2));
+	ASSERT_EQ(handler.tags.size(), 2U);
+	EXPECT_EQ(handler.tags[0], std::pair(TAG_ARTIST, std::string{"Foo"}));
+	EXPECT_EQ(handler.tags[1], std::pair(TAG_TITLE, std::string{"Bar"}));
+}
+
+TEST(FlacHeaderScan, Id3v2)
+{
+	/* a 16 byte ID3v2 tag which libFLAC skips */
+	std::string flac = "ID3\x04\x00\x00\x00\x00\x00\x10"s;
+	flac.append(16, '\0');
+	flac += MakeFlacHeader();
+	flac[flac.size() - 256 - 4] |= 0x80; // PADDING is the last block
+
+	TemporaryFile file(flac);
+	FileRangeReader reader(file.GetPath());
+
+	RecordTagHandler handler;
+	ASSERT_TRUE(ScanFlacHeaders(reader, handler));
+	EXPECT_EQ(handler.duration, SongTime::FromS(10U));
+	EXPECT_TRUE(handler.tags.empty());
+}
+
+TEST(FlacHeaderScan, Malformed)
+{
+	std::string flac = MakeFlacHeader();
+
+	/* the comment block is truncated */
+	const auto comments = MakeVorbisComments({"ARTIST=Foo"sv});
+	flac.push_back(char(0x80 | 4));
+	flac.push_back(0);
+	AppendBE16(flac, comments.size() + 10);
+	flac += comments;
+
+	TemporaryFile file(flac);
+	FileRangeReader reader(file.GetPath());
+
+	RecordTagHandler handler;
+	EXPECT_FALSE(ScanFlacHeaders(reader, handler));
+	EXPECT_FALSE(handler.duration);
+	EXPECT_TRUE(handler.tags.empty());
+
+	/* pictures are not supported */
+	RecordTagHandler picture_handler(TagHandler::WANT_PICTURE);
+	EXPECT_FALSE(ScanFlacHeaders(reader, picture_handler));
+
+	/* not a FLAC file */
+	TemporaryFile other("RIFF\0\0\0\0WAVE"sv);
+	FileRangeReader other_reader(other.GetPath());
+	EXPECT_FALSE(ScanFlacHeaders(other_reader, handler));
+}
+
+/**
+ * Calculate the Ogg page checksum bit by bit (independent of the
+ * table-driven implementation in OggHeaderScan.cxx).
+ */
+static uint_least32_t
+OggCrc(std::string_view page) noexcept
+{
+	uint_least32_t crc = 0;
+	for (const char ch : page) {
+		crc ^= uint_least32_t(static_cast<unsigned char>(ch)) << 24;
+		for (unsigned i = 0; i < 8; ++i)
+			crc = (crc & 0x80000000) != 0
+				? ((crc << 1) ^ 0x04c11db7) & 0xffffffff
+				: (crc << 1) & 0xffffffff;
+	}
+
+	return crc;
+}
+
+/**
+ * Append an Ogg page.
+ *
+ * @param body the page body
+ * @param complete true if the last packet on this page ends here
+ * (otherwise the size must be a multiple of 255)
+ */
+static void
+AppendOggPage(std::string &dest, uint_least32_t serial, unsigned flags,
+	      int_least64_t granulepos,
+	      std::initializer_list<std::string_view> packets,
+	      bool complete=true)
+{
+	std::string lacing;
+	std::string body;
+	for (const auto i : packets) {
+		for (std::size_t n = i.size(); n >= 255; n -= 255)
+			lacing.push_back('\xff');
+		lacing.push_back(char(i.size() % 255));
+		body += i;
+	}
+
+	if (!complete)
+		/* remove the terminating lacing value */
+		lacing.pop_back();
+
+	std::string page;
+	page += "OggS"sv;
+	page.push_back(0);
+	page.push_back(char(flags));
+	AppendLE64(page, granulepos);
+	AppendLE32(page, serial);
+	AppendLE32(page, 0); // sequence number
+	AppendLE32(page, 0); // checksum
+	page.push_back(char(lacing.size()));
+	page += lacing;
+	page += body;
+
+	std::string crc;
+	AppendLE32(crc, OggCrc(page));
+	page.replace(22, 4, crc);
+
+	dest += page;
+}
+
+TEST(OggHeaderScan, Basic)
+{
+	const std::string first(30, 'a'), second(600, 'b');
+
+	std::string ogg;
+	AppendOggPage(ogg, 1, 0x02, 0, {first});
+	AppendOggPage(ogg, 2, 0x02, 0, {"other stream"sv});
+	AppendOggPage(ogg, 1, 0, -1, {std::string_view{second}.substr(0, 510)}, false);
+	AppendOggPage(ogg, 2, 0, 100, {"other stream"sv});
+	AppendOggPage(ogg, 1, 0x01, 0, {std::string_view{second}.substr(510)});
+	AppendOggPage(ogg, 1, 0, 1000, {"audio"sv});
+	AppendOggPage(ogg, 1, 0x04, 123456, {"audio"sv});
+	AppendOggPage(ogg, 2, 0x04, 999999, {"other stream"sv});
+
+	TemporaryFile file(ogg);
+	FileRangeReader reader(file.GetPath());
+
+	OggHeaders headers;
+	ASSERT_TRUE(ReadOggHeaders(reader, 2, headers));
+	ASSERT_EQ(headers.packets.size(), 2U);
+	EXPECT_EQ(ToStringView(std::span{headers.packets[0]}), first);
+	EXPECT_EQ(ToStringView(std::span{headers.packets[1]}), second);
+	EXPECT_EQ(headers.last_granulepos, 123456);
+
+	/* not enough packets */
+	EXPECT_FALSE(ReadOggHeaders(reader, 5, headers));
+
+	/* garbage at the end of the file which looks like a page,
+	   but has a wrong checksum, is ignored */
+	std::string garbage;
+	AppendOggPage(garbage, 1, 0x04, 999999999, {"garbage"sv});
+	garbage[garbage.size() - 1] ^= 1;
+
+	TemporaryFile file2(ogg + garbage);
+	FileRangeReader reader2(file2.GetPath());
+	ASSERT_TRUE(ReadOggHeaders(reader2, 2, headers));
+	EXPECT_EQ(headers.last_granulepos, 123456);
+}
+
+TEST(OggHeaderScan, Malformed)
+{
+	/* the first page is not a BOS page */
+	std::string ogg;
+	AppendOggPage(ogg, 1, 0, 0, {"foo"sv, "bar"sv});
+
+	TemporaryFile file(ogg);
+	FileRangeReader reader(file.GetPath());
+
+	OggHeaders headers;
+	EXPECT_FALSE(ReadOggHeaders(reader, 1, headers));
+
+	/* truncated page */
+	ogg.clear();
+	AppendOggPage(ogg, 1, 0x02, 0, {"foo"sv, "bar"sv});
+	ogg.pop_back();
+
+	TemporaryFile truncated(ogg);
+	FileRangeReader truncated_reader(truncated.GetPath());
+	EXPECT_FALSE(ReadOggHeaders(truncated_reader, 1, headers));
+
+	/* wrong checksum */
+	ogg.clear();
+	AppendOggPage(ogg, 1, 0x02, 0, {"foo"sv, "bar"sv});
+	ogg.back() = 'X';
+
+	TemporaryFile corrupt(ogg);
+	FileRangeReader corrupt_reader(corrupt.GetPath());
+	EXPECT_FALSE(ReadOggHeaders(corrupt_reader, 1, headers));
+}
+
+static std::string
+Mp4Box(const char *type, std::string_view payload)
+{
+	std::string result;
+	AppendBE32(result, 8 + payload.size());
+	result += std::string_view{type, 4};
+	result += payload;
+	return result;
+}
+
+static std::string
+Mp4FullBox(const char *type, std::string_view payload)
+{
+	return Mp4Box(type, std::string(4, '\0') + std::string{payload});
+}
+
+static std::string
+Mp4DataBox(unsigned data_type, std::string_view value)
+{
+	std::string payload;
+	AppendBE32(payload, data_type);
+	AppendBE32(payload, 0); // locale
+	payload += value;
+	return Mp4Box("data", payload);
+}
+
+static std::string
+MakeMp4AudioTrack()
+{
+	std::string mdhd;
+	AppendBE32(mdhd, 0); // creation time
+	AppendBE32(mdhd, 0); // modification time
+	AppendBE32(mdhd, 44100);
+	AppendBE32(mdhd, 441000);
+	AppendBE32(mdhd, 0); // language, quality
+
+	std::string hdlr;
+	AppendBE32(hdlr, 0);
+	hdlr += "soun"sv;
+	hdlr.append(12, '\0');
+	hdlr += "SoundHandler\0"sv;
+
+	/* AudioSpecificConfig: AAC LC, 44.1 kHz, stereo */
+	const std::string asc{"\x12\x10", 2};
+	std::string decoder_config = "\x40\x15"s;
+	decoder_config.append(11, '\0');
+	decoder_config += "\x05"s + char(asc.size()) + asc;
+	std::string es = "\0\0\0"s;
+	es += "\x04"s + char(decoder_config.size()) + decoder_config;
+	es += "\x06\x01\x02"sv;
+	const std::string esds = Mp4FullBox("esds", "\x03"s + char(es.size()) + es);
+
+	std::string mp4a;
+	mp4a.append(6, '\0');
+	AppendBE16(mp4a, 1); // data reference index
+	AppendBE16(mp4a, 0); // version
+	AppendBE16(mp4a, 0); // revision
+	AppendBE32(mp4a, 0); // vendor
+	AppendBE16(mp4a, 2); // channels
+	AppendBE16(mp4a, 16); // sample size
+	AppendBE32(mp4a, 0);
+	AppendBE32(mp4a, 44100 << 16);
+	mp4a += esds;
+
+	std::string stsd;
+	AppendBE32(stsd, 1);
+	stsd += Mp4Box("mp4a", mp4a);
+
+	const std::string stbl = Mp4Box("stbl",
+					Mp4FullBox("stsd", stsd) +
+					Mp4FullBox("stts", std::string(4, '\0')));
+
+	return Mp4Box("trak",
+		      Mp4Box("mdia",
+			     Mp4FullBox("mdhd", mdhd) +
+			     Mp4FullBox("hdlr", hdlr) +
+			     Mp4Box("minf", stbl)));
+}
+
+static std::string
+MakeMp4Tags()
+{
+	std::string ilst;
+	ilst += Mp4Box("\xa9nam", Mp4DataBox(1, "Title"sv));
+	ilst += Mp4Box("\xa9""ART", Mp4DataBox(1, "Artist"sv));
+	ilst += Mp4Box("trkn", Mp4DataBox(0, "\0\0\0\x03\0\x0c\0\0"sv));
+	ilst += Mp4Box("\xa9too", Mp4DataBox(1, "Encoder"sv));
+	ilst += Mp4Box("----",
+		       Mp4FullBox("mean", "com.apple.iTunes"sv) +
+		       Mp4FullBox("name", "MusicBrainz Track Id"sv) +
+		       Mp4DataBox(1, "1234"sv));
+
+	std::string hdlr;
+	AppendBE32(hdlr, 0);
+	hdlr += "mdirappl"sv;
+	hdlr.append(10, '\0');
+
+	return Mp4Box("udta",
+		      Mp4FullBox("meta",
+				 Mp4FullBox("hdlr", hdlr) +
+				 Mp4Box("ilst", ilst)));
+}
+
+static std::string
+MakeMp4Movie()
+{
+	std::string mvhd;
+	AppendBE32(mvhd, 0);
+	AppendBE32(mvhd, 0);
+	AppendBE32(mvhd, 1000);
+	AppendBE32(mvhd, 9999);
+	mvhd.append(80, '\0');
+
+	return Mp4Box("moov",
+		      Mp4FullBox("mvhd", mvhd) +
+		      MakeMp4AudioTrack() +
+		      MakeMp4Tags());
+}
+
+TEST(Mp4Scan, Basic)
+{
+	/* "moov" after "mdat" */
+	std::string mp4 = Mp4Box("ftyp", "M4A \0\0\0\0M4A mp42isom"sv);
+	mp4 += Mp4Box("mdat", std::string(200000, '\x42'));
+	mp4 += MakeMp4Movie();
+
+	TemporaryFile file(mp4);
+	FileRangeReader reader(file.GetPath());
+
+	RecordTagHandler handler;
+	ASSERT_TRUE(ScanMp4Headers(reader, handler));
+	EXPECT_EQ(handler.duration, SongTime::FromS(10U));
+	EXPECT_EQ(handler.audio_format, AudioFormat(44100, SampleFormat::FLOAT, 2));
+	ASSERT_EQ(handler.tags.size(), 4U);
+	EXPECT_EQ(handler.tags[0], std::pair(TAG_TITLE, std::string{"Title"}));
+	EXPECT_EQ(handler.tags[1], std::pair(TAG_ARTIST, std::string{"Artist"}));
+	EXPECT_EQ(handler.tags[2], std::pair(TAG_TRACK, std::string{"3/12"}));
+	EXPECT_EQ(handler.tags[3], std::pair(TAG_MUSICBRAINZ_TRACKID, std::string{"1234"}));
+}
+
+TEST(Mp4Scan, Header)
+{
+	const std::string ftyp = Mp4Box("ftyp", "M4A \0\0\0\0"sv);
+	ASSERT_GE(ftyp.size(), MP4_HEADER_SIZE);
+	EXPECT_TRUE(IsMp4Header(std::as_bytes(std::span{ftyp}).first<MP4_HEADER_SIZE>()));
+
+	static constexpr char flac[] = "fLaC\0\0\0\x22";
+	EXPECT_FALSE(IsMp4Header(std::as_bytes(std::span{flac}).first<MP4_HEADER_SIZE>()));
+}
+
+TEST(Mp4Scan, Unsupported)
+{
+	std::string mp4 = Mp4Box("ftyp", "M4A \0\0\0\0M4A mp42isom"sv);
+	mp4 += MakeMp4Movie();
+
+	TemporaryFile file(mp4);
+	FileRangeReader reader(file.GetPath());
+
+	/* pairs and pictures are left to FFmpeg */
+	RecordTagHandler pair_handler(TagHandler::WANT_PAIR);
+	EXPECT_FALSE(ScanMp4Headers(reader, pair_handler));
+
+	RecordTagHandler picture_handler(TagHandler::WANT_PICTURE);
+	EXPECT_FALSE(ScanMp4Headers(reader, picture_handler));
+
+	/* truncated "moov" */
+	mp4.resize(mp4.size() - 20);
+	TemporaryFile truncated(mp4);
+	FileRangeReader truncated_reader(truncated.GetPath());
+
+	RecordTagHandler handler;
+	EXPECT_FALSE(ScanMp4Headers(truncated_reader, handler));
+	EXPECT_FALSE(handler.duration);
+	EXPECT_TRUE(handler.tags.empty());
+}
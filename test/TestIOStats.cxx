@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "iostats/Registry.hxx"
+#include "input/ThreadInputStream.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+using std::chrono::seconds;
+
+TEST(IOStats, Bucket)
+{
+	EXPECT_EQ(IOStatsSnapshot::GetBucket(nanoseconds{0}), 0U);
+	EXPECT_EQ(IOStatsSnapshot::GetBucket(nanoseconds{999}), 0U);
+	EXPECT_EQ(IOStatsSnapshot::GetBucket(microseconds{1}), 1U);
+	EXPECT_EQ(IOStatsSnapshot::GetBucket(microseconds{2}), 2U);
+	EXPECT_EQ(IOStatsSnapshot::GetBucket(microseconds{3}), 2U);
+	EXPECT_EQ(IOStatsSnapshot::GetBucket(microseconds{4}), 3U);
+	EXPECT_EQ(IOStatsSnapshot::GetBucket(seconds{3600}),
+		  IOStatsSnapshot::N_BUCKETS - 1);
+
+	/* every duration is below the limit of its bucket */
+	for (const auto d : {microseconds{1}, microseconds{5},
+			     microseconds{1000}, microseconds{123456}}) {
+		const auto i = IOStatsSnapshot::GetBucket(d);
+		EXPECT_LT(d, IOStatsSnapshot::GetBucketLimit(i));
+		EXPECT_GE(d, IOStatsSnapshot::GetBucketLimit(i - 1));
+	}
+}
+
+TEST(IOStats, Counter)
+{
+	IOStatsCounter counter;
+	for (unsigned i = 0; i < 98; ++i)
+		counter.Add(microseconds{100}, 1000);
+	counter.Add(microseconds{10000}, 1000);
+	counter.Add(microseconds{10000}, 0, true);
+
+	const auto s = counter.GetSnapshot();
+	EXPECT_EQ(s.count, 100U);
+	EXPECT_EQ(s.bytes, 99000U);
+	EXPECT_EQ(s.errors, 1U);
+	EXPECT_EQ(s.duration, microseconds{98 * 100 + 2 * 10000});
+	EXPECT_EQ(s.histogram[IOStatsSnapshot::GetBucket(microseconds{100})], 98U);
+	EXPECT_EQ(s.GetPercentile(0.5), microseconds{128});
+	EXPECT_EQ(s.GetPercentile(0.98), microseconds{128});
+	EXPECT_EQ(s.GetPercentile(0.99), microseconds{16384});
+
+	auto delta = counter.GetSnapshot();
+	counter.Add(microseconds{3});
+	delta = counter.GetSnapshot() -= delta;
+	EXPECT_EQ(delta.count, 1U);
+	EXPECT_EQ(delta.GetPercentile(0.5), microseconds{4});
+}
+
+TEST(IOStats, Registry)
+{
+	auto &a = GetIOStatsCounter("test:b", "read");
+	auto &b = GetIOStatsCounter("test:a", "read");
+	EXPECT_NE(&a, &b);
+	EXPECT_EQ(&a, &GetIOStatsCounter("test:b", "read"));
+
+	a.Add(microseconds{1}, 42);
+
+	const auto stats = CollectIOStats();
+	ASSERT_EQ(stats.size(), 2U);
+	EXPECT_EQ(stats[0].source, "test:a");
+	EXPECT_EQ(stats[1].source, "test:b");
+	EXPECT_EQ(stats[1].operation, "read");
+	EXPECT_EQ(stats[1].snapshot.bytes, 42U);
+}
+
+/**
+ * A #ThreadInputStream whose thread needs some time to deliver the
+ * first bytes, so the first Read() call stalls.
+ */
+class SlowInputStream final : public ThreadInputStream {
+	bool done = false;
+
+public:
+	explicit SlowInputStream(Mutex &_mutex)
+		:ThreadInputStream("test_slow", "test://slow", _mutex, 4096) {
+		Start();
+	}
+
+	~SlowInputStream() noexcept override {
+		Stop();
+	}
+
+protected:
+	std::size_t ThreadRead(std::span<std::byte> dest) override {
+		if (std::exchange(done, true))
+			return 0;
+
+		std::this_thread::sleep_for(milliseconds{20});
+
+		const std::size_t nbytes = std::min<std::size_t>(dest.size(), 100);
+		std::fill_n(dest.begin(), nbytes, std::byte{'x'});
+		return nbytes;
+	}
+};
+
+TEST(IOStats, ThreadInputStreamStall)
+{
+	Mutex mutex;
+	SlowInputStream is{mutex};
+
+	std::byte buffer[1024];
+
+	{
+		std::unique_lock lock{mutex};
+		EXPECT_EQ(is.Read(lock, buffer), 100U);
+	}
+
+	const auto s = GetIOStatsCounter("input:test_slow", "stall").GetSnapshot();
+	EXPECT_EQ(s.count, 1U);
+	EXPECT_EQ(s.bytes, 100U);
+	EXPECT_EQ(s.errors, 0U);
+	EXPECT_GE(s.duration, milliseconds{10});
+}
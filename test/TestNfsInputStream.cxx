@@ -0,0 +1,536 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Tests for the READ pipeline of the "nfs" input plugin.  The
+ * #NfsConnection methods are replaced with a fake which records the
+ * submitted operations, so the tests can complete them in any order
+ * and with any size they like.
+ */
+
+#include "input/plugins/NfsInputPlugin.hxx"
+#include "input/InputStream.hxx"
+#include "lib/nfs/Connection.hxx"
+#include "lib/nfs/Callback.hxx"
+#include "lib/nfs/Lease.hxx"
+#include "lib/nfs/Glue.hxx"
+#include "lib/nfs/Base.hxx"
+#include "event/Thread.hxx"
+#include "event/Call.hxx"
+#include "thread/Mutex.hxx"
+
+#include <nfsc/libnfs.h> // for struct nfs_stat_64
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+/**
+ * The plugin's default size of a READ call.
+ */
+static constexpr std::size_t READ_SIZE = 128 * 1024;
+
+static std::byte
+PatternAt(uint64_t offset) noexcept
+{
+	return std::byte(offset % 251);
+}
+
+static bool
+CheckPattern(uint64_t offset, std::span<const std::byte> data) noexcept
+{
+	for (std::size_t i = 0; i < data.size(); ++i)
+		if (data[i] != PatternAt(offset + i))
+			return false;
+	return true;
+}
+
+/**
+ * An operation submitted to the fake #NfsConnection.
+ */
+struct FakeOperation {
+	enum class Type { OPEN, STAT, READ } type;
+
+	NfsCallback *callback;
+
+	uint64_t offset = 0;
+	std::size_t size = 0;
+
+#ifdef LIBNFS_API_2
+	std::byte *dest = nullptr;
+#endif
+};
+
+/**
+ * The state of the fake #NfsConnection; only accessed from inside
+ * the I/O thread.
+ */
+static struct {
+	std::list<FakeOperation> pending;
+
+	uint64_t file_size;
+
+	unsigned n_cancelled, n_closed;
+
+	void Reset(uint64_t _file_size) noexcept {
+		pending.clear();
+		file_size = _file_size;
+		n_cancelled = n_closed = 0;
+	}
+} fake_server;
+
+static int fake_fh_value;
+static auto *const fake_fh = reinterpret_cast<struct nfsfh *>(&fake_fh_value);
+
+/*
+ * The #NfsConnection methods used by #NfsFileReader
+ *
+ */
+
+NfsConnection::NfsConnection(EventLoop &_loop,
+			     nfs_context *_context,
+			     std::string_view _server,
+			     std::string_view _export_name)
+	:socket_event(_loop, BIND_THIS_METHOD(OnSocketReady)),
+	 defer_new_lease(_loop, BIND_THIS_METHOD(RunDeferred)),
+	 mount_timeout_event(_loop, BIND_THIS_METHOD(OnMountTimeout)),
+	 server(_server), export_name(_export_name),
+	 context(_context)
+{
+}
+
+NfsConnection::~NfsConnection() noexcept = default;
+
+void
+NfsConnection::AddLease(NfsLease &lease) noexcept
+{
+	new_leases.push_back(lease);
+	defer_new_lease.Schedule();
+}
+
+void
+NfsConnection::RemoveLease(NfsLease &lease) noexcept
+{
+	lease.unlink();
+}
+
+void
+NfsConnection::Open(const char *, int, NfsCallback &callback)
+{
+	fake_server.pending.push_back({FakeOperation::Type::OPEN, &callback});
+}
+
+void
+NfsConnection::Stat(struct nfsfh *fh, NfsCallback &callback)
+{
+	EXPECT_EQ(fh, fake_fh);
+	fake_server.pending.push_back({FakeOperation::Type::STAT, &callback});
+}
+
+void
+NfsConnection::Read(struct nfsfh *fh, uint64_t offset,
+#ifdef LIBNFS_API_2
+		    std::span<std::byte> dest,
+#else
+		    std::size_t size,
+#endif
+		    NfsCallback &callback)
+{
+	EXPECT_EQ(fh, fake_fh);
+
+#ifdef LIBNFS_API_2
+	fake_server.pending.push_back({FakeOperation::Type::READ, &callback,
+				       offset, dest.size(), dest.data()});
+#else
+	fake_server.pending.push_back({FakeOperation::Type::READ, &callback,
+				       offset, size});
+#endif
+}
+
+void
+NfsConnection::Cancel(NfsCallback &callback, struct nfsfh *fh,
+		      DisposablePointer) noexcept
+{
+	const auto i = std::find_if(fake_server.pending.begin(),
+				    fake_server.pending.end(),
+				    [&callback](const auto &o){
+					    return o.callback == &callback;
+				    });
+	EXPECT_NE(i, fake_server.pending.end());
+	if (i != fake_server.pending.end())
+		fake_server.pending.erase(i);
+
+	++fake_server.n_cancelled;
+
+	if (fh != nullptr) {
+		EXPECT_EQ(fh, fake_fh);
+		++fake_server.n_closed;
+	}
+}
+
+void
+NfsConnection::Close(struct nfsfh *fh) noexcept
+{
+	EXPECT_EQ(fh, fake_fh);
+	++fake_server.n_closed;
+}
+
+void
+NfsConnection::RunDeferred() noexcept
+{
+	while (!new_leases.empty()) {
+		auto &lease = new_leases.pop_front();
+		active_leases.push_back(lease);
+		lease.OnNfsConnectionReady();
+	}
+}
+
+void
+NfsConnection::OnSocketReady(unsigned) noexcept
+{
+}
+
+void
+NfsConnection::OnMountTimeout() noexcept
+{
+}
+
+class FakeNfsConnection final : public NfsConnection {
+public:
+	explicit FakeNfsConnection(EventLoop &_loop)
+		:NfsConnection(_loop,
+			       reinterpret_cast<nfs_context *>(&fake_fh_value),
+			       "server", "/export") {}
+
+protected:
+	void OnNfsConnectionError(std::exception_ptr) noexcept override {}
+};
+
+/*
+ * The glue functions used by #NfsFileReader and the plugin
+ *
+ */
+
+void
+nfs_init(EventLoop &)
+{
+}
+
+void
+nfs_finish() noexcept
+{
+}
+
+EventLoop &
+nfs_get_event_loop() noexcept
+{
+	std::terminate();
+}
+
+NfsConnection &
+nfs_get_connection(std::string_view, std::string_view)
+{
+	throw std::runtime_error("Not implemented");
+}
+
+const char *
+nfs_check_base(const char *, const char *) noexcept
+{
+	return nullptr;
+}
+
+class NfsInputStreamTest : public ::testing::Test {
+protected:
+	EventThread io_thread;
+
+	Mutex mutex;
+
+	std::unique_ptr<FakeNfsConnection> connection;
+
+	InputStreamPtr is;
+
+	void SetUp() override {
+		io_thread.Start();
+		connection = std::make_unique<FakeNfsConnection>(io_thread.GetEventLoop());
+	}
+
+	void TearDown() override {
+		is.reset();
+		BlockingCall(io_thread.GetEventLoop(), [this](){
+			connection.reset();
+		});
+	}
+
+	/**
+	 * Invoke the function inside the I/O thread and wait for it
+	 * to return.
+	 */
+	template<typename F>
+	void Call(F &&f) {
+		BlockingCall(io_thread.GetEventLoop(), std::forward<F>(f));
+	}
+
+	/**
+	 * Wait until an operation of the given type has been
+	 * submitted, and remove it from the list.
+	 */
+	FakeOperation WaitOperation(FakeOperation::Type type) {
+		for (unsigned retry = 0; retry < 1000; ++retry) {
+			std::optional<FakeOperation> result;
+			Call([type, &result](){
+				auto &pending = fake_server.pending;
+				const auto i = std::find_if(pending.begin(), pending.end(),
+							    [type](const auto &o){
+								    return o.type == type;
+							    });
+				if (i != pending.end()) {
+					result = *i;
+					pending.erase(i);
+				}
+			});
+
+			if (result)
+				return *result;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		throw std::runtime_error("Timeout");
+	}
+
+	/**
+	 * Open a file of the given size and complete the OPEN and
+	 * STAT operations.
+	 */
+	void OpenFile(uint64_t size) {
+		Call([size](){ fake_server.Reset(size); });
+
+		is = OpenNfsInputStream(*connection, "/file.dsf", mutex);
+
+		const auto open = WaitOperation(FakeOperation::Type::OPEN);
+		Call([&open](){
+			open.callback->OnNfsCallback(0, fake_fh);
+		});
+
+		const auto stat = WaitOperation(FakeOperation::Type::STAT);
+		Call([&stat](){
+			struct nfs_stat_64 st{};
+			st.nfs_mode = S_IFREG|0644;
+			st.nfs_size = fake_server.file_size;
+			stat.callback->OnNfsCallback(0, &st);
+		});
+
+		const std::scoped_lock lock{mutex};
+		ASSERT_TRUE(is->IsReady());
+		ASSERT_EQ(is->GetSize(), size);
+	}
+
+	/**
+	 * @return the (offset, size) pairs of all pending READ
+	 * operations in submission order
+	 */
+	std::vector<std::pair<uint64_t, std::size_t>> GetPendingReads() {
+		std::vector<std::pair<uint64_t, std::size_t>> result;
+		Call([&result](){
+			for (const auto &o : fake_server.pending)
+				if (o.type == FakeOperation::Type::READ)
+					result.emplace_back(o.offset, o.size);
+		});
+		return result;
+	}
+
+	/**
+	 * Let the pending READ operation at the given offset
+	 * complete with the given number of bytes.
+	 */
+	void CompleteRead(uint64_t offset, std::size_t nbytes) {
+		Call([offset, nbytes](){
+			auto &pending = fake_server.pending;
+			const auto i = std::find_if(pending.begin(), pending.end(),
+						    [offset](const auto &o){
+							    return o.type == FakeOperation::Type::READ &&
+								    o.offset == offset;
+						    });
+			ASSERT_NE(i, pending.end());
+			ASSERT_LE(nbytes, i->size);
+
+			const auto o = *i;
+			pending.erase(i);
+
+#ifdef LIBNFS_API_2
+			std::byte *data = o.dest;
+#else
+			std::vector<std::byte> buffer(nbytes);
+			std::byte *data = buffer.data();
+#endif
+			for (std::size_t j = 0; j < nbytes; ++j)
+				data[j] = PatternAt(offset + j);
+
+			o.callback->OnNfsCallback(nbytes, data);
+		});
+	}
+
+	/**
+	 * Read everything from the stream which can be read without
+	 * blocking.
+	 */
+	std::vector<std::byte> ReadAvailable() {
+		std::vector<std::byte> result;
+
+		std::unique_lock lock{mutex};
+		while (!is->IsEOF() && is->IsAvailable()) {
+			std::byte buffer[16384];
+			const std::size_t nbytes = is->Read(lock, buffer);
+			result.insert(result.end(), buffer, buffer + nbytes);
+		}
+
+		return result;
+	}
+
+	uint64_t GetOffset() {
+		const std::scoped_lock lock{mutex};
+		return is->GetOffset();
+	}
+};
+
+TEST_F(NfsInputStreamTest, InOrder)
+{
+	OpenFile(3 * READ_SIZE);
+
+	/* the initial window has two requests */
+	ASSERT_EQ(GetPendingReads(),
+		  (std::vector<std::pair<uint64_t, std::size_t>>{
+			  {0, READ_SIZE}, {READ_SIZE, READ_SIZE},
+		  }));
+
+	/* the second response is held back until the first one
+	   arrives */
+	CompleteRead(READ_SIZE, READ_SIZE);
+	EXPECT_TRUE(ReadAvailable().empty());
+
+	CompleteRead(0, READ_SIZE);
+	auto data = ReadAvailable();
+	ASSERT_EQ(data.size(), 2 * READ_SIZE);
+	EXPECT_TRUE(CheckPattern(0, data));
+
+	/* the window has been refilled with the rest of the file */
+	ASSERT_EQ(GetPendingReads(),
+		  (std::vector<std::pair<uint64_t, std::size_t>>{
+			  {2 * READ_SIZE, READ_SIZE},
+		  }));
+
+	CompleteRead(2 * READ_SIZE, READ_SIZE);
+	data = ReadAvailable();
+	ASSERT_EQ(data.size(), READ_SIZE);
+	EXPECT_TRUE(CheckPattern(2 * READ_SIZE, data));
+
+	{
+		const std::scoped_lock lock{mutex};
+		EXPECT_TRUE(is->IsEOF());
+	}
+
+	EXPECT_TRUE(GetPendingReads().empty());
+
+	/* without pending requests, the file handle is closed right
+	   away */
+	is.reset();
+	Call([](){
+		EXPECT_EQ(fake_server.n_cancelled, 0U);
+		EXPECT_EQ(fake_server.n_closed, 1U);
+	});
+}
+
+TEST_F(NfsInputStreamTest, ShortRead)
+{
+	OpenFile(2 * READ_SIZE);
+
+	/* the rest of a short read is requested right away, and it
+	   is delivered before the next request */
+	CompleteRead(0, 1000);
+	auto data = ReadAvailable();
+	ASSERT_EQ(data.size(), 1000U);
+	EXPECT_TRUE(CheckPattern(0, data));
+
+	const auto reads = GetPendingReads();
+	ASSERT_EQ(reads.size(), 2U);
+	EXPECT_NE(std::find(reads.begin(), reads.end(),
+			    std::pair<uint64_t, std::size_t>{1000, READ_SIZE - 1000}),
+		  reads.end());
+
+	CompleteRead(READ_SIZE, READ_SIZE);
+	EXPECT_TRUE(ReadAvailable().empty());
+
+	CompleteRead(1000, READ_SIZE - 1000);
+	data = ReadAvailable();
+	ASSERT_EQ(data.size(), 2 * READ_SIZE - 1000);
+	EXPECT_TRUE(CheckPattern(1000, data));
+
+	const std::scoped_lock lock{mutex};
+	EXPECT_TRUE(is->IsEOF());
+}
+
+TEST_F(NfsInputStreamTest, SeekRefill)
+{
+	OpenFile(8 * READ_SIZE);
+
+	/* the second response arrives, but it is never delivered,
+	   because the first one is still pending when seeking */
+	CompleteRead(READ_SIZE, READ_SIZE);
+
+	const uint64_t new_offset = 5 * READ_SIZE + 17;
+
+	{
+		std::unique_lock lock{mutex};
+		is->Seek(lock, new_offset);
+	}
+
+	/* the pending request has been cancelled, and the window has
+	   been refilled starting at the new offset */
+	ASSERT_EQ(GetPendingReads(),
+		  (std::vector<std::pair<uint64_t, std::size_t>>{
+			  {new_offset, READ_SIZE},
+			  {new_offset + READ_SIZE, READ_SIZE},
+		  }));
+	Call([](){
+		EXPECT_EQ(fake_server.n_cancelled, 1U);
+		EXPECT_EQ(fake_server.n_closed, 0U);
+	});
+
+	EXPECT_EQ(GetOffset(), new_offset);
+
+	CompleteRead(new_offset, READ_SIZE);
+	const auto data = ReadAvailable();
+	ASSERT_EQ(data.size(), READ_SIZE);
+	EXPECT_TRUE(CheckPattern(new_offset, data));
+	EXPECT_EQ(GetOffset(), new_offset + READ_SIZE);
+}
+
+TEST_F(NfsInputStreamTest, Cancel)
+{
+	OpenFile(4 * READ_SIZE);
+
+	CompleteRead(READ_SIZE, READ_SIZE);
+
+	/* closing the stream cancels the request which is still
+	   pending (and discards the completed one); the cancelled
+	   request closes the file handle after it has finished */
+	is.reset();
+
+	EXPECT_TRUE(GetPendingReads().empty());
+	Call([](){
+		EXPECT_EQ(fake_server.n_cancelled, 1U);
+		EXPECT_EQ(fake_server.n_closed, 1U);
+	});
+}
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "PictureCache.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using std::string_view_literals::operator""sv;
+
+static constexpr std::chrono::system_clock::time_point t1{std::chrono::seconds{1}};
+static constexpr std::chrono::system_clock::time_point t2{std::chrono::seconds{2}};
+
+TEST(PictureCache, Basic)
+{
+	PictureCache cache;
+
+	EXPECT_EQ(cache.Get("a.flac"sv, t1), nullptr);
+	EXPECT_EQ(cache.GetMisses(), 1U);
+
+	const std::vector<std::byte> picture(1000, std::byte{0x42});
+	cache.Put("a.flac"sv, t1, "image/jpeg"sv, picture);
+
+	const auto *item = cache.Get("a.flac"sv, t1);
+	ASSERT_NE(item, nullptr);
+	EXPECT_EQ(item->mime_type, "image/jpeg"sv);
+	EXPECT_EQ(item->data.size(), picture.size());
+	EXPECT_EQ(cache.GetHits(), 1U);
+
+	/* a song without a picture */
+	cache.Put("b.flac"sv, t1, {}, {});
+	item = cache.Get("b.flac"sv, t1);
+	ASSERT_NE(item, nullptr);
+	EXPECT_TRUE(item->data.empty());
+
+	/* modified file */
+	EXPECT_EQ(cache.Get("a.flac"sv, t2), nullptr);
+	EXPECT_EQ(cache.Get("a.flac"sv, t1), nullptr);
+
+	cache.Flush();
+	EXPECT_EQ(cache.Get("b.flac"sv, t1), nullptr);
+	EXPECT_EQ(cache.GetHits(), 2U);
+	EXPECT_EQ(cache.GetMisses(), 4U);
+}
+
+TEST(PictureCache, Evict)
+{
+	PictureCache cache;
+
+	const std::vector<std::byte> picture(6 * 1024 * 1024);
+	cache.Put("a"sv, t1, {}, picture);
+	cache.Put("b"sv, t1, {}, picture);
+
+	/* touch "a" so "b" is the least recently used item */
+	EXPECT_NE(cache.Get("a"sv, t1), nullptr);
+
+	cache.Put("c"sv, t1, {}, picture);
+	EXPECT_NE(cache.Get("a"sv, t1), nullptr);
+	EXPECT_EQ(cache.Get("b"sv, t1), nullptr);
+	EXPECT_NE(cache.Get("c"sv, t1), nullptr);
+
+	/* too large to be cached */
+	const std::vector<std::byte> huge(9 * 1024 * 1024);
+	cache.Put("d"sv, t1, {}, huge);
+	EXPECT_EQ(cache.Get("d"sv, t1), nullptr);
+	EXPECT_NE(cache.Get("a"sv, t1), nullptr);
+}
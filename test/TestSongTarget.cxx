@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "db/plugins/simple/Song.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/ExportedSong.hxx"
+#include "db/DatabaseLock.hxx"
+#include "tag/Builder.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+using std::string_view_literals::operator""sv;
+
+static Tag
+MakeTag(TagType type, const char *value) noexcept
+{
+	TagBuilder builder;
+	builder.AddItem(type, value);
+	return builder.Commit();
+}
+
+static const char *
+GetArtist(const LightSong &song) noexcept
+{
+	return song.tag.GetValue(TAG_ARTIST);
+}
+
+/**
+ * A CUE track "x.cue/track001" which points to the song file
+ * "x.flac".
+ */
+class SongTargetTest : public ::testing::Test {
+protected:
+	const ScopeDatabaseLock protect;
+
+	std::unique_ptr<Directory> root{Directory::NewRoot()};
+	Song *track;
+
+	void SetUp() override {
+		auto &cue = *root->MakeChild("x.cue"sv);
+
+		auto song = std::make_unique<Song>("track001", cue);
+		song->target = "../x.flac";
+		song->tag = MakeTag(TAG_TITLE, "Title");
+		track = song.get();
+		cue.AddSong(std::move(song));
+	}
+
+	Song &AddTarget(const char *artist) noexcept {
+		auto song = std::make_unique<Song>("x.flac", *root);
+		song->tag = MakeTag(TAG_ARTIST, artist);
+		auto &result = *song;
+		root->AddSong(std::move(song));
+		return result;
+	}
+
+	void RemoveTarget() noexcept {
+		root->RemoveSong(root->FindSong("x.flac"sv));
+	}
+};
+
+TEST_F(SongTargetTest, Added)
+{
+	EXPECT_EQ(GetArtist(track->Export()), nullptr);
+
+	AddTarget("A");
+
+	const auto e = track->Export();
+	EXPECT_STREQ(GetArtist(e), "A");
+	EXPECT_STREQ(e.tag.GetValue(TAG_TITLE), "Title");
+}
+
+TEST_F(SongTargetTest, Replaced)
+{
+	AddTarget("A");
+	EXPECT_STREQ(GetArtist(track->Export()), "A");
+
+	RemoveTarget();
+	AddTarget("B");
+	EXPECT_STREQ(GetArtist(track->Export()), "B");
+}
+
+TEST_F(SongTargetTest, Modified)
+{
+	auto &target = AddTarget("A");
+	EXPECT_STREQ(GetArtist(track->Export()), "A");
+
+	/* this is what the database update does after reloading a
+	   song's tags */
+	target.tag = MakeTag(TAG_ARTIST, "B");
+	InvalidateSongTargets();
+
+	EXPECT_STREQ(GetArtist(track->Export()), "B");
+}
+
+TEST_F(SongTargetTest, Removed)
+{
+	AddTarget("A");
+	EXPECT_STREQ(GetArtist(track->Export()), "A");
+
+	RemoveTarget();
+
+	const auto e = track->Export();
+	EXPECT_EQ(GetArtist(e), nullptr);
+	EXPECT_STREQ(e.tag.GetValue(TAG_TITLE), "Title");
+}
+
+TEST_F(SongTargetTest, Lifetime)
+{
+	/* an #ExportedSong owns its merged tag; it survives the
+	   invalidation of the cache */
+	AddTarget("A");
+	const auto e = track->Export();
+
+	RemoveTarget();
+	AddTarget("B");
+	EXPECT_STREQ(GetArtist(track->Export()), "B");
+
+	EXPECT_STREQ(GetArtist(e), "A");
+}
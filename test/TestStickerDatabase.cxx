@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "sticker/Database.hxx"
+#include "sticker/WriteQueue.hxx"
+#include "lib/sqlite/Database.hxx"
+#include "lib/sqlite/Util.hxx"
+#include "fs/Path.hxx"
+#include "Idle.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+void
+idle_add([[maybe_unused]] unsigned flags)
+{
+}
+
+class StickerDatabaseTest : public ::testing::Test {
+protected:
+	std::string directory, path;
+
+	void SetUp() override {
+		char buffer[] = "/tmp/TestStickerDatabase.XXXXXX";
+		ASSERT_NE(mkdtemp(buffer), nullptr);
+		directory = buffer;
+		path = directory + "/sticker.sql";
+	}
+
+	void TearDown() override {
+		for (const char *suffix : {"", "-wal", "-shm"})
+			unlink((path + suffix).c_str());
+		rmdir(directory.c_str());
+	}
+
+	StickerDatabase Open() const {
+		return StickerDatabase{Path::FromFS(path.c_str())};
+	}
+
+	/**
+	 * Execute SQL on a separate connection, bypassing
+	 * #StickerDatabase.
+	 */
+	void Execute(const char *sql) const {
+		Sqlite::Database db{path.c_str()};
+		ASSERT_EQ(sqlite3_exec(db, sql, nullptr, nullptr, nullptr),
+			  SQLITE_OK) << sqlite3_errmsg(db);
+	}
+
+	unsigned CountRows(const char *table) const {
+		Sqlite::Database db{path.c_str()};
+		const auto sql = std::string{"SELECT COUNT(*) FROM "} + table;
+		sqlite3_stmt *const s = Sqlite::Prepare(db, sql.c_str());
+		unsigned n = 0;
+		if (Sqlite::ExecuteRow(s))
+			n = sqlite3_column_int(s, 0);
+		sqlite3_finalize(s);
+		return n;
+	}
+
+	/**
+	 * Let each INSERT of a sticker named "bad" fail with
+	 * RAISE(FAIL), which (unlike ABORT) keeps the changes the
+	 * statement has already made, i.e. the row in "attempts".
+	 * Only a "ROLLBACK TO" discards it.
+	 */
+	void InstallFailingTrigger() const {
+		Execute("CREATE TABLE attempts(uri VARCHAR NOT NULL);"
+			"CREATE TRIGGER reject_bad BEFORE INSERT ON sticker "
+			"BEGIN "
+			" INSERT INTO attempts(uri) VALUES(NEW.uri);"
+			" SELECT RAISE(FAIL, 'rejected') WHERE NEW.name='bad';"
+			"END;");
+	}
+};
+
+static std::vector<std::string>
+FindUris(StickerDatabase &db, const char *base_uri)
+{
+	std::vector<std::string> result;
+	db.Find("song", base_uri, "x", StickerOperator::EXISTS, nullptr,
+		"", false, RangeArg::All(),
+		[](const char *uri, const char *, void *user_data){
+			auto &r = *(std::vector<std::string> *)user_data;
+			r.emplace_back(uri);
+		}, &result);
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+using Uris = std::vector<std::string>;
+
+TEST_F(StickerDatabaseTest, FindPrefixNoCase)
+{
+	auto db = Open();
+	for (const char *uri : {"Artist/a", "artist/b", "ARTIST/c",
+				"Artist", "artiss/d", "artisu/e",
+				"artist0/f", "Other/g"})
+		db.StoreValue("song", uri, "x", "1");
+
+	/* the prefix is matched case-insensitively, whatever the
+	   case of the prefix and the URI */
+	const Uris artist_dir{"ARTIST/c", "Artist/a", "artist/b"};
+	EXPECT_EQ(FindUris(db, "artist/"), artist_dir);
+	EXPECT_EQ(FindUris(db, "ARTIST/"), artist_dir);
+	EXPECT_EQ(FindUris(db, "ArTiSt/"), artist_dir);
+
+	EXPECT_EQ(FindUris(db, "aRtIsT"),
+		  (Uris{"ARTIST/c", "Artist", "Artist/a", "artist/b",
+			"artist0/f"}));
+
+	/* the last character of the prefix is incremented for the
+	   upper bound, which must not match the next letter */
+	EXPECT_EQ(FindUris(db, "ARTISS"), (Uris{"artiss/d"}));
+
+	EXPECT_EQ(FindUris(db, "o"), (Uris{"Other/g"}));
+	EXPECT_EQ(FindUris(db, "x"), Uris{});
+
+	/* no prefix */
+	EXPECT_EQ(FindUris(db, "").size(), 8u);
+}
+
+TEST_F(StickerDatabaseTest, FindPrefixBeforeUpperCase)
+{
+	auto db = Open();
+	for (const char *uri : {"b@/1", "b@", "bA", "ba", "b[", "b?"})
+		db.StoreValue("song", uri, "x", "1");
+
+	/* the character after '@' is 'A', but no folded character
+	   is upper case, so the bound must be '[' */
+	EXPECT_EQ(FindUris(db, "b@"), (Uris{"b@", "b@/1"}));
+	EXPECT_EQ(FindUris(db, "B@"), (Uris{"b@", "b@/1"}));
+}
+
+TEST_F(StickerDatabaseTest, FindPrefixTilde)
+{
+	auto db = Open();
+	for (const char *uri : {"a~/1", "A~2", "a~", "a}", "a\x7f", "b"})
+		db.StoreValue("song", uri, "x", "1");
+
+	/* the upper bound is "a\x7f" */
+	EXPECT_EQ(FindUris(db, "a~"), (Uris{"A~2", "a~", "a~/1"}));
+}
+
+TEST_F(StickerDatabaseTest, FindPrefixFF)
+{
+	auto db = Open();
+	for (const char *uri : {"a\xff", "a\xff\xff/1", "A\xff" "2", "a\xfe",
+				"b", "B/1", "\xff", "\xff\xff/2"})
+		db.StoreValue("song", uri, "x", "1");
+
+	/* trailing 0xff bytes are removed and the byte before them
+	   is incremented, i.e. the upper bound is "b" */
+	EXPECT_EQ(FindUris(db, "a\xff"),
+		  (Uris{"A\xff" "2", "a\xff", "a\xff\xff/1"}));
+	EXPECT_EQ(FindUris(db, "A\xff\xff"), (Uris{"a\xff\xff/1"}));
+
+	/* a prefix consisting only of 0xff bytes has no upper
+	   bound */
+	EXPECT_EQ(FindUris(db, "\xff"), (Uris{"\xff", "\xff\xff/2"}));
+	EXPECT_EQ(FindUris(db, "\xff\xff"), (Uris{"\xff\xff/2"}));
+}
+
+TEST_F(StickerDatabaseTest, WriteQueueBatch)
+{
+	auto db = Open();
+
+	std::vector<StickerDatabase::Modification> committed;
+
+	{
+		StickerWriteQueue queue{db};
+
+		using Operation = StickerDatabase::Modification::Operation;
+		queue.Push({Operation::SET, "song", "a", "rating", "5"});
+		queue.Push({Operation::INC, "song", "a", "rating", "3"});
+		queue.Push({Operation::SET, "album", "b", "rating", "1"});
+		queue.Push({Operation::DEC, "song", "a", "rating", "1"});
+		queue.Push({Operation::INC, "song", "c", "playcount", "1"});
+
+		/* the queue's connection has not committed yet */
+		EXPECT_EQ(db.LoadValue("song", "a", "rating"), "");
+
+		queue.Flush();
+		EXPECT_FALSE(queue.HasFailed());
+
+		/* modifications are applied in submission order */
+		EXPECT_EQ(db.LoadValue("song", "a", "rating"), "7");
+		EXPECT_EQ(db.LoadValue("album", "b", "rating"), "1");
+		EXPECT_EQ(db.LoadValue("song", "c", "playcount"), "1");
+
+		/* only "song" modifications are passed back */
+		committed = queue.TakeCommitted();
+		EXPECT_TRUE(queue.TakeCommitted().empty());
+
+		/* the destructor commits what is still pending */
+		queue.Push({Operation::SET, "song", "d", "rating", "2"});
+	}
+
+	EXPECT_EQ(db.LoadValue("song", "d", "rating"), "2");
+
+	ASSERT_EQ(committed.size(), 4u);
+	EXPECT_EQ(committed[0].value, "5");
+	EXPECT_EQ(committed[1].value, "3");
+	EXPECT_EQ(committed[2].value, "1");
+	EXPECT_EQ(committed[2].uri, "a");
+	EXPECT_EQ(committed[3].uri, "c");
+}
+
+TEST_F(StickerDatabaseTest, WriteQueueColumn)
+{
+	auto db = Open();
+	db.StoreValue("song", "a", "rating", "1");
+
+	const auto column = db.GetSongStickerColumn("rating");
+	ASSERT_NE(column, nullptr);
+
+	db.EnableWriteQueue();
+	db.IncValue("song", "a", "rating", "2");
+	db.StoreValue("song", "b", "rating", "4");
+
+	/* reading waits for the queue and applies the committed
+	   modifications to the column */
+	EXPECT_EQ(db.LoadValue("song", "a", "rating"), "3");
+	ASSERT_NE(column->Find("a"), nullptr);
+	EXPECT_EQ(*column->Find("a"), "3");
+	ASSERT_NE(column->Find("b"), nullptr);
+	EXPECT_EQ(*column->Find("b"), "4");
+}
+
+TEST_F(StickerDatabaseTest, BatchStoreRollback)
+{
+	auto db = Open();
+	InstallFailingTrigger();
+
+	using Operation = StickerDatabase::Modification::Operation;
+	const std::vector<StickerDatabase::Modification> batch{
+		{Operation::SET, "song", "a", "good", "1"},
+		{Operation::SET, "song", "b", "bad", "2"},
+		{Operation::INC, "song", "c", "good", "3"},
+	};
+
+	const auto errors = db.BatchStoreNoIdle(batch);
+	ASSERT_EQ(errors.size(), batch.size());
+	EXPECT_FALSE(errors[0]);
+	EXPECT_TRUE(errors[1]);
+	EXPECT_FALSE(errors[2]);
+
+	/* the failed modification does not discard the others */
+	EXPECT_EQ(db.LoadValue("song", "a", "good"), "1");
+	EXPECT_EQ(db.LoadValue("song", "b", "bad"), "");
+	EXPECT_EQ(db.LoadValue("song", "c", "good"), "3");
+
+	/* the partial changes of the failed statement have been
+	   rolled back to its SAVEPOINT */
+	EXPECT_EQ(CountRows("attempts"), 2u);
+}
+
+TEST_F(StickerDatabaseTest, WriteQueueFallback)
+{
+	auto db = Open();
+	InstallFailingTrigger();
+
+	db.EnableWriteQueue();
+
+	/* the error cannot be reported to the caller, which has
+	   already returned */
+	EXPECT_NO_THROW(db.StoreValue("song", "a", "bad", "1"));
+	db.StoreValue("song", "a", "good", "1");
+	EXPECT_EQ(db.LoadValue("song", "a", "good"), "1");
+	EXPECT_EQ(db.LoadValue("song", "a", "bad"), "");
+
+	/* after the failure, modifications are synchronous, so the
+	   caller sees the error */
+	EXPECT_ANY_THROW(db.StoreValue("song", "b", "bad", "1"));
+	EXPECT_EQ(db.LoadValue("song", "b", "bad"), "");
+
+	/* a successful synchronous modification switches back to
+	   the queue */
+	db.StoreValue("song", "b", "good", "2");
+	EXPECT_EQ(db.LoadValue("song", "b", "good"), "2");
+
+	EXPECT_NO_THROW(db.StoreValue("song", "c", "bad", "1"));
+	EXPECT_EQ(db.LoadValue("song", "c", "bad"), "");
+}
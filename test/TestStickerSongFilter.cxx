@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+#include "sticker/Column.hxx"
+#include "tag/Tag.hxx"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+class FakeStickerColumns final : public StickerColumnProvider {
+public:
+	std::map<std::string, std::shared_ptr<StickerColumn>, std::less<>> columns;
+
+	StickerColumn &operator[](const std::string &name) noexcept {
+		auto &column = columns[name];
+		if (!column)
+			column = std::make_shared<StickerColumn>();
+		return *column;
+	}
+
+	std::shared_ptr<const StickerColumn> GetSongStickerColumn(const std::string &name) override {
+		(*this)[name];
+		return columns[name];
+	}
+};
+
+} // anonymous namespace
+
+static SongFilter
+ParseFilter(const char *expression, StickerColumnProvider *stickers)
+{
+	SongFilter filter;
+	const char *const args[] = {expression};
+	filter.Parse(args, false, stickers);
+	return filter;
+}
+
+static bool
+Match(const SongFilter &filter, const char *directory, const char *uri) noexcept
+{
+	const Tag tag;
+	LightSong song{uri, tag};
+	song.directory = directory;
+	return filter.Match(song);
+}
+
+TEST(StickerSongFilter, Integer)
+{
+	FakeStickerColumns stickers;
+	auto &rating = stickers["rating"];
+	rating.Set("a/x.flac", "5");
+	rating.Set("a/y.flac", "3");
+	rating.Set("z.flac", "4");
+
+	const auto f = ParseFilter("(sticker:rating >= 4)", &stickers);
+	EXPECT_EQ(f.ToExpression(), "(sticker:rating >= 4)");
+
+	EXPECT_TRUE(Match(f, "a", "x.flac"));
+	EXPECT_FALSE(Match(f, "a", "y.flac"));
+	EXPECT_TRUE(Match(f, nullptr, "z.flac"));
+
+	/* songs without the sticker never match */
+	EXPECT_FALSE(Match(f, nullptr, "w.flac"));
+	EXPECT_FALSE(Match(ParseFilter("(sticker:rating != 4)", &stickers),
+			   nullptr, "w.flac"));
+
+	/* modifications are visible to existing filters */
+	rating.Set("a/y.flac", "4");
+	EXPECT_TRUE(Match(f, "a", "y.flac"));
+	rating.Erase("a/x.flac");
+	EXPECT_FALSE(Match(f, "a", "x.flac"));
+}
+
+TEST(StickerSongFilter, String)
+{
+	FakeStickerColumns stickers;
+	stickers["mood"].Set("x.flac", "happy");
+
+	const auto f = ParseFilter("(sticker:mood == \"happy\")", &stickers);
+	EXPECT_EQ(f.ToExpression(), "(sticker:mood == \"happy\")");
+	EXPECT_TRUE(Match(f, nullptr, "x.flac"));
+
+	EXPECT_FALSE(Match(ParseFilter("(sticker:mood < 'happy')", &stickers),
+			   nullptr, "x.flac"));
+	EXPECT_TRUE(Match(ParseFilter("(!(sticker:mood == 'sad'))", &stickers),
+			  nullptr, "x.flac"));
+}
+
+TEST(StickerSongFilter, ParseErrors)
+{
+	FakeStickerColumns stickers;
+
+	EXPECT_THROW(ParseFilter("(sticker:rating >= 4)", nullptr),
+		     std::runtime_error);
+	EXPECT_THROW(ParseFilter("(sticker: >= 4)", &stickers),
+		     std::runtime_error);
+	EXPECT_THROW(ParseFilter("(sticker:rating =~ 4)", &stickers),
+		     std::runtime_error);
+	EXPECT_THROW(ParseFilter("(sticker:rating >= x)", &stickers),
+		     std::runtime_error);
+	EXPECT_THROW(ParseFilter("(sticker:rating >= 4", &stickers),
+		     std::runtime_error);
+}
+
+TEST(StickerColumn, Add)
+{
+	StickerColumn column;
+
+	column.Add("x", "2", false);
+	EXPECT_EQ(*column.Find("x"), "2");
+
+	column.Add("x", "3", false);
+	EXPECT_EQ(*column.Find("x"), "5");
+
+	column.Add("x", "7", true);
+	EXPECT_EQ(*column.Find("x"), "-2");
+
+	column.Add("x", "0.5", false);
+	EXPECT_EQ(*column.Find("x"), "-1.5");
+
+	column.Add("x", "1.5", false);
+	EXPECT_EQ(*column.Find("x"), "0.0");
+
+	column.Set("y", "foo");
+	column.Add("y", "1", false);
+	EXPECT_EQ(*column.Find("y"), "1");
+
+	/* like SQLite, a missing value is initialized with the
+	   operand, even when decrementing */
+	column.Add("z", "3", true);
+	EXPECT_EQ(*column.Find("z"), "3");
+}
+
+TEST(StickerColumn, FindSplit)
+{
+	StickerColumn column;
+	column.Set("a/b/x.flac", "1");
+	column.Set("y.flac", "2");
+
+	EXPECT_EQ(*column.Find("a/b", "x.flac"), "1");
+	EXPECT_EQ(*column.Find("a", "b/x.flac"), "1");
+	EXPECT_EQ(*column.Find(nullptr, "a/b/x.flac"), "1");
+	EXPECT_EQ(*column.Find(nullptr, "y.flac"), "2");
+
+	EXPECT_EQ(column.Find("a", "x.flac"), nullptr);
+	EXPECT_EQ(column.Find("a/b/", "x.flac"), nullptr);
+	EXPECT_EQ(column.Find("", "y.flac"), nullptr);
+	EXPECT_EQ(column.Find("a/b", "x.flac.bak"), nullptr);
+}
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "db/update/PathTree.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using List = std::vector<std::string>;
+
+TEST(UpdatePathTree, Empty)
+{
+	UpdatePathTree tree{64};
+	EXPECT_TRUE(tree.empty());
+	EXPECT_EQ(tree.TakeAll(), List{});
+
+	tree.Insert("a");
+	EXPECT_FALSE(tree.empty());
+	EXPECT_EQ(tree.TakeAll(), List{"a"});
+
+	/* TakeAll() has cleared the tree */
+	EXPECT_TRUE(tree.empty());
+	EXPECT_EQ(tree.TakeAll(), List{});
+}
+
+TEST(UpdatePathTree, Sorted)
+{
+	UpdatePathTree tree{64};
+	tree.Insert("b/y");
+	tree.Insert("a");
+	tree.Insert("b/x");
+	tree.Insert("c/d/e");
+
+	EXPECT_EQ(tree.TakeAll(), (List{"a", "b/x", "b/y", "c/d/e"}));
+}
+
+TEST(UpdatePathTree, Duplicate)
+{
+	UpdatePathTree tree{64};
+	tree.Insert("a/b");
+	tree.Insert("a/b");
+	tree.Insert("a//b/");
+
+	EXPECT_EQ(tree.TakeAll(), List{"a/b"});
+}
+
+TEST(UpdatePathTree, CoveredByAncestor)
+{
+	/* a path below a pending directory is dropped */
+	UpdatePathTree tree{64};
+	tree.Insert("a");
+	tree.Insert("a/b");
+	tree.Insert("a/b/c");
+
+	EXPECT_EQ(tree.TakeAll(), List{"a"});
+}
+
+TEST(UpdatePathTree, CollapseDescendants)
+{
+	/* a new path replaces its pending descendants, but not its
+	   siblings */
+	UpdatePathTree tree{64};
+	tree.Insert("a/b/c");
+	tree.Insert("a/b/d");
+	tree.Insert("a/e");
+	tree.Insert("ab");
+	tree.Insert("a/b");
+
+	EXPECT_EQ(tree.TakeAll(), (List{"a/b", "a/e", "ab"}));
+}
+
+TEST(UpdatePathTree, Root)
+{
+	/* the root directory covers everything */
+	UpdatePathTree tree{64};
+	tree.Insert("a");
+	tree.Insert("");
+	tree.Insert("b");
+
+	EXPECT_EQ(tree.TakeAll(), List{""});
+}
+
+TEST(UpdatePathTree, Coalesce)
+{
+	UpdatePathTree tree{3};
+	tree.Insert("x/a");
+	tree.Insert("x/b");
+	tree.Insert("y");
+
+	EXPECT_EQ(tree.TakeAll(), (List{"x/a", "x/b", "y"}));
+
+	/* the third pending subdirectory of "x" makes "x" itself
+	   pending */
+	tree.Insert("x/a");
+	tree.Insert("x/b");
+	tree.Insert("x/c");
+	tree.Insert("y");
+
+	EXPECT_EQ(tree.TakeAll(), (List{"x", "y"}));
+
+	/* a pending path further down does not count */
+	tree.Insert("x/a");
+	tree.Insert("x/b");
+	tree.Insert("x/c/d");
+
+	EXPECT_EQ(tree.TakeAll(), (List{"x/a", "x/b", "x/c/d"}));
+}
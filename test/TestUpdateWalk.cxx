@@ -0,0 +1,327 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "db/update/Walk.hxx"
+#include "db/update/Config.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "playlist/PlaylistRegistry.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/DatabaseLock.hxx"
+#include "storage/StorageInterface.hxx"
+#include "storage/InstrumentedStorage.hxx"
+#include "storage/FileInfo.hxx"
+#include "config/Data.hxx"
+#include "event/Loop.hxx"
+#include "system/Error.hxx"
+
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::string_view_literals::operator""sv;
+
+/* the fake storage contains only directories; these are never
+   called */
+
+const DecoderPlugin *const decoder_plugins[] = {nullptr};
+bool decoder_plugins_enabled[1];
+
+bool
+decoder_plugins_supports_suffix(std::string_view) noexcept
+{
+	return false;
+}
+
+bool
+DecoderPlugin::SupportsSuffix(std::string_view) const noexcept
+{
+	return false;
+}
+
+const PlaylistPlugin *
+FindPlaylistPluginBySuffix(std::string_view) noexcept
+{
+	return nullptr;
+}
+
+bool
+GetPlaylistPluginAsFolder(const PlaylistPlugin &) noexcept
+{
+	return false;
+}
+
+SongPtr
+Song::LoadFile(Storage &, std::string_view, const StorageFileInfo &,
+	       Directory &)
+{
+	return nullptr;
+}
+
+bool
+Song::UpdateFile(Storage &, const StorageFileInfo &)
+{
+	return false;
+}
+
+#ifdef ENABLE_ARCHIVE
+
+bool
+UpdateWalk::UpdateArchiveFile(Directory &, std::string_view,
+			      std::string_view, const StorageFileInfo &) noexcept
+{
+	return false;
+}
+
+#endif
+
+static constexpr std::chrono::system_clock::time_point
+MakeTime(unsigned seconds) noexcept
+{
+	return std::chrono::system_clock::time_point{std::chrono::seconds{seconds}};
+}
+
+/**
+ * An in-memory #Storage which records which directories were
+ * enumerated and which were announced with PrefetchDirectory().
+ */
+class FakeStorage final : public Storage {
+	/**
+	 * All directories; the key is the URI, the value the
+	 * modification time.
+	 */
+	std::map<std::string, std::chrono::system_clock::time_point,
+		 std::less<>> directories{{{}, MakeTime(1)}};
+
+public:
+	std::multiset<std::string, std::less<>> opened, prefetched;
+
+	void MakeDirectory(std::string_view uri, unsigned mtime) noexcept {
+		directories.insert_or_assign(std::string{uri}, MakeTime(mtime));
+	}
+
+	void Touch(std::string_view uri, unsigned mtime) noexcept {
+		directories.find(uri)->second = MakeTime(mtime);
+	}
+
+	void Remove(std::string_view uri) noexcept {
+		directories.erase(directories.find(uri));
+	}
+
+	/* virtual methods from class Storage */
+	StorageFileInfo GetInfo(std::string_view uri_utf8, bool) override {
+		const auto i = directories.find(uri_utf8);
+		if (i == directories.end())
+			throw MakeErrno(ENOENT, "No such directory");
+
+		StorageFileInfo info{StorageFileInfo::Type::DIRECTORY};
+		info.mtime = i->second;
+		return info;
+	}
+
+	std::unique_ptr<StorageDirectoryReader> OpenDirectory(std::string_view uri_utf8) override;
+
+	void PrefetchDirectory(std::string_view uri_utf8) noexcept override {
+		prefetched.emplace(uri_utf8);
+	}
+
+	std::string MapUTF8(std::string_view uri_utf8) const noexcept override {
+		return std::string{uri_utf8};
+	}
+
+	std::string_view MapToRelativeUTF8(std::string_view) const noexcept override {
+		return {};
+	}
+
+	InputStreamPtr OpenFile(std::string_view, Mutex &) override {
+		throw MakeErrno(ENOENT, "No such file");
+	}
+};
+
+class FakeDirectoryReader final : public StorageDirectoryReader {
+	std::vector<std::pair<std::string, StorageFileInfo>> entries;
+	std::size_t next = 0;
+
+public:
+	void Add(std::string_view name, const StorageFileInfo &info) noexcept {
+		entries.emplace_back(name, info);
+	}
+
+	/* virtual methods from class StorageDirectoryReader */
+	const char *Read() noexcept override {
+		if (next >= entries.size())
+			return nullptr;
+
+		return entries[next++].first.c_str();
+	}
+
+	StorageFileInfo GetInfo(bool) override {
+		return entries[next - 1].second;
+	}
+};
+
+std::unique_ptr<StorageDirectoryReader>
+FakeStorage::OpenDirectory(std::string_view uri_utf8)
+{
+	if (!directories.contains(uri_utf8))
+		throw MakeErrno(ENOENT, "No such directory");
+
+	opened.emplace(uri_utf8);
+
+	auto reader = std::make_unique<FakeDirectoryReader>();
+	for (const auto &[uri, mtime] : directories) {
+		std::string_view name = uri;
+		if (uri_utf8.empty()) {
+			if (name.empty() || name.find('/') != name.npos)
+				continue;
+		} else {
+			if (!name.starts_with(uri_utf8) ||
+			    name.size() <= uri_utf8.size() ||
+			    name[uri_utf8.size()] != '/')
+				continue;
+
+			name = name.substr(uri_utf8.size() + 1);
+			if (name.find('/') != name.npos)
+				continue;
+		}
+
+		StorageFileInfo info{StorageFileInfo::Type::DIRECTORY};
+		info.mtime = mtime;
+		reader->Add(name, info);
+	}
+
+	return reader;
+}
+
+class NullDatabaseListener final : public DatabaseListener {
+public:
+	void OnDatabaseModified() noexcept override {}
+	void OnDatabaseSongRemoved(const char *) noexcept override {}
+};
+
+class UpdateWalkTest : public ::testing::Test {
+protected:
+	EventLoop event_loop;
+	NullDatabaseListener listener;
+
+	std::unique_ptr<FakeStorage> fake_storage = std::make_unique<FakeStorage>();
+	FakeStorage &storage = *fake_storage;
+
+	/**
+	 * The walk uses the storage through the same wrapper as all
+	 * storages created by CreateStorageURI(); this verifies that
+	 * the wrapper passes on the PrefetchDirectory() hint.
+	 */
+	const std::unique_ptr<Storage> instrumented_storage =
+		InstrumentStorage(std::move(fake_storage), "fake://");
+	std::unique_ptr<Directory> root{Directory::NewRoot()};
+
+	void SetUp() override {
+		storage.MakeDirectory("a"sv, 1);
+		storage.MakeDirectory("a/b"sv, 1);
+		storage.MakeDirectory("a/b/c"sv, 1);
+		storage.MakeDirectory("d"sv, 1);
+
+		ASSERT_TRUE(Walk(false));
+	}
+
+	bool Walk(bool trust_mtime, const char *uri=nullptr,
+		  bool discard=false) {
+		UpdateConfig config{ConfigData{}};
+		config.trust_directory_mtime = trust_mtime;
+
+		storage.opened.clear();
+		storage.prefetched.clear();
+		UpdateWalk walk{config, event_loop, listener,
+				*instrumented_storage};
+		return walk.Walk(*root, uri, discard);
+	}
+
+	bool Exists(std::string_view uri) noexcept {
+		const ScopeDatabaseLock protect;
+		return root->LookupDirectory(uri).rest.empty();
+	}
+};
+
+TEST_F(UpdateWalkTest, NoTrust)
+{
+	/* without trust_directory_mtime, all directories are
+	   enumerated */
+	EXPECT_FALSE(Walk(false));
+	EXPECT_EQ(storage.opened,
+		  (std::multiset<std::string, std::less<>>{"", "a", "a/b", "a/b/c", "d"}));
+
+	/* all subdirectories were announced before they were
+	   opened */
+	EXPECT_EQ(storage.prefetched,
+		  (std::multiset<std::string, std::less<>>{"a", "a/b", "a/b/c", "d"}));
+}
+
+TEST_F(UpdateWalkTest, Unmodified)
+{
+	/* only the directory named by the update request is
+	   enumerated; its unmodified subdirectories are only
+	   stat'ed */
+	EXPECT_FALSE(Walk(true));
+	EXPECT_EQ(storage.opened,
+		  (std::multiset<std::string, std::less<>>{""}));
+	EXPECT_TRUE(storage.prefetched.empty());
+
+	EXPECT_TRUE(Exists("a/b/c"sv));
+	EXPECT_TRUE(Exists("d"sv));
+
+	EXPECT_FALSE(Walk(true, "a"));
+	EXPECT_EQ(storage.opened,
+		  (std::multiset<std::string, std::less<>>{"a"}));
+}
+
+TEST_F(UpdateWalkTest, Modified)
+{
+	/* a new subdirectory changes the parent's mtime */
+	storage.MakeDirectory("a/b/e"sv, 1);
+	storage.Touch("a/b"sv, 2);
+
+	EXPECT_TRUE(Walk(true));
+	EXPECT_EQ(storage.opened,
+		  (std::multiset<std::string, std::less<>>{"", "a/b", "a/b/e"}));
+	EXPECT_TRUE(Exists("a/b/e"sv));
+
+	/* only the new subdirectory was announced; "a/b/c" is
+	   unmodified and is not opened */
+	EXPECT_EQ(storage.prefetched,
+		  (std::multiset<std::string, std::less<>>{"a/b/e"}));
+
+	/* the new mtime has been recorded */
+	EXPECT_FALSE(Walk(true));
+	EXPECT_EQ(storage.opened,
+		  (std::multiset<std::string, std::less<>>{""}));
+}
+
+TEST_F(UpdateWalkTest, Removed)
+{
+	/* even if the parent's mtime is unchanged, the subdirectories
+	   are stat'ed, and vanished ones are removed */
+	storage.Remove("a/b/c"sv);
+
+	EXPECT_TRUE(Walk(true));
+	EXPECT_EQ(storage.opened,
+		  (std::multiset<std::string, std::less<>>{""}));
+	EXPECT_TRUE(Exists("a/b"sv));
+	EXPECT_FALSE(Exists("a/b/c"sv));
+}
+
+TEST_F(UpdateWalkTest, Discard)
+{
+	/* "rescan" ignores trust_directory_mtime */
+	EXPECT_FALSE(Walk(true, nullptr, true));
+	EXPECT_EQ(storage.opened,
+		  (std::multiset<std::string, std::less<>>{"", "a", "a/b", "a/b/c", "d"}));
+}
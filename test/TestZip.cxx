@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "lib/zip/Directory.hxx"
+#include "lib/zip/Inflate.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "util/PackedLittleEndian.hxx"
+#include "util/SpanCast.hxx"
+
+#include <gtest/gtest.h>
+
+#include <zlib.h>
+
+#include <cstring>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+
+class ZipWriter {
+	std::vector<std::byte> data, directory;
+	unsigned n_entries = 0;
+
+	static void Append(std::vector<std::byte> &dest,
+			   std::span<const std::byte> src) noexcept {
+		dest.insert(dest.end(), src.begin(), src.end());
+	}
+
+	static void Append16(std::vector<std::byte> &dest, uint16_t value) noexcept {
+		const PackedLE16 packed{value};
+		Append(dest, ReferenceAsBytes(packed));
+	}
+
+	static void Append32(std::vector<std::byte> &dest, uint32_t value) noexcept {
+		const PackedLE32 packed{value};
+		Append(dest, ReferenceAsBytes(packed));
+	}
+
+public:
+	void Add(std::string_view name, std::span<const std::byte> contents,
+		 bool compress) {
+		std::vector<std::byte> compressed;
+		if (compress) {
+			z_stream z{};
+			EXPECT_EQ(deflateInit2(&z, 6, Z_DEFLATED, -MAX_WBITS, 8,
+					       Z_DEFAULT_STRATEGY), Z_OK);
+			compressed.resize(deflateBound(&z, contents.size()));
+			z.next_in = (Bytef *)const_cast<std::byte *>(contents.data());
+			z.avail_in = contents.size();
+			z.next_out = (Bytef *)compressed.data();
+			z.avail_out = compressed.size();
+			EXPECT_EQ(deflate(&z, Z_FINISH), Z_STREAM_END);
+			compressed.resize(z.total_out);
+			deflateEnd(&z);
+		} else
+			compressed.assign(contents.begin(), contents.end());
+
+		const uint32_t crc = crc32(0, (const Bytef *)contents.data(),
+					   contents.size());
+		const uint32_t header_offset = data.size();
+		const uint16_t method = compress ? 8 : 0;
+
+		Append32(data, 0x04034b50);
+		Append16(data, 20);
+		Append16(data, 0);
+		Append16(data, method);
+		Append32(data, 0);
+		Append32(data, crc);
+		Append32(data, compressed.size());
+		Append32(data, contents.size());
+		Append16(data, name.size());
+		Append16(data, 0);
+		Append(data, AsBytes(name));
+		Append(data, compressed);
+
+		Append32(directory, 0x02014b50);
+		Append16(directory, 20);
+		Append16(directory, 20);
+		Append16(directory, 0);
+		Append16(directory, method);
+		Append32(directory, 0);
+		Append32(directory, crc);
+		Append32(directory, compressed.size());
+		Append32(directory, contents.size());
+		Append16(directory, name.size());
+		Append16(directory, 0);
+		Append16(directory, 0);
+		Append16(directory, 0);
+		Append16(directory, 0);
+		Append32(directory, 0);
+		Append32(directory, header_offset);
+		Append(directory, AsBytes(name));
+
+		++n_entries;
+	}
+
+	std::vector<std::byte> Finish(std::string_view comment) {
+		std::vector<std::byte> result = data;
+		Append(result, directory);
+
+		Append32(result, 0x06054b50);
+		Append16(result, 0);
+		Append16(result, 0);
+		Append16(result, n_entries);
+		Append16(result, n_entries);
+		Append32(result, directory.size());
+		Append32(result, data.size());
+		Append16(result, comment.size());
+		Append(result, AsBytes(comment));
+		return result;
+	}
+};
+
+/**
+ * Generate moderately compressible data.
+ */
+static std::vector<std::byte>
+MakeContents(std::size_t size)
+{
+	std::minstd_rand rng;
+	std::vector<std::byte> result(size);
+	for (auto &i : result)
+		i = std::byte('a' + rng() % 16);
+	return result;
+}
+
+class ZipTest : public ::testing::Test {
+protected:
+	static constexpr std::size_t BIG_SIZE = 3 * 1024 * 1024 + 12345;
+
+	std::vector<std::byte> small, big;
+	UniqueFileDescriptor fd;
+
+	void SetUp() override {
+		small = MakeContents(1000);
+		big = MakeContents(BIG_SIZE);
+
+		ZipWriter writer;
+		writer.Add("dir/", {}, false);
+		writer.Add("dir/stored.txt", small, false);
+		writer.Add("dir/deflated.txt", big, true);
+
+		/* the signature in the comment must not confuse
+		   the parser */
+		const auto zip = writer.Finish("PK\x05\x06 comment");
+
+		char path[] = "/tmp/TestZip.XXXXXX";
+		const int _fd = mkstemp(path);
+		ASSERT_GE(_fd, 0);
+		unlink(path);
+
+		fd = UniqueFileDescriptor{AdoptTag{}, _fd};
+		fd.FullWrite(zip);
+	}
+
+	void ExpectRead(ZipInflateReader &reader, std::size_t offset,
+			std::size_t length) {
+		reader.Seek(offset);
+		EXPECT_EQ(reader.GetOffset(), offset);
+
+		std::vector<std::byte> buffer(length);
+		std::size_t position = 0;
+		while (position < length) {
+			std::size_t n = reader.Read(std::span{buffer}.subspan(position));
+			if (n == 0)
+				break;
+			position += n;
+		}
+
+		length = std::min(length, big.size() - offset);
+		ASSERT_EQ(position, length);
+		EXPECT_EQ(std::memcmp(buffer.data(), big.data() + offset, length), 0);
+	}
+};
+
+} // anonymous namespace
+
+TEST_F(ZipTest, Directory)
+{
+	const ZipDirectory directory{fd};
+	ASSERT_EQ(directory.GetEntries().size(), 3U);
+	EXPECT_TRUE(directory.GetEntries()[0].IsDirectory());
+
+	const auto *stored = directory.Find("dir/stored.txt");
+	ASSERT_NE(stored, nullptr);
+	EXPECT_EQ(stored->method, ZipMethod::STORED);
+	EXPECT_EQ(stored->size, small.size());
+	EXPECT_EQ(directory.GetIndex(*stored), 1U);
+
+	const auto *deflated = directory.Find("dir/deflated.txt");
+	ASSERT_NE(deflated, nullptr);
+	EXPECT_EQ(deflated->method, ZipMethod::DEFLATED);
+	EXPECT_EQ(deflated->size, big.size());
+	EXPECT_LT(deflated->compressed_size, deflated->size);
+
+	EXPECT_EQ(directory.Find("dir/missing.txt"), nullptr);
+}
+
+TEST_F(ZipTest, Stored)
+{
+	const ZipDirectory directory{fd};
+	const auto &entry = *directory.Find("dir/stored.txt");
+	const auto data_offset = ReadZipDataOffset(fd, entry);
+
+	std::vector<std::byte> buffer(100);
+	ZipReadFull(fd, data_offset + 500, buffer);
+	EXPECT_EQ(std::memcmp(buffer.data(), small.data() + 500, buffer.size()), 0);
+}
+
+TEST_F(ZipTest, Inflate)
+{
+	const ZipDirectory directory{fd};
+	const auto &entry = *directory.Find("dir/deflated.txt");
+	const auto data_offset = ReadZipDataOffset(fd, entry);
+
+	ZipInflateIndex index;
+	ZipInflateReader reader(fd, data_offset, entry.compressed_size,
+				entry.size, index);
+
+	/* seek backwards without checkpoints */
+	ExpectRead(reader, 300000, 5000);
+	ExpectRead(reader, 1000, 5000);
+	EXPECT_EQ(index.size(), 0U);
+
+	/* reading everything records checkpoints */
+	ExpectRead(reader, 0, BIG_SIZE);
+	const std::size_t n_checkpoints = index.size();
+	EXPECT_GE(n_checkpoints, 2U);
+	EXPECT_LE(n_checkpoints, BIG_SIZE / ZipInflateIndex::SPAN);
+
+	/* another reader shares the index */
+	ZipInflateReader reader2(fd, data_offset, entry.compressed_size,
+				 entry.size, index);
+	std::minstd_rand rng;
+	for (unsigned i = 0; i < 32; ++i)
+		ExpectRead(reader2, rng() % BIG_SIZE, 20000);
+
+	ExpectRead(reader2, BIG_SIZE - 10, 100);
+	ExpectRead(reader2, 2 * ZipInflateIndex::SPAN + 1, 100);
+	ExpectRead(reader2, 0, 100);
+	EXPECT_EQ(index.size(), n_checkpoints);
+}
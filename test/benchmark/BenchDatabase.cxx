@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Benchmarks for the "simple" database plugin with synthetic
+ * databases: Directory::Walk(), db_save_internal() and
+ * db_load_internal().
+ */
+
+#include "Suites.hxx"
+#include "Harness.hxx"
+#include "Synthetic.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "song/Filter.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "io/LineReader.hxx"
+#include "io/StringOutputStream.hxx"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct DirectoryDeleter {
+	void operator()(Directory *directory) const noexcept {
+		const ScopeDatabaseLock protect;
+		delete directory;
+	}
+};
+
+using DirectoryPtr = std::unique_ptr<Directory, DirectoryDeleter>;
+
+/**
+ * A #LineReader which parses a copy of a string in memory.
+ */
+class MemoryLineReader final : public LineReader {
+	std::vector<char> buffer;
+	char *p, *end;
+
+public:
+	explicit MemoryLineReader(const std::string &src) noexcept
+		:buffer(src.begin(), src.end()),
+		 p(buffer.data()), end(p + buffer.size()) {}
+
+	/* virtual methods from class LineReader */
+	char *ReadLine() override {
+		if (p == end)
+			return nullptr;
+
+		char *line = p;
+		char *eol = static_cast<char *>(memchr(p, '\n', end - p));
+		if (eol == nullptr)
+			eol = end;
+
+		p = eol == end ? end : eol + 1;
+
+		while (eol > line && (eol[-1] == ' ' || eol[-1] == '\r'))
+			--eol;
+		*eol = 0;
+		return line;
+	}
+};
+
+} // anonymous namespace
+
+static DirectoryPtr
+MakeSyntheticDatabase(unsigned n_songs)
+{
+	DirectoryPtr root{Directory::NewRoot()};
+
+	const ScopeDatabaseLock protect;
+
+	Directory *artist_directory = nullptr, *album_directory = nullptr;
+	for (unsigned i = 0; i < n_songs; ++i) {
+		const unsigned track = i % SYNTHETIC_TRACKS_PER_ALBUM;
+
+		if (track == 0) {
+			if (GetSyntheticAlbum(i) % SYNTHETIC_ALBUMS_PER_ARTIST == 0)
+				artist_directory = root->CreateChild(fmt::format("Artist {}",
+										  GetSyntheticArtist(i)));
+
+			album_directory = artist_directory->CreateChild(fmt::format("Album {}",
+										    GetSyntheticAlbum(i)));
+			album_directory->mtime = std::chrono::system_clock::from_time_t(1500000000 + i);
+		}
+
+		auto song = std::make_unique<Song>(fmt::format("{:02} Title {}.flac",
+								track + 1, i),
+						   *album_directory);
+		song->tag = MakeSyntheticTag(i);
+		song->mtime = std::chrono::system_clock::from_time_t(1500000000 + i);
+		song->audio_format = {44100, SampleFormat::S16, 2};
+		album_directory->AddSong(std::move(song));
+	}
+
+	return root;
+}
+
+static std::string
+SaveDatabase(const Directory &root)
+{
+	StringOutputStream sos;
+	BufferedOutputStream bos{sos};
+
+	{
+		const ScopeDatabaseLock protect;
+		db_save_internal(bos, root);
+	}
+
+	bos.Flush();
+	return std::move(sos).GetValue();
+}
+
+static void
+AddDatabaseBenchmarks(BenchmarkRunner &runner, unsigned n_songs)
+{
+	const auto walk_name = fmt::format("db/walk/{}", n_songs);
+	const auto walk_filter_name = fmt::format("db/walk_filter/{}", n_songs);
+	const auto save_name = fmt::format("db/save/{}", n_songs);
+	const auto load_name = fmt::format("db/load/{}", n_songs);
+
+	if (!runner.IsEnabled(walk_name) &&
+	    !runner.IsEnabled(walk_filter_name) &&
+	    !runner.IsEnabled(save_name) &&
+	    !runner.IsEnabled(load_name))
+		return;
+
+	std::shared_ptr<const Directory> root{MakeSyntheticDatabase(n_songs)};
+	auto text = std::make_shared<const std::string>(SaveDatabase(*root));
+
+	runner.Add({
+		walk_name,
+		0, n_songs,
+		[root](uint_least64_t n){
+			unsigned count = 0;
+			const VisitSong visit_song = [&count](const LightSong &){
+				++count;
+			};
+
+			const ScopeDatabaseLock protect;
+			for (uint_least64_t i = 0; i < n; ++i)
+				root->Walk(true, nullptr, false, false,
+					   {}, visit_song, {});
+			DoNotOptimize(count);
+		},
+	});
+
+	auto filter = std::make_shared<SongFilter>();
+	const char *const filter_args[] = {"(Genre == \"Jazz\")"};
+	filter->Parse(filter_args);
+	filter->Optimize();
+
+	runner.Add({
+		walk_filter_name,
+		0, n_songs,
+		[root, filter](uint_least64_t n){
+			unsigned count = 0;
+			const VisitSong visit_song = [&count](const LightSong &){
+				++count;
+			};
+
+			const ScopeDatabaseLock protect;
+			for (uint_least64_t i = 0; i < n; ++i)
+				root->Walk(true, filter.get(), false, false,
+					   {}, visit_song, {});
+			DoNotOptimize(count);
+		},
+	});
+
+	runner.Add({
+		save_name,
+		text->size(), n_songs,
+		[root](uint_least64_t n){
+			for (uint_least64_t i = 0; i < n; ++i)
+				DoNotOptimize(SaveDatabase(*root).size());
+		},
+	});
+
+	/* this includes copying the text and freeing the loaded
+	   tree, both of which are small compared to parsing */
+	runner.Add({
+		load_name,
+		text->size(), n_songs,
+		[text](uint_least64_t n){
+			for (uint_least64_t i = 0; i < n; ++i) {
+				DirectoryPtr loaded{Directory::NewRoot()};
+				MemoryLineReader reader{*text};
+				db_load_internal(reader, *loaded, true);
+			}
+		},
+	});
+
+	/* run now, so the database can be freed before the next
+	   (larger) one is created */
+	runner.Run();
+}
+
+void
+AddDatabaseBenchmarks(BenchmarkRunner &runner,
+		      std::span<const unsigned> sizes)
+{
+	for (const unsigned n_songs : sizes)
+		AddDatabaseBenchmarks(runner, n_songs);
+}
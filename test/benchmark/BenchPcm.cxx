@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Benchmarks for the PCM conversion, volume and mixing code with
+ * synthetic input in every sample format.
+ */
+
+#include "Suites.hxx"
+#include "Harness.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "pcm/Convert.hxx"
+#include "pcm/Dither.hxx"
+#include "pcm/Mix.hxx"
+#include "pcm/Volume.hxx"
+#include "config.h"
+
+#include <fmt/core.h>
+
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+static constexpr unsigned N_FRAMES = 4096;
+static constexpr unsigned N_CHANNELS = 2;
+
+static constexpr SampleFormat sample_formats[] = {
+	SampleFormat::S8,
+	SampleFormat::S16,
+	SampleFormat::S24_P32,
+	SampleFormat::S32,
+	SampleFormat::FLOAT,
+#ifdef ENABLE_DSD
+	SampleFormat::DSD,
+#endif
+};
+
+/**
+ * Generate reproducible pseudo-random samples in the given format.
+ */
+static std::vector<std::byte>
+GeneratePcm(SampleFormat format, unsigned seed)
+{
+	const AudioFormat af{44100, format, N_CHANNELS};
+	std::vector<std::byte> buffer(N_FRAMES * af.GetFrameSize());
+
+	std::minstd_rand engine{seed};
+
+	const auto fill = [&buffer](auto g){
+		using T = decltype(g());
+		for (std::size_t i = 0; i < buffer.size(); i += sizeof(T)) {
+			const T value = g();
+			memcpy(buffer.data() + i, &value, sizeof(value));
+		}
+	};
+
+	switch (format) {
+	case SampleFormat::UNDEFINED:
+		break;
+
+	case SampleFormat::S8:
+	case SampleFormat::DSD:
+		fill([&engine]{ return int8_t(engine()); });
+		break;
+
+	case SampleFormat::S16:
+		fill([&engine]{ return int16_t(engine()); });
+		break;
+
+	case SampleFormat::S24_P32:
+		fill([&engine]{
+			/* sign-extend 24 bit */
+			return int32_t(uint32_t(engine()) << 8) >> 8;
+		});
+		break;
+
+	case SampleFormat::S32:
+		fill([&engine]{ return int32_t(engine() << 1); });
+		break;
+
+	case SampleFormat::FLOAT:
+		fill([&engine, dis = std::uniform_real_distribution<float>(-1, 1)]() mutable {
+			return dis(engine);
+		});
+		break;
+	}
+
+	return buffer;
+}
+
+static void
+AddConvert(BenchmarkRunner &runner, SampleFormat src, SampleFormat dest)
+{
+	auto name = fmt::format("pcm/convert/{}->{}",
+				sample_format_to_string(src),
+				sample_format_to_string(dest));
+	if (!runner.IsEnabled(name))
+		return;
+
+	auto buffer = std::make_shared<const std::vector<std::byte>>(GeneratePcm(src, 1));
+
+	/* DSD uses the byte rate of DSD64; sample rate conversion is
+	   not benchmarked here */
+	const unsigned rate = src == SampleFormat::DSD ? 352800 : 44100;
+	auto convert = std::make_shared<PcmConvert>(AudioFormat{rate, src, N_CHANNELS},
+						    AudioFormat{rate, dest, N_CHANNELS});
+
+	runner.Add({
+		std::move(name),
+		buffer->size(), N_FRAMES,
+		[buffer, convert](uint_least64_t n){
+			for (uint_least64_t i = 0; i < n; ++i)
+				DoNotOptimize(convert->Convert(*buffer).data());
+		},
+	});
+}
+
+static void
+AddVolume(BenchmarkRunner &runner, SampleFormat format)
+{
+	auto name = fmt::format("pcm/volume/{}",
+				sample_format_to_string(format));
+	if (!runner.IsEnabled(name))
+		return;
+
+	auto buffer = std::make_shared<const std::vector<std::byte>>(GeneratePcm(format, 2));
+
+	auto volume = std::make_shared<PcmVolume>();
+	volume->Open(format, false);
+	volume->SetVolume(PCM_VOLUME_1 / 2);
+
+	runner.Add({
+		std::move(name),
+		buffer->size(), N_FRAMES,
+		[buffer, volume](uint_least64_t n){
+			for (uint_least64_t i = 0; i < n; ++i)
+				DoNotOptimize(volume->Apply(*buffer).data());
+		},
+	});
+}
+
+static void
+AddMix(BenchmarkRunner &runner, SampleFormat format)
+{
+	auto name = fmt::format("pcm/mix/{}",
+				sample_format_to_string(format));
+	if (!runner.IsEnabled(name))
+		return;
+
+	auto a = std::make_shared<std::vector<std::byte>>(GeneratePcm(format, 3));
+	auto b = std::make_shared<const std::vector<std::byte>>(GeneratePcm(format, 4));
+
+	const std::size_t size = a->size();
+	runner.Add({
+		std::move(name),
+		size, N_FRAMES,
+		[a, b, format](uint_least64_t n){
+			PcmDither dither;
+			for (uint_least64_t i = 0; i < n; ++i)
+				if (!pcm_mix(dither, a->data(), b->data(), a->size(),
+					     format, 0.5))
+					throw std::runtime_error("pcm_mix() failed");
+			DoNotOptimize(a->front());
+		},
+	});
+}
+
+void
+AddPcmBenchmarks(BenchmarkRunner &runner)
+{
+	for (const auto format : sample_formats) {
+		if (format != SampleFormat::S16)
+			AddConvert(runner, format, SampleFormat::S16);
+		if (format != SampleFormat::FLOAT)
+			AddConvert(runner, format, SampleFormat::FLOAT);
+
+		/* volume and mixing are not implemented for DSD */
+		if (format != SampleFormat::DSD) {
+			AddVolume(runner, format);
+			AddMix(runner, format);
+		}
+	}
+
+	AddConvert(runner, SampleFormat::FLOAT, SampleFormat::S24_P32);
+}
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Benchmarks for #MusicBuffer and #MusicPipe, i.e. the path of
+ * decoded PCM data from the decoder thread to the player thread.
+ */
+
+#include "Suites.hxx"
+#include "Harness.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicPipe.hxx"
+#include "MusicChunk.hxx"
+#include "pcm/AudioFormat.hxx"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+
+static constexpr AudioFormat audio_format{44100, SampleFormat::S16, 2};
+
+/**
+ * The number of chunks in the #MusicBuffer; the default
+ * "audio_buffer_size" (4 MiB) has 1024 chunks.
+ */
+static constexpr unsigned N_CHUNKS = 1024;
+
+/**
+ * Fill a chunk like the decoder does.
+ */
+static void
+FillChunk(MusicChunk &chunk, std::span<const std::byte> src) noexcept
+{
+	const auto w = chunk.Write(audio_format, SongTime::zero(), 1411);
+	const std::size_t n = std::min(w.size(), src.size());
+	memcpy(w.data(), src.data(), n);
+	chunk.Expand(audio_format, n);
+}
+
+void
+AddPipeBenchmarks(BenchmarkRunner &runner)
+{
+	const std::size_t chunk_data_size =
+		sizeof(MusicChunk::data) / audio_format.GetFrameSize()
+		* audio_format.GetFrameSize();
+
+	auto pcm = std::make_shared<std::array<std::byte, sizeof(MusicChunk::data)>>();
+	for (std::size_t i = 0; i < pcm->size(); ++i)
+		(*pcm)[i] = std::byte(i * 7);
+
+	/* the buffer is shared by all runs, because its constructor
+	   and destructor (mmap(), munmap()) are expensive and not
+	   part of the hot path */
+	auto buffer = std::make_shared<MusicBuffer>(N_CHUNKS);
+
+	/* allocate, fill, push and later shift and free the chunk,
+	   keeping the pipe half full like during playback */
+	runner.Add({
+		"pipe/push_shift",
+		chunk_data_size, 1,
+		[buffer, pcm](uint_least64_t n){
+			MusicPipe pipe;
+
+			for (uint_least64_t i = 0; i < n; ++i) {
+				auto chunk = buffer->Allocate();
+				FillChunk(*chunk, *pcm);
+				pipe.Push(std::move(chunk));
+
+				if (pipe.GetSize() >= N_CHUNKS / 2)
+					DoNotOptimize(pipe.Shift()->length);
+			}
+
+			pipe.Clear();
+		},
+	});
+
+	/* allocating and freeing chunks only */
+	runner.Add({
+		"pipe/allocate",
+		0, 1,
+		[buffer](uint_least64_t n){
+			/* keep one chunk allocated, or else freeing the
+			   last one would discard the buffer's memory
+			   each time */
+			const auto pinned = buffer->Allocate();
+
+			for (uint_least64_t i = 0; i < n; ++i)
+				DoNotOptimize(buffer->Allocate().get());
+		},
+	});
+}
@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Benchmarks for common edit patterns on a large #Queue.
+ */
+
+#include "Suites.hxx"
+#include "Harness.hxx"
+#include "queue/Queue.hxx"
+#include "song/DetachedSong.hxx"
+
+#include <memory>
+#include <random>
+
+#include <stdlib.h>
+
+/**
+ * The number of songs in the queue.
+ */
+static constexpr unsigned QUEUE_LENGTH = 100000;
+
+namespace {
+
+/**
+ * A queue filled with #QUEUE_LENGTH songs, shared by all benchmarks
+ * of one kind.  The benchmarks keep its length constant.
+ */
+struct QueueFixture {
+	Queue queue{QUEUE_LENGTH * 2};
+	std::minstd_rand rng;
+
+	explicit QueueFixture(bool random) {
+		for (unsigned i = 0; i < QUEUE_LENGTH; ++i)
+			queue.Append(DetachedSong("foo.ogg"), 0);
+
+		if (random) {
+			queue.random = true;
+			queue.ShuffleOrder();
+		}
+	}
+
+	unsigned RandomIndex(unsigned size) noexcept {
+		return std::uniform_int_distribution<unsigned>(0, size - 1)(rng);
+	}
+
+	unsigned RandomPosition() noexcept {
+		return RandomIndex(queue.GetLength());
+	}
+};
+
+} // anonymous namespace
+
+void
+AddQueueBenchmarks(BenchmarkRunner &runner)
+{
+	runner.Add({
+		"queue/append",
+		0, 1,
+		[](uint_least64_t n){
+			Queue queue(n);
+			for (uint_least64_t i = 0; i < n; ++i)
+				queue.Append(DetachedSong("foo.ogg"), 0);
+			DoNotOptimize(queue.GetLength());
+		},
+	});
+
+	if (runner.IsAnyEnabled({"queue/move_position", "queue/move_range",
+				 "queue/delete_append", "queue/id_to_position",
+				 "queue/find_changed_ranges"})) {
+		auto f = std::make_shared<QueueFixture>(false);
+
+		runner.Add({
+			"queue/move_position",
+			0, 1,
+			[f](uint_least64_t n){
+				for (uint_least64_t i = 0; i < n; ++i)
+					f->queue.MovePostion(f->RandomPosition(),
+							     f->RandomPosition());
+			},
+		});
+
+		runner.Add({
+			"queue/move_range",
+			0, 1,
+			[f](uint_least64_t n){
+				const unsigned length = f->queue.GetLength();
+				for (uint_least64_t i = 0; i < n; ++i) {
+					const unsigned start = f->RandomIndex(length - 8);
+					f->queue.MoveRange(start, start + 8,
+							   f->RandomIndex(length - 8 + 1));
+				}
+			},
+		});
+
+		runner.Add({
+			"queue/delete_append",
+			0, 1,
+			[f](uint_least64_t n){
+				for (uint_least64_t i = 0; i < n; ++i) {
+					f->queue.DeletePosition(f->RandomPosition());
+					f->queue.Append(DetachedSong("bar.ogg"), 0);
+				}
+			},
+		});
+
+		runner.Add({
+			"queue/id_to_position",
+			0, 1,
+			[f](uint_least64_t n){
+				for (uint_least64_t i = 0; i < n; ++i) {
+					const unsigned position = f->RandomPosition();
+					if (f->queue.IdToPosition(f->queue.PositionToId(position)) != int(position))
+						abort();
+				}
+			},
+		});
+
+		runner.Add({
+			"queue/find_changed_ranges",
+			0, 1,
+			[f](uint_least64_t n){
+				auto &queue = f->queue;
+
+				for (uint_least64_t i = 0; i < n; ++i) {
+					queue.IncrementVersion();
+					const auto old_version = queue.version;
+					queue.ModifyAtPosition(f->RandomPosition());
+					queue.IncrementVersion();
+
+					unsigned n_changed = 0;
+					for (const auto &[start, end] :
+						     queue.FindChangedRanges(old_version, 0, queue.GetLength()))
+						for (unsigned j = start; j < end; ++j)
+							n_changed += queue.IsNewerAtPosition(j, old_version);
+
+					if (n_changed != 1)
+						abort();
+				}
+			},
+		});
+	}
+
+	if (runner.IsAnyEnabled({"queue/random/shuffle",
+				 "queue/random/move_position",
+				 "queue/random/set_priority",
+				 "queue/random/delete_append"})) {
+		auto f = std::make_shared<QueueFixture>(true);
+
+		runner.Add({
+			"queue/random/shuffle",
+			0, QUEUE_LENGTH,
+			[f](uint_least64_t n){
+				for (uint_least64_t i = 0; i < n; ++i)
+					f->queue.ShuffleOrder();
+			},
+		});
+
+		runner.Add({
+			"queue/random/move_position",
+			0, 1,
+			[f](uint_least64_t n){
+				for (uint_least64_t i = 0; i < n; ++i)
+					f->queue.MovePostion(f->RandomPosition(),
+							     f->RandomPosition());
+			},
+		});
+
+		runner.Add({
+			"queue/random/set_priority",
+			0, 1,
+			[f](uint_least64_t n){
+				for (uint_least64_t i = 0; i < n; ++i)
+					f->queue.SetPriority(f->RandomPosition(),
+							     f->RandomIndex(256), 0);
+			},
+		});
+
+		runner.Add({
+			"queue/random/delete_append",
+			0, 1,
+			[f](uint_least64_t n){
+				auto &queue = f->queue;
+
+				for (uint_least64_t i = 0; i < n; ++i) {
+					queue.DeletePosition(f->RandomPosition());
+					queue.Append(DetachedSong("bar.ogg"), 0);
+					queue.ShuffleOrderLastWithPriority(0, queue.GetLength());
+				}
+			},
+		});
+	}
+}
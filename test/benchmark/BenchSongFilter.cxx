@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Benchmarks for SongFilter::Match() as used by "find", "search"
+ * and "list".
+ */
+
+#include "Suites.hxx"
+#include "Harness.hxx"
+#include "Synthetic.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+static constexpr unsigned N_SONGS = 10000;
+
+namespace {
+
+struct SyntheticSongs {
+	std::vector<std::string> uris;
+	std::vector<Tag> tags;
+	std::vector<LightSong> songs;
+
+	explicit SyntheticSongs(unsigned n) {
+		uris.reserve(n);
+		tags.reserve(n);
+		songs.reserve(n);
+
+		for (unsigned i = 0; i < n; ++i) {
+			uris.emplace_back(fmt::format("Artist {}/Album {}/{:02}.flac",
+						      GetSyntheticArtist(i),
+						      GetSyntheticAlbum(i),
+						      i % SYNTHETIC_TRACKS_PER_ALBUM + 1));
+			tags.emplace_back(MakeSyntheticTag(i));
+			songs.emplace_back(uris.back().c_str(), tags.back());
+		}
+	}
+};
+
+} // anonymous namespace
+
+static constexpr struct {
+	const char *name, *expression;
+} filters[] = {
+	{ "filter/tag_equal", "(Artist == \"Artist 42\")" },
+	{ "filter/tag_contains_ci", "(Title contains_ci \"title 99\")" },
+	{ "filter/any_contains_ci", "(any contains_ci \"jazz\")" },
+	{ "filter/and", "((Genre == \"Jazz\") AND (Album starts_with \"Album 1\"))" },
+	{ "filter/base", "(base \"Artist 7\")" },
+};
+
+void
+AddSongFilterBenchmarks(BenchmarkRunner &runner)
+{
+	std::shared_ptr<const SyntheticSongs> songs;
+
+	for (const auto &i : filters) {
+		if (!runner.IsEnabled(i.name))
+			continue;
+
+		if (!songs)
+			songs = std::make_shared<const SyntheticSongs>(N_SONGS);
+
+		auto filter = std::make_shared<SongFilter>();
+		const char *const args[] = {i.expression};
+		filter->Parse(args);
+		filter->Optimize();
+
+		runner.Add({
+			i.name,
+			0, songs->songs.size(),
+			[songs, filter](uint_least64_t n){
+				unsigned matches = 0;
+				for (uint_least64_t j = 0; j < n; ++j)
+					for (const auto &song : songs->songs)
+						matches += filter->Match(song);
+				DoNotOptimize(matches);
+			},
+		});
+	}
+}
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Benchmarks for the tag pool when used by many threads
+ * concurrently (e.g. the database update and the decoder).
+ */
+
+#include "Suites.hxx"
+#include "Harness.hxx"
+#include "tag/Pool.hxx"
+#include "tag/Type.hxx"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * The number of values which all threads share, like artist and
+ * genre names.
+ */
+static constexpr unsigned N_SHARED = 64;
+
+namespace {
+
+struct SharedTagValues {
+	std::vector<std::string> values;
+
+	/**
+	 * One reference to each shared value, so the items are never
+	 * freed during the benchmark.
+	 */
+	std::vector<TagItem *> pinned;
+
+	SharedTagValues() {
+		values.reserve(N_SHARED);
+		pinned.reserve(N_SHARED);
+
+		for (unsigned i = 0; i < N_SHARED; ++i) {
+			values.emplace_back(fmt::format("Artist {}", i));
+			pinned.push_back(tag_pool_get_item(TAG_ARTIST,
+							   values.back()));
+		}
+	}
+
+	~SharedTagValues() noexcept {
+		for (auto *i : pinned)
+			tag_pool_put_item(i);
+	}
+
+	SharedTagValues(const SharedTagValues &) = delete;
+	SharedTagValues &operator=(const SharedTagValues &) = delete;
+};
+
+} // anonymous namespace
+
+/**
+ * Call the given function #n times in each of #n_threads threads,
+ * passing the thread index and the iteration.
+ */
+template<typename F>
+static void
+RunThreads(unsigned n_threads, uint_least64_t n, const F &f)
+{
+	std::vector<std::thread> threads;
+	threads.reserve(n_threads);
+	for (unsigned t = 0; t < n_threads; ++t)
+		threads.emplace_back([&f, t, n]{
+			for (uint_least64_t i = 0; i < n; ++i)
+				f(t, i);
+		});
+
+	for (auto &i : threads)
+		i.join();
+}
+
+void
+AddTagPoolBenchmarks(BenchmarkRunner &runner)
+{
+	if (!runner.IsAnyEnabled({"tag_pool/intern_shared", "tag_pool/intern_unique",
+				  "tag_pool/dup_put", "tag_pool/grow_free"}))
+		return;
+
+	const unsigned n_threads =
+		std::max(std::thread::hardware_concurrency(), 1U);
+
+	auto shared = std::make_shared<const SharedTagValues>();
+
+	/* each iteration performs one operation in each thread */
+
+	runner.Add({
+		"tag_pool/intern_shared",
+		0, n_threads,
+		[n_threads, shared](uint_least64_t n){
+			RunThreads(n_threads, n, [&shared](unsigned, uint_least64_t i){
+				tag_pool_put_item(tag_pool_get_item(TAG_ARTIST,
+								    shared->values[i % N_SHARED]));
+			});
+		},
+	});
+
+	runner.Add({
+		"tag_pool/intern_unique",
+		0, n_threads,
+		[n_threads](uint_least64_t n){
+			RunThreads(n_threads, n, [](unsigned t, uint_least64_t i){
+				char buffer[48];
+				const auto result = fmt::format_to_n(buffer, sizeof(buffer),
+								     "Title {} {}", t, i);
+				tag_pool_put_item(tag_pool_get_item(TAG_TITLE,
+								    {buffer, result.out}));
+			});
+		},
+	});
+
+	runner.Add({
+		"tag_pool/dup_put",
+		0, n_threads,
+		[n_threads, shared](uint_least64_t n){
+			RunThreads(n_threads, n, [&shared](unsigned t, uint_least64_t i){
+				tag_pool_put_item(tag_pool_dup_item(shared->pinned[(t + i) % N_SHARED]));
+			});
+		},
+	});
+
+	/* populate the pool with many items, forcing the hash tables
+	   to grow, and release them all at the end */
+	runner.Add({
+		"tag_pool/grow_free",
+		0, n_threads,
+		[n_threads](uint_least64_t n){
+			std::vector<std::vector<TagItem *>> items(n_threads);
+			for (auto &i : items)
+				i.reserve(n);
+
+			RunThreads(n_threads, n, [&items](unsigned t, uint_least64_t i){
+				char buffer[48];
+				const auto result = fmt::format_to_n(buffer, sizeof(buffer),
+								     "Album {} {}", t, i);
+				items[t].push_back(tag_pool_get_item(TAG_ALBUM,
+								     {buffer, result.out}));
+			});
+
+			for (const auto &i : items)
+				for (auto *item : i)
+					tag_pool_put_item(item);
+		},
+	});
+}
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Harness.hxx"
+#include "Version.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+
+using std::chrono::steady_clock;
+
+static void
+PrintJsonHeader(const BenchmarkRunner &runner)
+{
+#ifdef NDEBUG
+	static constexpr bool debug = false;
+#else
+	static constexpr bool debug = true;
+#endif
+
+	fmt::print(runner.out,
+		   "{{\n"
+		   "  \"context\": {{\"version\": \"{}\", \"debug\": {}, "
+		   "\"min_time_ns\": {}, \"repetitions\": {}}},\n"
+		   "  \"benchmarks\": [",
+		   VERSION, debug,
+		   std::chrono::duration_cast<std::chrono::nanoseconds>(runner.min_time).count(),
+		   runner.repetitions);
+}
+
+static steady_clock::duration
+Measure(const Benchmark &b, uint_least64_t n)
+{
+	const auto start = steady_clock::now();
+	b.run(n);
+	return steady_clock::now() - start;
+}
+
+void
+BenchmarkRunner::Run()
+{
+	for (const auto &i : benchmarks)
+		Run(i);
+
+	benchmarks.clear();
+}
+
+void
+BenchmarkRunner::Run(const Benchmark &b)
+{
+	/* warm up and find the number of iterations which takes
+	   at least #min_time */
+	uint_least64_t n = 1;
+	while (true) {
+		const auto d = Measure(b, n);
+		if (d >= min_time)
+			break;
+
+		/* grow at most by factor 10 per step, and aim a bit
+		   higher than necessary */
+		const double factor = d.count() > 0
+			? std::clamp(1.2 * min_time / d, 2.0, 10.0)
+			: 10.0;
+		n = uint_least64_t(n * factor);
+	}
+
+	std::vector<double> ns_per_op;
+	ns_per_op.reserve(repetitions);
+	for (unsigned i = 0; i < repetitions; ++i) {
+		const auto d = Measure(b, n);
+		ns_per_op.push_back(std::chrono::duration<double, std::nano>(d).count() / n);
+	}
+
+	std::sort(ns_per_op.begin(), ns_per_op.end());
+	const double median = ns_per_op[ns_per_op.size() / 2];
+	const double min = ns_per_op.front(), max = ns_per_op.back();
+
+	const double bytes_per_second = b.bytes * 1e9 / median;
+	const double items_per_second = b.items * 1e9 / median;
+
+	switch (format) {
+	case Format::TEXT:
+		fmt::print(out, "{:<40} {:>10} iterations {:>14.1f} ns/op",
+			   b.name, n, median);
+		if (b.bytes > 0)
+			fmt::print(out, " {:>10.1f} MiB/s",
+				   bytes_per_second / (1024 * 1024));
+		if (b.items > 1)
+			fmt::print(out, " {:>14.0f} items/s", items_per_second);
+		fmt::print(out, "\n");
+		break;
+
+	case Format::JSON:
+		if (first)
+			PrintJsonHeader(*this);
+
+		/* benchmark names are ASCII without quotes and
+		   backslashes, no escaping needed */
+		fmt::print(out,
+			   "{}\n    {{\"name\": \"{}\", \"iterations\": {}, "
+			   "\"ns_per_op\": {:.3f}, \"ns_per_op_min\": {:.3f}, \"ns_per_op_max\": {:.3f}, "
+			   "\"bytes_per_op\": {}, \"bytes_per_second\": {:.0f}, "
+			   "\"items_per_op\": {}, \"items_per_second\": {:.0f}}}",
+			   first ? "" : ",",
+			   b.name, n,
+			   median, min, max,
+			   b.bytes, bytes_per_second,
+			   b.items, items_per_second);
+		break;
+	}
+
+	first = false;
+	fflush(out);
+}
+
+void
+BenchmarkRunner::Finish()
+{
+	if (format == Format::JSON) {
+		if (first)
+			PrintJsonHeader(*this);
+
+		fmt::print(out, "\n  ]\n}}\n");
+	}
+}
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Prevent the compiler from optimizing away the computation of the
+ * given value.
+ */
+template<typename T>
+inline void
+DoNotOptimize(const T &value) noexcept
+{
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * One benchmark case.
+ */
+struct Benchmark {
+	/**
+	 * A unique name, components separated with slashes,
+	 * e.g. "pcm/volume/s16".
+	 */
+	std::string name;
+
+	/**
+	 * The number of bytes processed by one iteration; used to
+	 * calculate the throughput.  Zero if not applicable.
+	 */
+	uint_least64_t bytes = 0;
+
+	/**
+	 * The number of items (songs, chunks, ...) processed by one
+	 * iteration.
+	 */
+	uint_least64_t items = 1;
+
+	/**
+	 * Run the measured operation the given number of times.
+	 */
+	std::function<void(uint_least64_t n)> run;
+};
+
+/**
+ * A small benchmark harness.  Each benchmark is calibrated until one
+ * run takes at least #min_time, and then repeated; the median of the
+ * repetitions is reported.
+ */
+class BenchmarkRunner {
+	std::vector<Benchmark> benchmarks;
+
+public:
+	enum class Format {
+		/**
+		 * One line per benchmark for humans.
+		 */
+		TEXT,
+
+		/**
+		 * One JSON document with all results; this is meant
+		 * to be archived for tracking results over time.
+		 */
+		JSON,
+	};
+
+	Format format = Format::TEXT;
+
+	FILE *out = stdout;
+
+	/**
+	 * Run only benchmarks whose name contains this string.
+	 */
+	std::string filter;
+
+	std::chrono::steady_clock::duration min_time =
+		std::chrono::milliseconds{200};
+
+	unsigned repetitions = 3;
+
+	/**
+	 * Is the given benchmark enabled by #filter?  Use this to
+	 * skip expensive setup of benchmarks which are not going to
+	 * run.
+	 */
+	[[gnu::pure]]
+	bool IsEnabled(std::string_view name) const noexcept {
+		return name.find(filter) != name.npos;
+	}
+
+	/**
+	 * Is any of the given benchmarks enabled by #filter?
+	 */
+	[[gnu::pure]]
+	bool IsAnyEnabled(std::initializer_list<std::string_view> names) const noexcept {
+		return std::any_of(names.begin(), names.end(),
+				   [this](std::string_view name){
+					   return IsEnabled(name);
+				   });
+	}
+
+	void Add(Benchmark &&b) {
+		if (IsEnabled(b.name))
+			benchmarks.emplace_back(std::move(b));
+	}
+
+	/**
+	 * Run all benchmarks added so far and forget them.
+	 */
+	void Run();
+
+	/**
+	 * Finish the output; call this after the last Run() call.
+	 */
+	void Finish();
+
+private:
+	bool first = true;
+
+	void Run(const Benchmark &b);
+};
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Micro-benchmarks for hot paths: PCM conversion, the music pipe,
+ * song filters, the queue, the tag pool and the "simple" database.  All inputs are
+ * synthetic and generated with fixed seeds, so results are
+ * comparable between runs.
+ */
+
+#include "Suites.hxx"
+#include "Harness.hxx"
+#include "cmdline/OptionDef.hxx"
+#include "cmdline/OptionParser.hxx"
+#include "lib/icu/Init.hxx"
+#include "util/PrintException.hxx"
+#include "config.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include <stdlib.h>
+
+static constexpr auto usage_text = R"(Usage: RunBenchmark [OPTIONS]
+
+Options:
+  --json             emit one JSON document instead of text
+  --filter=STRING    run only benchmarks whose name contains STRING
+  --min-time=MS      minimum duration of one measurement (default 200)
+  --repetitions=N    number of measurements per benchmark (default 3)
+  --songs=N          size of a synthetic database; may be repeated
+                     (default 10000 and 100000)
+)";
+
+enum class Option {
+	JSON,
+	FILTER,
+	MIN_TIME,
+	REPETITIONS,
+	SONGS,
+};
+
+static constexpr OptionDef option_defs[] = {
+	{"json", 0, false, "Emit JSON"},
+	{"filter", 0, true, "Run only matching benchmarks"},
+	{"min-time", 0, true, "Minimum duration of one measurement [ms]"},
+	{"repetitions", 0, true, "Number of measurements per benchmark"},
+	{"songs", 0, true, "Size of a synthetic database"},
+};
+
+static unsigned
+ParsePositive(const char *s)
+{
+	char *endptr;
+	const auto value = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != 0 || value == 0)
+		throw std::runtime_error{usage_text};
+
+	return value;
+}
+
+int
+main(int argc, char **argv)
+try {
+	BenchmarkRunner runner;
+	std::vector<unsigned> database_sizes;
+
+	OptionParser option_parser(option_defs, argc, argv);
+	while (auto o = option_parser.Next()) {
+		switch (static_cast<Option>(o.index)) {
+		case Option::JSON:
+			runner.format = BenchmarkRunner::Format::JSON;
+			break;
+
+		case Option::FILTER:
+			runner.filter = o.value;
+			break;
+
+		case Option::MIN_TIME:
+			runner.min_time = std::chrono::milliseconds{ParsePositive(o.value)};
+			break;
+
+		case Option::REPETITIONS:
+			runner.repetitions = ParsePositive(o.value);
+			break;
+
+		case Option::SONGS:
+			database_sizes.push_back(ParsePositive(o.value));
+			break;
+		}
+	}
+
+	if (!option_parser.GetRemaining().empty())
+		throw std::runtime_error{usage_text};
+
+	if (database_sizes.empty())
+		database_sizes = {10000, 100000};
+
+	const ScopeIcuInit icu_init;
+
+	AddPcmBenchmarks(runner);
+	AddPipeBenchmarks(runner);
+	AddSongFilterBenchmarks(runner);
+	runner.Run();
+
+	/* these allocate large fixtures, which are freed after each
+	   Run() */
+	AddQueueBenchmarks(runner);
+	runner.Run();
+
+	AddTagPoolBenchmarks(runner);
+	runner.Run();
+
+#ifdef ENABLE_DATABASE
+	AddDatabaseBenchmarks(runner, database_sizes);
+#endif
+
+	runner.Finish();
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <span>
+
+class BenchmarkRunner;
+
+void
+AddPcmBenchmarks(BenchmarkRunner &runner);
+
+void
+AddPipeBenchmarks(BenchmarkRunner &runner);
+
+void
+AddSongFilterBenchmarks(BenchmarkRunner &runner);
+
+void
+AddQueueBenchmarks(BenchmarkRunner &runner);
+
+void
+AddTagPoolBenchmarks(BenchmarkRunner &runner);
+
+/**
+ * Unlike the other functions, this one runs the benchmarks
+ * immediately, so each synthetic database can be freed before the
+ * next one is created.
+ *
+ * @param sizes the number of songs in each synthetic database
+ */
+void
+AddDatabaseBenchmarks(BenchmarkRunner &runner,
+		      std::span<const unsigned> sizes);
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "tag/Builder.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Type.hxx"
+#include "Chrono.hxx"
+
+#include <fmt/core.h>
+
+#include <array>
+
+/*
+ * Reproducible synthetic song metadata: each album has 10 tracks,
+ * each artist has 10 albums.
+ */
+
+static constexpr unsigned SYNTHETIC_TRACKS_PER_ALBUM = 10;
+static constexpr unsigned SYNTHETIC_ALBUMS_PER_ARTIST = 10;
+
+inline unsigned
+GetSyntheticArtist(unsigned song) noexcept
+{
+	return song / (SYNTHETIC_TRACKS_PER_ALBUM * SYNTHETIC_ALBUMS_PER_ARTIST);
+}
+
+inline unsigned
+GetSyntheticAlbum(unsigned song) noexcept
+{
+	return song / SYNTHETIC_TRACKS_PER_ALBUM;
+}
+
+inline Tag
+MakeSyntheticTag(unsigned song) noexcept
+{
+	static constexpr std::array genres{
+		"Rock", "Pop", "Jazz", "Classical", "Electronic", "Hip-Hop",
+		"Blues", "Country", "Folk", "Metal", "Reggae", "Soul",
+		"Punk", "Ambient", "Latin", "Soundtrack",
+	};
+
+	const unsigned artist = GetSyntheticArtist(song);
+	const unsigned album = GetSyntheticAlbum(song);
+
+	TagBuilder b;
+	b.SetDuration(SignedSongTime::FromS(120 + song % 300));
+	b.AddItem(TAG_ARTIST, fmt::format("Artist {}", artist));
+	b.AddItem(TAG_ALBUM_ARTIST, fmt::format("Artist {}", artist));
+	b.AddItem(TAG_ALBUM, fmt::format("Album {}", album));
+	b.AddItem(TAG_TITLE, fmt::format("Title {}", song));
+	b.AddItem(TAG_TRACK, fmt::format("{}", song % SYNTHETIC_TRACKS_PER_ALBUM + 1));
+	b.AddItem(TAG_GENRE, genres[artist % genres.size()]);
+	b.AddItem(TAG_DATE, fmt::format("{}", 1960 + album % 64));
+	return b.Commit();
+}
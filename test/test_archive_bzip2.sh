@@ -8,3 +8,8 @@ mkdir -p test/tmp
 rm -f "$DST"
 bzip2 -c "$SRC" >"$DST"
 ./test/run_input "$DST/${SRC_BASE}" |diff "$SRC" -
+
+# trailing garbage which looks like a block header makes the block
+# index unusable; this must fall back to sequential decompression
+printf '\061\101\131\046\123\131garbage' >>"$DST"
+./test/run_input "$DST/${SRC_BASE}" |diff "$SRC" -
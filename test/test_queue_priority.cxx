@@ -4,7 +4,10 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <iterator>
+#include <random>
+#include <vector>
 
 Tag::Tag(const Tag &) noexcept {}
 void Tag::Clear() noexcept {}
@@ -23,7 +26,7 @@ check_descending_priority(const Queue *queue,
 	uint8_t last_priority = 0xff;
 	for (unsigned order = start_order; order < queue->GetLength(); ++order) {
 		unsigned position = queue->OrderToPosition(order);
-		uint8_t priority = queue->items[position].priority;
+		uint8_t priority = queue->GetPriorityAtPosition(position);
 		assert(priority <= last_priority);
 		(void)last_priority;
 		last_priority = priority;
@@ -129,7 +132,7 @@ TEST(QueuePriority, Priority)
 
 	unsigned a_order = 3;
 	unsigned a_position = queue.OrderToPosition(a_order);
-	EXPECT_EQ(10u, unsigned(queue.items[a_position].priority));
+	EXPECT_EQ(10u, unsigned(queue.GetPriorityAtPosition(a_position)));
 	queue.SetPriority(a_position, 20, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
@@ -146,7 +149,7 @@ TEST(QueuePriority, Priority)
 
 	unsigned b_order = 10;
 	unsigned b_position = queue.OrderToPosition(b_order);
-	EXPECT_EQ(0u, unsigned(queue.items[b_position].priority));
+	EXPECT_EQ(0u, unsigned(queue.GetPriorityAtPosition(b_position)));
 	queue.SetPriority(b_position, 70, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
@@ -161,7 +164,7 @@ TEST(QueuePriority, Priority)
 
 	a_order = queue.PositionToOrder(a_position);
 	EXPECT_EQ(5u, a_order);
-	EXPECT_EQ(20u, unsigned(queue.items[a_position].priority));
+	EXPECT_EQ(20u, unsigned(queue.GetPriorityAtPosition(a_position)));
 	queue.SetPriority(a_position, 5, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
@@ -170,3 +173,161 @@ TEST(QueuePriority, Priority)
 	a_order = queue.PositionToOrder(a_position);
 	EXPECT_EQ(6u, a_order);
 }
+
+/**
+ * Compare the queue with a simple array based model.
+ */
+static void
+check_queue(const Queue &queue, const std::vector<unsigned> &positions,
+	    const std::vector<unsigned> &orders)
+{
+	ASSERT_EQ(positions.size(), queue.GetLength());
+
+	for (unsigned i = 0; i < positions.size(); ++i) {
+		EXPECT_EQ(int(positions[i]), queue.PositionToId(i));
+		EXPECT_EQ(int(i), queue.IdToPosition(positions[i]));
+		EXPECT_EQ(orders[i],
+			  unsigned(queue.PositionToId(queue.OrderToPosition(i))));
+		EXPECT_EQ(i, queue.OrderToPosition(queue.PositionToOrder(i)));
+	}
+}
+
+/**
+ * Verify that Queue::FindChangedRanges() finds the same songs as a
+ * full scan.
+ */
+static void
+check_changes(const Queue &queue, uint32_t version)
+{
+	std::vector<unsigned> expected, found;
+
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		if (queue.IsNewerAtPosition(i, version))
+			expected.push_back(i);
+
+	for (const auto &[start, end] : queue.FindChangedRanges(version, 0,
+								queue.GetLength()))
+		for (unsigned i = start; i < end; ++i)
+			if (queue.IsNewerAtPosition(i, version))
+				found.push_back(i);
+
+	EXPECT_EQ(expected, found);
+}
+
+template<typename T>
+static void
+move_range(std::vector<T> &v, unsigned start, unsigned end, unsigned to)
+{
+	std::vector<T> range(v.begin() + start, v.begin() + end);
+	v.erase(v.begin() + start, v.begin() + end);
+	v.insert(v.begin() + to, range.begin(), range.end());
+}
+
+TEST(QueuePriority, Edit)
+{
+	Queue queue(256);
+	std::vector<unsigned> positions, orders;
+
+	for (unsigned i = 0; i < 64; ++i) {
+		const unsigned id = queue.Append(DetachedSong("x.ogg"), 0);
+		positions.push_back(id);
+		orders.push_back(id);
+	}
+
+	check_queue(queue, positions, orders);
+
+	std::minstd_rand rng;
+	auto random_index = [&rng](std::size_t n){
+		return std::uniform_int_distribution<unsigned>(0, n - 1)(rng);
+	};
+
+	for (unsigned round = 0; round < 2; ++round) {
+		/* first round outside of random mode, where the
+		   order follows the positions; then in random mode,
+		   where the order follows the songs */
+		const bool random = round > 0;
+		queue.random = random;
+
+		if (random) {
+			queue.ShuffleOrder();
+			for (unsigned i = 0; i < orders.size(); ++i)
+				orders[i] = queue.PositionToId(queue.OrderToPosition(i));
+		}
+
+		for (unsigned i = 0; i < 32; ++i) {
+			queue.IncrementVersion();
+
+			const unsigned from = random_index(positions.size());
+			const unsigned to = random_index(positions.size());
+			queue.MovePostion(from, to);
+
+			/* only the songs which have moved are
+			   reported as modified */
+			for (unsigned j = 0; j < positions.size(); ++j)
+				EXPECT_EQ(j >= std::min(from, to) &&
+					  j <= std::max(from, to),
+					  queue.IsNewerAtPosition(j, queue.version));
+			move_range(positions, from, from + 1, to);
+			if (!random)
+				move_range(orders, from, from + 1, to);
+
+			const unsigned start = random_index(positions.size() - 4);
+			const unsigned end = start + 1 + random_index(4);
+			const unsigned range_to =
+				random_index(positions.size() - (end - start) + 1);
+			queue.MoveRange(start, end, range_to);
+			move_range(positions, start, end, range_to);
+			if (!random)
+				move_range(orders, start, end, range_to);
+
+			const unsigned del = random_index(positions.size());
+			queue.DeletePosition(del);
+			std::erase(orders, positions[del]);
+			positions.erase(positions.begin() + del);
+
+			const unsigned id = queue.Append(DetachedSong("y.ogg"), 0);
+			positions.push_back(id);
+			orders.push_back(id);
+
+			const unsigned a = random_index(positions.size());
+			const unsigned b = random_index(positions.size());
+			queue.SwapOrders(a, b);
+			std::swap(orders[a], orders[b]);
+
+			check_queue(queue, positions, orders);
+			check_changes(queue, random_index(queue.version) + 1);
+		}
+	}
+
+	queue.RestoreOrder();
+	check_queue(queue, positions, positions);
+}
+
+TEST(QueuePriority, ShuffleLast)
+{
+	Queue queue(64);
+
+	for (unsigned i = 0; i < 16; ++i)
+		queue.Append(DetachedSong("x.ogg"), 0);
+
+	queue.SetPriorityRange(4, 8, 10, -1);
+	queue.random = true;
+	queue.ShuffleOrder();
+
+	/* append 16 more songs and shuffle them into the list in
+	   one call */
+	for (unsigned i = 0; i < 16; ++i)
+		queue.Append(DetachedSong("y.ogg"), 0);
+
+	queue.ShuffleOrderLastWithPriority(2, queue.GetLength(), 16);
+
+	check_descending_priority(&queue, 2);
+
+	std::vector<unsigned> positions;
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		positions.push_back(queue.OrderToPosition(i));
+
+	std::sort(positions.begin(), positions.end());
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		EXPECT_EQ(i, positions[i]);
+}
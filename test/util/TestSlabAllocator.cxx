@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "util/SlabAllocator.hxx"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <vector>
+
+namespace {
+
+struct alignas(16) Object {
+	std::byte data[40];
+};
+
+using Allocator = SlabAllocator<Object, 4>;
+
+} // anonymous namespace
+
+TEST(SlabAllocator, Empty)
+{
+	Allocator a;
+	EXPECT_EQ(a.GetCount(), 0U);
+	EXPECT_EQ(a.GetMemoryUsage(), 0U);
+	EXPECT_EQ(a.GetMemoryPerObject(), 0U);
+
+	/* like operator delete, nullptr is ignored */
+	a.Free(nullptr);
+	EXPECT_EQ(a.GetCount(), 0U);
+}
+
+TEST(SlabAllocator, Slabs)
+{
+	Allocator a;
+	std::vector<void *> objects;
+
+	objects.push_back(a.Allocate());
+	const std::size_t slab_size = a.GetMemoryUsage();
+	EXPECT_GE(slab_size, 4 * sizeof(Object));
+	EXPECT_EQ(a.GetMemoryPerObject(), slab_size);
+
+	/* the first slab has room for 4 objects */
+	for (unsigned i = 1; i < 4; ++i)
+		objects.push_back(a.Allocate());
+	EXPECT_EQ(a.GetCount(), 4U);
+	EXPECT_EQ(a.GetMemoryUsage(), slab_size);
+	EXPECT_EQ(a.GetMemoryPerObject(), slab_size / 4);
+
+	objects.push_back(a.Allocate());
+	EXPECT_EQ(a.GetCount(), 5U);
+	EXPECT_EQ(a.GetMemoryUsage(), 2 * slab_size);
+
+	/* all objects are distinct, aligned and writable */
+	const std::set<void *> unique(objects.begin(), objects.end());
+	EXPECT_EQ(unique.size(), objects.size());
+
+	for (void *p : objects) {
+		EXPECT_EQ(reinterpret_cast<std::uintptr_t>(p) % alignof(Object), 0U);
+		std::memset(p, 0xaa, sizeof(Object));
+	}
+
+	for (void *p : objects)
+		a.Free(p);
+
+	/* the last Free() has released all slabs */
+	EXPECT_EQ(a.GetCount(), 0U);
+	EXPECT_EQ(a.GetMemoryUsage(), 0U);
+}
+
+TEST(SlabAllocator, Reuse)
+{
+	Allocator a;
+
+	void *keep = a.Allocate();
+	void *p = a.Allocate();
+	void *q = a.Allocate();
+	const std::size_t slab_size = a.GetMemoryUsage();
+
+	/* freed slots are reused, the most recently freed one first */
+	a.Free(p);
+	a.Free(q);
+	EXPECT_EQ(a.GetCount(), 1U);
+	EXPECT_EQ(a.Allocate(), q);
+	EXPECT_EQ(a.Allocate(), p);
+
+	/* no new slab was needed */
+	EXPECT_EQ(a.GetCount(), 3U);
+	EXPECT_EQ(a.GetMemoryUsage(), slab_size);
+
+	a.Free(keep);
+	a.Free(p);
+	a.Free(q);
+	EXPECT_EQ(a.GetMemoryUsage(), 0U);
+}